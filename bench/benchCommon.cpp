@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+
+#include "benchCommon.hpp" // IWYU pragma: associated
+#include "config/ServerConfig.hpp"
+#include "metrics/MemoryAccounting.hpp"
+#include "net/NetworkManager.hpp"
+#include "net/websockets/WsListener.hpp"
+#include "net/websockets/WsServer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <string>
+
+namespace {
+
+#ifdef BOOSTANDER_MEMORY_ACCOUNTING
+
+// operator new is replaced by memory accounting, it counts allocations of all threads
+std::size_t totalAllocationsCount() { return boostander::metrics::getTotalAllocationsCount(); }
+
+void countThreadAllocations(bool) {}
+
+} // namespace
+
+#else
+
+std::atomic<std::size_t> gAllocationsCount{0};
+
+thread_local bool tCountAllocations = true;
+
+void countAllocation() {
+  if (tCountAllocations) {
+    gAllocationsCount.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+std::size_t totalAllocationsCount() { return gAllocationsCount.load(std::memory_order_relaxed); }
+
+void countThreadAllocations(bool enable) { tCountAllocations = enable; }
+
+} // namespace
+
+// NOTE: GCC 11+ takes free() in the replaced operator delete for a mismatch with operator new
+// wherever both are inlined, both are replaced here and match
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+// Replaced global allocation functions, only count calls
+void* operator new(std::size_t size) {
+  countAllocation();
+  if (void* ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+  countAllocation();
+  if (void* ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+#endif // BOOSTANDER_MEMORY_ACCOUNTING
+
+namespace boostander {
+namespace bench {
+
+namespace beast = boost::beast;         // from <boost/beast.hpp>
+namespace websocket = beast::websocket; // from <boost/beast/websocket.hpp>
+namespace net = boost::asio;            // from <boost/asio.hpp>
+using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
+namespace ssl = boost::asio::ssl;       // from <boost/asio/ssl.hpp>
+
+std::size_t allocationsCount() { return totalAllocationsCount(); }
+
+void countThisThreadAllocations(bool enable) { countThreadAllocations(enable); }
+
+double LatencyStats::percentileNs(double p) {
+  if (samples_.empty()) {
+    return 0.0;
+  }
+  if (!sorted_) {
+    std::sort(samples_.begin(), samples_.end());
+    sorted_ = true;
+  }
+  const double rank = p / 100.0 * static_cast<double>(samples_.size() - 1);
+  return static_cast<double>(samples_[static_cast<std::size_t>(std::llround(rank))]);
+}
+
+double LatencyStats::meanNs() const {
+  if (samples_.empty()) {
+    return 0.0;
+  }
+  return std::accumulate(samples_.begin(), samples_.end(), 0.0) /
+         static_cast<double>(samples_.size());
+}
+
+double LatencyStats::maxNs() { return percentileNs(100.0); }
+
+void addLatencyValues(BenchResult& result, const std::string& prefix, LatencyStats& stats) {
+  result.values[prefix + "_p50_us"] = stats.percentileNs(50.0) / 1000.0;
+  result.values[prefix + "_p99_us"] = stats.percentileNs(99.0) / 1000.0;
+  result.values[prefix + "_p999_us"] = stats.percentileNs(99.9) / 1000.0;
+  result.values[prefix + "_mean_us"] = stats.meanNs() / 1000.0;
+  result.values[prefix + "_max_us"] = stats.maxNs() / 1000.0;
+}
+
+void writeJsonReport(std::ostream& out, const std::string& benchName,
+                     const std::vector<BenchResult>& results) {
+  out << "{\n  \"benchmark\": \"" << benchName << "\",\n  \"results\": [";
+  for (std::size_t i = 0; i < results.size(); i++) {
+    out << (i ? ",\n" : "\n") << "    {\"name\": \"" << results[i].name << "\"";
+    for (const auto& kv : results[i].values) {
+      out << ", \"" << kv.first << "\": " << (std::isfinite(kv.second) ? kv.second : 0.0);
+    }
+    out << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+void printReport(int argc, char** argv, const std::string& benchName,
+                 const std::vector<BenchResult>& results) {
+  writeJsonReport(std::cout, benchName, results);
+  if (argc > 1) {
+    std::ofstream file(argv[1]);
+    writeJsonReport(file, benchName, results);
+  }
+}
+
+void quietLogs() {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::error);
+}
+
+config::ServerConfig localServerConfig(int32_t threads) {
+  config::ServerConfig serverConfig(std::filesystem::current_path());
+  serverConfig.address_ = net::ip::make_address("127.0.0.1");
+  // NOTE Tell the socket to bind to port 0 - random port
+  serverConfig.wsPort_ = static_cast<unsigned short>(0);
+  serverConfig.wssPort_ = static_cast<unsigned short>(0);
+  serverConfig.metricsPort_ = static_cast<unsigned short>(0);
+  serverConfig.threads_ = threads;
+  return serverConfig;
+}
+
+bool useSelfSignedCertificate(config::ServerConfig& serverConfig,
+                              const std::filesystem::path& dir) {
+  std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> keyCtx(
+      EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr), &EVP_PKEY_CTX_free);
+  EVP_PKEY* rawKey = nullptr;
+  if (!keyCtx || EVP_PKEY_keygen_init(keyCtx.get()) <= 0 ||
+      EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyCtx.get(), NID_X9_62_prime256v1) <= 0 ||
+      EVP_PKEY_keygen(keyCtx.get(), &rawKey) <= 0) {
+    return false;
+  }
+  std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(rawKey, &EVP_PKEY_free);
+
+  std::unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), &X509_free);
+  if (!cert) {
+    return false;
+  }
+  X509_set_version(cert.get(), 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert.get()), 60L * 60L * 24L);
+  X509_set_pubkey(cert.get(), key.get());
+  X509_NAME* name = X509_get_subject_name(cert.get());
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                             reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+  X509_set_issuer_name(cert.get(), name);
+  if (X509_sign(cert.get(), key.get(), EVP_sha256()) <= 0) {
+    return false;
+  }
+
+  const std::filesystem::path certPath = dir / "boostander_bench.crt";
+  const std::filesystem::path keyPath = dir / "boostander_bench.key";
+  std::unique_ptr<FILE, decltype(&std::fclose)> certFile(std::fopen(certPath.c_str(), "w"),
+                                                         &std::fclose);
+  std::unique_ptr<FILE, decltype(&std::fclose)> keyFile(std::fopen(keyPath.c_str(), "w"),
+                                                        &std::fclose);
+  if (!certFile || !keyFile || !PEM_write_X509(certFile.get(), cert.get()) ||
+      !PEM_write_PrivateKey(keyFile.get(), key.get(), nullptr, nullptr, 0, nullptr, nullptr)) {
+    return false;
+  }
+
+  serverConfig.tlsCertFile_ = certPath.string();
+  serverConfig.tlsKeyFile_ = keyPath.string();
+  return true;
+}
+
+LocalServer::LocalServer(const config::ServerConfig& serverConfig,
+                         std::chrono::microseconds tickPeriod)
+    : nm_(std::make_shared<::boostander::net::NetworkManager>()) {
+  nm_->run(serverConfig);
+  port_ = nm_->getWS()->getWsListener()->getLocalEndpoint().port();
+  if (const auto wssListener = nm_->getWS()->getWssListener()) {
+    wssPort_ = wssListener->getLocalEndpoint().port();
+  }
+  tickThread_ = std::thread([this, tickPeriod]() {
+    countThisThreadAllocations(false);
+    while (needRun_) {
+      nm_->handleIncomingMessages();
+      std::this_thread::sleep_for(tickPeriod);
+    }
+  });
+}
+
+LocalServer::~LocalServer() {
+  needRun_ = false;
+  if (tickThread_.joinable()) {
+    tickThread_.join();
+  }
+  // sessions keep timers and reads pending, stop the io_context instead of waiting for them
+  nm_->getWS()->ioc_.stop();
+  nm_->finish();
+}
+
+SyncWsClient::SyncWsClient() : ws_(ioc_) {}
+
+void SyncWsClient::connect(const std::string& host, unsigned short port) {
+  tcp::resolver resolver(ioc_);
+  const auto results = resolver.resolve(host, std::to_string(port));
+  net::connect(ws_.next_layer(), results.begin(), results.end());
+  // NOTE: a masked frame is written in several chunks, Nagle would delay them until ACK
+  ws_.next_layer().set_option(tcp::no_delay(true));
+  ws_.handshake(host, "/");
+  ws_.text(true);
+}
+
+void SyncWsClient::write(const std::string& message) { ws_.write(net::buffer(message)); }
+
+std::string SyncWsClient::read() {
+  buffer_.consume(buffer_.size());
+  ws_.read(buffer_);
+  return beast::buffers_to_string(buffer_.data());
+}
+
+void SyncWsClient::close() {
+  beast::error_code ec;
+  ws_.close(websocket::close_code::normal, ec);
+}
+
+ssl::context makeClientTlsContext() {
+  ssl::context sslContext(ssl::context::tls_client);
+  sslContext.set_verify_mode(ssl::verify_none);
+  // sessions are cached by SyncWssClient callers, see SyncWssClient::session()
+  SSL_CTX_set_session_cache_mode(sslContext.native_handle(), SSL_SESS_CACHE_CLIENT);
+  return sslContext;
+}
+
+SyncWssClient::SyncWssClient(ssl::context& sslContext) : sslContext_(sslContext) {}
+
+void SyncWssClient::connect(const std::string& host, unsigned short port, TlsSession session) {
+  ws_ = std::make_unique<websocket::stream<ssl::stream<tcp::socket>>>(ioc_, sslContext_);
+  buffer_.consume(buffer_.size());
+
+  tcp::resolver resolver(ioc_);
+  const auto results = resolver.resolve(host, std::to_string(port));
+  net::connect(ws_->next_layer().next_layer(), results.begin(), results.end());
+  ws_->next_layer().next_layer().set_option(tcp::no_delay(true));
+  if (session) {
+    SSL_set_session(ws_->next_layer().native_handle(), session.get());
+  }
+  ws_->next_layer().handshake(ssl::stream_base::client);
+  ws_->handshake(host, "/");
+  ws_->text(true);
+}
+
+bool SyncWssClient::isResumed() {
+  return ws_ && SSL_session_reused(ws_->next_layer().native_handle()) == 1;
+}
+
+SyncWssClient::TlsSession SyncWssClient::session() {
+  if (!ws_) {
+    return nullptr;
+  }
+  return TlsSession(SSL_get1_session(ws_->next_layer().native_handle()), &SSL_SESSION_free);
+}
+
+void SyncWssClient::write(const std::string& message) { ws_->write(net::buffer(message)); }
+
+std::string SyncWssClient::read() {
+  buffer_.consume(buffer_.size());
+  ws_->read(buffer_);
+  return beast::buffers_to_string(buffer_.data());
+}
+
+void SyncWssClient::close() {
+  beast::error_code ec;
+  ws_->close(websocket::close_code::normal, ec);
+}
+
+} // namespace bench
+} // namespace boostander
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include "config/ServerConfig.hpp"
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace boostander {
+namespace net {
+class NetworkManager;
+} // namespace net
+} // namespace boostander
+
+namespace boostander {
+namespace bench {
+
+/**
+ * Number of calls to global operator new since program start.
+ * Global operator new is replaced in benchCommon.cpp, so every benchmark program counts.
+ * Threads that called countThisThreadAllocations(false) are not counted.
+ * With memory accounting its operator new counts, allocations of all threads.
+ **/
+std::size_t allocationsCount();
+
+/**
+ * Include or exclude allocations made by the calling thread,
+ * e.g. exclude client and tick threads to count only allocations of server I/O threads
+ **/
+void countThisThreadAllocations(bool enable);
+
+/**
+ * Collects latency samples (nanoseconds) and reports percentiles
+ **/
+class LatencyStats {
+public:
+  void reserve(std::size_t n) { samples_.reserve(n); }
+
+  void add(std::chrono::nanoseconds sample) { samples_.push_back(sample.count()); }
+
+  // Adds all samples of other, e.g. to combine stats of client threads
+  void append(const LatencyStats& other) {
+    samples_.insert(samples_.end(), other.samples_.begin(), other.samples_.end());
+    sorted_ = false;
+  }
+
+  std::size_t count() const { return samples_.size(); }
+
+  // p in [0, 100]
+  double percentileNs(double p);
+
+  double meanNs() const;
+
+  double maxNs();
+
+private:
+  std::vector<std::int64_t> samples_;
+
+  bool sorted_ = false;
+};
+
+/**
+ * One named benchmark result, values are printed as JSON numbers
+ **/
+struct BenchResult {
+  std::string name;
+  std::map<std::string, double> values;
+};
+
+/**
+ * Adds p50/p99/p999/mean/max of stats to result with given key prefix
+ **/
+void addLatencyValues(BenchResult& result, const std::string& prefix, LatencyStats& stats);
+
+/**
+ * Writes {"benchmark": name, "results": [...]} to out
+ **/
+void writeJsonReport(std::ostream& out, const std::string& benchName,
+                     const std::vector<BenchResult>& results);
+
+/**
+ * Prints report to stdout and, if argv[1] is given, to the file argv[1]
+ **/
+void printReport(int argc, char** argv, const std::string& benchName,
+                 const std::vector<BenchResult>& results);
+
+/**
+ * Disables INFO logs, per-message logging would dominate every measurement
+ **/
+void quietLogs();
+
+/**
+ * NetworkManager running in-process on a loopback port with a fast tick thread
+ **/
+class LocalServer {
+public:
+  explicit LocalServer(const config::ServerConfig& serverConfig,
+                       std::chrono::microseconds tickPeriod = std::chrono::microseconds(100));
+
+  ~LocalServer();
+
+  unsigned short port() const { return port_; }
+
+  // Port of wss:// listener, 0 if TLS is disabled
+  unsigned short wssPort() const { return wssPort_; }
+
+  std::shared_ptr<net::NetworkManager> getNM() const { return nm_; }
+
+private:
+  std::shared_ptr<net::NetworkManager> nm_;
+
+  unsigned short port_ = 0;
+
+  unsigned short wssPort_ = 0;
+
+  std::atomic<bool> needRun_{true};
+
+  std::thread tickThread_;
+};
+
+/**
+ * Loopback config: random port, given number of I/O threads
+ **/
+config::ServerConfig localServerConfig(int32_t threads = 1);
+
+/**
+ * Writes self-signed certificate (CN=localhost, EC P-256) and its key to dir
+ * and enables TLS in serverConfig. Returns false on OpenSSL errors.
+ **/
+bool useSelfSignedCertificate(config::ServerConfig& serverConfig,
+                              const std::filesystem::path& dir);
+
+/**
+ * Blocking WebSocket client, used to drive the server from benchmark threads
+ **/
+class SyncWsClient {
+public:
+  SyncWsClient();
+
+  void connect(const std::string& host, unsigned short port);
+
+  void write(const std::string& message);
+
+  std::string read();
+
+  void close();
+
+private:
+  boost::asio::io_context ioc_;
+
+  boost::beast::websocket::stream<boost::asio::ip::tcp::socket> ws_;
+
+  boost::beast::flat_buffer buffer_;
+};
+
+/**
+ * Blocking secure WebSocket client, does not verify the server certificate.
+ * Resumes the TLS session given to connect(), so full and resumed handshakes
+ * are measured with the same client.
+ **/
+class SyncWssClient {
+public:
+  typedef std::shared_ptr<SSL_SESSION> TlsSession;
+
+  explicit SyncWssClient(boost::asio::ssl::context& sslContext);
+
+  void connect(const std::string& host, unsigned short port, TlsSession session = nullptr);
+
+  // Whether the last connect() resumed the given session
+  bool isResumed();
+
+  // Session for the next connect(), TLS 1.3 tickets arrive with the WebSocket handshake response
+  TlsSession session();
+
+  void write(const std::string& message);
+
+  std::string read();
+
+  void close();
+
+private:
+  boost::asio::io_context ioc_;
+
+  boost::asio::ssl::context& sslContext_;
+
+  // NOTE: TLS stream can not be reused, new one for every connect()
+  std::unique_ptr<
+      boost::beast::websocket::stream<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>>
+      ws_;
+
+  boost::beast::flat_buffer buffer_;
+};
+
+// Client context for SyncWssClient
+boost::asio::ssl::context makeClientTlsContext();
+
+} // namespace bench
+} // namespace boostander
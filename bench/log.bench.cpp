@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+
+/**
+ * Cost of LOG(INFO) on the logging thread: synchronous sink vs asynchronous sink
+ * with per-thread rings. Records are discarded by a stream that waits on every flush,
+ * as a console or a busy syslog daemon does (auto flush, as std::clog).
+ * Usage: log_bench [result.json]
+ **/
+
+#include "benchCommon.hpp"
+#include "log/Logger.hpp"
+#include <boost/core/null_deleter.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/utility/setup/common_attributes.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace boostander;
+using namespace boostander::bench;
+
+namespace logging = boost::log;
+namespace expr = boost::log::expressions;
+namespace keywords = boost::log::keywords;
+
+constexpr std::size_t recordsPerThread = 20000;
+
+constexpr std::size_t ringCapacity = 1024;
+
+// Discards output, every flush takes writeDelay
+class SlowDeviceBuf : public std::streambuf {
+public:
+  explicit SlowDeviceBuf(std::chrono::microseconds writeDelay) : writeDelay_(writeDelay) {}
+
+protected:
+  int_type overflow(int_type ch) override { return traits_type::not_eof(ch); }
+
+  std::streamsize xsputn(const char_type*, std::streamsize count) override { return count; }
+
+  int sync() override {
+    const auto until = std::chrono::steady_clock::now() + writeDelay_;
+    while (std::chrono::steady_clock::now() < until) {
+    }
+    return 0;
+  }
+
+private:
+  const std::chrono::microseconds writeDelay_;
+};
+
+template <typename SinkT> void setupSink(SinkT& sink, std::ostream& device) {
+  sink.locked_backend()->add_stream(
+      boost::shared_ptr<std::ostream>(&device, boost::null_deleter{}));
+  sink.locked_backend()->auto_flush(true);
+  sink.set_formatter(expr::stream << "[" << logging::trivial::severity << "] : " << expr::smessage);
+}
+
+// Logs from threadsCount threads, returns latency of single LOG calls
+LatencyStats logFromThreads(std::size_t threadsCount) {
+  std::vector<LatencyStats> perThread(threadsCount);
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < threadsCount; t++) {
+    threads.emplace_back([&stats = perThread[t], t]() {
+      stats.reserve(recordsPerThread);
+      for (std::size_t i = 0; i < recordsPerThread; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        LOG(INFO) << "WsSession::on_read: message from session " << t << " size " << i;
+        stats.add(std::chrono::steady_clock::now() - start);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  LatencyStats merged;
+  merged.reserve(threadsCount * recordsPerThread);
+  for (LatencyStats& stats : perThread) {
+    for (double p = 0.0; p < 100.0; p += 100.0 / recordsPerThread) {
+      merged.add(std::chrono::nanoseconds(static_cast<std::int64_t>(stats.percentileNs(p))));
+    }
+  }
+  return merged;
+}
+
+std::string caseName(const std::string& sinkName, std::size_t threadsCount,
+                     std::chrono::microseconds writeDelay) {
+  return sinkName + "_" + std::to_string(threadsCount) + "_threads_" +
+         std::to_string(writeDelay.count()) + "us_write";
+}
+
+BenchResult runSync(std::size_t threadsCount, std::chrono::microseconds writeDelay) {
+  BenchResult result{caseName("sync_sink", threadsCount, writeDelay), {}};
+  SlowDeviceBuf deviceBuf(writeDelay);
+  std::ostream device(&deviceBuf);
+  auto sink = boost::make_shared<log::sync_ostream_sink>();
+  setupSink(*sink, device);
+  logging::core::get()->add_sink(sink);
+
+  LatencyStats stats = logFromThreads(threadsCount);
+
+  logging::core::get()->remove_sink(sink);
+  result.values["records"] = static_cast<double>(threadsCount * recordsPerThread);
+  result.values["dropped"] = 0.0;
+  addLatencyValues(result, "log_call", stats);
+  return result;
+}
+
+BenchResult runAsync(std::size_t threadsCount, std::chrono::microseconds writeDelay) {
+  BenchResult result{caseName("async_sink", threadsCount, writeDelay), {}};
+  SlowDeviceBuf deviceBuf(writeDelay);
+  std::ostream device(&deviceBuf);
+  auto sink = boost::make_shared<log::ostream_sink>(keywords::capacity = ringCapacity);
+  setupSink(*sink, device);
+  logging::core::get()->add_sink(sink);
+
+  LatencyStats stats = logFromThreads(threadsCount);
+
+  logging::core::get()->remove_sink(sink);
+  sink->stop();
+  sink->flush();
+  result.values["records"] = static_cast<double>(threadsCount * recordsPerThread);
+  result.values["ring_capacity"] = static_cast<double>(ringCapacity);
+  result.values["dropped"] = static_cast<double>(sink->droppedCount());
+  addLatencyValues(result, "log_call", stats);
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  // TimeStamp and LineID, as log::Logger
+  logging::add_common_attributes();
+
+  std::vector<BenchResult> results;
+  for (const std::size_t threadsCount : {1u, 4u}) {
+    for (const auto writeDelay : {std::chrono::microseconds(0), std::chrono::microseconds(20)}) {
+      results.push_back(runSync(threadsCount, writeDelay));
+      results.push_back(runAsync(threadsCount, writeDelay));
+    }
+  }
+
+  printReport(argc, argv, "log", results);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+
+/**
+ * Microbenchmarks of hot primitives of the message path:
+ * CSV::loadFromMemory (1 KB .. max CSV size), dateTimeFromStr, Opcodes::wsOpcodeFromStr,
+ * DispatchQueue::dispatch and DispatchQueued.
+ * CSV files are generated as in the randomCSV test, with a fixed seed.
+ * Usage: primitives_bench [result.json] [max CSV size in MB, default 64, up to 1024]
+ **/
+
+#include "algo/CSV.hpp"
+#include "algo/DispatchQueue.hpp"
+#include "algo/NetworkOperation.hpp"
+#include "algo/StringUtils.hpp"
+#include "benchCommon.hpp"
+#include <algorithm>
+#include <boost/format.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <locale>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace boostander;
+using namespace boostander::bench;
+
+typedef std::chrono::steady_clock Clock;
+
+// Each primitive runs at least this long, after one warmup run
+constexpr std::chrono::milliseconds minRunTime{500};
+
+// Results are accumulated here, so the compiler can not drop the measured calls
+volatile std::size_t sink = 0;
+
+/**
+ * Calls op(batch) until minRunTime passes, every call performs `batch` operations.
+ * Adds ns per operation (mean and percentiles of batches) and operations per second.
+ **/
+BenchResult measure(const std::string& name, std::size_t batch,
+                    const std::function<void(std::size_t)>& op) {
+  BenchResult result{name, {}};
+  LatencyStats perOp;
+
+  op(batch);
+
+  std::size_t operations = 0;
+  const auto start = Clock::now();
+  auto now = start;
+  while (now - start < minRunTime) {
+    const auto batchStart = Clock::now();
+    op(batch);
+    now = Clock::now();
+    perOp.add((now - batchStart) / batch);
+    operations += batch;
+  }
+  const double elapsedSec = std::chrono::duration<double>(now - start).count();
+
+  result.values["operations"] = static_cast<double>(operations);
+  result.values["ops_per_sec"] = static_cast<double>(operations) / elapsedSec;
+  result.values["ns_per_op"] = elapsedSec * 1e9 / static_cast<double>(operations);
+  addLatencyValues(result, "op", perOp);
+  return result;
+}
+
+// Rows of the randomCSV test: date, two doubles with 9 digits
+std::string makeRandomCsv(std::size_t bytes) {
+  std::mt19937 randomGenerator(42);
+  std::uniform_int_distribution<int> iRoll(1, 1000);
+  std::uniform_real_distribution<double> dRoll(1, 1000);
+
+  std::string csv;
+  csv.reserve(bytes + 64);
+  auto now = std::chrono::system_clock::time_point() + std::chrono::hours(24 * 365 * 49);
+  while (csv.size() < bytes) {
+    now += std::chrono::hours(iRoll(randomGenerator));
+    csv += algo::dateToStr(now);
+    csv += ',';
+    csv += boost::str(boost::format("%.9f") % dRoll(randomGenerator));
+    csv += ',';
+    csv += boost::str(boost::format("%.9f") % dRoll(randomGenerator));
+    csv += '\n';
+  }
+  return csv;
+}
+
+std::string sizeName(std::size_t bytes) {
+  if (bytes >= 1024 * 1024) {
+    return std::to_string(bytes / (1024 * 1024)) + "mb";
+  }
+  return std::to_string(bytes / 1024) + "kb";
+}
+
+void benchCsv(std::vector<BenchResult>& results, std::size_t maxCsvBytes) {
+  for (std::size_t bytes = 1024; bytes <= maxCsvBytes; bytes *= 32) {
+    const std::string csvData = makeRandomCsv(bytes);
+    const auto loadCsv = [&csvData](std::size_t) {
+      algo::CSV csv;
+      csv.loadFromMemory(csvData);
+      sink += csv.getRowsCount();
+    };
+    BenchResult result = measure("csv_load_from_memory_" + sizeName(bytes), 1, loadCsv);
+    result.values["input_bytes"] = static_cast<double>(csvData.size());
+    result.values["mb_per_sec"] = result.values["ops_per_sec"] *
+                                  static_cast<double>(csvData.size()) / (1024.0 * 1024.0);
+    results.push_back(result);
+  }
+}
+
+void benchParsing(std::vector<BenchResult>& results) {
+  const std::string date = "28.02.2019 10:18:05";
+  results.push_back(measure("date_time_from_str", 1000, [&date](std::size_t batch) {
+    for (std::size_t i = 0; i < batch; i++) {
+      sink += static_cast<std::size_t>(algo::dateTimeFromStr(date).time_since_epoch().count());
+    }
+  }));
+
+  // as WsSession::handleIncomingData calls it: from c_str() of the whole message
+  for (const std::size_t payloadSize : {16u, 4096u}) {
+    const std::string message =
+        algo::Opcodes::opcodeToStr(algo::WS_OPCODE::PING) + std::string(payloadSize, 'x');
+    results.push_back(measure("ws_opcode_from_str_" + std::to_string(payloadSize) + "b", 1000,
+                              [&message](std::size_t batch) {
+                                for (std::size_t i = 0; i < batch; i++) {
+                                  sink += static_cast<std::size_t>(
+                                      algo::Opcodes::wsOpcodeFromStr(message.c_str()));
+                                }
+                              }));
+  }
+}
+
+void benchDispatchQueue(std::vector<BenchResult>& results) {
+  // as per-session queues of WsSession: no threads, drained by the tick thread
+  algo::DispatchQueue queue("bench", 0);
+  const auto message = std::make_shared<std::string>("0ping");
+
+  // a batch of messages is dispatched, then run by one tick
+  results.push_back(measure("dispatch_queue_batch", 1000, [&](std::size_t batch) {
+    for (std::size_t i = 0; i < batch; i++) {
+      queue.dispatch([message]() { sink += message->size(); });
+    }
+    queue.DispatchQueued();
+  }));
+
+  // every message is run by its own tick
+  results.push_back(measure("dispatch_queue_single", 1000, [&](std::size_t batch) {
+    for (std::size_t i = 0; i < batch; i++) {
+      queue.dispatch([message]() { sink += message->size(); });
+      queue.DispatchQueued();
+    }
+  }));
+
+  // DispatchQueued of an empty queue: the cost of a tick for every idle session
+  results.push_back(measure("dispatch_queue_empty_tick", 1000, [&](std::size_t batch) {
+    for (std::size_t i = 0; i < batch; i++) {
+      queue.DispatchQueued();
+    }
+  }));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  quietLogs();
+
+  std::locale::global(std::locale::classic());
+
+  std::size_t maxCsvMb = 64;
+  if (argc > 2) {
+    maxCsvMb = std::clamp<std::size_t>(std::strtoull(argv[2], nullptr, 10), 1, 1024);
+  }
+
+  std::vector<BenchResult> results;
+  benchCsv(results, maxCsvMb * 1024 * 1024);
+  benchParsing(results);
+  benchDispatchQueue(results);
+
+  printReport(argc, argv, "primitives", results);
+
+  return EXIT_SUCCESS;
+}
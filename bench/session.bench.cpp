@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+
+/**
+ * Compares callback-based WsSession with coroutine-based WsCoroSession:
+ * PING round-trip latency and heap allocations per message on the server I/O threads.
+ * Usage: session_bench [result.json]
+ **/
+
+#include "algo/NetworkOperation.hpp"
+#include "benchCommon.hpp"
+#include "config/ServerConfig.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace boostander;
+using namespace boostander::bench;
+
+constexpr std::size_t warmupMessages = 1000;
+
+constexpr std::size_t measuredMessages = 5000;
+
+BenchResult runEcho(const std::string& name, bool coroSessions, std::size_t payloadSize) {
+  config::ServerConfig serverConfig = localServerConfig();
+  serverConfig.wsCoroSessions_ = coroSessions;
+
+  BenchResult result{name, {}};
+  LatencyStats rtt;
+  rtt.reserve(measuredMessages);
+
+  LocalServer server(serverConfig);
+  SyncWsClient client;
+  client.connect("127.0.0.1", server.port());
+
+  const std::string message =
+      algo::Opcodes::opcodeToStr(algo::WS_OPCODE::PING) + std::string(payloadSize, 'x');
+
+  for (std::size_t i = 0; i < warmupMessages; i++) {
+    client.write(message);
+    client.read();
+  }
+
+  const std::size_t allocationsBefore = allocationsCount();
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < measuredMessages; i++) {
+    const auto sent = std::chrono::steady_clock::now();
+    client.write(message);
+    client.read();
+    rtt.add(std::chrono::steady_clock::now() - sent);
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  const std::size_t allocations = allocationsCount() - allocationsBefore;
+
+  client.close();
+
+  result.values["payload_bytes"] = static_cast<double>(payloadSize);
+  result.values["messages"] = static_cast<double>(measuredMessages);
+  result.values["io_allocs_per_msg"] =
+      static_cast<double>(allocations) / static_cast<double>(measuredMessages);
+  result.values["msgs_per_sec"] =
+      static_cast<double>(measuredMessages) /
+      std::chrono::duration_cast<std::chrono::duration<double>>(elapsed).count();
+  addLatencyValues(result, "rtt", rtt);
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  quietLogs();
+
+  // only server I/O threads are counted
+  countThisThreadAllocations(false);
+
+  std::vector<BenchResult> results;
+  for (const std::size_t payloadSize : {16u, 1024u}) {
+    const std::string suffix = "_" + std::to_string(payloadSize) + "b";
+    results.push_back(runEcho("callback_session" + suffix, false, payloadSize));
+    results.push_back(runEcho("coroutine_session" + suffix, true, payloadSize));
+  }
+
+  printReport(argc, argv, "session", results);
+
+  return EXIT_SUCCESS;
+}
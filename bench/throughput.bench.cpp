@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+
+/**
+ * Throughput and latency of the server under N concurrent clients:
+ * PING echo round trip (p50/p99/p999) and messages per second,
+ * CSV_ANALIZE messages and megabytes per second across CSV sizes.
+ * Each client runs a closed loop (write, wait for the reply) on its own thread.
+ * Usage: throughput_bench [result.json]
+ **/
+
+#include "algo/NetworkOperation.hpp"
+#include "benchCommon.hpp"
+#include "config/ServerConfig.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace boostander;
+using namespace boostander::bench;
+
+constexpr int32_t serverThreads = 2;
+
+constexpr std::size_t warmupMessages = 100;
+
+// PING messages of all clients per run
+constexpr std::size_t pingMessages = 20000;
+
+// CSV bytes of all clients per run, large CSV files are sent less often
+constexpr std::size_t csvBytes = 32 * 1024 * 1024;
+
+// Rows as in assets/test_data_28.01.2019.csv, the date grows so every row is analized
+std::string makeCsv(std::size_t rows) {
+  std::string csv;
+  for (std::size_t i = 0; i < rows; i++) {
+    const std::size_t second = i % 60;
+    const std::size_t minute = i / 60 % 60;
+    const std::size_t hour = i / 3600 % 24;
+    char row[64];
+    std::snprintf(row, sizeof(row), "28.02.2019 %02zu:%02zu:%02zu,%zu.410645031,204.849620970\n",
+                  hour, minute, second, 100 + i % 900);
+    csv += row;
+  }
+  return csv;
+}
+
+/**
+ * Runs clients concurrently, each sends messagesPerClient messages and waits for every reply.
+ * Replies not starting with replyOpcode are counted as errors.
+ **/
+BenchResult runClients(const std::string& name, std::size_t clients, const std::string& message,
+                       char replyOpcode, std::size_t messagesPerClient) {
+  BenchResult result{name, {}};
+
+  LocalServer server(localServerConfig(serverThreads));
+
+  std::atomic<std::size_t> readyClients{0};
+  std::atomic<bool> isStarted{false};
+  std::atomic<std::size_t> errors{0};
+  std::vector<LatencyStats> rtts(clients);
+  std::vector<std::thread> threads;
+
+  for (std::size_t c = 0; c < clients; c++) {
+    threads.emplace_back([&, c]() {
+      // only server I/O threads are counted
+      countThisThreadAllocations(false);
+
+      SyncWsClient client;
+      client.connect("127.0.0.1", server.port());
+      for (std::size_t i = 0; i < warmupMessages; i++) {
+        client.write(message);
+        client.read();
+      }
+
+      LatencyStats& rtt = rtts[c];
+      rtt.reserve(messagesPerClient);
+      readyClients++;
+      while (!isStarted.load()) {
+        std::this_thread::yield();
+      }
+
+      for (std::size_t i = 0; i < messagesPerClient; i++) {
+        const auto sent = std::chrono::steady_clock::now();
+        client.write(message);
+        const std::string reply = client.read();
+        rtt.add(std::chrono::steady_clock::now() - sent);
+        if (reply.empty() || reply[0] != replyOpcode) {
+          errors++;
+        }
+      }
+
+      client.close();
+    });
+  }
+
+  while (readyClients.load() < clients) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  const std::size_t allocationsBefore = allocationsCount();
+  const auto start = std::chrono::steady_clock::now();
+  isStarted = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const double elapsedSec =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const std::size_t allocations = allocationsCount() - allocationsBefore;
+
+  LatencyStats rtt;
+  for (const LatencyStats& clientRtt : rtts) {
+    rtt.append(clientRtt);
+  }
+
+  const double messages = static_cast<double>(clients * messagesPerClient);
+  result.values["clients"] = static_cast<double>(clients);
+  result.values["server_threads"] = static_cast<double>(serverThreads);
+  result.values["payload_bytes"] = static_cast<double>(message.size());
+  result.values["messages"] = messages;
+  result.values["errors"] = static_cast<double>(errors.load());
+  result.values["msgs_per_sec"] = messages / elapsedSec;
+  result.values["mb_per_sec"] =
+      messages * static_cast<double>(message.size()) / elapsedSec / (1024.0 * 1024.0);
+  // I/O threads only, callbacks run on the tick thread of LocalServer
+  result.values["io_allocs_per_msg"] = static_cast<double>(allocations) / messages;
+  addLatencyValues(result, "rtt", rtt);
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  quietLogs();
+
+  // only server I/O threads are counted
+  countThisThreadAllocations(false);
+
+  const char pingOpcode = algo::Opcodes::opcodeToStr(algo::WS_OPCODE::PING)[0];
+  const char csvAnswerOpcode = algo::Opcodes::opcodeToStr(algo::WS_OPCODE::CSV_ANSWER)[0];
+
+  std::vector<BenchResult> results;
+  for (const std::size_t clients : {1u, 8u, 32u}) {
+    for (const std::size_t payloadSize : {16u, 4096u}) {
+      const std::string message = algo::Opcodes::opcodeToStr(algo::WS_OPCODE::PING) +
+                                  std::string(payloadSize, 'x');
+      results.push_back(runClients("ping_" + std::to_string(clients) + "c_" +
+                                       std::to_string(payloadSize) + "b",
+                                   clients, message, pingOpcode, pingMessages / clients));
+    }
+  }
+
+  for (const std::size_t clients : {1u, 8u}) {
+    for (const std::size_t rows : {10u, 1000u, 30000u}) {
+      const std::string message =
+          algo::Opcodes::opcodeToStr(algo::WS_OPCODE::CSV_ANALIZE) + makeCsv(rows);
+      const std::size_t messagesPerClient =
+          std::clamp<std::size_t>(csvBytes / message.size() / clients, 10, 2000);
+      results.push_back(runClients("csv_analize_" + std::to_string(clients) + "c_" +
+                                       std::to_string(rows) + "rows",
+                                   clients, message, csvAnswerOpcode, messagesPerClient));
+    }
+  }
+
+  printReport(argc, argv, "throughput", results);
+
+  return EXIT_SUCCESS;
+}
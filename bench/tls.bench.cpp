@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+
+/**
+ * TLS handshakes per second, full vs resumed, and PING round trip of an established
+ * session during a reconnect storm with handshakes on the I/O thread vs offloaded.
+ * Certificate is generated in the temp directory on every run.
+ * Usage: tls_bench [result.json]
+ **/
+
+#include "algo/NetworkOperation.hpp"
+#include "benchCommon.hpp"
+#include "config/ServerConfig.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace boostander;
+using namespace boostander::bench;
+
+constexpr std::size_t warmupHandshakes = 20;
+
+constexpr std::size_t measuredHandshakes = 500;
+
+constexpr std::size_t stormThreads = 4;
+
+constexpr std::chrono::seconds stormDuration(3);
+
+double perSecond(std::size_t count, std::chrono::steady_clock::duration elapsed) {
+  return static_cast<double>(count) /
+         std::chrono::duration_cast<std::chrono::duration<double>>(elapsed).count();
+}
+
+// Sequential connects of one client, with or without session resumption
+BenchResult runHandshakes(const std::string& name, const config::ServerConfig& serverConfig,
+                          bool resume) {
+  BenchResult result{name, {}};
+  LatencyStats handshake;
+  handshake.reserve(measuredHandshakes);
+
+  LocalServer server(serverConfig);
+  auto sslContext = makeClientTlsContext();
+  SyncWssClient client(sslContext);
+
+  SyncWssClient::TlsSession session;
+  std::size_t resumedCount = 0;
+  std::chrono::steady_clock::duration elapsed{};
+  for (std::size_t i = 0; i < warmupHandshakes + measuredHandshakes; i++) {
+    const auto start = std::chrono::steady_clock::now();
+    client.connect("127.0.0.1", server.wssPort(), resume ? session : nullptr);
+    const auto connected = std::chrono::steady_clock::now();
+    if (resume) {
+      session = client.session();
+    }
+    if (i >= warmupHandshakes) {
+      handshake.add(connected - start);
+      elapsed += connected - start;
+      resumedCount += client.isResumed() ? 1 : 0;
+    }
+    client.close();
+  }
+
+  result.values["handshakes"] = static_cast<double>(measuredHandshakes);
+  result.values["handshakes_per_sec"] = perSecond(measuredHandshakes, elapsed);
+  result.values["resumed_ratio"] =
+      static_cast<double>(resumedCount) / static_cast<double>(measuredHandshakes);
+  addLatencyValues(result, "handshake", handshake);
+  return result;
+}
+
+// Plain session sends PINGs while other clients reconnect without resumption
+BenchResult runStorm(const std::string& name, const config::ServerConfig& serverConfig) {
+  BenchResult result{name, {}};
+  LatencyStats rtt;
+
+  LocalServer server(serverConfig);
+  SyncWsClient client;
+  client.connect("127.0.0.1", server.port());
+  const std::string message = algo::Opcodes::opcodeToStr(algo::WS_OPCODE::PING) + "x";
+
+  std::atomic<bool> isStormRunning{true};
+  std::atomic<std::size_t> handshakesCount{0};
+  std::vector<std::thread> storm;
+  for (std::size_t i = 0; i < stormThreads; i++) {
+    storm.emplace_back([&]() {
+      auto sslContext = makeClientTlsContext();
+      SyncWssClient stormClient(sslContext);
+      while (isStormRunning) {
+        stormClient.connect("127.0.0.1", server.wssPort());
+        stormClient.close();
+        handshakesCount++;
+      }
+    });
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now() - start < stormDuration) {
+    const auto sent = std::chrono::steady_clock::now();
+    client.write(message);
+    client.read();
+    rtt.add(std::chrono::steady_clock::now() - sent);
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  isStormRunning = false;
+  for (std::thread& thread : storm) {
+    thread.join();
+  }
+  client.close();
+
+  result.values["handshake_threads"] = static_cast<double>(serverConfig.tlsHandshakeThreads_);
+  result.values["handshakes_per_sec"] = perSecond(handshakesCount, elapsed);
+  result.values["pings"] = static_cast<double>(rtt.count());
+  addLatencyValues(result, "ping_rtt", rtt);
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  quietLogs();
+
+  config::ServerConfig serverConfig = localServerConfig();
+  if (!useSelfSignedCertificate(serverConfig, std::filesystem::temp_directory_path())) {
+    std::cerr << "tls_bench: can not generate certificate" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<BenchResult> results;
+  results.push_back(runHandshakes("full_handshake", serverConfig, false));
+  results.push_back(runHandshakes("resumed_handshake", serverConfig, true));
+
+  config::ServerConfig noTicketsConfig = serverConfig;
+  noTicketsConfig.tlsSessionTickets_ = false;
+  results.push_back(runHandshakes("resumed_handshake_no_tickets", noTicketsConfig, true));
+
+  for (const int32_t handshakeThreads : {0, 1}) {
+    config::ServerConfig stormConfig = serverConfig;
+    stormConfig.tlsHandshakeThreads_ = handshakeThreads;
+    results.push_back(runStorm(handshakeThreads ? "storm_offloaded_handshakes"
+                                                : "storm_io_thread_handshakes",
+                               stormConfig));
+  }
+
+  printReport(argc, argv, "tls", results);
+
+  return EXIT_SUCCESS;
+}
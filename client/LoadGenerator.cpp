@@ -0,0 +1,215 @@
+#include "LoadGenerator.hpp" // IWYU pragma: associated
+#include "SessionConnector.hpp"
+#include "algo/NetworkOperation.hpp"
+#include "log/Logger.hpp"
+#include "net/NetworkManager.hpp"
+#include "net/websockets/WsServer.hpp"
+#include "net/websockets/WsSession.hpp"
+#include <functional>
+#include <thread>
+#include <utility>
+
+namespace boostander {
+namespace client {
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr std::chrono::seconds PROGRESS_PERIOD{1};
+
+// sends behind schedule by more than this are counted as late
+constexpr std::chrono::milliseconds LATE_SEND{1};
+
+double toUs(std::uint64_t ns) { return static_cast<double>(ns) / 1000.0; }
+
+} // namespace
+
+LoadGenerator::LoadGenerator(std::shared_ptr<net::NetworkManager> nm, const LoadConfig& config)
+    : nm_(std::move(nm)), config_(config) {
+  const auto replyOpcode = static_cast<algo::WS_OPCODE>(config_.replyOpcode);
+  const net::WsNetworkOperation op(replyOpcode, algo::Opcodes::opcodeToStr(replyOpcode));
+  nm_->getWS()->getOperationCallbacks().addCallback(
+      op, [this](net::WsSession* session, net::NetworkManager*, std::shared_ptr<std::string>) {
+        onReply(session);
+      });
+
+  // messages dropped by an overloaded server or by rate limits are answered, but not timed
+  for (const auto dropOpcode : {algo::WS_OPCODE::BUSY, algo::WS_OPCODE::THROTTLED}) {
+    const net::WsNetworkOperation dropOp(dropOpcode, algo::Opcodes::opcodeToStr(dropOpcode));
+    std::atomic<std::uint64_t>& dropped =
+        dropOpcode == algo::WS_OPCODE::BUSY ? busy_ : throttled_;
+    nm_->getWS()->getOperationCallbacks().addCallback(
+        dropOp, [this, &dropped](net::WsSession* session, net::NetworkManager*,
+                                 std::shared_ptr<std::string>) { onDropped(session, dropped); });
+  }
+}
+
+std::size_t LoadGenerator::connect(std::chrono::milliseconds timeout) {
+  for (auto& session :
+       connectSessions(*nm_, splitHosts(config_.host), config_.port, config_.connections, "load_",
+                       timeout)) {
+    auto connection = std::make_unique<Connection>();
+    connection->session = std::move(session);
+    bySession_[connection->session.get()] = connection.get();
+    connections_.push_back(std::move(connection));
+  }
+
+  LOG(INFO) << "LoadGenerator: " << connections_.size() << " of " << config_.connections
+            << " connections to " << config_.host << ":" << config_.port;
+  return connections_.size();
+}
+
+void LoadGenerator::run() {
+  if (connections_.empty() || config_.rate <= 0.0) {
+    LOG(WARNING) << "LoadGenerator::run: no connections or rate";
+    return;
+  }
+
+  // replies are dispatched by the tick thread, as in the server
+  std::atomic<bool> needTick{true};
+  std::thread tickThread([this, &needTick]() {
+    while (needTick) {
+      nm_->handleIncomingMessages();
+      std::this_thread::sleep_for(config_.tickPeriod);
+    }
+  });
+
+  const std::chrono::duration<double> interval(1.0 / config_.rate);
+  const auto start = Clock::now();
+  const auto end = start + config_.duration;
+  auto nextProgress = start + PROGRESS_PERIOD;
+
+  for (std::uint64_t i = 0;; i++) {
+    const auto due = start + std::chrono::duration_cast<Clock::duration>(interval * i);
+    if (due >= end) {
+      break;
+    }
+
+    const auto now = Clock::now();
+    if (due > now) {
+      std::this_thread::sleep_until(due);
+    } else if (now - due > LATE_SEND) {
+      // the sender falls behind, the delay still counts into latency
+      lateSends_++;
+    }
+
+    Connection& connection = *connections_[i % connections_.size()];
+    {
+      // NOTE: before send, the reply may arrive before send returns
+      std::scoped_lock lock(connection.mutex);
+      connection.pending.push_back(due);
+    }
+    connection.session->send(config_.message);
+    sent_++;
+
+    if (due >= nextProgress) {
+      nextProgress += PROGRESS_PERIOD;
+      logProgress("sending");
+    }
+  }
+  sendSec_ = std::chrono::duration<double>(Clock::now() - start).count();
+
+  const auto drainEnd = Clock::now() + config_.drainTimeout;
+  while (pendingCount() && Clock::now() < drainEnd) {
+    std::this_thread::sleep_for(10ms);
+  }
+  logProgress("done");
+
+  needTick = false;
+  tickThread.join();
+}
+
+void LoadGenerator::close() {
+  for (const auto& connection : connections_) {
+    connection->session->close();
+  }
+}
+
+void LoadGenerator::onReply(net::WsSession* session) {
+  const auto now = Clock::now();
+  const auto found = bySession_.find(session);
+  if (found == bySession_.end()) {
+    unexpected_++;
+    return;
+  }
+
+  Connection& connection = *found->second;
+  Clock::time_point due;
+  {
+    std::scoped_lock lock(connection.mutex);
+    if (connection.pending.empty()) {
+      unexpected_++;
+      return;
+    }
+    due = connection.pending.front();
+    connection.pending.pop_front();
+  }
+  latency_.record(now - due);
+  received_++;
+}
+
+void LoadGenerator::onDropped(net::WsSession* session, std::atomic<std::uint64_t>& dropped) {
+  const auto found = bySession_.find(session);
+  if (found == bySession_.end()) {
+    unexpected_++;
+    return;
+  }
+
+  Connection& connection = *found->second;
+  {
+    std::scoped_lock lock(connection.mutex);
+    if (connection.pending.empty()) {
+      unexpected_++;
+      return;
+    }
+    // NOTE: drops are answered before replies of queued messages, latency of the next reply of
+    // the connection is measured from a later due time
+    connection.pending.pop_front();
+  }
+  dropped++;
+}
+
+std::uint64_t LoadGenerator::pendingCount() const {
+  const std::uint64_t sent = sent_.load();
+  const std::uint64_t received = received_.load() + busy_.load() + throttled_.load();
+  return sent > received ? sent - received : 0;
+}
+
+void LoadGenerator::logProgress(const char* stage) const {
+  LOG(INFO) << "LoadGenerator " << stage << ": sent " << sent_.load() << ", received "
+            << received_.load() << ", busy " << busy_.load() << ", throttled "
+            << throttled_.load() << ", p50 " << toUs(latency_.quantileNs(0.5)) << "us, p99 "
+            << toUs(latency_.quantileNs(0.99)) << "us";
+}
+
+void LoadGenerator::writeReport(std::ostream& out) const {
+  const std::uint64_t received = received_.load();
+  const double achievedRate = sendSec_ > 0.0 ? static_cast<double>(received) / sendSec_ : 0.0;
+  const double meanUs =
+      received ? toUs(latency_.sumNs()) / static_cast<double>(latency_.count()) : 0.0;
+
+  out << "{\n  \"workload\": \"" << config_.workload << "\",\n"
+      << "  \"message_bytes\": " << config_.message.size() << ",\n"
+      << "  \"connections\": " << connections_.size() << ",\n"
+      << "  \"target_rate\": " << config_.rate << ",\n"
+      << "  \"achieved_rate\": " << achievedRate << ",\n"
+      << "  \"duration_sec\": " << sendSec_ << ",\n"
+      << "  \"sent\": " << sent_.load() << ",\n"
+      << "  \"received\": " << received << ",\n"
+      << "  \"busy\": " << busy_.load() << ",\n"
+      << "  \"throttled\": " << throttled_.load() << ",\n"
+      << "  \"unanswered\": " << pendingCount() << ",\n"
+      << "  \"unexpected\": " << unexpected_.load() << ",\n"
+      << "  \"late_sends\": " << lateSends_ << ",\n"
+      << "  \"latency_us\": {\"mean\": " << meanUs
+      << ", \"p50\": " << toUs(latency_.quantileNs(0.5))
+      << ", \"p90\": " << toUs(latency_.quantileNs(0.9))
+      << ", \"p99\": " << toUs(latency_.quantileNs(0.99))
+      << ", \"p999\": " << toUs(latency_.quantileNs(0.999))
+      << ", \"p9999\": " << toUs(latency_.quantileNs(0.9999))
+      << ", \"max\": " << toUs(latency_.quantileNs(1.0)) << "}\n}\n";
+}
+
+} // namespace client
+} // namespace boostander
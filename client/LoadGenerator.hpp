@@ -0,0 +1,131 @@
+#pragma once
+
+#include "metrics/Metrics.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace boostander {
+namespace net {
+class NetworkManager;
+class WsSession;
+} // namespace net
+} // namespace boostander
+
+namespace boostander {
+namespace client {
+
+struct LoadConfig {
+  // comma-separated, connections are spread over the hosts
+  std::string host = "127.0.0.1";
+
+  std::string port = "8080";
+
+  std::size_t connections = 1;
+
+  // messages per second of all connections
+  double rate = 10.0;
+
+  std::chrono::seconds duration{10};
+
+  // replies to messages sent before the end are awaited this long
+  std::chrono::seconds drainTimeout{5};
+
+  // client sessions receive replies on ticks, latency is overestimated by up to a tick
+  std::chrono::microseconds tickPeriod{200};
+
+  // workload name for the report, e.g. "ping" or "csv"
+  std::string workload;
+
+  // every message is the same, opcode included
+  std::string message;
+
+  // opcode of replies to message
+  char replyOpcode = 0;
+};
+
+/**
+ * Replays one message over many client sessions at a target rate.
+ * Open-loop: the i-th message is due at start + i / rate regardless of replies,
+ * latency is measured from the due time, so a stalled server is not hidden by
+ * a stalled sender (coordinated omission).
+ * Connections are used round-robin, replies of a connection come in order of its messages.
+ **/
+class LoadGenerator {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  // Replaces the callback of config.replyOpcode of nm, replies are counted instead
+  LoadGenerator(std::shared_ptr<net::NetworkManager> nm, const LoadConfig& config);
+
+  // Opens config.connections client sessions, returns the number of connected ones
+  std::size_t connect(std::chrono::milliseconds timeout);
+
+  // Sends messages for config.duration, then waits for replies up to config.drainTimeout
+  void run();
+
+  // Closes all sessions, required before NetworkManager::finish
+  void close();
+
+  // Results as JSON
+  void writeReport(std::ostream& out) const;
+
+private:
+  struct Connection {
+    std::shared_ptr<net::WsSession> session;
+
+    std::mutex mutex;
+
+    // due times of messages without replies, requires mutex
+    std::deque<Clock::time_point> pending;
+  };
+
+  // Runs on the tick thread
+  void onReply(net::WsSession* session);
+
+  // The server dropped a message with BUSY or THROTTLED, runs on the tick thread
+  void onDropped(net::WsSession* session, std::atomic<std::uint64_t>& dropped);
+
+  std::uint64_t pendingCount() const;
+
+  void logProgress(const char* stage) const;
+
+  std::shared_ptr<net::NetworkManager> nm_;
+
+  const LoadConfig config_;
+
+  std::vector<std::unique_ptr<Connection>> connections_;
+
+  // read-only after connect()
+  std::unordered_map<const net::WsSession*, Connection*> bySession_;
+
+  metrics::Histogram latency_;
+
+  std::atomic<std::uint64_t> sent_{0};
+
+  std::atomic<std::uint64_t> received_{0};
+
+  // messages answered with BUSY (see AdmissionControl) and THROTTLED (see SessionRateLimiter)
+  std::atomic<std::uint64_t> busy_{0};
+
+  std::atomic<std::uint64_t> throttled_{0};
+
+  // replies on sessions without pending messages
+  std::atomic<std::uint64_t> unexpected_{0};
+
+  double sendSec_ = 0.0;
+
+  // sends behind schedule by more than a millisecond
+  std::uint64_t lateSends_ = 0;
+};
+
+} // namespace client
+} // namespace boostander
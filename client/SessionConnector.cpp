@@ -0,0 +1,85 @@
+#include "SessionConnector.hpp" // IWYU pragma: associated
+#include "log/Logger.hpp"
+#include "net/NetworkManager.hpp"
+#include "net/websockets/WsListener.hpp"
+#include "net/websockets/WsServer.hpp"
+#include "net/websockets/WsSession.hpp"
+#include <boost/beast/core/error.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+
+namespace boostander {
+namespace client {
+
+std::vector<std::string> splitHosts(const std::string& hosts) {
+  std::vector<std::string> result;
+  std::istringstream in(hosts);
+  for (std::string host; std::getline(in, host, ',');) {
+    if (!host.empty()) {
+      result.push_back(host);
+    }
+  }
+  return result;
+}
+
+std::vector<std::shared_ptr<net::WsSession>>
+connectSessions(net::NetworkManager& nm, const std::vector<std::string>& hosts,
+                const std::string& port, std::size_t count, const std::string& idPrefix,
+                std::chrono::milliseconds timeout) {
+  std::vector<std::shared_ptr<net::WsSession>> connected;
+  if (hosts.empty()) {
+    LOG(WARNING) << "connectSessions: no hosts";
+    return connected;
+  }
+
+  // completions come from I/O threads and may outlive this call on timeout
+  struct ConnectResults {
+    std::mutex mutex;
+
+    std::condition_variable cv;
+
+    std::size_t finished = 0;
+
+    std::vector<bool> isConnected;
+  };
+  auto results = std::make_shared<ConnectResults>();
+  results->isConnected.resize(count);
+
+  // all connections are established concurrently, nothing waits for a single one
+  const auto listener = nm.getWS()->getWsListener();
+  std::vector<std::shared_ptr<net::WsSession>> sessions;
+  sessions.reserve(count);
+  for (std::size_t i = 0; i < count; i++) {
+    auto session = listener->addClientSession(idPrefix + std::to_string(i));
+    if (!session) {
+      LOG(WARNING) << "connectSessions: addClientSession failed";
+      break;
+    }
+    sessions.push_back(session);
+    session->connectAsClient(
+        hosts[i % hosts.size()], port, [results, i](boost::beast::error_code ec) {
+          {
+            std::lock_guard<std::mutex> lock(results->mutex);
+            results->isConnected[i] = !ec;
+            results->finished++;
+          }
+          results->cv.notify_one();
+        });
+  }
+
+  std::unique_lock<std::mutex> lock(results->mutex);
+  const std::size_t started = sessions.size();
+  results->cv.wait_for(lock, timeout, [&]() { return results->finished == started; });
+  for (std::size_t i = 0; i < started; i++) {
+    if (results->isConnected[i]) {
+      connected.push_back(std::move(sessions[i]));
+    } else {
+      sessions[i]->close();
+    }
+  }
+  return connected;
+}
+
+} // namespace client
+} // namespace boostander
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace boostander {
+namespace net {
+class NetworkManager;
+class WsSession;
+} // namespace net
+} // namespace boostander
+
+namespace boostander {
+namespace client {
+
+// "a,b,c" -> {"a", "b", "c"}, empty items are skipped
+std::vector<std::string> splitHosts(const std::string& hosts);
+
+/**
+ * Opens count client sessions concurrently, spread round-robin over hosts:
+ * one source address reaches at most ~28k ports of one destination, more loopback
+ * connections need more destinations (127.0.0.2, 127.0.0.3, ...).
+ * Returns the sessions connected within timeout, others are closed.
+ * Session ids are idPrefix + number.
+ **/
+std::vector<std::shared_ptr<net::WsSession>>
+connectSessions(net::NetworkManager& nm, const std::vector<std::string>& hosts,
+                const std::string& port, std::size_t count, const std::string& idPrefix,
+                std::chrono::milliseconds timeout);
+
+} // namespace client
+} // namespace boostander
@@ -0,0 +1,216 @@
+#include "SoakTest.hpp" // IWYU pragma: associated
+#include "SessionConnector.hpp"
+#include "log/Logger.hpp"
+#include "metrics/MemoryAccounting.hpp"
+#include "net/NetworkManager.hpp"
+#include "net/websockets/WsSession.hpp"
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <exception>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+namespace boostander {
+namespace client {
+
+namespace beast = boost::beast;   // from <boost/beast.hpp>
+namespace http = beast::http;     // from <boost/beast/http.hpp>
+using tcp = boost::asio::ip::tcp; // from <boost/asio/ip/tcp.hpp>
+
+namespace {
+
+constexpr char RSS_METRIC[] = "process_resident_memory_bytes";
+
+constexpr char HEAP_METRIC_PREFIX[] = "heap_bytes{";
+
+constexpr char SESSIONS_METRIC[] = "ws_sessions";
+
+/**
+ * Samples of the Prometheus text format by name with labels,
+ * e.g. heap_bytes{subsystem="network"}. Empty if the server does not answer within 10 seconds.
+ **/
+std::map<std::string, double> scrapeMetrics(const std::string& host, unsigned short port) {
+  std::map<std::string, double> samples;
+  try {
+    boost::asio::io_context ioc;
+    tcp::resolver resolver(ioc);
+    tcp::socket socket(ioc);
+    http::request<http::empty_body> request(http::verb::get, "/metrics", 11);
+    request.set(http::field::host, host);
+    beast::flat_buffer buffer;
+    http::response<http::string_body> response;
+
+    // the deadline closes the socket, a pending operation completes with an error
+    boost::asio::steady_timer deadline(ioc, std::chrono::seconds(10));
+    deadline.async_wait([&socket](beast::error_code ec) {
+      if (!ec) {
+        socket.close(ec);
+      }
+    });
+
+    beast::error_code result = boost::asio::error::timed_out;
+    boost::asio::async_connect(
+        socket, resolver.resolve(host, std::to_string(port)),
+        [&](beast::error_code ec, const tcp::endpoint&) {
+          if (ec) {
+            result = ec;
+            deadline.cancel();
+            return;
+          }
+          http::async_write(socket, request, [&](beast::error_code ec, std::size_t) {
+            if (ec) {
+              result = ec;
+              deadline.cancel();
+              return;
+            }
+            http::async_read(socket, buffer, response, [&](beast::error_code ec, std::size_t) {
+              result = ec;
+              deadline.cancel();
+            });
+          });
+        });
+    ioc.run();
+    if (result) {
+      throw beast::system_error(result);
+    }
+    beast::error_code ec;
+    socket.shutdown(tcp::socket::shutdown_both, ec);
+
+    std::istringstream body(response.body());
+    for (std::string line; std::getline(body, line);) {
+      const auto valueStart = line.rfind(' ');
+      if (line.empty() || line[0] == '#' || valueStart == std::string::npos) {
+        continue;
+      }
+      samples[line.substr(0, valueStart)] = std::stod(line.substr(valueStart + 1));
+    }
+  } catch (const std::exception& e) {
+    LOG(WARNING) << "SoakTest: can`t scrape metrics of " << host << ":" << port << ": "
+                 << e.what();
+    samples.clear();
+  }
+  return samples;
+}
+
+double valueOf(const std::map<std::string, double>& samples, const std::string& name) {
+  const auto found = samples.find(name);
+  return found != samples.end() ? found->second : 0.0;
+}
+
+} // namespace
+
+SoakTest::SoakTest(std::shared_ptr<net::NetworkManager> nm, const SoakConfig& config)
+    : nm_(std::move(nm)), config_(config), hosts_(splitHosts(config.host)) {}
+
+bool SoakTest::run() {
+  if (hosts_.empty()) {
+    LOG(WARNING) << "SoakTest: no hosts";
+    return false;
+  }
+  const auto start = std::chrono::steady_clock::now();
+
+  // baseline
+  if (!takeSample(start)) {
+    return false;
+  }
+
+  const std::size_t step = std::max<std::size_t>(config_.step, 1);
+  while (sessions_.size() < config_.connections) {
+    const std::size_t count = std::min(step, config_.connections - sessions_.size());
+    auto connected = connectSessions(*nm_, hosts_, config_.port, count,
+                                     "soak_" + std::to_string(sessions_.size()) + "_",
+                                     config_.stepTimeout);
+    const std::size_t connectedCount = connected.size();
+    sessions_.insert(sessions_.end(), std::make_move_iterator(connected.begin()),
+                     std::make_move_iterator(connected.end()));
+    if (!takeSample(start)) {
+      return false;
+    }
+    if (connectedCount < count) {
+      // e.g. out of file descriptors or local ports, memory of reached connections is sampled
+      LOG(WARNING) << "SoakTest: only " << connectedCount << " of " << count
+                   << " connections of the step are connected, stopping the ramp";
+      break;
+    }
+  }
+
+  const auto holdEnd = std::chrono::steady_clock::now() + config_.hold;
+  for (auto now = std::chrono::steady_clock::now(); now < holdEnd;
+       now = std::chrono::steady_clock::now()) {
+    // the last period is shortened, so the end of the hold is always sampled
+    std::this_thread::sleep_for(
+        std::min<std::chrono::steady_clock::duration>(config_.samplePeriod, holdEnd - now));
+    if (!takeSample(start)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SoakTest::close() {
+  for (const auto& session : sessions_) {
+    session->close();
+  }
+}
+
+bool SoakTest::takeSample(std::chrono::steady_clock::time_point start) {
+  Sample sample;
+  sample.server = scrapeMetrics(hosts_.front(), config_.metricsPort);
+  if (sample.server.empty()) {
+    return false;
+  }
+  sample.elapsedSec =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  // closed by the server (e.g. idle timeout) are counted too, alive ones are in ws_sessions
+  sample.connections = sessions_.size();
+  sample.clientRssBytes = metrics::getResidentMemoryBytes();
+  samples_.push_back(std::move(sample));
+
+  const Sample& last = samples_.back();
+  LOG(INFO) << "SoakTest: " << last.connections << " connections, server sessions "
+            << valueOf(last.server, SESSIONS_METRIC) << ", server RSS "
+            << valueOf(last.server, RSS_METRIC) / (1024 * 1024) << " MB, "
+            << perConnection(last, RSS_METRIC) << " bytes per connection";
+  return true;
+}
+
+double SoakTest::perConnection(const Sample& sample, const std::string& metric) const {
+  if (!sample.connections || samples_.empty()) {
+    return 0.0;
+  }
+  return (valueOf(sample.server, metric) - valueOf(samples_.front().server, metric)) /
+         static_cast<double>(sample.connections);
+}
+
+void SoakTest::writeReport(std::ostream& out) const {
+  out << "{\n  \"connections\": " << config_.connections << ",\n  \"samples\": [";
+  for (std::size_t i = 0; i < samples_.size(); i++) {
+    const Sample& sample = samples_[i];
+    out << (i ? ",\n" : "\n") << "    {\"elapsed_sec\": " << sample.elapsedSec
+        << ", \"connections\": " << sample.connections
+        << ", \"server_sessions\": " << valueOf(sample.server, SESSIONS_METRIC)
+        << ", \"server_rss_bytes\": " << valueOf(sample.server, RSS_METRIC)
+        << ", \"rss_per_connection\": " << perConnection(sample, RSS_METRIC)
+        << ", \"client_rss_bytes\": " << sample.clientRssBytes << ", \"heap_per_connection\": {";
+    // only servers built with memory accounting export heap_bytes
+    bool isFirst = true;
+    for (const auto& metric : sample.server) {
+      if (metric.first.rfind(HEAP_METRIC_PREFIX, 0) != 0) {
+        continue;
+      }
+      // heap_bytes{subsystem="network"} -> network
+      const auto nameStart = metric.first.find('"') + 1;
+      const auto name = metric.first.substr(nameStart, metric.first.rfind('"') - nameStart);
+      out << (isFirst ? "" : ", ") << "\"" << name << "\": " << perConnection(sample, metric.first);
+      isFirst = false;
+    }
+    out << "}}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+} // namespace client
+} // namespace boostander
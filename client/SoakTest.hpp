@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace boostander {
+namespace net {
+class NetworkManager;
+class WsSession;
+} // namespace net
+} // namespace boostander
+
+namespace boostander {
+namespace client {
+
+struct SoakConfig {
+  // comma-separated, connections are spread over the hosts (see connectSessions)
+  std::string host = "127.0.0.1";
+
+  std::string port = "8080";
+
+  std::size_t connections = 10000;
+
+  // connections opened at once, every step is followed by a sample
+  std::size_t step = 10000;
+
+  std::chrono::seconds stepTimeout{30};
+
+  // all connections are held this long after the last step, sampled every samplePeriod
+  std::chrono::seconds hold{60};
+
+  std::chrono::seconds samplePeriod{10};
+
+  // memory of the server is scraped from http://first host:metricsPort/metrics
+  unsigned short metricsPort = 9464;
+};
+
+/**
+ * Capacity test of idle connections: opens connections step by step and holds them,
+ * after every step and every samplePeriod the server RSS (and heap by subsystem if the server
+ * is built with memory accounting) is scraped from its metrics and divided by connections.
+ * Memory of the server before the first step is the baseline.
+ * Sessions stay idle, only websocket pings of the server keep them alive.
+ **/
+class SoakTest {
+public:
+  SoakTest(std::shared_ptr<net::NetworkManager> nm, const SoakConfig& config);
+
+  // Returns false if the server metrics are not available
+  bool run();
+
+  // Closes all sessions, required before NetworkManager::finish
+  void close();
+
+  // Samples as JSON
+  void writeReport(std::ostream& out) const;
+
+private:
+  struct Sample {
+    double elapsedSec = 0.0;
+
+    std::size_t connections = 0;
+
+    // process_resident_memory_bytes, heap_bytes{subsystem="..."}, ws_sessions of the server
+    std::map<std::string, double> server;
+
+    std::size_t clientRssBytes = 0;
+  };
+
+  // Returns false if the server metrics are not available. Requires hosts_.
+  bool takeSample(std::chrono::steady_clock::time_point start);
+
+  // Bytes per connection over the baseline, 0 without connections
+  double perConnection(const Sample& sample, const std::string& metric) const;
+
+  std::shared_ptr<net::NetworkManager> nm_;
+
+  const SoakConfig config_;
+
+  const std::vector<std::string> hosts_;
+
+  std::vector<std::shared_ptr<net::WsSession>> sessions_;
+
+  std::vector<Sample> samples_;
+};
+
+} // namespace client
+} // namespace boostander
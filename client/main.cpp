@@ -4,6 +4,8 @@
  * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
  */
 
+#include "LoadGenerator.hpp"
+#include "SoakTest.hpp"
 #include "algo/CSV.hpp"
 #include "algo/StringUtils.hpp"
 #include "algo/TickManager.hpp"
@@ -14,9 +16,12 @@
 #include "net/websockets/WsServer.hpp"
 #include "net/websockets/WsSession.hpp"
 #include "storage/path.hpp"
+#include <boost/program_options.hpp>
 #include <chrono>
 #include <cstdlib>
 #include <filesystem>
+#include <sys/resource.h>
+#include <fstream>
 #include <functional>
 #include <iostream>
 #include <string>
@@ -25,6 +30,11 @@
 
 namespace fs = std::filesystem; // from <filesystem>
 
+namespace po = boost::program_options; // from <boost/program_options.hpp>
+
+// chunks must fit into max-message-size of the server
+static constexpr std::size_t MAX_CHUNK_KB = 16 * 1024;
+
 using namespace std::chrono_literals;
 
 static void printNumOfCores() {
@@ -36,29 +46,8 @@ static void printNumOfCores() {
   }
 }
 
-int main(int argc, char** argv) {
-  using namespace boostander::algo;
-  using namespace boostander::net;
-  using namespace boostander::storage;
-
-  std::locale::global(std::locale::classic()); // https://stackoverflow.com/a/18981514/10904212
-
-  boostander::log::Logger::instance(); // inits Logger
-
-  LOG(INFO) << "Starting client..";
-
-  // Check command line arguments.
-  if (argc < 2) {
-    LOG(WARNING) << "Got argc = " << std::to_string(argc) << " \n"
-                 << "Got argv[1] = " << (argc > 1 ? argv[1] : "NULL") << " \n"
-                 << "Usage: websocket-client-async <csvFilePath>\n"
-                 << "Example:\n"
-                 << "    boostander_client data/test_data_28.01.2019.csv\n";
-    return EXIT_FAILURE;
-  }
-
-  auto const csvFilePath = argv[1];
-
+// Relative paths are relative to the binary
+static fs::path resolveDataPath(const std::string& csvFilePath) {
   std::filesystem::path path(csvFilePath); // Construct the path from a string.
   if (path.is_relative()) {
     LOG(INFO) << "Detected relative filepath..";
@@ -66,8 +55,14 @@ int main(int argc, char** argv) {
     path = std::filesystem::path(workdir / csvFilePath);
     LOG(INFO) << "New filepath = " << path.c_str();
   }
+  return path;
+}
+
+static std::string loadCsvFile(const std::string& csvFilePath) {
+  using namespace boostander::algo;
 
-  const std::string csvContents = getFileContents(path);
+  const std::string csvContents =
+      boostander::storage::getFileContents(resolveDataPath(csvFilePath));
 
   // check csv format
   {
@@ -78,21 +73,64 @@ int main(int argc, char** argv) {
                    << "See example .csv files in assets folder\n";
     }
   }
+  return csvContents;
+}
 
-  printNumOfCores();
+/**
+ * Streams the file as CSV_CHUNK messages of chunkSize bytes, then sends CSV_CHUNK_END.
+ * The file is read chunk by chunk and at most MAX_CHUNKS_IN_FLIGHT chunks wait to be written,
+ * so memory of the client does not grow with the file.
+ **/
+static bool uploadCsvChunks(boostander::net::WsSession& session, const fs::path& path,
+                            std::size_t chunkSize) {
+  using namespace boostander::algo;
 
-  const fs::path workdir = boostander::storage::getThisBinaryDirectoryPath();
+  constexpr std::size_t MAX_CHUNKS_IN_FLIGHT = 4;
 
-  // TODO: support async file read, use futures or std::async
-  // NOTE: future/promise Should Not Be Coupled to std::thread Execution Agents
-  boostander::config::ServerConfig serverConfig(workdir);
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file) {
+    LOG(WARNING) << "Can`t open " << path.string();
+    return false;
+  }
 
-  // NOTE Tell the socket to bind to port 0 - random port
-  serverConfig.wsPort_ = static_cast<unsigned short>(0);
+  // the opcode is written once, chunks are read after it
+  std::string chunk = Opcodes::opcodeToStr(WS_OPCODE::CSV_CHUNK);
+  const std::size_t opcodeSize = chunk.size();
+  std::size_t bytesSent = 0;
+  while (file) {
+    chunk.resize(opcodeSize + chunkSize);
+    file.read(&chunk[opcodeSize], static_cast<std::streamsize>(chunkSize));
+    const auto bytesRead = static_cast<std::size_t>(file.gcount());
+    if (bytesRead == 0) {
+      break;
+    }
+    chunk.resize(opcodeSize + bytesRead);
 
-  auto nm = std::make_shared<boostander::net::NetworkManager>();
+    // NOTE: polls, sessions do not notify about written messages
+    while (session.getPendingSendCount() >= MAX_CHUNKS_IN_FLIGHT) {
+      if (!session.isOpen()) {
+        LOG(WARNING) << "uploadCsvChunks: session is closed after " << bytesSent << " bytes";
+        return false;
+      }
+      std::this_thread::sleep_for(1ms);
+    }
+    session.send(chunk);
+    bytesSent += bytesRead;
+  }
 
-  nm->run(serverConfig);
+  session.send(Opcodes::opcodeToStr(WS_OPCODE::CSV_CHUNK_END));
+  LOG(INFO) << "uploaded " << bytesSent << " bytes of " << path.string() << " in chunks of "
+            << chunkSize << " bytes";
+  return true;
+}
+
+/**
+ * Uploads CSV data with upload and processes replies until the process is stopped.
+ **/
+static int runSingleSession(std::shared_ptr<boostander::net::NetworkManager> nm,
+                            const std::string& hostToConnect, const std::string& portToConnect,
+                            const std::function<void(boostander::net::WsSession&)>& upload) {
+  using namespace boostander::algo;
 
   // process recieved messages with some period
   TickManager<std::chrono::milliseconds> tm(50ms);
@@ -107,11 +145,9 @@ int main(int argc, char** argv) {
     return EXIT_SUCCESS;
   }
 
-  const std::string hostToConnect = "127.0.0.1";
-  const std::string portToConnect = "8080";
   newWsSession->connectAsClient(hostToConnect, portToConnect);
 
-  // NOTE: need wait connected state
+  // NOTE: need wait connected state, the session starts reading by itself
   LOG(WARNING) << "connecting to " << hostToConnect << ":" << portToConnect << "...";
   bool isConnected = newWsSession->waitForConnect(/* maxWait_ms */ 1000);
   if (!isConnected) {
@@ -121,20 +157,20 @@ int main(int argc, char** argv) {
     return EXIT_SUCCESS;
   }
 
-  newWsSession->runAsClient();
-
-  const std::string msg = Opcodes::opcodeToStr(WS_OPCODE::CSV_ANALIZE) + csvContents;
-  newWsSession->send(std::make_shared<std::string>(msg));
-
-  tm.addTickHandler(TickHandler("handleAllPlayerMessages", [&nm, &newSessId, &newWsSession]() {
+  tm.addTickHandler(TickHandler("handleAllPlayerMessages", [&nm]() {
     // Handle queued incoming messages
     nm->handleIncomingMessages();
   }));
 
+  // replies are handled while the upload is in progress
+  std::thread uploadThread([&upload, &newWsSession]() { upload(*newWsSession); });
+
   while (tm.needServerRun()) {
     tm.tick();
   }
 
+  uploadThread.join();
+
   // (If we get here, it means we got a SIGINT or SIGTERM)
   LOG(WARNING) << "If we get here, it means we got a SIGINT or SIGTERM";
 
@@ -142,3 +178,241 @@ int main(int argc, char** argv) {
 
   return EXIT_SUCCESS;
 }
+
+/**
+ * Runs LoadGenerator, prints its report to stdout and to reportFile if set.
+ **/
+static int runLoad(std::shared_ptr<boostander::net::NetworkManager> nm,
+                   const boostander::client::LoadConfig& loadConfig,
+                   const std::string& reportFile) {
+  boostander::client::LoadGenerator generator(nm, loadConfig);
+
+  LOG(WARNING) << "connecting " << loadConfig.connections << " sessions to " << loadConfig.host
+               << ":" << loadConfig.port << "...";
+  if (generator.connect(10s) == 0) {
+    LOG(WARNING) << "LoadGenerator: Can`t connect to " << loadConfig.host << ":"
+                 << loadConfig.port;
+    generator.close();
+    nm->finish();
+    return EXIT_FAILURE;
+  }
+
+  generator.run();
+
+  generator.writeReport(std::cout);
+  if (!reportFile.empty()) {
+    std::ofstream out(reportFile, std::ios::out | std::ios::trunc);
+    generator.writeReport(out);
+    if (!out.good()) {
+      LOG(WARNING) << "can`t write report to " << reportFile;
+    }
+  }
+
+  generator.close();
+  nm->finish();
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Runs SoakTest, prints its report to stdout and to reportFile if set.
+ **/
+static int runSoak(std::shared_ptr<boostander::net::NetworkManager> nm,
+                   const boostander::client::SoakConfig& soakConfig,
+                   const std::string& reportFile) {
+  // every connection takes a file descriptor, the soft limit is often 1024
+  rlimit limit{};
+  if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  boostander::client::SoakTest soak(nm, soakConfig);
+
+  LOG(WARNING) << "soak: " << soakConfig.connections << " idle sessions to " << soakConfig.host
+               << ":" << soakConfig.port << ", server metrics port " << soakConfig.metricsPort;
+  const bool isDone = soak.run();
+
+  soak.writeReport(std::cout);
+  if (!reportFile.empty()) {
+    std::ofstream out(reportFile, std::ios::out | std::ios::trunc);
+    soak.writeReport(out);
+    if (!out.good()) {
+      LOG(WARNING) << "can`t write report to " << reportFile;
+    }
+  }
+
+  soak.close();
+  nm->finish();
+
+  return isDone ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char** argv) {
+  using namespace boostander::algo;
+
+  std::locale::global(std::locale::classic()); // https://stackoverflow.com/a/18981514/10904212
+
+  boostander::log::Logger::instance(); // inits Logger
+
+  LOG(INFO) << "Starting client..";
+
+  boostander::client::LoadConfig loadConfig;
+  boostander::client::SoakConfig soakConfig;
+  std::chrono::seconds::rep samplePeriod = soakConfig.samplePeriod.count();
+  bool isDeflateEnabled = true;
+  std::string csvFilePath;
+  std::string workload;
+  std::size_t payloadSize = 16;
+  std::size_t chunkKb = 0;
+  std::chrono::milliseconds::rep cancelMs = 0;
+  std::int32_t threads = 1;
+  std::chrono::seconds::rep duration = loadConfig.duration.count();
+  std::chrono::microseconds::rep tickPeriod = loadConfig.tickPeriod.count();
+  std::string reportFile;
+
+  // clang-format off
+  po::options_description desc("Client options");
+  desc.add_options()
+    ("help,h", "print this help message")
+    ("csv", po::value<std::string>(&csvFilePath), "CSV file to send, relative to the binary")
+    ("chunk-kb", po::value<std::size_t>(&chunkKb)->default_value(chunkKb),
+        "stream the CSV file in CSV_CHUNK messages of this size, 0 sends one CSV_ANALIZE")
+    ("cancel-ms", po::value(&cancelMs)->default_value(cancelMs),
+        "send CSV_CANCEL this many milliseconds after CSV_ANALIZE, 0 - never")
+    ("host", po::value<std::string>(&loadConfig.host)->default_value(loadConfig.host),
+        "server address, load tests take comma-separated addresses (127.0.0.1,127.0.0.2)")
+    ("port", po::value<std::string>(&loadConfig.port)->default_value(loadConfig.port),
+        "server port")
+    ("workload", po::value<std::string>(&workload),
+        "load test: csv (CSV_ANALIZE of --csv), ping or soak (idle sessions, server memory), "
+        "without it one CSV is sent")
+    ("connections", po::value<std::size_t>(&loadConfig.connections)
+        ->default_value(loadConfig.connections), "load test: number of sessions")
+    ("threads", po::value<std::int32_t>(&threads)->default_value(threads),
+        "load test: number of client I/O threads")
+    ("rate", po::value<double>(&loadConfig.rate)->default_value(loadConfig.rate),
+        "load test: messages per second of all sessions")
+    ("duration", po::value(&duration)->default_value(duration),
+        "load test: seconds of sending, soak: seconds of holding all sessions")
+    ("payload", po::value<std::size_t>(&payloadSize)->default_value(payloadSize),
+        "load test: PING payload bytes")
+    ("tick-us", po::value(&tickPeriod)->default_value(tickPeriod),
+        "load test: microseconds between processing of replies")
+    ("step", po::value<std::size_t>(&soakConfig.step)->default_value(soakConfig.step),
+        "soak: sessions opened at once, server memory is sampled after each step")
+    ("sample-sec", po::value(&samplePeriod)->default_value(samplePeriod),
+        "soak: seconds between samples while sessions are held")
+    ("metrics-port",
+        po::value<unsigned short>(&soakConfig.metricsPort)->default_value(soakConfig.metricsPort),
+        "soak: metrics port of the server (--metrics true) on the first host")
+    ("deflate", po::value<bool>(&isDeflateEnabled)->default_value(isDeflateEnabled),
+        "offer permessage-deflate, servers keep deflate state only if it is offered")
+    ("report", po::value<std::string>(&reportFile), "load test: also write JSON report here");
+  // clang-format on
+
+  po::positional_options_description positional;
+  positional.add("csv", 1);
+
+  po::variables_map vm;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+    po::notify(vm);
+  } catch (const std::exception& e) {
+    LOG(WARNING) << "Invalid options: " << e.what() << "\n" << desc;
+    return EXIT_FAILURE;
+  }
+
+  if (vm.count("help") || (csvFilePath.empty() && workload != "ping" && workload != "soak") ||
+      (!workload.empty() && workload != "csv" && workload != "ping" && workload != "soak") ||
+      threads < 1 ||
+      chunkKb > MAX_CHUNK_KB) {
+    LOG(WARNING) << "Usage: boostander_client <csvFilePath> [options]\n"
+                 << "       boostander_client --workload ping [options]\n"
+                 << desc << "Example:\n"
+                 << "    boostander_client data/test_data_28.01.2019.csv\n"
+                 << "    boostander_client data/test_data_28.01.2019.csv --chunk-kb 1024\n"
+                 << "    boostander_client --workload ping --connections 1000 --rate 20000\n"
+                 << "    boostander_client --workload soak --connections 100000 --step 10000\n";
+    return vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // streamed files are never loaded as a whole
+  const bool isStreamed = workload.empty() && chunkKb > 0;
+  const std::string csvContents =
+      csvFilePath.empty() || isStreamed ? std::string() : loadCsvFile(csvFilePath);
+  if (workload == "csv" && csvContents.empty()) {
+    LOG(WARNING) << "empty or missing csv file " << csvFilePath;
+    return EXIT_FAILURE;
+  }
+
+  printNumOfCores();
+
+  const fs::path workdir = boostander::storage::getThisBinaryDirectoryPath();
+
+  // TODO: support async file read, use futures or std::async
+  // NOTE: future/promise Should Not Be Coupled to std::thread Execution Agents
+  boostander::config::ServerConfig serverConfig(workdir);
+
+  // NOTE Tell the socket to bind to port 0 - random port
+  serverConfig.wsPort_ = static_cast<unsigned short>(0);
+  serverConfig.deflateEnabled_ = isDeflateEnabled;
+  // replies are handled by the tick thread of the client, see LoadGenerator::run
+  serverConfig.inlineOpcodes_.clear();
+  serverConfig.heavyOpcodes_.clear();
+
+  if (!workload.empty()) {
+    serverConfig.threads_ = threads;
+    // the generator sends ahead of replies, its own schedule is the limit
+    serverConfig.maxSendQueueSize_ = 0;
+    serverConfig.maxReceiveQueueSize_ = 0;
+    serverConfig.traceSampleEvery_ = 0;
+
+    loadConfig.workload = workload;
+    loadConfig.duration = std::chrono::seconds(duration);
+    loadConfig.tickPeriod = std::chrono::microseconds(tickPeriod);
+    if (workload == "csv") {
+      loadConfig.message = Opcodes::opcodeToStr(WS_OPCODE::CSV_ANALIZE) + csvContents;
+      loadConfig.replyOpcode = Opcodes::opcodeToStr(WS_OPCODE::CSV_ANSWER)[0];
+    } else {
+      loadConfig.message = Opcodes::opcodeToStr(WS_OPCODE::PING) + std::string(payloadSize, 'x');
+      loadConfig.replyOpcode = Opcodes::opcodeToStr(WS_OPCODE::PING)[0];
+    }
+  }
+
+  auto nm = std::make_shared<boostander::net::NetworkManager>();
+
+  nm->run(serverConfig);
+
+  if (workload == "soak") {
+    soakConfig.host = loadConfig.host;
+    soakConfig.port = loadConfig.port;
+    soakConfig.connections = loadConfig.connections;
+    soakConfig.hold = std::chrono::seconds(duration);
+    soakConfig.samplePeriod = std::chrono::seconds(samplePeriod);
+    return runSoak(nm, soakConfig, reportFile);
+  }
+
+  if (!workload.empty()) {
+    return runLoad(nm, loadConfig, reportFile);
+  }
+
+  if (isStreamed) {
+    const fs::path path = resolveDataPath(csvFilePath);
+    return runSingleSession(nm, loadConfig.host, loadConfig.port,
+                            [&path, chunkKb](boostander::net::WsSession& session) {
+                              uploadCsvChunks(session, path, chunkKb * 1024);
+                            });
+  }
+
+  return runSingleSession(nm, loadConfig.host, loadConfig.port,
+                          [&csvContents, cancelMs](boostander::net::WsSession& session) {
+                            session.send(Opcodes::opcodeToStr(WS_OPCODE::CSV_ANALIZE) +
+                                         csvContents);
+                            // partial results are answered with CSV_CANCEL
+                            if (cancelMs > 0) {
+                              std::this_thread::sleep_for(std::chrono::milliseconds(cancelMs));
+                              session.send(Opcodes::opcodeToStr(WS_OPCODE::CSV_CANCEL));
+                            }
+                          });
+}
@@ -0,0 +1,15 @@
+#!/usr/bin/env bash
+# Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+# Distributed under the MIT License.
+# See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+
+# Generates self-signed certificate for local wss:// testing,
+# see tls-cert and tls-key in assets/server.conf
+
+set -ev
+
+cmake -E make_directory assets/certs
+
+openssl req -x509 -nodes -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 \
+  -keyout assets/certs/server.key -out assets/certs/server.crt \
+  -days 365 -subj "/CN=localhost"
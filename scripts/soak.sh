@@ -0,0 +1,46 @@
+#!/usr/bin/env bash
+# Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+# Distributed under the MIT License.
+# See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+
+# Soak test of idle connections: starts the server with metrics and opens CONNECTIONS loopback
+# sessions to it in steps, server RSS per connection is sampled after each step and while the
+# sessions are held. Build the server with -DMEMORY_ACCOUNTING=ON to also get heap per subsystem.
+# usage: bash scripts/soak.sh <server binary> <client binary> [connections] [report.json]
+# environment: SOAK_STEP, SOAK_HOLD_SEC, SOAK_PORT, SOAK_METRICS_PORT, SOAK_SERVER_ARGS
+
+set -e
+
+SERVER=$1
+CLIENT=$2
+CONNECTIONS=${3:-100000}
+REPORT=${4:-soak.json}
+STEP=${SOAK_STEP:-10000}
+HOLD_SEC=${SOAK_HOLD_SEC:-60}
+PORT=${SOAK_PORT:-18080}
+METRICS_PORT=${SOAK_METRICS_PORT:-19464}
+
+# both processes take a file descriptor per connection
+ulimit -n "$(ulimit -Hn)"
+if [ "$(ulimit -n)" != unlimited ] && [ "$(ulimit -n)" -lt $((CONNECTIONS + 1024)) ]; then
+  echo "soak: file descriptor limit $(ulimit -n) is too low for $CONNECTIONS connections" >&2
+  exit 1
+fi
+
+# one destination address takes at most ~28k ephemeral ports of the client,
+# so connections are spread over 127.0.0.1, 127.0.0.2, ... and the server listens on all
+HOSTS=127.0.0.1
+for ((i = 2; i <= (CONNECTIONS + 19999) / 20000; i++)); do
+  HOSTS="$HOSTS,127.0.0.$i"
+done
+
+# shellcheck disable=SC2086
+"$SERVER" --address 0.0.0.0 --port "$PORT" --metrics true --metrics-port "$METRICS_PORT" \
+  $SOAK_SERVER_ARGS &
+SERVER_PID=$!
+trap 'kill $SERVER_PID 2>/dev/null' EXIT
+sleep 1
+
+"$CLIENT" --workload soak --host "$HOSTS" --port "$PORT" --metrics-port "$METRICS_PORT" \
+  --connections "$CONNECTIONS" --step "$STEP" --duration "$HOLD_SEC" --threads 2 \
+  --report "$REPORT"
@@ -85,7 +85,8 @@ void CSV::parseData(std::deque<std::string>& readed_data) {
 
 void CSV::appendRow(const std::vector<std::string>& strVec) {
   if (strVec.size() != colsCount_) {
-    LOG(WARNING) << "CSV::appendRow: strVec.size() != cols_count";
+    // NOTE: one invalid file may have many invalid rows
+    LOG_EVERY_N(WARNING, 1000) << "CSV::appendRow: strVec.size() != cols_count";
     return;
   }
   rowsDeque_.push_back(strVec);
@@ -11,7 +11,8 @@ public:
 
   virtual ~CallbackManager(){};
 
-  virtual std::map<opType, cbType> getCallbacks() const = 0;
+  // NOTE: by reference, callbacks are looked up for every received message
+  virtual const std::map<opType, cbType>& getCallbacks() const = 0;
 
   virtual void addCallback(const opType& op, const cbType& cb) = 0;
 
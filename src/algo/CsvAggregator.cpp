@@ -0,0 +1,124 @@
+#include "algo/CsvAggregator.hpp" // IWYU pragma: associated
+#include "algo/StringUtils.hpp"
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+#include <cmath>
+#include <sstream>
+#include <string_view>
+
+namespace boostander {
+namespace algo {
+
+namespace {
+
+bool isRowEnd(char c) { return c == '\n' || c == '\r'; }
+
+} // namespace
+
+CsvAggregator::CsvAggregator(char delimiter) : delimiter_(delimiter) {}
+
+void CsvAggregator::feed(const char* data, std::size_t size) {
+  bytesCount_ += size;
+
+  const char* const end = data + size;
+  const char* rowBegin = data;
+  while (rowBegin != end) {
+    const char* rowEnd = std::find_if(rowBegin, end, isRowEnd);
+    if (rowEnd == end) {
+      break;
+    }
+
+    if (isSkippingRow_) {
+      isSkippingRow_ = false;
+    } else if (!partialRow_.empty()) {
+      partialRow_.append(rowBegin, rowEnd);
+      parseRow(partialRow_.data(), partialRow_.data() + partialRow_.size());
+      partialRow_.clear();
+    } else {
+      // whole rows are parsed in place, without copies
+      parseRow(rowBegin, rowEnd);
+    }
+    rowBegin = rowEnd + 1;
+  }
+
+  if (rowBegin == end || isSkippingRow_) {
+    return;
+  }
+  if (partialRow_.size() + static_cast<std::size_t>(end - rowBegin) > MAX_ROW_SIZE) {
+    partialRow_.clear();
+    partialRow_.shrink_to_fit();
+    isSkippingRow_ = true;
+    skippedRowsCount_++;
+    return;
+  }
+  partialRow_.append(rowBegin, end);
+}
+
+void CsvAggregator::finish() {
+  if (!partialRow_.empty()) {
+    parseRow(partialRow_.data(), partialRow_.data() + partialRow_.size());
+    partialRow_.clear();
+  }
+  isSkippingRow_ = false;
+}
+
+void CsvAggregator::parseRow(const char* begin, const char* end) {
+  // first three non-empty fields, as CSV::getAt(row, 0..2)
+  std::string_view fields[3];
+  std::size_t fieldsCount = 0;
+  for (const char* fieldBegin = begin;;) {
+    const char* fieldEnd = std::find(fieldBegin, end, delimiter_);
+    if (fieldEnd != fieldBegin) {
+      if (fieldsCount < 3) {
+        fields[fieldsCount] =
+            std::string_view(fieldBegin, static_cast<std::size_t>(fieldEnd - fieldBegin));
+      }
+      fieldsCount++;
+    }
+    if (fieldEnd == end) {
+      break;
+    }
+    fieldBegin = fieldEnd + 1;
+  }
+
+  if (fieldsCount == 0) {
+    return;
+  }
+  rowsCount_++;
+
+  if (fieldsCount < 3) {
+    return;
+  }
+
+  const auto date = dateTimeFromStr(std::string(fields[0]));
+  if (date <= maxDate_) {
+    return;
+  }
+  maxDate_ = date;
+
+  double a = 0.0;
+  double b = 0.0;
+  if (boost::conversion::try_lexical_convert(fields[1].data(), fields[1].size(), a) &&
+      boost::conversion::try_lexical_convert(fields[2].data(), fields[2].size(), b) &&
+      !std::isinf(b) && b != 0) {
+    ratio_ = a / b;
+  }
+}
+
+std::string csvPartialResults(WS_OPCODE opcode, const CsvAggregator& csv) {
+  std::ostringstream results;
+  results << Opcodes::opcodeToStr(opcode) << csv.getRowsCount() << ';' << csv.getBytesCount()
+          << ';' << dateToStr(csv.getMaxDate()) << ';' << csv.getRatio();
+  return results.str();
+}
+
+bool CsvProgress::update(const CsvAggregator& csv) {
+  if (!progressBytes_ || csv.getBytesCount() < nextProgress_) {
+    return false;
+  }
+  nextProgress_ = csv.getBytesCount() + progressBytes_;
+  return true;
+}
+
+} // namespace algo
+} // namespace boostander
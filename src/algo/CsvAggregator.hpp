@@ -0,0 +1,86 @@
+#pragma once
+
+#include "algo/NetworkOperation.hpp"
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace boostander {
+namespace algo {
+
+/**
+ * Incremental analysis of CSV_ANALIZE data: rows are parsed as data arrives,
+ * only an unfinished row is kept, so memory does not grow with the file.
+ * Rows are split as by CSV: '\n' and '\r' end rows, empty fields and rows are skipped.
+ * Computes the rows count, the max date of the first column and
+ * a / b of the second and third columns of the row with the max date.
+ **/
+class CsvAggregator {
+public:
+  // Rows longer than this are skipped, a file without line breaks must not pin memory
+  static constexpr std::size_t MAX_ROW_SIZE = 64 * 1024;
+
+  explicit CsvAggregator(char delimiter = ',');
+
+  // Data may end anywhere, also in the middle of a row or a field
+  void feed(const char* data, std::size_t size);
+
+  void feed(const std::string& data) { feed(data.data(), data.size()); }
+
+  // Parses the last row if it does not end with a line break
+  void finish();
+
+  std::size_t getRowsCount() const { return rowsCount_; }
+
+  // Rows dropped for MAX_ROW_SIZE
+  std::size_t getSkippedRowsCount() const { return skippedRowsCount_; }
+
+  std::size_t getBytesCount() const { return bytesCount_; }
+
+  std::chrono::system_clock::time_point getMaxDate() const { return maxDate_; }
+
+  // a / b at getMaxDate(), 0 if b is 0 or not a number
+  double getRatio() const { return ratio_; }
+
+private:
+  void parseRow(const char* begin, const char* end);
+
+  const char delimiter_;
+
+  // Beginning of the row that is cut by the end of fed data
+  std::string partialRow_;
+
+  // The current row exceeded MAX_ROW_SIZE, it is skipped up to the line break
+  bool isSkippingRow_{false};
+
+  std::size_t rowsCount_{0};
+
+  std::size_t skippedRowsCount_{0};
+
+  std::size_t bytesCount_{0};
+
+  std::chrono::system_clock::time_point maxDate_;
+
+  double ratio_{0.0};
+};
+
+// Partial results of CSV_PROGRESS and CSV_CANCEL after the opcode: rows;bytes;max date;a/b
+std::string csvPartialResults(WS_OPCODE opcode, const CsvAggregator& csv);
+
+// Cadence of CSV_PROGRESS: after every progressBytes of data fed to an analysis, 0 - never
+class CsvProgress {
+public:
+  explicit CsvProgress(std::size_t progressBytes)
+      : progressBytes_(progressBytes), nextProgress_(progressBytes) {}
+
+  // True if CSV_PROGRESS of csv is due, once per progressBytes
+  bool update(const CsvAggregator& csv);
+
+private:
+  const std::size_t progressBytes_;
+
+  std::size_t nextProgress_;
+};
+
+} // namespace algo
+} // namespace boostander
@@ -1,11 +1,39 @@
 #include "algo/DispatchQueue.hpp" // IWYU pragma: associated
 #include "log/Logger.hpp"
+#include "metrics/Metrics.hpp"
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <utility>
 
 namespace boostander {
 namespace algo {
 
+namespace {
+
+// Summed over all queues, every session has its own queue
+struct DispatchQueueMetrics {
+  metrics::Gauge& depth;
+
+  metrics::Counter& dispatched;
+
+  metrics::Histogram& waitTime;
+};
+
+DispatchQueueMetrics& dispatchQueueMetrics() {
+  static DispatchQueueMetrics queueMetrics{
+      metrics::MetricsRegistry::instance().gauge("dispatch_queue_depth",
+                                                 "Callbacks waiting in dispatch queues"),
+      metrics::MetricsRegistry::instance().counter("dispatch_queue_dispatched_total",
+                                                   "Callbacks added to dispatch queues"),
+      metrics::MetricsRegistry::instance().histogram(
+          "dispatch_queue_wait_seconds", "Time from dispatch to the start of a callback")};
+  return queueMetrics;
+}
+
+} // namespace
+
 DispatchQueue::DispatchQueue(const std::string& name, const size_t thread_cnt)
     : name_(name), threads_(thread_cnt) {
 
@@ -24,6 +52,9 @@ DispatchQueue::~DispatchQueue() {
   /*while (!callbacksQueue_.empty())
     callbacksQueue_.pop();*/
 
+  // callbacks left in the queue are destroyed with it
+  dispatchQueueMetrics().depth.sub(static_cast<std::int64_t>(callbacksQueue_.size()));
+
   lock.unlock();
   cv_.notify_all();
 
@@ -37,9 +68,16 @@ DispatchQueue::~DispatchQueue() {
   }
 }
 
+size_t DispatchQueue::totalSize() {
+  // NOTE: shards of the gauge are summed without a lock, a racing dispatch may count as -1
+  return static_cast<size_t>(std::max<std::int64_t>(0, dispatchQueueMetrics().depth.value()));
+}
+
 void DispatchQueue::dispatch(const dispatch_callback& op) {
   std::unique_lock<std::mutex> lock(lock_);
-  callbacksQueue_.push(op);
+  callbacksQueue_.push(QueuedCallback{op, std::chrono::steady_clock::now()});
+  dispatchQueueMetrics().depth.add();
+  dispatchQueueMetrics().dispatched.inc();
 
   // Manual unlocking is done before notifying, to avoid waking up
   // the waiting thread only to block again (see notify_one for details)
@@ -49,7 +87,9 @@ void DispatchQueue::dispatch(const dispatch_callback& op) {
 
 void DispatchQueue::dispatch(dispatch_callback&& op) {
   std::unique_lock<std::mutex> lock(lock_);
-  callbacksQueue_.push(std::move(op));
+  callbacksQueue_.push(QueuedCallback{std::move(op), std::chrono::steady_clock::now()});
+  dispatchQueueMetrics().depth.add();
+  dispatchQueueMetrics().dispatched.inc();
 
   // Manual unlocking is done before notifying, to avoid waking up
   // the waiting thread only to block again (see notify_one for details)
@@ -67,8 +107,7 @@ void DispatchQueue::dispatch_loop(void) {
 
     // after wait, we own the lock
     if (!quit_ && callbacksQueue_.size()) {
-      auto dispatchCallback = std::move(callbacksQueue_.front());
-      callbacksQueue_.pop();
+      auto dispatchCallback = popQueued();
 
       // unlock now that we're done messing with the queue
       lock.unlock();
@@ -85,17 +124,27 @@ void DispatchQueue::dispatch_loop(void) {
 void DispatchQueue::clear() {
   std::unique_lock<std::mutex> lock(lock_);
 
+  dispatchQueueMetrics().depth.sub(static_cast<std::int64_t>(callbacksQueue_.size()));
   while (!callbacksQueue_.empty())
     callbacksQueue_.pop();
 }
 
+DispatchQueue::dispatch_callback DispatchQueue::popQueued() {
+  QueuedCallback& front = callbacksQueue_.front();
+  dispatchQueueMetrics().waitTime.record(std::chrono::steady_clock::now() - front.dispatchedAt);
+  dispatchQueueMetrics().depth.sub();
+
+  dispatch_callback result = std::move(front.callback);
+  callbacksQueue_.pop();
+  return result;
+}
+
 void DispatchQueue::DispatchQueued(void) {
   std::unique_lock<std::mutex> lock(lock_);
 
   do {
     if (!quit_ && callbacksQueue_.size()) {
-      auto dispatchCallback = std::move(callbacksQueue_.front());
-      callbacksQueue_.pop();
+      auto dispatchCallback = popQueued();
 
       // unlock now that we're done messing with the queue
       lock.unlock();
@@ -109,5 +158,59 @@ void DispatchQueue::DispatchQueued(void) {
   lock.unlock();
 }
 
+bool DispatchQueue::dispatchTurn(std::chrono::nanoseconds quantum, size_t maxCallbacks) {
+  std::unique_lock<std::mutex> lock(lock_);
+
+  const bool isTimed = quantum.count() > 0;
+  if (isTimed) {
+    deficit_ += quantum;
+  }
+  for (size_t dispatched = 0; !quit_ && tickCallbacks_ && callbacksQueue_.size(); dispatched++) {
+    // a long callback is paid for by the next turns of the queue
+    if ((isTimed && deficit_.count() <= 0) || (maxCallbacks && dispatched == maxCallbacks)) {
+      return true;
+    }
+    auto dispatchCallback = popQueued();
+    tickCallbacks_--;
+    lock.unlock();
+
+    if (isTimed) {
+      const auto start = std::chrono::steady_clock::now();
+      dispatchCallback();
+      const auto elapsed = std::chrono::steady_clock::now() - start;
+      lock.lock();
+      deficit_ -= elapsed;
+    } else {
+      dispatchCallback();
+      lock.lock();
+    }
+  }
+
+  // the queue does not save credit for later bursts, the debt of a long callback is kept
+  deficit_ = std::min(deficit_, std::chrono::nanoseconds(0));
+  tickCallbacks_ = 0;
+  return false;
+}
+
+void DispatchQueue::dispatchFair(std::vector<OwnedQueue>& queues,
+                                 std::chrono::nanoseconds quantum, size_t maxCallbacks) {
+  // callbacks dispatched by I/O threads meanwhile wait for the next call, it ends
+  for (auto& queue : queues) {
+    std::scoped_lock<std::mutex> lock(queue.second->lock_);
+    queue.second->tickCallbacks_ = queue.second->callbacksQueue_.size();
+  }
+  while (!queues.empty()) {
+    // queues with callbacks left keep their order for the next round
+    size_t backlogged = 0;
+    for (size_t i = 0; i < queues.size(); i++) {
+      if (queues[i].second->dispatchTurn(quantum, maxCallbacks)) {
+        std::swap(queues[backlogged++], queues[i]);
+      }
+    }
+    // owners of emptied queues are released here, after their last callback
+    queues.resize(backlogged);
+  }
+}
+
 } // namespace algo
 } // namespace boostander
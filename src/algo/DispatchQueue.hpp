@@ -1,12 +1,15 @@
 #pragma once
 
+#include <chrono>
 #include <condition_variable>
 #include <cstdio>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 namespace boostander {
@@ -36,23 +39,71 @@ public:
   DispatchQueue& operator=(DispatchQueue&& rhs) = delete;
 
   // private:
+  // Callback with the time it was dispatched, the time waiting in the queue is a metric
+  struct QueuedCallback {
+    dispatch_callback callback;
+    std::chrono::steady_clock::time_point dispatchedAt;
+  };
+
   std::string name_;
   std::mutex lock_;
   std::vector<std::thread> threads_;
-  std::queue<dispatch_callback> callbacksQueue_;
+  std::queue<QueuedCallback> callbacksQueue_;
   std::condition_variable cv_;
   bool quit_ = false;
 
   void dispatch_loop(void);
 
+  // Takes the front callback, requires lock_
+  dispatch_callback popQueued();
+
   void DispatchQueued(void);
 
+  /**
+   * One turn of deficit round-robin: adds quantum to the deficit of the queue and runs callbacks
+   * while it is positive, each one takes its duration from it, and at most maxCallbacks of them.
+   * 0 - no limit. Only callbacks queued when the tick began run, see dispatchFair.
+   * Returns true if callbacks of the tick are left for the next turn.
+   **/
+  bool dispatchTurn(std::chrono::nanoseconds quantum, size_t maxCallbacks);
+
+  /**
+   * Queue with the object its callbacks use, e.g. a session. The owner is kept alive
+   * while dispatchFair runs the callbacks, even if everyone else drops it meanwhile.
+   **/
+  typedef std::pair<std::shared_ptr<void>, std::shared_ptr<DispatchQueue>> OwnedQueue;
+
+  /**
+   * Runs callbacks of queues in turns until the callbacks queued before the call are done,
+   * a queue with many callbacks waits for the turns of the others instead of delaying them.
+   * Callbacks dispatched meanwhile are left for the next call. Reorders and empties queues.
+   * @see dispatchTurn
+   **/
+  static void dispatchFair(std::vector<OwnedQueue>& queues, std::chrono::nanoseconds quantum,
+                           size_t maxCallbacks);
+
   void clear();
 
   bool isEmpty() {
     std::scoped_lock<std::mutex> lock(lock_);
     return threads_.empty();
   }
+
+  // callbacks waiting in all queues of the process, thread-safe
+  static size_t totalSize();
+
+  // number of queued callbacks
+  size_t size() {
+    std::scoped_lock<std::mutex> lock(lock_);
+    return callbacksQueue_.size();
+  }
+
+private:
+  // Callback time the queue may still take in its turns, see dispatchTurn. Requires lock_
+  std::chrono::nanoseconds deficit_{0};
+
+  // Callbacks the queue may still run in the current dispatchFair call. Requires lock_
+  size_t tickCallbacks_ = 0;
 };
 
 } // namespace algo
@@ -6,7 +6,29 @@
 namespace boostander {
 namespace algo {
 
-enum class WS_OPCODE_ENUM : uint32_t { PING = 48, CSV_ANALIZE = 49, CSV_ANSWER = 50, TOTAL };
+/**
+ * First byte of every message.
+ * CSV_CHUNK messages upload CSV_ANALIZE data in parts, CSV_CHUNK_END completes the upload
+ * and is answered with CSV_ANSWER.
+ * BUSY answers a message dropped by the overload protection of the server instead of its reply,
+ * THROTTLED a message over the rate limits of the session, the second byte of both is the opcode
+ * of the dropped message.
+ * CSV_PROGRESS reports partial results of a CSV_ANALIZE in progress: rows;bytes;max date;a/b.
+ * CSV_CANCEL (just the opcode) stops analyses of the session received before it, each one is
+ * answered with CSV_CANCEL and its partial results (as CSV_PROGRESS) instead of CSV_ANSWER.
+ **/
+enum class WS_OPCODE_ENUM : uint32_t {
+  PING = 48,
+  CSV_ANALIZE = 49,
+  CSV_ANSWER = 50,
+  CSV_CHUNK = 51,
+  CSV_CHUNK_END = 52,
+  BUSY = 53,
+  THROTTLED = 54,
+  CSV_PROGRESS = 55,
+  CSV_CANCEL = 56,
+  TOTAL
+};
 
 class Opcodes {
 public:
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <string>
 #include <thread>
@@ -32,6 +33,7 @@ public:
 
   bool needServerRun() const { return needServerRun_; }
 
+  // Thread-safe, e.g. called by a signal handler on an I/O thread
   void stop() { needServerRun_ = false; }
 
   void addTickHandler(const TickHandler& tickHandler) { tickHandlers_.push_back(tickHandler); }
@@ -43,7 +45,7 @@ private:
 
   std::vector<TickHandler> tickHandlers_;
 
-  bool needServerRun_ = true;
+  std::atomic<bool> needServerRun_{true};
 };
 } // namespace algo
 } // namespace boostander
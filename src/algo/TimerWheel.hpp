@@ -0,0 +1,149 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace boostander {
+namespace algo {
+
+/**
+ * Hashed timer wheel with coarse granularity.
+ * Items are kept in slots by deadline tick, deadlines further than one revolution
+ * are tracked by the number of remaining rounds, so schedule and expiry are O(1) per item.
+ * Deadlines are checked lazily: T::deadline() is read only when the slot is reached,
+ * an item whose deadline moved (e.g. last activity timestamp changed) is re-inserted,
+ * otherwise T::onDeadline() is called. So the owner updates deadlines without
+ * touching the wheel at all.
+ * T must provide `Clock::time_point deadline() const` (thread-safe)
+ * and `void onDeadline()` (called without the wheel lock held).
+ * @note items are stored as weak_ptr, expired items are dropped.
+ * @see http://www.cs.columbia.edu/~nahum/w6998/papers/sosp87-timing-wheels.pdf
+ **/
+template <typename T> class TimerWheel {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  TimerWheel(Clock::duration granularity, std::size_t slotsCount,
+             Clock::time_point start = Clock::now())
+      : granularity_(granularity), slots_(slotsCount), start_(start) {}
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  // Item will be checked at the first tick not earlier than deadline
+  void schedule(std::weak_ptr<T> item, Clock::time_point deadline) {
+    std::scoped_lock<std::mutex> lock(mutex_);
+    insert(std::move(item), deadline);
+    size_++;
+  }
+
+  /**
+   * Processes all ticks passed until now.
+   * Returns number of items for which onDeadline() was called.
+   * @note must be called from one thread at a time (e.g. a periodic timer),
+   * schedule() may be called from any thread.
+   **/
+  std::size_t advance(Clock::time_point now) {
+    if (now < start_) {
+      return 0;
+    }
+    const std::uint64_t nowTick = static_cast<std::uint64_t>((now - start_) / granularity_);
+
+    {
+      std::scoped_lock<std::mutex> lock(mutex_);
+      while (currentTick_ <= nowTick) {
+        // NOTE: swap keeps capacity of both vectors, no allocations in steady state
+        expiring_.clear();
+        expiring_.swap(slots_[currentTick_ % slots_.size()]);
+        currentTick_++;
+
+        for (Entry& entry : expiring_) {
+          if (entry.rounds > 0) {
+            entry.rounds--;
+            slots_[(currentTick_ - 1) % slots_.size()].push_back(std::move(entry));
+            continue;
+          }
+          std::shared_ptr<T> item = entry.item.lock();
+          if (!item) {
+            size_--;
+            continue;
+          }
+          const Clock::time_point deadline = item->deadline();
+          if (deadline > now) {
+            // deadline moved, check item again later
+            insert(std::move(entry.item), deadline);
+            continue;
+          }
+          size_--;
+          fired_.push_back(std::move(item));
+        }
+      }
+    }
+
+    // NOTE: onDeadline() may schedule the item again, so call it without the lock
+    const std::size_t firedCount = fired_.size();
+    for (std::shared_ptr<T>& item : fired_) {
+      item->onDeadline();
+    }
+    fired_.clear();
+    return firedCount;
+  }
+
+  // Number of scheduled items, including items that were destroyed but not yet dropped
+  std::size_t size() const {
+    std::scoped_lock<std::mutex> lock(mutex_);
+    return size_;
+  }
+
+  Clock::duration granularity() const { return granularity_; }
+
+private:
+  struct Entry {
+    std::weak_ptr<T> item;
+
+    // full revolutions of the wheel to wait before deadline is checked
+    std::uint64_t rounds;
+  };
+
+  // Requires mutex_
+  void insert(std::weak_ptr<T> item, Clock::time_point deadline) {
+    std::uint64_t tick = currentTick_;
+    if (deadline > start_) {
+      // round up, item must not be checked before deadline
+      const auto sinceStart = deadline - start_;
+      tick = static_cast<std::uint64_t>((sinceStart + granularity_ - Clock::duration(1)) /
+                                        granularity_);
+      if (tick < currentTick_) {
+        tick = currentTick_;
+      }
+    }
+    const std::uint64_t rounds = (tick - currentTick_) / slots_.size();
+    slots_[tick % slots_.size()].push_back(Entry{std::move(item), rounds});
+  }
+
+  mutable std::mutex mutex_;
+
+  const Clock::duration granularity_;
+
+  std::vector<std::vector<Entry>> slots_;
+
+  const Clock::time_point start_;
+
+  // next tick to be processed
+  std::uint64_t currentTick_ = 0;
+
+  std::size_t size_ = 0;
+
+  // reused by advance() to avoid allocations
+  std::vector<Entry> expiring_;
+
+  std::vector<std::shared_ptr<T>> fired_;
+};
+
+} // namespace algo
+} // namespace boostander
@@ -4,12 +4,17 @@
 #include <boost/asio.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/websocket.hpp>
+#include <boost/program_options.hpp>
 #include <cstdlib>
+#include <exception>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <sstream>
 #include <streambuf>
 #include <string>
+#include <vector>
 
 namespace boostander {
 namespace config {
@@ -19,20 +24,386 @@ namespace beast = boost::beast;         // from <boost/beast.hpp>
 namespace http = beast::http;           // from <boost/beast/http.hpp>
 namespace websocket = beast::websocket; // from <boost/beast/websocket.hpp>
 namespace net = boost::asio;            // from <boost/asio.hpp>
+namespace po = boost::program_options;  // from <boost/program_options.hpp>
 using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
 
+namespace {
+
+// OPCODE:MESSAGES:BYTES, e.g. 1:5:10485760
+bool parseRateLimit(const std::string& str, char& opcode, RateLimit& limit) {
+  std::istringstream in(str);
+  char separator = 0;
+  char bytesSeparator = 0;
+  if (!(in >> opcode >> separator >> limit.messagesPerSec >> bytesSeparator >>
+        limit.bytesPerSec) ||
+      separator != ':' || bytesSeparator != ':' || !in.eof()) {
+    return false;
+  }
+  return limit.messagesPerSec >= 0.0 && limit.bytesPerSec >= 0.0;
+}
+
+std::string rateLimitsToStr(const std::map<char, RateLimit>& rateLimits) {
+  std::ostringstream out;
+  for (const auto& rateLimit : rateLimits) {
+    out << (out.tellp() ? " " : "") << rateLimit.first << ':' << rateLimit.second.messagesPerSec
+        << ':' << rateLimit.second.bytesPerSec;
+  }
+  return out.str();
+}
+
+} // namespace
+
 ServerConfig::ServerConfig(const fs::path& workdir) : workdir_(workdir) { loadConf(); }
 
 void ServerConfig::print() const {
   LOG(INFO) << "address: " << address_.to_string() << '\n'
             << "port: " << wsPort_ << '\n'
-            << "threads: " << threads_;
+            << "threads: " << threads_ << '\n'
+            << "coroutine sessions: " << wsCoroSessions_ << '\n'
+            << "ping interval (sec): " << pingInterval_.count() << '\n'
+            << "pong timeout (sec): " << pongTimeout_.count() << '\n'
+            << "idle timeout (sec): " << idleTimeout_.count() << '\n'
+            << "max message size (bytes): " << maxMessageSize_ << '\n'
+            << "max send queue size: " << maxSendQueueSize_ << '\n'
+            << "max receive queue size: " << maxReceiveQueueSize_ << '\n'
+            << "max sessions: " << maxSessions_ << '\n'
+            << "max sessions per address: " << maxSessionsPerAddress_ << '\n'
+            << "busy queued messages: " << busyQueuedMessages_ << '\n'
+            << "busy CPU percent: " << busyCpuPercent_ << '\n'
+            << "rate limits: " << (rateLimits_.empty() ? "none" : rateLimitsToStr(rateLimits_))
+            << '\n'
+            << "rate limit burst (ms): " << rateLimitBurst_.count() << '\n'
+            << "stream opcodes: " << (streamOpcodes_.empty() ? "none" : streamOpcodes_) << '\n'
+            << "deflate: "
+            << (deflateEnabled_ ? "window bits " + std::to_string(deflateWindowBits_) +
+                                      ", memory level " + std::to_string(deflateMemLevel_) +
+                                      ", compression level " + std::to_string(deflateCompLevel_)
+                                : "off")
+            << '\n'
+            << "tick period (ms): " << tickPeriod_.count() << '\n'
+            << "dispatch quantum (us): " << dispatchQuantum_.count() << '\n'
+            << "dispatch quantum messages: " << dispatchQuantumMessages_ << '\n'
+            << "inline opcodes: " << (inlineOpcodes_.empty() ? "none" : inlineOpcodes_) << '\n'
+            << "heavy opcodes: " << (heavyOpcodes_.empty() ? "none" : heavyOpcodes_) << '\n'
+            << "heavy threads: " << heavyThreads_ << '\n'
+            << "max heavy queue size: " << maxHeavyQueueSize_ << '\n'
+            << "csv progress (KB): " << csvProgressBytes_ / 1024 << '\n'
+            << "wss port: " << wssPort_ << '\n'
+            << "TLS certificate: " << (tlsCertFile_.empty() ? "none, TLS disabled" : tlsCertFile_)
+            << '\n'
+            << "TLS handshake threads: " << tlsHandshakeThreads_ << '\n'
+            << "TLS max concurrent handshakes: " << tlsMaxConcurrentHandshakes_ << '\n'
+            << "TLS session cache size: " << tlsSessionCacheSize_ << '\n'
+            << "TLS session tickets: " << tlsSessionTickets_ << '\n'
+            << "async logging: " << logAsync_ << '\n'
+            << "log ring capacity: " << logRingCapacity_ << '\n'
+            << "metrics: " << (metricsEnabled_ ? "port " + std::to_string(metricsPort_) : "off")
+            << '\n'
+            << "trace sample every: " << traceSampleEvery_ << '\n'
+            << "trace file: " << (traceFile_.empty() ? "none" : traceFile_) << '\n'
+            << "drain timeout (sec): " << drainTimeout_.count() << '\n'
+            << "handoff socket: " << (handoffSocket_.empty() ? "none" : handoffSocket_);
 }
 
 void ServerConfig::loadConf() {
   address_ = net::ip::make_address("127.0.0.1");
   wsPort_ = static_cast<unsigned short>(8080);
   threads_ = 1;
+  wsCoroSessions_ = false;
+  pingInterval_ = std::chrono::seconds(15);
+  pongTimeout_ = std::chrono::seconds(15);
+  idleTimeout_ = std::chrono::seconds(0);
+  maxMessageSize_ = 64 * 1024 * 1024;
+  maxSendQueueSize_ = 256;
+  maxReceiveQueueSize_ = 1024;
+  maxSessions_ = 0;
+  maxSessionsPerAddress_ = 0;
+  busyQueuedMessages_ = 0;
+  busyCpuPercent_ = 0;
+  rateLimits_.clear();
+  rateLimitBurst_ = std::chrono::milliseconds(1000);
+  streamOpcodes_.clear();
+  deflateEnabled_ = true;
+  deflateWindowBits_ = 15;
+  deflateMemLevel_ = 4;
+  deflateCompLevel_ = 3;
+  tickPeriod_ = std::chrono::milliseconds(50);
+  dispatchQuantum_ = std::chrono::microseconds(1000);
+  dispatchQuantumMessages_ = 0;
+  inlineOpcodes_ = "08";
+  heavyOpcodes_ = "1";
+  heavyThreads_ = 1;
+  maxHeavyQueueSize_ = 64;
+  csvProgressBytes_ = 1024 * 1024;
+  wssPort_ = static_cast<unsigned short>(8443);
+  tlsCertFile_.clear();
+  tlsKeyFile_.clear();
+  tlsHandshakeThreads_ = 1;
+  tlsMaxConcurrentHandshakes_ = 64;
+  tlsSessionCacheSize_ = 20480;
+  tlsSessionTickets_ = true;
+  logAsync_ = true;
+  logRingCapacity_ = 1024;
+  metricsEnabled_ = false;
+  metricsPort_ = static_cast<unsigned short>(9464);
+  traceSampleEvery_ = 100;
+  traceFile_.clear();
+  drainTimeout_ = std::chrono::seconds(30);
+  handoffSocket_.clear();
+}
+
+bool ServerConfig::loadFromArgs(int argc, const char* const argv[]) {
+  std::string address = address_.to_string();
+  std::chrono::seconds::rep pingInterval = pingInterval_.count();
+  std::chrono::seconds::rep pongTimeout = pongTimeout_.count();
+  std::chrono::seconds::rep idleTimeout = idleTimeout_.count();
+  std::chrono::milliseconds::rep tickPeriod = tickPeriod_.count();
+  std::chrono::microseconds::rep dispatchQuantum = dispatchQuantum_.count();
+  std::size_t csvProgressKb = csvProgressBytes_ / 1024;
+  std::chrono::seconds::rep drainTimeout = drainTimeout_.count();
+  std::chrono::milliseconds::rep rateLimitBurst = rateLimitBurst_.count();
+  std::vector<std::string> rateLimits;
+
+  // clang-format off
+  po::options_description desc("Server options");
+  desc.add_options()
+    ("help,h", "print this help message")
+    ("config,c", po::value<std::string>()->default_value(
+        (workdir_ / "assets" / "server.conf").string()),
+        "path to config file, command line options take precedence")
+    ("address", po::value<std::string>(&address)->default_value(address),
+        "address to listen on")
+    ("port", po::value<unsigned short>(&wsPort_)->default_value(wsPort_),
+        "WebSockets port, 0 for random port")
+    ("threads", po::value<int32_t>(&threads_)->default_value(threads_),
+        "number of I/O threads")
+    ("coro-sessions", po::value<bool>(&wsCoroSessions_)->default_value(wsCoroSessions_),
+        "use stackless coroutine sessions")
+    ("ping-interval", po::value(&pingInterval)->default_value(pingInterval),
+        "seconds without remote activity before a ping is sent")
+    ("pong-timeout", po::value(&pongTimeout)->default_value(pongTimeout),
+        "seconds to wait for an answer to a ping before the session is closed")
+    ("idle-timeout", po::value(&idleTimeout)->default_value(idleTimeout),
+        "seconds without incoming messages before the session is closed, 0 to disable")
+    ("max-message-size", po::value<std::size_t>(&maxMessageSize_)->default_value(maxMessageSize_),
+        "max size in bytes of incoming and outgoing messages")
+    ("max-send-queue", po::value<std::size_t>(&maxSendQueueSize_)->default_value(maxSendQueueSize_),
+        "max messages waiting to be sent per session, 0 for unlimited")
+    ("max-receive-queue",
+        po::value<std::size_t>(&maxReceiveQueueSize_)->default_value(maxReceiveQueueSize_),
+        "max received messages waiting for processing per session, 0 for unlimited")
+    ("max-sessions", po::value<std::size_t>(&maxSessions_)->default_value(maxSessions_),
+        "max sessions, listeners stop accepting at it, 0 for unlimited")
+    ("max-sessions-per-ip",
+        po::value<std::size_t>(&maxSessionsPerAddress_)->default_value(maxSessionsPerAddress_),
+        "max sessions from one remote address, 0 for unlimited")
+    ("busy-queued-messages",
+        po::value<std::size_t>(&busyQueuedMessages_)->default_value(busyQueuedMessages_),
+        "received messages waiting in all sessions to answer new ones with BUSY, 0 - off")
+    ("busy-cpu-percent", po::value<unsigned>(&busyCpuPercent_)->default_value(busyCpuPercent_),
+        "CPU usage (percent of all CPUs) to answer new messages with BUSY, 0 - off")
+    ("rate-limit", po::value<std::vector<std::string>>(&rateLimits)->composing(),
+        "OPCODE:MESSAGES:BYTES per second and session, 0 for unlimited, * - other opcodes, "
+        "e.g. 1:5:10485760, may be repeated")
+    ("rate-limit-burst", po::value(&rateLimitBurst)->default_value(rateLimitBurst),
+        "milliseconds of the rate limits passed at once")
+    ("stream-opcodes", po::value<std::string>(&streamOpcodes_),
+        "opcodes of messages consumed while they arrive, e.g. 1 for CSV_ANALIZE")
+    ("deflate", po::value<bool>(&deflateEnabled_)->default_value(deflateEnabled_),
+        "negotiate permessage-deflate compression")
+    ("deflate-window-bits",
+        po::value<int>(&deflateWindowBits_)->default_value(deflateWindowBits_),
+        "deflate window of each session and direction is 2^N bytes, 9..15")
+    ("deflate-mem-level", po::value<int>(&deflateMemLevel_)->default_value(deflateMemLevel_),
+        "deflate memory level 1..9, state of each session is 2^(N + 9) bytes")
+    ("deflate-level", po::value<int>(&deflateCompLevel_)->default_value(deflateCompLevel_),
+        "deflate compression level 0..9")
+    ("tick-period", po::value(&tickPeriod)->default_value(tickPeriod),
+        "milliseconds between processing of received messages")
+    ("dispatch-quantum-us", po::value(&dispatchQuantum)->default_value(dispatchQuantum),
+        "microseconds of callbacks of one session per turn of the tick, 0 for unlimited")
+    ("dispatch-quantum-messages",
+        po::value<std::size_t>(&dispatchQuantumMessages_)
+            ->default_value(dispatchQuantumMessages_),
+        "callbacks of one session per turn of the tick, 0 for unlimited")
+    ("inline-opcodes", po::value<std::string>(&inlineOpcodes_)->default_value(inlineOpcodes_),
+        "opcodes answered on the I/O threads right after the read, e.g. 0 for PING, 8 for "
+        "CSV_CANCEL")
+    ("heavy-opcodes", po::value<std::string>(&heavyOpcodes_)->default_value(heavyOpcodes_),
+        "opcodes processed on --heavy-threads instead of the tick thread, e.g. 1 for CSV_ANALIZE")
+    ("heavy-threads", po::value<int32_t>(&heavyThreads_)->default_value(heavyThreads_),
+        "threads of heavy opcodes, 0 to process them on the tick thread")
+    ("max-heavy-queue",
+        po::value<std::size_t>(&maxHeavyQueueSize_)->default_value(maxHeavyQueueSize_),
+        "max heavy messages queued or processed, more are answered with BUSY, 0 for unlimited")
+    ("csv-progress-kb", po::value<std::size_t>(&csvProgressKb)->default_value(csvProgressKb),
+        "CSV_ANALIZE sends partial results (CSV_PROGRESS) after every N KB parsed, 0 - never")
+    ("wss-port", po::value<unsigned short>(&wssPort_)->default_value(wssPort_),
+        "secure WebSockets port, 0 for random port")
+    ("tls-cert", po::value<std::string>(&tlsCertFile_),
+        "PEM certificate chain file, enables TLS (relative to the binary directory)")
+    ("tls-key", po::value<std::string>(&tlsKeyFile_), "PEM private key file")
+    ("tls-handshake-threads",
+        po::value<int32_t>(&tlsHandshakeThreads_)->default_value(tlsHandshakeThreads_),
+        "threads for TLS handshakes, 0 to run them on the I/O threads")
+    ("tls-max-handshakes", po::value<std::size_t>(&tlsMaxConcurrentHandshakes_)
+        ->default_value(tlsMaxConcurrentHandshakes_),
+        "max TLS handshakes in progress, 0 for unlimited")
+    ("tls-session-cache",
+        po::value<std::size_t>(&tlsSessionCacheSize_)->default_value(tlsSessionCacheSize_),
+        "number of TLS sessions cached for resumption")
+    ("tls-session-tickets",
+        po::value<bool>(&tlsSessionTickets_)->default_value(tlsSessionTickets_),
+        "allow TLS session resumption by tickets")
+    ("log-async", po::value<bool>(&logAsync_)->default_value(logAsync_),
+        "write logs on background threads")
+    ("log-ring-size", po::value<std::size_t>(&logRingCapacity_)->default_value(logRingCapacity_),
+        "log records per thread waiting for background write, more records are dropped")
+    ("metrics", po::value<bool>(&metricsEnabled_)->default_value(metricsEnabled_),
+        "serve metrics in Prometheus format over HTTP at /metrics")
+    ("metrics-port", po::value<unsigned short>(&metricsPort_)->default_value(metricsPort_),
+        "HTTP port of metrics, 0 for random port")
+    ("trace-sample",
+        po::value<std::uint32_t>(&traceSampleEvery_)->default_value(traceSampleEvery_),
+        "trace every N-th message through the pipeline (stage latency per opcode), 0 - off")
+    ("trace-file", po::value<std::string>(&traceFile_),
+        "write Chrome trace JSON of the last traced messages to this file on exit")
+    ("drain-timeout", po::value(&drainTimeout)->default_value(drainTimeout),
+        "seconds to close sessions gracefully on SIGINT or SIGTERM")
+    ("handoff-socket", po::value<std::string>(&handoffSocket_),
+        "Unix socket to take listening sockets over from a running server, zero-downtime restart");
+  // clang-format on
+
+  try {
+    po::variables_map vm;
+
+    // NOTE: stored values are not overwritten, so command line is stored first
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+
+    if (vm.count("help")) {
+      std::cout << desc << '\n';
+      return false;
+    }
+
+    const fs::path configPath = vm["config"].as<std::string>();
+    if (fs::exists(configPath)) {
+      std::ifstream configFile(configPath);
+      po::store(po::parse_config_file(configFile, desc), vm);
+    } else if (!vm["config"].defaulted()) {
+      LOG(WARNING) << "ServerConfig: config file not found: " << configPath.string();
+      return false;
+    }
+
+    po::notify(vm);
+
+    address_ = net::ip::make_address(address);
+  } catch (const std::exception& e) {
+    // po::error or invalid address
+    LOG(WARNING) << "ServerConfig: invalid options: " << e.what();
+    return false;
+  }
+
+  // relative paths are relative to the binary directory, as assets
+  for (std::string* path : {&tlsCertFile_, &tlsKeyFile_, &traceFile_}) {
+    if (!path->empty() && fs::path(*path).is_relative()) {
+      *path = (workdir_ / *path).string();
+    }
+  }
+
+  pingInterval_ = std::chrono::seconds(pingInterval);
+  pongTimeout_ = std::chrono::seconds(pongTimeout);
+  idleTimeout_ = std::chrono::seconds(idleTimeout);
+  tickPeriod_ = std::chrono::milliseconds(tickPeriod);
+  dispatchQuantum_ = std::chrono::microseconds(dispatchQuantum);
+  csvProgressBytes_ = csvProgressKb * 1024;
+  drainTimeout_ = std::chrono::seconds(drainTimeout);
+  rateLimitBurst_ = std::chrono::milliseconds(rateLimitBurst);
+
+  // NOTE: options of the command line come first, the first limit of an opcode is kept
+  rateLimits_.clear();
+  for (const std::string& rateLimit : rateLimits) {
+    char opcode = 0;
+    RateLimit limit;
+    if (!parseRateLimit(rateLimit, opcode, limit)) {
+      LOG(WARNING) << "ServerConfig: invalid rate limit " << rateLimit
+                   << ", expected OPCODE:MESSAGES:BYTES";
+      return false;
+    }
+    rateLimits_.emplace(opcode, limit);
+  }
+
+  return validate();
+}
+
+bool ServerConfig::validate() const {
+  if (threads_ < 1) {
+    LOG(WARNING) << "ServerConfig: threads must be at least 1";
+    return false;
+  }
+  if (pingInterval_.count() <= 0 || pongTimeout_.count() <= 0) {
+    LOG(WARNING) << "ServerConfig: ping interval and pong timeout must be positive";
+    return false;
+  }
+  if (idleTimeout_.count() < 0) {
+    LOG(WARNING) << "ServerConfig: idle timeout must not be negative";
+    return false;
+  }
+  if (maxMessageSize_ == 0) {
+    LOG(WARNING) << "ServerConfig: max message size must be positive";
+    return false;
+  }
+  if (deflateWindowBits_ < 9 || deflateWindowBits_ > 15) {
+    LOG(WARNING) << "ServerConfig: deflate window bits must be in 9..15";
+    return false;
+  }
+  if (deflateMemLevel_ < 1 || deflateMemLevel_ > 9 || deflateCompLevel_ < 0 ||
+      deflateCompLevel_ > 9) {
+    LOG(WARNING) << "ServerConfig: deflate memory level must be in 1..9, level in 0..9";
+    return false;
+  }
+  if (busyCpuPercent_ > 100) {
+    LOG(WARNING) << "ServerConfig: busy CPU percent must be in 0..100";
+    return false;
+  }
+  if (rateLimitBurst_.count() <= 0) {
+    LOG(WARNING) << "ServerConfig: rate limit burst must be positive";
+    return false;
+  }
+  if (heavyThreads_ < 0) {
+    LOG(WARNING) << "ServerConfig: heavy threads must not be negative";
+    return false;
+  }
+  for (const char opcode : inlineOpcodes_) {
+    if (heavyOpcodes_.find(opcode) != std::string::npos) {
+      LOG(WARNING) << "ServerConfig: opcode " << opcode << " is both inline and heavy";
+      return false;
+    }
+  }
+  if (tickPeriod_.count() <= 0) {
+    LOG(WARNING) << "ServerConfig: tick period must be positive";
+    return false;
+  }
+  if (dispatchQuantum_.count() < 0) {
+    LOG(WARNING) << "ServerConfig: dispatch quantum must not be negative";
+    return false;
+  }
+  if (drainTimeout_.count() < 0) {
+    LOG(WARNING) << "ServerConfig: drain timeout must not be negative";
+    return false;
+  }
+  if (tlsHandshakeThreads_ < 0) {
+    LOG(WARNING) << "ServerConfig: TLS handshake threads must not be negative";
+    return false;
+  }
+  if (!tlsCertFile_.empty() && tlsKeyFile_.empty()) {
+    LOG(WARNING) << "ServerConfig: TLS private key file is not set";
+    return false;
+  }
+  if (logAsync_ && logRingCapacity_ == 0) {
+    LOG(WARNING) << "ServerConfig: log ring size must be positive";
+    return false;
+  }
+  return true;
 }
 
 } // namespace config
@@ -1,19 +1,44 @@
 #pragma once
 
 #include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <map>
+#include <string>
 
 namespace boostander {
 namespace config {
 
+// Limits of received messages of one opcode per session (token buckets), 0 for unlimited
+struct RateLimit {
+  double messagesPerSec = 0.0;
+
+  double bytesPerSec = 0.0;
+};
+
+// Key of rateLimits_ for opcodes without own limits
+constexpr char ANY_OPCODE = '*';
+
 struct ServerConfig {
   ServerConfig(const std::filesystem::path& workdir);
 
   void print() const;
 
+  // Sets default values
   void loadConf();
 
+  /**
+   * Loads options from command line and from config file (--config,
+   * assets/server.conf by default). Command line options take precedence.
+   * Returns false if the server must not start: help was printed or options are invalid.
+   **/
+  bool loadFromArgs(int argc, const char* const argv[]);
+
+  // Returns false and logs the reason if some option is out of range
+  bool validate() const;
+
   const std::filesystem::path workdir_;
 
   // TODO private:
@@ -24,6 +49,139 @@ struct ServerConfig {
   unsigned short wsPort_;
 
   int32_t threads_;
+
+  // accept connections into WsCoroSession (stackless coroutines) instead of WsSession
+  bool wsCoroSessions_;
+
+  // send a websocket ping after this time without remote activity
+  std::chrono::seconds pingInterval_;
+
+  // dead peer detection: close the session if a ping is not answered within this time
+  std::chrono::seconds pongTimeout_;
+
+  // close the session after this time without incoming messages (control frames are not
+  // counted), 0 disables idle timeout
+  std::chrono::seconds idleTimeout_;
+
+  // max size in bytes of incoming and outgoing websocket messages
+  std::size_t maxMessageSize_;
+
+  // max number of messages waiting to be sent per session, 0 for unlimited
+  std::size_t maxSendQueueSize_;
+
+  // max number of received messages waiting for processing per session, 0 for unlimited
+  std::size_t maxReceiveQueueSize_;
+
+  // max sessions of all listeners, the listeners stop accepting at it, 0 for unlimited
+  std::size_t maxSessions_;
+
+  // max sessions from one remote address, more connections are closed, 0 for unlimited
+  std::size_t maxSessionsPerAddress_;
+
+  // overload thresholds: received messages waiting for processing in all sessions and CPU usage
+  // of the server (percent of its CPUs), over them new messages are answered with BUSY and
+  // listeners stop accepting, 0 - off
+  std::size_t busyQueuedMessages_;
+
+  unsigned busyCpuPercent_;
+
+  // per opcode or ANY_OPCODE, messages over them are answered with THROTTLED, empty - no limits
+  std::map<char, RateLimit> rateLimits_;
+
+  // bursts of up to this time of the rate limits pass at once
+  std::chrono::milliseconds rateLimitBurst_;
+
+  // messages of these opcodes are consumed fragment by fragment while they arrive,
+  // e.g. "1" for CSV_ANALIZE, empty - every message is read as a whole first
+  std::string streamOpcodes_;
+
+  // negotiate permessage-deflate, compression state costs memory in every session
+  bool deflateEnabled_;
+
+  // LZ77 window of deflate and inflate, 2^bits bytes per session and direction, 9..15
+  int deflateWindowBits_;
+
+  // memory of the deflate state, 1..9, 2^(level + 9) bytes per session
+  int deflateMemLevel_;
+
+  // 0..9, 0 - no compression
+  int deflateCompLevel_;
+
+  // period of incoming messages processing
+  std::chrono::milliseconds tickPeriod_;
+
+  /**
+   * Sessions take turns on the tick thread (deficit round-robin): a turn runs callbacks of one
+   * session for up to dispatchQuantum_ of callback time and up to dispatchQuantumMessages_
+   * callbacks, so a session with a long queue does not delay others. 0 - no limit, both 0 - the
+   * queue of a session is drained in one turn.
+   **/
+  std::chrono::microseconds dispatchQuantum_;
+
+  std::size_t dispatchQuantumMessages_;
+
+  // callbacks of these opcodes run on the I/O thread as soon as the message is read, they must
+  // be cheap, e.g. "0" for PING. CSV_CANCEL ("8") stops a running analysis only from here.
+  std::string inlineOpcodes_;
+
+  // callbacks of these opcodes run on heavyThreads_ instead of the tick thread, in order per
+  // session, e.g. "1" for CSV_ANALIZE. Opcodes sharing session state (CSV_CHUNK and
+  // CSV_CHUNK_END) must stay in one lane.
+  std::string heavyOpcodes_;
+
+  // 0 - heavy opcodes run on the tick thread
+  int32_t heavyThreads_;
+
+  // max heavy messages queued or running, more are answered with BUSY, 0 for unlimited
+  std::size_t maxHeavyQueueSize_;
+
+  // CSV_ANALIZE sends CSV_PROGRESS after every csvProgressBytes_ of parsed data, 0 - never
+  std::size_t csvProgressBytes_;
+
+  // port for secure WebSockets (wss://) connections, used if tlsCertFile_ is set
+  unsigned short wssPort_;
+
+  // PEM certificate chain and private key, TLS is disabled if tlsCertFile_ is empty
+  std::string tlsCertFile_;
+
+  std::string tlsKeyFile_;
+
+  // threads for TLS handshakes, 0 to run handshakes on the I/O threads
+  int32_t tlsHandshakeThreads_;
+
+  // max TLS handshakes in progress, other connections wait in the listen backlog
+  std::size_t tlsMaxConcurrentHandshakes_;
+
+  // number of TLS sessions cached for resumption by session id
+  std::size_t tlsSessionCacheSize_;
+
+  // allow resumption by session tickets
+  bool tlsSessionTickets_;
+
+  // write logs on background threads, logging threads never block on syslog or console
+  bool logAsync_;
+
+  // records per logging thread waiting for asynchronous sinks, more records are dropped
+  std::size_t logRingCapacity_;
+
+  // serve metrics in Prometheus format at http://address_:metricsPort_/metrics
+  bool metricsEnabled_;
+
+  // 0 is for random port
+  unsigned short metricsPort_;
+
+  // every traceSampleEvery_-th message of each I/O thread is traced through the pipeline, 0 - off
+  std::uint32_t traceSampleEvery_;
+
+  // Chrome trace JSON of the last traced messages is written here on exit, empty - not written
+  std::string traceFile_;
+
+  // on SIGINT or SIGTERM sessions are closed gracefully within this time, then closed at once
+  std::chrono::seconds drainTimeout_;
+
+  // Unix socket to take listening sockets over from a running server and to hand them off to
+  // the next one (zero-downtime restart), empty - disabled
+  std::string handoffSocket_;
 };
 
 } // namespace config
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <boost/log/core/record_view.hpp>
+#include <boost/log/keywords/capacity.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace boostander {
+namespace log {
+
+/**
+ * Bounded lock-free queue for one producer thread and one consumer thread.
+ * Capacity is rounded up to a power of two.
+ **/
+template <typename T> class SpscRing {
+public:
+  explicit SpscRing(std::size_t capacity) : slots_(roundUpToPowerOfTwo(capacity)) {}
+
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  // Producer only. Returns false if the ring is full.
+  bool tryPush(const T& value) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+      return false;
+    }
+    slots_[tail & (slots_.size() - 1)] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. Returns false if the ring is empty.
+  bool tryPop(T& value) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    // NOTE: move leaves the slot empty, popped values are not kept alive by the ring
+    value = std::move(slots_[head & (slots_.size() - 1)]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::size_t capacity() const { return slots_.size(); }
+
+private:
+  static std::size_t roundUpToPowerOfTwo(std::size_t n) {
+    std::size_t result = 1;
+    while (result < n) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  std::vector<T> slots_;
+
+  // NOTE: separate cache lines, producer and consumer do not invalidate each other
+  alignas(64) std::atomic<std::size_t> head_{0};
+
+  alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+/**
+ * Multi producer, single consumer queue made of one SpscRing per producer thread,
+ * so producers never contend with each other. A producer takes a lock only once,
+ * to register its ring. Values that do not fit into the ring of the calling thread
+ * are dropped and counted.
+ * Order is preserved per producer thread, consumer takes values from the rings round-robin.
+ * @note rings of finished threads are kept until the queue is destroyed. A thread forgets
+ * rings of destroyed queues (e.g. sinks recreated by Logger::configure) when it registers
+ * its next ring.
+ **/
+template <typename T> class PerThreadRings {
+public:
+  explicit PerThreadRings(std::size_t ringCapacity)
+      : ringCapacity_(ringCapacity), id_(nextId()) {}
+
+  PerThreadRings(const PerThreadRings&) = delete;
+  PerThreadRings& operator=(const PerThreadRings&) = delete;
+
+  // Any thread. Returns false and counts the value as dropped if the ring is full.
+  bool push(const T& value) {
+    if (tryPush(value)) {
+      return true;
+    }
+    droppedCount_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // Any thread. Returns false if the ring is full, the value is not counted as dropped.
+  bool tryPush(const T& value) { return threadRing().tryPush(value); }
+
+  // One consumer thread at a time
+  bool tryPop(T& value) {
+    std::scoped_lock<std::mutex> lock(ringsMutex_);
+    for (std::size_t i = 0; i < rings_.size(); i++) {
+      SpscRing<T>& ring = *rings_[nextRing_];
+      nextRing_ = (nextRing_ + 1) % rings_.size();
+      if (ring.tryPop(value)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::size_t droppedCount() const { return droppedCount_.load(std::memory_order_relaxed); }
+
+  std::size_t ringCapacity() const { return ringCapacity_; }
+
+  // Rings the calling thread knows, of all queues of T
+  static std::size_t threadRingsCount() { return threadRings().size(); }
+
+private:
+  // Ring of the calling thread in the queue with queueId
+  struct ThreadRing {
+    std::uint64_t queueId;
+
+    SpscRing<T>* ring;
+
+    // expires with the queue
+    std::weak_ptr<SpscRing<T>> owner;
+  };
+
+  static std::vector<ThreadRing>& threadRings() {
+    thread_local std::vector<ThreadRing> rings;
+    return rings;
+  }
+
+  static std::uint64_t nextId() {
+    static std::atomic<std::uint64_t> lastId{0};
+    return ++lastId;
+  }
+
+  SpscRing<T>& threadRing() {
+    // NOTE: rings are found by queue id, so a new queue at the address of a destroyed one
+    // never gets a dangling ring
+    std::vector<ThreadRing>& known = threadRings();
+    for (const ThreadRing& threadRing : known) {
+      if (threadRing.queueId == id_) {
+        return *threadRing.ring;
+      }
+    }
+
+    known.erase(std::remove_if(known.begin(), known.end(),
+                               [](const ThreadRing& threadRing) {
+                                 return threadRing.owner.expired();
+                               }),
+                known.end());
+
+    std::scoped_lock<std::mutex> lock(ringsMutex_);
+    rings_.push_back(std::make_shared<SpscRing<T>>(ringCapacity_));
+    known.push_back(ThreadRing{id_, rings_.back().get(), rings_.back()});
+    return *rings_.back();
+  }
+
+  const std::size_t ringCapacity_;
+
+  const std::uint64_t id_;
+
+  std::mutex ringsMutex_;
+
+  std::vector<std::shared_ptr<SpscRing<T>>> rings_;
+
+  // next ring to pop from, requires ringsMutex_
+  std::size_t nextRing_ = 0;
+
+  std::atomic<std::size_t> droppedCount_{0};
+};
+
+/**
+ * Queueing strategy for boost::log::sinks::asynchronous_sink.
+ * Logging threads only copy the record view into the ring of their thread,
+ * attribute formatting and the backend write (syscall) happen on the feeding thread.
+ * Records are dropped and counted when the ring of the logging thread is full,
+ * logging threads never block on the sink.
+ * Ring capacity per thread is set by keywords::capacity.
+ * @see boost/log/sinks/unbounded_fifo_queue.hpp for the interface
+ **/
+class DroppingRingQueue {
+public:
+  static constexpr std::size_t defaultRingCapacity = 1024;
+
+  // The feeding thread checks rings at least that often if it missed a notification
+  static constexpr std::chrono::milliseconds pollPeriod{10};
+
+  std::size_t droppedCount() const { return rings_.droppedCount(); }
+
+protected:
+  DroppingRingQueue() : rings_(defaultRingCapacity) {}
+
+  template <typename ArgsT>
+  explicit DroppingRingQueue(const ArgsT& args)
+      : rings_(args[boost::log::keywords::capacity | defaultRingCapacity]) {}
+
+  // NOTE: logging core calls try_enqueue first and enqueue if it failed, so only enqueue drops
+  void enqueue(const boost::log::record_view& rec) {
+    if (rings_.push(rec)) {
+      notifyConsumer();
+    }
+  }
+
+  bool try_enqueue(const boost::log::record_view& rec) {
+    if (!rings_.tryPush(rec)) {
+      return false;
+    }
+    notifyConsumer();
+    return true;
+  }
+
+  bool try_dequeue_ready(boost::log::record_view& rec) { return rings_.tryPop(rec); }
+
+  bool try_dequeue(boost::log::record_view& rec) { return rings_.tryPop(rec); }
+
+  // Blocks until a record is available or interrupt_dequeue() is called
+  bool dequeue_ready(boost::log::record_view& rec) {
+    std::unique_lock<std::mutex> lock(waitMutex_);
+    while (!isInterrupted_) {
+      if (rings_.tryPop(rec)) {
+        return true;
+      }
+      isConsumerWaiting_.store(true, std::memory_order_relaxed);
+      wakeUp_.wait_for(lock, pollPeriod);
+      isConsumerWaiting_.store(false, std::memory_order_relaxed);
+    }
+    isInterrupted_ = false;
+    return false;
+  }
+
+  void interrupt_dequeue() {
+    {
+      std::scoped_lock<std::mutex> lock(waitMutex_);
+      isInterrupted_ = true;
+    }
+    wakeUp_.notify_one();
+  }
+
+private:
+  void notifyConsumer() {
+    // NOTE: notify only a sleeping consumer, a busy one picks the record up anyway.
+    // The notification may be missed without the lock, then the record waits up to pollPeriod.
+    if (isConsumerWaiting_.load(std::memory_order_relaxed)) {
+      wakeUp_.notify_one();
+    }
+  }
+
+  PerThreadRings<boost::log::record_view> rings_;
+
+  std::mutex waitMutex_;
+
+  std::condition_variable wakeUp_;
+
+  std::atomic<bool> isConsumerWaiting_{false};
+
+  // requires waitMutex_
+  bool isInterrupted_ = false;
+};
+
+} // namespace log
+} // namespace boostander
@@ -58,13 +58,13 @@ namespace keywords = boost::log::keywords;
 namespace boostander {
 namespace log {
 
-Logger::Logger() {
-  boost::shared_ptr<logging::core> core = logging::core::get();
+namespace {
 
-  /*The syslog API (and protocol) doesn't allow applications to specify the way how logs are
-   * processed by the log server. For that you have to configure your syslog server. See the
-   * documentation for your server (e.g. rsyslog, syslog-ng or journald for logging through the
-   * syslog API).*/
+/*The syslog API (and protocol) doesn't allow applications to specify the way how logs are
+ * processed by the log server. For that you have to configure your syslog server. See the
+ * documentation for your server (e.g. rsyslog, syslog-ng or journald for logging through the
+ * syslog API).*/
+boost::shared_ptr<sinks::syslog_backend> makeSyslogBackend() {
   boost::shared_ptr<sinks::syslog_backend> backend(new sinks::syslog_backend(
       keywords::facility = sinks::syslog::local7, /*< the logging facility >*/
       keywords::use_impl = sinks::syslog::native  /*< the native syslog API should be used >*/
@@ -72,67 +72,133 @@ Logger::Logger() {
 
   // Set the straightforward level translator for the "Severity" attribute of type int
   backend->set_severity_mapper(sinks::syslog::direct_severity_mapping<int>("Severity"));
+  return backend;
+}
 
-  logfile = boost::make_shared<sink_t>(backend);
-
-  // Wrap it into the frontend and register in the core.
-  // The backend requires synchronization in the frontend.
-  core->add_sink(logfile);
-
-  logfile->set_formatter(expr::stream
-
-                         << "["
-                         // line id will be 5-digits, zero-filled
-                         << std::setw(5) << std::setfill('0') << expr::attr<unsigned int>("LineID")
-                         << "|"
-                         << expr::format_date_time<boost::posix_time::ptime>("TimeStamp",
-                                                                             "%Y-%m-%d %H:%M:%S")
-                         << "|" << std::setw(7) << std::setfill(' ') << logging::trivial::severity
-                         << "] : " << expr::smessage);
-
-  // Register the logfile in the logging core
-  core->add_sink(logfile);
+// Same formatting for synchronous and asynchronous frontends
+template <typename SinkT> void setupLogfile(SinkT& logfile) {
+  logfile.set_formatter(expr::stream
+
+                        << "["
+                        // line id will be 5-digits, zero-filled
+                        << std::setw(5) << std::setfill('0') << expr::attr<unsigned int>("LineID")
+                        << "|"
+                        << expr::format_date_time<boost::posix_time::ptime>("TimeStamp",
+                                                                            "%Y-%m-%d %H:%M:%S")
+                        << "|" << std::setw(7) << std::setfill(' ') << logging::trivial::severity
+                        << "] : " << expr::smessage);
+}
 
-  outputstream = boost::make_shared<ostream_sink>();
+template <typename SinkT> void setupOutputstream(SinkT& outputstream) {
   boost::shared_ptr<std::ostream> clog{&std::clog, boost::null_deleter{}};
 
-  outputstream->locked_backend()->add_stream(clog);
+  outputstream.locked_backend()->add_stream(clog);
 
-  outputstream->set_filter(logging::trivial::severity >= logging::trivial::info
+  outputstream.set_filter(logging::trivial::severity >= logging::trivial::info
 
   );
 
   //		ostream->set_formatter(&logger::custom_formatter);
-  outputstream->set_formatter(expr::stream
+  outputstream.set_formatter(expr::stream
 
-                              << "[" << std::setw(7) << std::setfill(' ')
-                              << logging::trivial::severity << "] : " << expr::smessage);
+                             << "[" << std::setw(7) << std::setfill(' ')
+                             << logging::trivial::severity << "] : " << expr::smessage);
+}
 
-  // Register the ostream in the logging core
-  core->add_sink(outputstream);
+} // namespace
+
+Logger::Logger() {
+  addSinks(true, DroppingRingQueue::defaultRingCapacity);
 
   // Add TimeStamp, LineID to log records
   logging::add_common_attributes();
 }
 
 Logger::~Logger() {
-  boost::shared_ptr<logging::core> core = logging::core::get();
+  removeSinks();
+
+  if (droppedBeforeConfigure) {
+    std::clog << "Logger: dropped " << droppedBeforeConfigure << " records" << std::endl;
+  }
+}
+
+void Logger::configure(bool async, std::size_t ringCapacity) {
+  if (async == isAsync() && (!async || ringCapacity == asyncRingCapacity)) {
+    return;
+  }
+  removeSinks();
+  addSinks(async, ringCapacity);
+}
 
-  // Remove the sink from the core, so that no records are passed to it
-  core->remove_sink(outputstream);
-  core->remove_sink(logfile);
+bool Logger::isAsync() const { return outputstream != nullptr; }
+
+std::size_t Logger::droppedCount() const {
+  std::size_t dropped = droppedBeforeConfigure;
+  if (outputstream) {
+    dropped += outputstream->droppedCount();
+  }
+  if (logfile) {
+    dropped += logfile->droppedCount();
+  }
+  return dropped;
+}
 
-  // Break the feeding loop
-  outputstream->stop();
-  // logfile->stop();
+void Logger::addSinks(bool async, std::size_t ringCapacity) {
+  boost::shared_ptr<logging::core> core = logging::core::get();
 
-  // Flush all log records that may have left buffered
-  outputstream->flush();
-  logfile->flush();
+  // Wrap backends into the frontends and register them in the logging core
+  if (async) {
+    asyncRingCapacity = ringCapacity;
+    logfile = boost::make_shared<async_sink_t>(makeSyslogBackend(),
+                                               keywords::capacity = ringCapacity);
+    setupLogfile(*logfile);
+    core->add_sink(logfile);
+
+    outputstream = boost::make_shared<ostream_sink>(keywords::capacity = ringCapacity);
+    setupOutputstream(*outputstream);
+    core->add_sink(outputstream);
+  } else {
+    // The backend requires synchronization in the frontend.
+    syncLogfile = boost::make_shared<sink_t>(makeSyslogBackend());
+    setupLogfile(*syncLogfile);
+    core->add_sink(syncLogfile);
+
+    syncOutputstream = boost::make_shared<sync_ostream_sink>();
+    setupOutputstream(*syncOutputstream);
+    core->add_sink(syncOutputstream);
+  }
+}
+
+void Logger::removeSinks() {
+  boost::shared_ptr<logging::core> core = logging::core::get();
 
-  // Delete shared_ptr
-  outputstream.reset();
-  logfile.reset();
+  droppedBeforeConfigure = droppedCount();
+
+  if (outputstream) {
+    // Remove the sink from the core, so that no records are passed to it
+    core->remove_sink(outputstream);
+    // Break the feeding loop
+    outputstream->stop();
+    // Flush all log records that may have left buffered
+    outputstream->flush();
+    outputstream.reset();
+  }
+  if (logfile) {
+    core->remove_sink(logfile);
+    logfile->stop();
+    logfile->flush();
+    logfile.reset();
+  }
+  if (syncOutputstream) {
+    core->remove_sink(syncOutputstream);
+    syncOutputstream->flush();
+    syncOutputstream.reset();
+  }
+  if (syncLogfile) {
+    core->remove_sink(syncLogfile);
+    syncLogfile->flush();
+    syncLogfile.reset();
+  }
 }
 
 Logger& Logger::instance() {
@@ -1,11 +1,18 @@
 #pragma once
 
+#include "log/LogQueue.hpp"
+#include <atomic>
 #include <boost/log/sinks/async_frontend.hpp>
 #include <boost/log/sinks/sync_frontend.hpp>
 #include <boost/log/sinks/text_ostream_backend.hpp>
 #include <boost/log/sources/severity_logger.hpp>
 #include <boost/log/trivial.hpp>
+#include <boost/log/utility/formatting_ostream.hpp>
 #include <boost/shared_ptr.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
 #include <string>
 
 namespace boost {
@@ -18,19 +25,123 @@ class syslog_backend;
 } // namespace log
 } // namespace boost
 
-#define LOG(lvl) BOOST_LOG_TRIVIAL(lvl)
+/**
+ * Log statements below this severity compile to nothing, their arguments are not evaluated.
+ * One of trace, debug, info, warning, error, fatal, set by CMake option LOG_MIN_SEVERITY.
+ **/
+#ifndef BOOSTANDER_LOG_MIN_SEVERITY
+#define BOOSTANDER_LOG_MIN_SEVERITY info
+#endif
+
+// NOTE: for is a single statement without else, so `if (x) LOG(INFO) << y; else ...` works
+#define BOOSTANDER_LOG_IF(lvl, condition)                                                          \
+  for (bool boostanderLogOn = (condition); boostanderLogOn; boostanderLogOn = false)             \
+  BOOST_LOG_TRIVIAL(lvl)
+
+// Unique object per call site
+#define BOOSTANDER_LOG_SITE(type)                                                                  \
+  ([]() -> type& {                                                                                 \
+    static type site;                                                                              \
+    return site;                                                                                   \
+  }())
+
+#define LOG(lvl)                                                                                   \
+  BOOSTANDER_LOG_IF(lvl, ::boostander::log::isCompiledIn(::boost::log::trivial::lvl))
+
+// Logs the first of every n calls of this statement
+#define LOG_EVERY_N(lvl, n)                                                                        \
+  BOOSTANDER_LOG_IF(lvl, ::boostander::log::isCompiledIn(::boost::log::trivial::lvl) &&           \
+                             BOOSTANDER_LOG_SITE(::boostander::log::LogEveryN).shouldLog(n))
+
+/**
+ * Logs this statement at most once per interval (std::chrono duration),
+ * the message is prefixed with the number of suppressed calls.
+ * Use it for warnings of the I/O and message paths, error storms must not take over the CPU.
+ **/
+#define LOG_RATE_LIMITED(lvl, interval)                                                            \
+  for (std::uint64_t boostanderLogSuppressed = 0,                                                  \
+                     boostanderLogOn =                                                             \
+                         ::boostander::log::isCompiledIn(::boost::log::trivial::lvl) &&            \
+                         BOOSTANDER_LOG_SITE(::boostander::log::LogRateLimiter)                    \
+                             .shouldLog(interval, boostanderLogSuppressed);                        \
+       boostanderLogOn; boostanderLogOn = 0)                                                       \
+  BOOST_LOG_TRIVIAL(lvl) << ::boostander::log::SuppressedCount{boostanderLogSuppressed}
+
 #define WARNING warning
 #define INFO info
 
 namespace boostander {
 namespace log {
 
+constexpr bool isCompiledIn(boost::log::trivial::severity_level level) {
+  return level >= boost::log::trivial::BOOSTANDER_LOG_MIN_SEVERITY;
+}
+
+// Call site state of LOG_EVERY_N
+class LogEveryN {
+public:
+  bool shouldLog(std::uint64_t n) {
+    return n <= 1 || counter_.fetch_add(1, std::memory_order_relaxed) % n == 0;
+  }
+
+private:
+  std::atomic<std::uint64_t> counter_{0};
+};
+
+// Call site state of LOG_RATE_LIMITED
+class LogRateLimiter {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  // suppressed is set to the number of calls suppressed since the last logged one
+  bool shouldLog(Clock::duration interval, std::uint64_t& suppressed) {
+    const Clock::rep now = Clock::now().time_since_epoch().count();
+    Clock::rep nextAllowed = nextAllowed_.load(std::memory_order_relaxed);
+    if (now < nextAllowed ||
+        !nextAllowed_.compare_exchange_strong(nextAllowed, now + interval.count(),
+                                              std::memory_order_relaxed)) {
+      suppressed_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+    return true;
+  }
+
+private:
+  std::atomic<Clock::rep> nextAllowed_{0};
+
+  std::atomic<std::uint64_t> suppressed_{0};
+};
+
+// Prints "[N suppressed] " if N > 0
+struct SuppressedCount {
+  std::uint64_t count;
+};
+
+template <typename CharT, typename TraitsT, typename AllocatorT>
+boost::log::basic_formatting_ostream<CharT, TraitsT, AllocatorT>&
+operator<<(boost::log::basic_formatting_ostream<CharT, TraitsT, AllocatorT>& stream,
+           const SuppressedCount& suppressed) {
+  if (suppressed.count) {
+    stream << "[" << suppressed.count << " suppressed] ";
+  }
+  return stream;
+}
+
 // typedef boost::log::sinks::asynchronous_sink<boost::log::sinks::text_ostream_backend> text_sink;
 
-typedef boost::log::sinks::asynchronous_sink<boost::log::sinks::text_ostream_backend> ostream_sink;
+typedef boost::log::sinks::asynchronous_sink<boost::log::sinks::text_ostream_backend,
+                                             DroppingRingQueue>
+    ostream_sink;
+
+typedef boost::log::sinks::synchronous_sink<boost::log::sinks::text_ostream_backend>
+    sync_ostream_sink;
 
 typedef boost::log::sinks::synchronous_sink<boost::log::sinks::syslog_backend> sink_t;
 
+typedef boost::log::sinks::asynchronous_sink<boost::log::sinks::syslog_backend, DroppingRingQueue>
+    async_sink_t;
+
 class Logger {
 public:
   Logger();
@@ -39,13 +150,41 @@ public:
 
   static Logger& instance();
 
+  /**
+   * Recreates sinks. Asynchronous sinks format and write records on background threads,
+   * records that do not fit into the ring of the logging thread (ringCapacity) are dropped.
+   * Synchronous sinks format and write on the logging thread.
+   **/
+  void configure(bool async, std::size_t ringCapacity);
+
+  bool isAsync() const;
+
+  // Records dropped by asynchronous sinks since start
+  std::size_t droppedCount() const;
+
 private:
   void log(std::string text, boost::log::trivial::severity_level sevLevel);
 
+  void addSinks(bool async, std::size_t ringCapacity);
+
+  // Flushes and removes all sinks from the logging core
+  void removeSinks();
+
   boost::log::sources::severity_logger<boost::log::trivial::severity_level> severityLogger;
 
+  // asynchronous sinks
   boost::shared_ptr<ostream_sink> outputstream;
-  boost::shared_ptr<sink_t> logfile;
+  boost::shared_ptr<async_sink_t> logfile;
+
+  // synchronous sinks
+  boost::shared_ptr<sync_ostream_sink> syncOutputstream;
+  boost::shared_ptr<sink_t> syncLogfile;
+
+  // ring capacity of asynchronous sinks
+  std::size_t asyncRingCapacity = 0;
+
+  // dropped by removed sinks
+  std::size_t droppedBeforeConfigure = 0;
 };
 
 } // namespace log
@@ -32,7 +32,7 @@ static void printNumOfCores() {
   }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
   using namespace boostander::algo;
 
   boostander::log::Logger::instance(); // inits Logger
@@ -43,26 +43,35 @@ int main() {
 
   const fs::path workdir = boostander::storage::getThisBinaryDirectoryPath();
 
-  const boostander::config::ServerConfig serverConfig(workdir);
+  boostander::config::ServerConfig serverConfig(workdir);
+  if (!serverConfig.loadFromArgs(argc, argv)) {
+    return EXIT_FAILURE;
+  }
+  boostander::log::Logger::instance().configure(serverConfig.logAsync_,
+                                                serverConfig.logRingCapacity_);
+  serverConfig.print();
 
   auto nm = std::make_shared<boostander::net::NetworkManager>();
 
-  nm->run(serverConfig);
-
   // process recieved messages with some period
-  TickManager<std::chrono::milliseconds> tm(50ms);
+  TickManager<std::chrono::milliseconds> tm(serverConfig.tickPeriod_);
 
   tm.addTickHandler(TickHandler("handleAllPlayerMessages", [&nm]() {
     // Handle queued incoming messages
     nm->handleIncomingMessages();
   }));
 
+  // SIGINT, SIGTERM or the handoff of listening sockets to a new process
+  nm->run(serverConfig, [&tm]() { tm.stop(); });
+
   while (tm.needServerRun()) {
     tm.tick();
   }
 
-  // (If we get here, it means we got a SIGINT or SIGTERM)
-  LOG(WARNING) << "If we get here, it means we got a SIGINT or SIGTERM";
+  LOG(WARNING) << "Stopping server..";
+
+  // Queued messages are answered and sessions are closed with close frames
+  nm->drain(serverConfig.drainTimeout_);
 
   nm->finish();
 
@@ -0,0 +1,254 @@
+#include "metrics/MemoryAccounting.hpp" // IWYU pragma: associated
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <unistd.h>
+
+namespace boostander {
+namespace metrics {
+
+namespace {
+
+constexpr std::size_t TAGS_COUNT = static_cast<std::size_t>(MemoryTag::COUNT);
+
+// NOTE: trivial types only, used by operator new before and after static constructors run
+thread_local MemoryTag gThreadTag = MemoryTag::OTHER;
+
+std::array<std::atomic<std::int64_t>, TAGS_COUNT> gBytes{};
+
+std::array<std::atomic<std::int64_t>, TAGS_COUNT> gAllocations{};
+
+std::atomic<std::uint64_t> gTotalAllocations{0};
+
+} // namespace
+
+const char* memoryTagName(MemoryTag tag) {
+  switch (tag) {
+  case MemoryTag::OTHER:
+    return "other";
+  case MemoryTag::NETWORK:
+    return "network";
+  case MemoryTag::SESSION:
+    return "session";
+  case MemoryTag::SEND_QUEUE:
+    return "send_queue";
+  case MemoryTag::RECEIVE_QUEUE:
+    return "receive_queue";
+  case MemoryTag::COUNT:
+    break;
+  }
+  return "unknown";
+}
+
+bool isMemoryAccountingEnabled() {
+#ifdef BOOSTANDER_MEMORY_ACCOUNTING
+  return true;
+#else
+  return false;
+#endif
+}
+
+MemoryUsage getMemoryUsage(MemoryTag tag) {
+  const auto index = static_cast<std::size_t>(tag);
+  MemoryUsage usage;
+  if (index < TAGS_COUNT) {
+    usage.bytes = gBytes[index].load(std::memory_order_relaxed);
+    usage.allocations = gAllocations[index].load(std::memory_order_relaxed);
+  }
+  return usage;
+}
+
+std::uint64_t getTotalAllocationsCount() {
+  return gTotalAllocations.load(std::memory_order_relaxed);
+}
+
+std::size_t getResidentMemoryBytes() {
+  // statm: total and resident sizes in pages
+  std::ifstream statm("/proc/self/statm");
+  std::size_t totalPages = 0;
+  std::size_t residentPages = 0;
+  if (!(statm >> totalPages >> residentPages)) {
+    return 0;
+  }
+  return residentPages * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+MemoryTag getThreadMemoryTag() { return gThreadTag; }
+
+void setThreadMemoryTag(MemoryTag tag) { gThreadTag = tag; }
+
+void renderMemoryMetrics(std::ostream& out) {
+  out << "# HELP process_resident_memory_bytes Resident memory size in bytes.\n"
+      << "# TYPE process_resident_memory_bytes gauge\n"
+      << "process_resident_memory_bytes " << getResidentMemoryBytes() << '\n';
+  if (!isMemoryAccountingEnabled()) {
+    return;
+  }
+
+  out << "# HELP heap_bytes Heap bytes in use by subsystem\n# TYPE heap_bytes gauge\n";
+  for (std::size_t i = 0; i < TAGS_COUNT; i++) {
+    const auto tag = static_cast<MemoryTag>(i);
+    out << "heap_bytes{subsystem=\"" << memoryTagName(tag) << "\"} " << getMemoryUsage(tag).bytes
+        << '\n';
+  }
+  out << "# HELP heap_allocations Live heap allocations by subsystem\n"
+      << "# TYPE heap_allocations gauge\n";
+  for (std::size_t i = 0; i < TAGS_COUNT; i++) {
+    const auto tag = static_cast<MemoryTag>(i);
+    out << "heap_allocations{subsystem=\"" << memoryTagName(tag) << "\"} "
+        << getMemoryUsage(tag).allocations << '\n';
+  }
+}
+
+} // namespace metrics
+} // namespace boostander
+
+#ifdef BOOSTANDER_MEMORY_ACCOUNTING
+
+namespace {
+
+using boostander::metrics::MemoryTag;
+
+// Placed right before every accounted allocation
+struct AllocationHeader {
+  std::size_t size;
+
+  // from the start of the malloc block to the returned pointer
+  std::uint32_t offset;
+
+  MemoryTag tag;
+};
+
+static_assert(sizeof(AllocationHeader) <= alignof(std::max_align_t),
+              "header must fit into the alignment padding");
+
+void* tryAllocate(std::size_t size, std::size_t alignment) noexcept {
+  alignment = std::max(alignment, alignof(std::max_align_t));
+  // the header takes whole alignment units, so the returned pointer stays aligned
+  const std::size_t offset =
+      (sizeof(AllocationHeader) + alignment - 1) / alignment * alignment;
+  void* block = alignment == alignof(std::max_align_t)
+                    ? std::malloc(offset + size)
+                    : std::aligned_alloc(alignment, (offset + size + alignment - 1) / alignment *
+                                                        alignment);
+  if (!block) {
+    return nullptr;
+  }
+
+  auto* pointer = static_cast<char*>(block) + offset;
+  auto* header = reinterpret_cast<AllocationHeader*>(pointer) - 1;
+  header->size = size;
+  header->offset = static_cast<std::uint32_t>(offset);
+  header->tag = boostander::metrics::gThreadTag;
+
+  const auto index = static_cast<std::size_t>(header->tag);
+  boostander::metrics::gBytes[index].fetch_add(static_cast<std::int64_t>(size),
+                                               std::memory_order_relaxed);
+  boostander::metrics::gAllocations[index].fetch_add(1, std::memory_order_relaxed);
+  boostander::metrics::gTotalAllocations.fetch_add(1, std::memory_order_relaxed);
+  return pointer;
+}
+
+void* allocate(std::size_t size, std::size_t alignment) {
+  for (;;) {
+    if (void* pointer = tryAllocate(size, alignment)) {
+      return pointer;
+    }
+    const std::new_handler handler = std::get_new_handler();
+    if (!handler) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+void* allocateNoThrow(std::size_t size, std::size_t alignment) noexcept {
+  try {
+    return allocate(size, alignment);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void deallocate(void* pointer) noexcept {
+  if (!pointer) {
+    return;
+  }
+  auto* header = static_cast<AllocationHeader*>(pointer) - 1;
+  const auto index = static_cast<std::size_t>(header->tag);
+  boostander::metrics::gBytes[index].fetch_sub(static_cast<std::int64_t>(header->size),
+                                               std::memory_order_relaxed);
+  boostander::metrics::gAllocations[index].fetch_sub(1, std::memory_order_relaxed);
+  std::free(static_cast<char*>(pointer) - header->offset);
+}
+
+constexpr std::size_t DEFAULT_ALIGNMENT = alignof(std::max_align_t);
+
+} // namespace
+
+void* operator new(std::size_t size) { return allocate(size, DEFAULT_ALIGNMENT); }
+
+void* operator new[](std::size_t size) { return allocate(size, DEFAULT_ALIGNMENT); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return allocateNoThrow(size, DEFAULT_ALIGNMENT);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return allocateNoThrow(size, DEFAULT_ALIGNMENT);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return allocateNoThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept {
+  return allocateNoThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept { deallocate(pointer); }
+
+void operator delete[](void* pointer) noexcept { deallocate(pointer); }
+
+void operator delete(void* pointer, std::size_t) noexcept { deallocate(pointer); }
+
+void operator delete[](void* pointer, std::size_t) noexcept { deallocate(pointer); }
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { deallocate(pointer); }
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { deallocate(pointer); }
+
+void operator delete(void* pointer, std::align_val_t) noexcept { deallocate(pointer); }
+
+void operator delete[](void* pointer, std::align_val_t) noexcept { deallocate(pointer); }
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+  deallocate(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept {
+  deallocate(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+  deallocate(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+  deallocate(pointer);
+}
+
+#endif // BOOSTANDER_MEMORY_ACCOUNTING
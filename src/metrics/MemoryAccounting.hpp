@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace boostander {
+namespace metrics {
+
+// Subsystems heap memory is accounted to, see ScopedMemoryTag
+enum class MemoryTag : std::uint8_t {
+  // not tagged: startup, configuration, logging, TLS handshake threads
+  OTHER,
+  // I/O threads: deflate state, read buffers, asio and beast operations
+  NETWORK,
+  // session objects (session pool slabs) with their websocket streams, the sessions map
+  SESSION,
+  // outgoing messages and send queues
+  SEND_QUEUE,
+  // received messages waiting for callbacks and dispatch queues
+  RECEIVE_QUEUE,
+  COUNT
+};
+
+const char* memoryTagName(MemoryTag tag);
+
+/**
+ * Heap accounting by subsystem, built with BOOSTANDER_MEMORY_ACCOUNTING
+ * (cmake -DMEMORY_ACCOUNTING=ON).
+ * The global operator new and delete are replaced: every allocation carries a header with its
+ * size and the tag of the allocating thread, so bytes go back to the subsystem that allocated
+ * them whatever thread frees them (e.g. a message allocated by an I/O thread and freed by the
+ * tick thread). Allocations of beast and asio take the tag of the thread running them.
+ * Costs 16 bytes and two atomic adds per allocation, meant for soak tests, not for production.
+ * Without accounting tags only set a thread_local and every usage is zero.
+ **/
+bool isMemoryAccountingEnabled();
+
+struct MemoryUsage {
+  // heap bytes in use, headers excluded
+  std::int64_t bytes = 0;
+
+  // live allocations
+  std::int64_t allocations = 0;
+};
+
+MemoryUsage getMemoryUsage(MemoryTag tag);
+
+// Allocations made since start, for allocation rates and tests
+std::uint64_t getTotalAllocationsCount();
+
+// Resident set size of the process from /proc/self/statm, 0 if unknown
+std::size_t getResidentMemoryBytes();
+
+// Tag of allocations of the calling thread
+MemoryTag getThreadMemoryTag();
+
+// Sets the default tag of a thread, e.g. MemoryTag::NETWORK for I/O threads
+void setThreadMemoryTag(MemoryTag tag);
+
+// Tags allocations of the calling thread within a scope
+class ScopedMemoryTag {
+public:
+  explicit ScopedMemoryTag(MemoryTag tag) : previous_(getThreadMemoryTag()) {
+    setThreadMemoryTag(tag);
+  }
+
+  ~ScopedMemoryTag() { setThreadMemoryTag(previous_); }
+
+  ScopedMemoryTag(const ScopedMemoryTag&) = delete;
+
+  ScopedMemoryTag& operator=(const ScopedMemoryTag&) = delete;
+
+private:
+  const MemoryTag previous_;
+};
+
+/**
+ * Writes process_resident_memory_bytes and, with accounting, heap_bytes and
+ * heap_allocations by subsystem in Prometheus text format (served with the other metrics).
+ **/
+void renderMemoryMetrics(std::ostream& out);
+
+} // namespace metrics
+} // namespace boostander
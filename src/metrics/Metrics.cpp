@@ -0,0 +1,257 @@
+#include "metrics/Metrics.hpp" // IWYU pragma: associated
+#include <algorithm>
+#include <boost/assert.hpp>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+namespace boostander {
+namespace metrics {
+
+namespace {
+
+/**
+ * Prometheus buckets of histograms: powers of two from about 1us to about 9 minutes.
+ * They match boundaries of Histogram buckets, so exported counts are exact.
+ * The last Histogram bucket also counts larger values, it is exported only in +Inf.
+ **/
+constexpr unsigned PROMETHEUS_MIN_BUCKET_BITS = 10;
+
+// NOTE: label values are quoted, backslash, quote and newline must be escaped
+std::string escapeLabelValue(const std::string& value) {
+  std::string result;
+  result.reserve(value.size());
+  for (char c : value) {
+    if (c == '\\' || c == '"') {
+      result += '\\';
+      result += c;
+    } else if (c == '\n') {
+      result += "\\n";
+    } else {
+      result += c;
+    }
+  }
+  return result;
+}
+
+std::string renderLabels(const MetricLabels& labels) {
+  std::string result;
+  for (const auto& label : labels) {
+    if (!result.empty()) {
+      result += ',';
+    }
+    result += label.first + "=\"" + escapeLabelValue(label.second) + "\"";
+  }
+  return result;
+}
+
+// name{labels,extra} or name{extra} or name
+void writeSeriesName(std::ostream& out, const std::string& name, const std::string& labels,
+                     const std::string& extraLabel = "") {
+  out << name;
+  if (labels.empty() && extraLabel.empty()) {
+    return;
+  }
+  out << '{' << labels;
+  if (!labels.empty() && !extraLabel.empty()) {
+    out << ',';
+  }
+  out << extraLabel << '}';
+}
+
+void writeHeader(std::ostream& out, const std::string& name, const std::string& help,
+                 const char* type) {
+  out << "# HELP " << name << ' ' << help << '\n' << "# TYPE " << name << ' ' << type << '\n';
+}
+
+} // namespace
+
+std::uint64_t Counter::value() const {
+  std::uint64_t result = 0;
+  for (const Shard& shard : shards_) {
+    result += shard.value.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+std::int64_t Gauge::value() const {
+  std::int64_t result = 0;
+  for (const Shard& shard : shards_) {
+    result += shard.value.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+std::array<std::uint64_t, Histogram::HISTOGRAM_BUCKETS> Histogram::bucketCounts() const {
+  std::array<std::uint64_t, HISTOGRAM_BUCKETS> result{};
+  for (const Shard& shard : shards_) {
+    for (std::size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+      result[i] += shard.buckets[i].load(std::memory_order_relaxed);
+    }
+  }
+  return result;
+}
+
+std::uint64_t Histogram::count() const {
+  const auto buckets = bucketCounts();
+  std::uint64_t result = 0;
+  for (std::uint64_t bucket : buckets) {
+    result += bucket;
+  }
+  return result;
+}
+
+std::uint64_t Histogram::sumNs() const {
+  std::uint64_t result = 0;
+  for (const Shard& shard : shards_) {
+    result += shard.sumNs.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+std::uint64_t Histogram::bucketUpperBound(std::size_t index) {
+  if (index < HISTOGRAM_SUB_BUCKETS) {
+    return index + 1;
+  }
+  const std::size_t shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+  const std::uint64_t lowerBound =
+      static_cast<std::uint64_t>(HISTOGRAM_SUB_BUCKETS + index % HISTOGRAM_SUB_BUCKETS) << shift;
+  return lowerBound + (std::uint64_t(1) << shift);
+}
+
+std::uint64_t Histogram::quantileNs(double q) const {
+  const auto buckets = bucketCounts();
+  std::uint64_t total = 0;
+  for (std::uint64_t bucket : buckets) {
+    total += bucket;
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  // rank of the value at quantile q, 1-based
+  const double clamped = std::min(std::max(q, 0.0), 1.0);
+  const std::uint64_t rank =
+      std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(clamped * total)));
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      return bucketUpperBound(i);
+    }
+  }
+  return HISTOGRAM_MAX_NS;
+}
+
+std::uint64_t Histogram::countBelow(std::uint64_t ns) const {
+  const auto buckets = bucketCounts();
+  std::uint64_t result = 0;
+  for (std::size_t i = 0; i < HISTOGRAM_BUCKETS && bucketUpperBound(i) <= ns; i++) {
+    result += buckets[i];
+  }
+  return result;
+}
+
+MetricsRegistry& MetricsRegistry::instance() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+template <typename T>
+T& MetricsRegistry::getOrCreate(std::map<std::string, Family<T>>& families,
+                                const std::string& name, const std::string& help,
+                                const MetricLabels& labels) {
+  std::scoped_lock<std::mutex> lock(mutex_);
+  // NOTE: one name must not be used by metrics of different types
+  BOOST_ASSERT(families.count(name) ||
+               (!counters_.count(name) && !gauges_.count(name) && !histograms_.count(name)));
+
+  Family<T>& family = families[name];
+  if (family.help.empty()) {
+    family.help = help;
+  }
+  std::unique_ptr<T>& metric = family.series[renderLabels(labels)];
+  if (!metric) {
+    metric = std::make_unique<T>();
+  }
+  return *metric;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help,
+                                  const MetricLabels& labels) {
+  return getOrCreate(counters_, name, help, labels);
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help,
+                              const MetricLabels& labels) {
+  return getOrCreate(gauges_, name, help, labels);
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                      const MetricLabels& labels) {
+  return getOrCreate(histograms_, name, help, labels);
+}
+
+void MetricsRegistry::renderPrometheus(std::ostream& out) const {
+  std::scoped_lock<std::mutex> lock(mutex_);
+
+  for (const auto& family : counters_) {
+    writeHeader(out, family.first, family.second.help, "counter");
+    for (const auto& series : family.second.series) {
+      writeSeriesName(out, family.first, series.first);
+      out << ' ' << series.second->value() << '\n';
+    }
+  }
+
+  for (const auto& family : gauges_) {
+    writeHeader(out, family.first, family.second.help, "gauge");
+    for (const auto& series : family.second.series) {
+      writeSeriesName(out, family.first, series.first);
+      out << ' ' << series.second->value() << '\n';
+    }
+  }
+
+  std::ostringstream le;
+  for (const auto& family : histograms_) {
+    writeHeader(out, family.first, family.second.help, "histogram");
+    for (const auto& series : family.second.series) {
+      const Histogram& histogram = *series.second;
+      // NOTE: one snapshot for all buckets, so cumulative counts never decrease
+      const auto buckets = histogram.bucketCounts();
+      std::uint64_t count = 0;
+      std::size_t bucket = 0;
+      for (unsigned bits = PROMETHEUS_MIN_BUCKET_BITS; bits < Histogram::HISTOGRAM_MAX_BITS;
+           bits++) {
+        const std::uint64_t boundNs = std::uint64_t(1) << bits;
+        for (; bucket < buckets.size() && Histogram::bucketUpperBound(bucket) <= boundNs;
+             bucket++) {
+          count += buckets[bucket];
+        }
+        le.str("");
+        le << "le=\"" << std::setprecision(12) << static_cast<double>(boundNs) * 1e-9 << '"';
+        writeSeriesName(out, family.first + "_bucket", series.first, le.str());
+        out << ' ' << count << '\n';
+      }
+      for (; bucket < buckets.size(); bucket++) {
+        count += buckets[bucket];
+      }
+      writeSeriesName(out, family.first + "_bucket", series.first, "le=\"+Inf\"");
+      out << ' ' << count << '\n';
+      writeSeriesName(out, family.first + "_sum", series.first);
+      out << ' ' << std::setprecision(9) << static_cast<double>(histogram.sumNs()) * 1e-9
+          << '\n';
+      writeSeriesName(out, family.first + "_count", series.first);
+      out << ' ' << count << '\n';
+    }
+  }
+}
+
+std::string MetricsRegistry::renderPrometheus() const {
+  std::ostringstream out;
+  renderPrometheus(out);
+  return out.str();
+}
+
+} // namespace metrics
+} // namespace boostander
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+namespace boostander {
+namespace metrics {
+
+/**
+ * Number of shards of counters and histograms.
+ * Threads are spread over shards round-robin, so I/O threads increment
+ * different cache lines and do not contend with each other.
+ **/
+constexpr std::size_t METRICS_SHARDS = 16;
+
+// Shard of the calling thread, assigned on first use
+inline std::size_t threadShard() {
+  static std::atomic<std::size_t> nextShard{0};
+  thread_local const std::size_t shard =
+      nextShard.fetch_add(1, std::memory_order_relaxed) % METRICS_SHARDS;
+  return shard;
+}
+
+/**
+ * Monotonic counter. inc() is one relaxed atomic add on the shard of the calling thread,
+ * value() sums all shards.
+ **/
+class Counter {
+public:
+  void inc(std::uint64_t n = 1) {
+    shards_[threadShard()].value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  std::uint64_t value() const;
+
+private:
+  struct alignas(64) Shard {
+    std::atomic<std::uint64_t> value{0};
+  };
+
+  std::array<Shard, METRICS_SHARDS> shards_;
+};
+
+/**
+ * Value that goes up and down, e.g. number of sessions or queue depth.
+ * Sharded as Counter, so add() and sub() may be called from different threads
+ * for the same item (e.g. enqueue on an I/O thread, dequeue on the tick thread).
+ **/
+class Gauge {
+public:
+  void add(std::int64_t n = 1) {
+    shards_[threadShard()].value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  void sub(std::int64_t n = 1) { add(-n); }
+
+  std::int64_t value() const;
+
+private:
+  struct alignas(64) Shard {
+    std::atomic<std::int64_t> value{0};
+  };
+
+  std::array<Shard, METRICS_SHARDS> shards_;
+};
+
+/**
+ * Latency histogram with log-linear buckets (as HdrHistogram):
+ * every power of two of nanoseconds is split into HISTOGRAM_SUB_BUCKETS linear buckets,
+ * so the relative error of quantiles is at most 1 / HISTOGRAM_SUB_BUCKETS
+ * from 1ns up to HISTOGRAM_MAX_NS. Larger values are counted in the last bucket.
+ * record() is two relaxed atomic adds on the shard of the calling thread.
+ * Exported to Prometheus in seconds with power of two boundaries.
+ * @see http://hdrhistogram.org/
+ **/
+class Histogram {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr unsigned HISTOGRAM_SUB_BUCKET_BITS = 3;
+
+  static constexpr std::size_t HISTOGRAM_SUB_BUCKETS = std::size_t(1)
+                                                       << HISTOGRAM_SUB_BUCKET_BITS;
+
+  // 2^40 ns is about 18 minutes
+  static constexpr unsigned HISTOGRAM_MAX_BITS = 40;
+
+  static constexpr std::uint64_t HISTOGRAM_MAX_NS = std::uint64_t(1) << HISTOGRAM_MAX_BITS;
+
+  static constexpr std::size_t HISTOGRAM_BUCKETS =
+      (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS;
+
+  void record(Clock::duration duration) {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    recordNs(ns > 0 ? static_cast<std::uint64_t>(ns) : 0);
+  }
+
+  void recordNs(std::uint64_t ns) {
+    Shard& shard = shards_[threadShard()];
+    shard.buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    shard.sumNs.fetch_add(ns, std::memory_order_relaxed);
+  }
+
+  std::uint64_t count() const;
+
+  std::uint64_t sumNs() const;
+
+  // Upper bound (ns) of the bucket holding the value at quantile q in [0, 1], 0 if empty
+  std::uint64_t quantileNs(double q) const;
+
+  // Number of recorded values less than ns, exact if ns is a power of two
+  std::uint64_t countBelow(std::uint64_t ns) const;
+
+  // Bucket counts summed over all shards
+  std::array<std::uint64_t, HISTOGRAM_BUCKETS> bucketCounts() const;
+
+  static std::size_t bucketIndex(std::uint64_t ns) {
+    if (ns < HISTOGRAM_SUB_BUCKETS) {
+      return static_cast<std::size_t>(ns);
+    }
+    if (ns >= HISTOGRAM_MAX_NS) {
+      return HISTOGRAM_BUCKETS - 1;
+    }
+    // NOTE: top HISTOGRAM_SUB_BUCKET_BITS + 1 bits of ns select the bucket
+    const unsigned shift = highestBit(ns) - HISTOGRAM_SUB_BUCKET_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS +
+           static_cast<std::size_t>((ns >> shift) - HISTOGRAM_SUB_BUCKETS);
+  }
+
+  // Smallest value of the next bucket
+  static std::uint64_t bucketUpperBound(std::size_t index);
+
+private:
+  static unsigned highestBit(std::uint64_t n) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63u - static_cast<unsigned>(__builtin_clzll(n));
+#else
+    unsigned bit = 0;
+    while (n >>= 1) {
+      bit++;
+    }
+    return bit;
+#endif
+  }
+
+  struct alignas(64) Shard {
+    std::array<std::atomic<std::uint64_t>, HISTOGRAM_BUCKETS> buckets{};
+
+    std::atomic<std::uint64_t> sumNs{0};
+  };
+
+  std::array<Shard, METRICS_SHARDS> shards_;
+};
+
+// Label name -> value, e.g. {{"opcode", "0"}}
+typedef std::map<std::string, std::string> MetricLabels;
+
+/**
+ * Process-wide set of named metrics, rendered in Prometheus text format.
+ * Metrics are created on first request and live until exit, so callers look them up once
+ * (e.g. into a static struct) and keep references, hot paths never touch the registry.
+ * @see https://prometheus.io/docs/instrumenting/exposition_formats/
+ **/
+class MetricsRegistry {
+public:
+  static MetricsRegistry& instance();
+
+  // Returns the existing metric if it was created before with the same name and labels
+  Counter& counter(const std::string& name, const std::string& help,
+                   const MetricLabels& labels = {});
+
+  Gauge& gauge(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+
+  Histogram& histogram(const std::string& name, const std::string& help,
+                       const MetricLabels& labels = {});
+
+  // Writes all metrics in Prometheus text exposition format (version 0.0.4)
+  void renderPrometheus(std::ostream& out) const;
+
+  std::string renderPrometheus() const;
+
+private:
+  template <typename T> struct Family {
+    std::string help;
+
+    // rendered labels ("a=\"1\",b=\"2\"") -> metric
+    std::map<std::string, std::unique_ptr<T>> series;
+  };
+
+  template <typename T>
+  T& getOrCreate(std::map<std::string, Family<T>>& families, const std::string& name,
+                 const std::string& help, const MetricLabels& labels);
+
+  mutable std::mutex mutex_;
+
+  std::map<std::string, Family<Counter>> counters_;
+
+  std::map<std::string, Family<Gauge>> gauges_;
+
+  std::map<std::string, Family<Histogram>> histograms_;
+};
+
+} // namespace metrics
+} // namespace boostander
@@ -0,0 +1,260 @@
+#include "metrics/Tracing.hpp" // IWYU pragma: associated
+#include "metrics/Metrics.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <utility>
+
+namespace boostander {
+namespace metrics {
+
+namespace {
+
+// Span between two stamps of a trace, recorded into ws_stage_duration_seconds{stage=name}
+struct StageSpan {
+  const char* name;
+
+  TraceStage from;
+
+  TraceStage to;
+};
+
+constexpr StageSpan STAGE_SPANS[] = {
+    {"read", TraceStage::RECEIVED, TraceStage::DISPATCHED},
+    {"dispatch_wait", TraceStage::DISPATCHED, TraceStage::CALLBACK_STARTED},
+    {"callback", TraceStage::CALLBACK_STARTED, TraceStage::CALLBACK_FINISHED},
+    {"send_wait", TraceStage::SEND_QUEUED, TraceStage::WRITE_STARTED},
+    {"write", TraceStage::WRITE_STARTED, TraceStage::WRITTEN},
+};
+
+constexpr std::size_t STAGE_SPANS_COUNT = sizeof(STAGE_SPANS) / sizeof(STAGE_SPANS[0]);
+
+// Index of the "total" span (RECEIVED -> WRITTEN or CALLBACK_FINISHED without a reply)
+constexpr std::size_t TOTAL_SPAN = STAGE_SPANS_COUNT;
+
+thread_local std::shared_ptr<MessageTrace> currentTrace;
+
+bool isStamped(const TraceRecord& record, TraceStage stage) {
+  return record.stamps[static_cast<std::size_t>(stage)] != TraceRecord::Clock::time_point{};
+}
+
+TraceRecord::Clock::time_point stampOf(const TraceRecord& record, TraceStage stage) {
+  return record.stamps[static_cast<std::size_t>(stage)];
+}
+
+bool hasSpan(const TraceRecord& record, TraceStage from, TraceStage to) {
+  return isStamped(record, from) && isStamped(record, to) &&
+         stampOf(record, from) <= stampOf(record, to);
+}
+
+// Last stamp of the pipeline: the written reply or the finished callback
+TraceStage lastStage(const TraceRecord& record) {
+  return isStamped(record, TraceStage::WRITTEN) ? TraceStage::WRITTEN
+                                                : TraceStage::CALLBACK_FINISHED;
+}
+
+// Opcode as a JSON string body, opcodes are arbitrary bytes
+std::string jsonOpcode(char opcode) {
+  const unsigned char c = static_cast<unsigned char>(opcode);
+  if (c < 0x20 || c >= 0x7f || c == '"' || c == '\\') {
+    char escaped[8];
+    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+    return escaped;
+  }
+  return std::string(1, opcode);
+}
+
+/**
+ * One nestable async event (ph "b" or "e") of the Chrome "Trace Event Format",
+ * events with the same id form one track.
+ **/
+void writeAsyncEvent(std::ostream& out, bool& first, char phase, const char* name,
+                     std::uint64_t id, TraceRecord::Clock::time_point at,
+                     const std::string& opcode) {
+  if (!first) {
+    out << ",\n";
+  }
+  first = false;
+  const double ts =
+      std::chrono::duration<double, std::micro>(at.time_since_epoch()).count();
+  out << "{\"name\":\"" << name << "\",\"cat\":\"ws\",\"ph\":\"" << phase << "\",\"id\":" << id
+      << ",\"pid\":1,\"tid\":1,\"ts\":" << std::fixed << std::setprecision(3) << ts;
+  if (phase == 'b') {
+    out << ",\"args\":{\"opcode\":\"" << opcode << "\"}";
+  }
+  out << '}';
+}
+
+/**
+ * Writes a parent span with its stage spans nested in it.
+ * Receiving and replying overlap (send() is called within the callback),
+ * so they are written as separate tracks.
+ **/
+void writeTrack(std::ostream& out, bool& first, const TraceRecord& record, const char* name,
+                std::uint64_t id, TraceStage from, TraceStage to, std::size_t firstSpan,
+                std::size_t lastSpan) {
+  if (!hasSpan(record, from, to)) {
+    return;
+  }
+  const std::string opcode = jsonOpcode(record.opcode);
+  writeAsyncEvent(out, first, 'b', name, id, stampOf(record, from), opcode);
+  for (std::size_t i = firstSpan; i <= lastSpan; i++) {
+    const StageSpan& span = STAGE_SPANS[i];
+    if (hasSpan(record, span.from, span.to)) {
+      writeAsyncEvent(out, first, 'b', span.name, id, stampOf(record, span.from), opcode);
+      writeAsyncEvent(out, first, 'e', span.name, id, stampOf(record, span.to), opcode);
+    }
+  }
+  writeAsyncEvent(out, first, 'e', name, id, stampOf(record, to), opcode);
+}
+
+} // namespace
+
+MessageTrace::~MessageTrace() { Tracer::instance().finish(record_); }
+
+std::shared_ptr<MessageTrace> MessageTrace::current() { return currentTrace; }
+
+ScopedTrace::ScopedTrace(std::shared_ptr<MessageTrace> trace)
+    : previous_(std::move(currentTrace)) {
+  trace->stamp(TraceStage::CALLBACK_STARTED);
+  currentTrace = std::move(trace);
+}
+
+ScopedTrace::~ScopedTrace() {
+  currentTrace->stamp(TraceStage::CALLBACK_FINISHED);
+  currentTrace = std::move(previous_);
+}
+
+Tracer& Tracer::instance() {
+  static Tracer tracer;
+  return tracer;
+}
+
+void Tracer::configure(std::uint32_t sampleEvery) {
+  if (sampleEvery != 0) {
+    // NOTE: traces finish in destructors, the ring must not allocate there
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_.reserve(TRACE_BUFFER_SIZE);
+  }
+  sampleEvery_.store(sampleEvery, std::memory_order_relaxed);
+}
+
+std::shared_ptr<MessageTrace> Tracer::startTrace(char opcode, Clock::time_point receivedAt) {
+  const std::uint32_t sampleEvery = sampleEvery_.load(std::memory_order_relaxed);
+  if (sampleEvery == 0) {
+    return nullptr;
+  }
+
+  // per thread, so unsampled messages do not contend on a shared counter
+  thread_local std::uint32_t sinceSample = 0;
+  if (++sinceSample < sampleEvery) {
+    return nullptr;
+  }
+  sinceSample = 0;
+
+  TraceRecord record;
+  record.id = lastId_.fetch_add(1, std::memory_order_relaxed) + 1;
+  record.opcode = opcode;
+  record.stamps[static_cast<std::size_t>(TraceStage::RECEIVED)] = receivedAt;
+  return std::make_shared<MessageTrace>(record);
+}
+
+std::uint64_t Tracer::finishedCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return finishedCount_;
+}
+
+Tracer::StageHistograms& Tracer::stageHistograms(char opcode) {
+  std::atomic<StageHistograms*>& slot = byOpcode_[static_cast<unsigned char>(opcode)];
+  StageHistograms* found = slot.load(std::memory_order_acquire);
+  if (found) {
+    return *found;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  found = slot.load(std::memory_order_relaxed);
+  if (found) {
+    return *found;
+  }
+
+  auto created = std::make_unique<StageHistograms>();
+  const auto stageHistogram = [opcode](const char* stage) {
+    return &MetricsRegistry::instance().histogram(
+        "ws_stage_duration_seconds", "Latency of message pipeline stages of sampled messages",
+        {{"opcode", std::string(1, opcode)}, {"stage", stage}});
+  };
+  for (const StageSpan& span : STAGE_SPANS) {
+    created->spans.push_back(stageHistogram(span.name));
+  }
+  created->spans.push_back(stageHistogram("total"));
+
+  found = created.get();
+  stageHistograms_.push_back(std::move(created));
+  slot.store(found, std::memory_order_release);
+  return *found;
+}
+
+void Tracer::finish(const TraceRecord& record) {
+  StageHistograms& histograms = stageHistograms(record.opcode);
+  for (std::size_t i = 0; i < STAGE_SPANS_COUNT; i++) {
+    const StageSpan& span = STAGE_SPANS[i];
+    if (hasSpan(record, span.from, span.to)) {
+      histograms.spans[i]->record(stampOf(record, span.to) - stampOf(record, span.from));
+    }
+  }
+  const TraceStage last = lastStage(record);
+  if (hasSpan(record, TraceStage::RECEIVED, last)) {
+    histograms.spans[TOTAL_SPAN]->record(stampOf(record, last) -
+                                         stampOf(record, TraceStage::RECEIVED));
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (finished_.size() < TRACE_BUFFER_SIZE) {
+    finished_.push_back(record);
+  } else {
+    finished_[finishedCount_ % TRACE_BUFFER_SIZE] = record;
+  }
+  finishedCount_++;
+}
+
+void Tracer::writeChromeTrace(std::ostream& out) const {
+  std::vector<TraceRecord> records;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // oldest first
+    const std::size_t oldest =
+        finished_.size() < TRACE_BUFFER_SIZE ? 0 : finishedCount_ % TRACE_BUFFER_SIZE;
+    records.reserve(finished_.size());
+    records.insert(records.end(), finished_.begin() + oldest, finished_.end());
+    records.insert(records.end(), finished_.begin(), finished_.begin() + oldest);
+  }
+
+  const auto flags = out.flags();
+  const auto precision = out.precision();
+
+  bool first = true;
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+  for (const TraceRecord& record : records) {
+    writeTrack(out, first, record, "message", record.id * 2, TraceStage::RECEIVED,
+               TraceStage::CALLBACK_FINISHED, 0, 2);
+    writeTrack(out, first, record, "reply", record.id * 2 + 1, TraceStage::SEND_QUEUED,
+               TraceStage::WRITTEN, 3, 4);
+  }
+  out << "\n]}\n";
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+bool Tracer::writeChromeTrace(const std::string& path) const {
+  std::ofstream out(path, std::ios::out | std::ios::trunc);
+  if (!out) {
+    return false;
+  }
+  writeChromeTrace(out);
+  out.flush();
+  return out.good();
+}
+
+} // namespace metrics
+} // namespace boostander
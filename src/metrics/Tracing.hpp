@@ -0,0 +1,154 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace boostander {
+namespace metrics {
+
+class Histogram;
+
+// Points of the message pipeline where a traced message is stamped, in pipeline order
+enum class TraceStage : std::size_t {
+  RECEIVED,          // read of the message completed
+  DISPATCHED,        // added to the dispatch queue of the session
+  CALLBACK_STARTED,  // taken from the queue by the tick thread
+  CALLBACK_FINISHED, // callback returned
+  SEND_QUEUED,       // callback called send()
+  WRITE_STARTED,     // reply taken from the send queue of the session
+  WRITTEN,           // write of the reply completed
+  TOTAL
+};
+
+constexpr std::size_t TRACE_STAGES = static_cast<std::size_t>(TraceStage::TOTAL);
+
+// Copyable state of a trace, kept for Chrome trace output
+struct TraceRecord {
+  typedef std::chrono::steady_clock Clock;
+
+  std::uint64_t id = 0;
+
+  char opcode = 0;
+
+  // default (zero) time point if the stage was not reached
+  std::array<Clock::time_point, TRACE_STAGES> stamps{};
+};
+
+/**
+ * Timestamps of one sampled message, carried with it through the pipeline:
+ * by the dispatch queue callback, then by the queued reply.
+ * Finished when the last holder releases it, then stage latencies are recorded.
+ * @note if a callback sends several replies, the last one is traced
+ **/
+class MessageTrace {
+public:
+  explicit MessageTrace(const TraceRecord& record) : record_(record) {}
+
+  ~MessageTrace();
+
+  MessageTrace(const MessageTrace&) = delete;
+  MessageTrace& operator=(const MessageTrace&) = delete;
+
+  void stamp(TraceStage stage) {
+    record_.stamps[static_cast<std::size_t>(stage)] = TraceRecord::Clock::now();
+  }
+
+  const TraceRecord& record() const { return record_; }
+
+  // Trace of the callback running on this thread, nullptr outside of traced callbacks
+  static std::shared_ptr<MessageTrace> current();
+
+private:
+  friend class ScopedTrace;
+
+  TraceRecord record_;
+};
+
+/**
+ * Marks the callback of a traced message: stamps CALLBACK_STARTED and CALLBACK_FINISHED
+ * and makes the trace current on this thread, so send() attaches it to the reply.
+ **/
+class ScopedTrace {
+public:
+  explicit ScopedTrace(std::shared_ptr<MessageTrace> trace);
+
+  ~ScopedTrace();
+
+  ScopedTrace(const ScopedTrace&) = delete;
+  ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+private:
+  std::shared_ptr<MessageTrace> previous_;
+};
+
+/**
+ * Samples messages for tracing and collects finished traces:
+ * per-opcode histograms of stage latencies (ws_stage_duration_seconds) and
+ * the last TRACE_BUFFER_SIZE traces for Chrome trace output.
+ * Stages: read (RECEIVED -> DISPATCHED), dispatch_wait (-> CALLBACK_STARTED, waits for the
+ * tick), callback, send_wait (SEND_QUEUED -> WRITE_STARTED), write, total.
+ **/
+class Tracer {
+public:
+  typedef TraceRecord::Clock Clock;
+
+  static constexpr std::size_t TRACE_BUFFER_SIZE = 4096;
+
+  static Tracer& instance();
+
+  // Every sampleEvery-th message of each I/O thread is traced, 0 disables tracing
+  void configure(std::uint32_t sampleEvery);
+
+  std::uint32_t sampleEvery() const { return sampleEvery_.load(std::memory_order_relaxed); }
+
+  // Returns nullptr if the message is not sampled
+  std::shared_ptr<MessageTrace> startTrace(char opcode, Clock::time_point receivedAt);
+
+  std::uint64_t finishedCount() const;
+
+  // Finished traces in Chrome trace event format (chrome://tracing, ui.perfetto.dev)
+  void writeChromeTrace(std::ostream& out) const;
+
+  // Returns false if the file can not be written
+  bool writeChromeTrace(const std::string& path) const;
+
+private:
+  friend class MessageTrace;
+
+  // Histograms of TraceStage spans of one opcode
+  struct StageHistograms {
+    std::vector<Histogram*> spans;
+  };
+
+  void finish(const TraceRecord& record);
+
+  StageHistograms& stageHistograms(char opcode);
+
+  std::atomic<std::uint32_t> sampleEvery_{0};
+
+  std::atomic<std::uint64_t> lastId_{0};
+
+  // by opcode, created on first finished trace of the opcode
+  std::array<std::atomic<StageHistograms*>, 256> byOpcode_{};
+
+  mutable std::mutex mutex_;
+
+  // requires mutex_
+  std::vector<std::unique_ptr<StageHistograms>> stageHistograms_;
+
+  // ring of finished traces, requires mutex_
+  std::vector<TraceRecord> finished_;
+
+  std::uint64_t finishedCount_ = 0;
+};
+
+} // namespace metrics
+} // namespace boostander
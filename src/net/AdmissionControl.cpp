@@ -0,0 +1,114 @@
+#include "net/AdmissionControl.hpp" // IWYU pragma: associated
+#include "log/Logger.hpp"
+#include <algorithm>
+#include <sched.h>
+#include <sys/resource.h>
+#include <thread>
+
+namespace boostander {
+namespace net {
+
+namespace {
+
+std::chrono::microseconds processCpuTime() {
+  rusage usage{};
+  if (::getrusage(RUSAGE_SELF, &usage) != 0) {
+    return std::chrono::microseconds(0);
+  }
+  const auto toUs = [](const timeval& time) {
+    return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
+  };
+  return toUs(usage.ru_utime) + toUs(usage.ru_stime);
+}
+
+// CPUs of the affinity mask (containers, taskset), all CPUs if it is not known
+unsigned availableCpus() {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  if (::sched_getaffinity(0, sizeof(cpus), &cpus) == 0 && CPU_COUNT(&cpus) > 0) {
+    return static_cast<unsigned>(CPU_COUNT(&cpus));
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+} // namespace
+
+AdmissionControl::AdmissionControl(std::size_t maxSessions, std::size_t maxSessionsPerAddress,
+                                   std::size_t maxQueuedMessages, unsigned maxCpuPercent)
+    : maxSessions_(maxSessions), maxSessionsPerAddress_(maxSessionsPerAddress),
+      maxQueuedMessages_(maxQueuedMessages), maxCpuPercent_(maxCpuPercent) {}
+
+AdmissionControl::Verdict AdmissionControl::admit(const boost::asio::ip::address& address) {
+  // NOTE: incremented first, concurrent accepts of both listeners do not exceed the limit
+  const std::size_t sessions = sessions_.fetch_add(1, std::memory_order_relaxed);
+  if (maxSessions_ && sessions >= maxSessions_) {
+    sessions_.fetch_sub(1, std::memory_order_relaxed);
+    return Verdict::TOO_MANY_SESSIONS;
+  }
+
+  if (maxSessionsPerAddress_) {
+    std::scoped_lock lock(addressesMutex_);
+    std::size_t& addressSessions = sessionsByAddress_[address];
+    if (addressSessions >= maxSessionsPerAddress_) {
+      sessions_.fetch_sub(1, std::memory_order_relaxed);
+      return Verdict::TOO_MANY_FROM_ADDRESS;
+    }
+    addressSessions++;
+  }
+  return Verdict::ADMITTED;
+}
+
+void AdmissionControl::release(const boost::asio::ip::address& address) {
+  sessions_.fetch_sub(1, std::memory_order_relaxed);
+
+  if (maxSessionsPerAddress_) {
+    std::scoped_lock lock(addressesMutex_);
+    const auto found = sessionsByAddress_.find(address);
+    if (found == sessionsByAddress_.end()) {
+      LOG(WARNING) << "AdmissionControl::release: unknown address " << address.to_string();
+      return;
+    }
+    if (--found->second == 0) {
+      sessionsByAddress_.erase(found);
+    }
+  }
+}
+
+void AdmissionControl::updateLoad(std::size_t queuedMessages, double cpuPercent) {
+  const bool wasOverloaded = isOverloaded();
+  const double ratio = wasOverloaded ? RECOVERY_RATIO : 1.0;
+  const bool isQueueFull =
+      maxQueuedMessages_ &&
+      static_cast<double>(queuedMessages) >= static_cast<double>(maxQueuedMessages_) * ratio;
+  const bool isCpuBusy = maxCpuPercent_ && cpuPercent >= maxCpuPercent_ * ratio;
+  const bool isOverloaded = isQueueFull || isCpuBusy;
+  if (isOverloaded != wasOverloaded) {
+    LOG(WARNING) << "AdmissionControl: " << (isOverloaded ? "overloaded" : "load is back to normal")
+                 << ", queued messages " << queuedMessages << ", CPU " << cpuPercent << "%";
+  }
+  isOverloaded_.store(isOverloaded, std::memory_order_relaxed);
+}
+
+bool AdmissionControl::canAccept() const {
+  return !isOverloaded() && (!maxSessions_ || getSessions() < maxSessions_);
+}
+
+ProcessCpuUsage::ProcessCpuUsage()
+    : lastWallTime_(std::chrono::steady_clock::now()), lastCpuTime_(processCpuTime()),
+      cpus_(availableCpus()) {}
+
+double ProcessCpuUsage::sample() {
+  const auto wallTime = std::chrono::steady_clock::now();
+  const auto cpuTime = processCpuTime();
+  const std::chrono::duration<double> wall = wallTime - lastWallTime_;
+  const std::chrono::duration<double> cpu = cpuTime - lastCpuTime_;
+  lastWallTime_ = wallTime;
+  lastCpuTime_ = cpuTime;
+  if (wall.count() <= 0.0) {
+    return 0.0;
+  }
+  return 100.0 * cpu.count() / (wall.count() * cpus_);
+}
+
+} // namespace net
+} // namespace boostander
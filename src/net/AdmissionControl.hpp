@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio/ip/address.hpp>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <mutex>
+
+namespace boostander {
+namespace net {
+
+/**
+ * Overload protection of the server: limits sessions (all and per remote address) and tracks
+ * the load, so new connections and messages are shed before queues and latency grow.
+ * While the server is overloaded listeners stop accepting (connections wait in the listen
+ * backlog) and received messages are answered with BUSY instead of being queued.
+ * Limits are 0 for unlimited. Thread-safe.
+ **/
+class AdmissionControl {
+public:
+  enum class Verdict { ADMITTED, TOO_MANY_SESSIONS, TOO_MANY_FROM_ADDRESS };
+
+  // The overload ends when the load is below this share of its threshold, so it does not flap
+  static constexpr double RECOVERY_RATIO = 0.75;
+
+  /**
+   * @param maxQueuedMessages received messages waiting for callbacks in all sessions
+   * @param maxCpuPercent CPU usage of the process, percent of the CPUs it may run on
+   **/
+  AdmissionControl(std::size_t maxSessions, std::size_t maxSessionsPerAddress,
+                   std::size_t maxQueuedMessages, unsigned maxCpuPercent);
+
+  // Counts a new session of address if the limits allow it, it is released by release()
+  Verdict admit(const boost::asio::ip::address& address);
+
+  void release(const boost::asio::ip::address& address);
+
+  // Updates the overload state with the load sampled since the previous call
+  void updateLoad(std::size_t queuedMessages, double cpuPercent);
+
+  // Messages are answered with BUSY, one relaxed load on the message path
+  bool isOverloaded() const { return isOverloaded_.load(std::memory_order_relaxed); }
+
+  // Listeners may accept: not overloaded and below maxSessions
+  bool canAccept() const;
+
+  // Load is sampled only if some threshold is set
+  bool isLoadLimited() const { return maxQueuedMessages_ || maxCpuPercent_; }
+
+  bool isEnabled() const { return isLoadLimited() || maxSessions_ || maxSessionsPerAddress_; }
+
+  std::size_t getSessions() const { return sessions_.load(std::memory_order_relaxed); }
+
+private:
+  const std::size_t maxSessions_;
+
+  const std::size_t maxSessionsPerAddress_;
+
+  const std::size_t maxQueuedMessages_;
+
+  const unsigned maxCpuPercent_;
+
+  std::atomic<std::size_t> sessions_{0};
+
+  std::atomic<bool> isOverloaded_{false};
+
+  // Sessions per remote address, counted only if maxSessionsPerAddress_ is set
+  std::mutex addressesMutex_;
+
+  std::map<boost::asio::ip::address, std::size_t> sessionsByAddress_;
+};
+
+/**
+ * CPU usage of the process (all threads, user and system time) between calls of sample(),
+ * in percent of the CPUs the process may run on.
+ **/
+class ProcessCpuUsage {
+public:
+  ProcessCpuUsage();
+
+  double sample();
+
+private:
+  std::chrono::steady_clock::time_point lastWallTime_;
+
+  std::chrono::microseconds lastCpuTime_;
+
+  const unsigned cpus_;
+};
+
+} // namespace net
+} // namespace boostander
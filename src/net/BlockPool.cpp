@@ -0,0 +1,81 @@
+#include "net/BlockPool.hpp" // IWYU pragma: associated
+#include <new>
+
+namespace boostander {
+namespace net {
+
+namespace {
+
+std::size_t alignToCacheLine(std::size_t size) {
+  return (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+}
+
+} // namespace
+
+BlockPool::BlockPool(std::size_t blockSize, std::size_t blocksPerSlab)
+    : blockSize_(alignToCacheLine(blockSize ? blockSize : 1)),
+      blocksPerSlab_(blocksPerSlab ? blocksPerSlab : 1) {}
+
+BlockPool::~BlockPool() {
+  for (void* slab : slabs_) {
+    ::operator delete(slab, std::align_val_t(CACHE_LINE_SIZE));
+  }
+}
+
+void* BlockPool::allocate(std::size_t size) {
+  if (size > blockSize_) {
+    heapAllocationsCount_.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(size, std::align_val_t(CACHE_LINE_SIZE));
+  }
+
+  std::scoped_lock lock(mutex_);
+  if (!freeList_) {
+    addSlab();
+  }
+  FreeBlock* block = freeList_;
+  freeList_ = block->next;
+  blocksInUse_++;
+  return block;
+}
+
+void BlockPool::deallocate(void* pointer, std::size_t size) noexcept {
+  if (!pointer) {
+    return;
+  }
+  if (size > blockSize_) {
+    ::operator delete(pointer, std::align_val_t(CACHE_LINE_SIZE));
+    return;
+  }
+
+  std::scoped_lock lock(mutex_);
+  // LIFO: the next allocation gets the block that is most likely still in cache
+  auto* block = static_cast<FreeBlock*>(pointer);
+  block->next = freeList_;
+  freeList_ = block;
+  blocksInUse_--;
+}
+
+std::size_t BlockPool::getBlocksInUse() const {
+  std::scoped_lock lock(mutex_);
+  return blocksInUse_;
+}
+
+std::size_t BlockPool::getBlocksCount() const {
+  std::scoped_lock lock(mutex_);
+  return slabs_.size() * blocksPerSlab_;
+}
+
+void BlockPool::addSlab() {
+  auto* slab = static_cast<char*>(
+      ::operator new(blockSize_ * blocksPerSlab_, std::align_val_t(CACHE_LINE_SIZE)));
+  slabs_.push_back(slab);
+  // blocks of the slab are handed out in address order
+  for (std::size_t i = blocksPerSlab_; i-- > 0;) {
+    auto* block = reinterpret_cast<FreeBlock*>(slab + i * blockSize_);
+    block->next = freeList_;
+    freeList_ = block;
+  }
+}
+
+} // namespace net
+} // namespace boostander
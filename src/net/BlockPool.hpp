@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace boostander {
+namespace net {
+
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * Fixed-size, cache line aligned blocks carved from large slabs.
+ * Freed blocks are kept in a LIFO free list and reused first, so objects created and
+ * destroyed per connection (sessions) land in the same memory again instead of being
+ * scattered over the heap, and connection churn does not fragment it.
+ * Slabs are never returned to the heap: memory stays at the peak of concurrent blocks.
+ * Thread-safe, blocks may be freed on any thread.
+ **/
+class BlockPool {
+public:
+  // blockSize is rounded up to CACHE_LINE_SIZE
+  BlockPool(std::size_t blockSize, std::size_t blocksPerSlab);
+
+  ~BlockPool();
+
+  BlockPool(const BlockPool&) = delete;
+
+  BlockPool& operator=(const BlockPool&) = delete;
+
+  // Bigger sizes than getBlockSize() are allocated from the heap (and counted)
+  void* allocate(std::size_t size);
+
+  // size must be the same as passed to allocate
+  void deallocate(void* pointer, std::size_t size) noexcept;
+
+  std::size_t getBlockSize() const { return blockSize_; }
+
+  std::size_t getBlocksInUse() const;
+
+  // blocks of all slabs, in use and free
+  std::size_t getBlocksCount() const;
+
+  std::size_t getHeapAllocationsCount() const {
+    return heapAllocationsCount_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  // Requires mutex_
+  void addSlab();
+
+  const std::size_t blockSize_;
+
+  const std::size_t blocksPerSlab_;
+
+  mutable std::mutex mutex_;
+
+  FreeBlock* freeList_ = nullptr;
+
+  std::vector<void*> slabs_;
+
+  std::size_t blocksInUse_ = 0;
+
+  std::atomic<std::size_t> heapAllocationsCount_{0};
+};
+
+/**
+ * Standard allocator over BlockPool, e.g. for std::allocate_shared:
+ * the object and the shared_ptr control block take one pooled block.
+ * With BlockSize (the block size of the pool) single objects of every rebound type must fit
+ * into a block, checked at compile time, so they never go to the heap silently.
+ **/
+template <typename T, std::size_t BlockSize = 0> class PoolAllocator {
+public:
+  using value_type = T;
+
+  template <typename U> struct rebind { using other = PoolAllocator<U, BlockSize>; };
+
+  explicit PoolAllocator(BlockPool& pool) noexcept : pool_(&pool) {}
+
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U, BlockSize>& other) noexcept : pool_(other.pool_) {}
+
+  bool operator==(const PoolAllocator& other) const noexcept { return pool_ == other.pool_; }
+
+  bool operator!=(const PoolAllocator& other) const noexcept { return pool_ != other.pool_; }
+
+  T* allocate(std::size_t n) {
+    static_assert(BlockSize == 0 || sizeof(T) <= BlockSize, "T does not fit into a pool block");
+    return static_cast<T*>(pool_->allocate(sizeof(T) * n));
+  }
+
+  void deallocate(T* pointer, std::size_t n) noexcept { pool_->deallocate(pointer, sizeof(T) * n); }
+
+private:
+  template <typename, std::size_t> friend class PoolAllocator;
+
+  BlockPool* pool_;
+};
+
+} // namespace net
+} // namespace boostander
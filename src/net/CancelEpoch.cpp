@@ -0,0 +1,33 @@
+#include "net/CancelEpoch.hpp" // IWYU pragma: associated
+
+namespace boostander {
+namespace net {
+
+namespace {
+
+// Owner and epoch of the callback running on this thread
+struct RunningEpoch {
+  const CancelEpoch* owner{nullptr};
+
+  std::uint64_t epoch{0};
+};
+
+thread_local RunningEpoch runningEpoch;
+
+} // namespace
+
+CancelEpoch::RunningCallback::RunningCallback(const CancelEpoch& owner, std::uint64_t epoch)
+    : previousOwner_(runningEpoch.owner), previousEpoch_(runningEpoch.epoch) {
+  runningEpoch = RunningEpoch{&owner, epoch};
+}
+
+CancelEpoch::RunningCallback::~RunningCallback() {
+  runningEpoch = RunningEpoch{previousOwner_, previousEpoch_};
+}
+
+bool CancelEpoch::isCancelled() const {
+  return runningEpoch.owner == this && runningEpoch.epoch != current();
+}
+
+} // namespace net
+} // namespace boostander
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace boostander {
+namespace net {
+
+/**
+ * Cancels messages of a session received so far, queued and running ones.
+ * Every message keeps the epoch it was received at (current()), its callback runs within a
+ * RunningCallback and long callbacks check isCancelled() to stop early.
+ * Thread-safe.
+ **/
+class CancelEpoch {
+public:
+  // Marks the callback of a message received at epoch as running on this thread
+  class RunningCallback {
+  public:
+    RunningCallback(const CancelEpoch& owner, std::uint64_t epoch);
+
+    ~RunningCallback();
+
+    RunningCallback(const RunningCallback&) = delete;
+    RunningCallback& operator=(const RunningCallback&) = delete;
+
+  private:
+    // callbacks may run callbacks of other sessions
+    const CancelEpoch* previousOwner_;
+
+    std::uint64_t previousEpoch_;
+  };
+
+  // Epoch of a message received now
+  std::uint64_t current() const { return epoch_.load(std::memory_order_relaxed); }
+
+  // Messages received before are cancelled
+  void cancel() { epoch_.fetch_add(1, std::memory_order_relaxed); }
+
+  /**
+   * The callback running on this thread handles a message of this owner received before
+   * cancel(). False outside of a RunningCallback of this owner.
+   **/
+  bool isCancelled() const;
+
+private:
+  std::atomic<std::uint64_t> epoch_{0};
+};
+
+} // namespace net
+} // namespace boostander
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <array>
+#include <boost/asio/associated_allocator.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/handler_alloc_hook.hpp>
+#include <boost/asio/handler_continuation_hook.hpp>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace boostander {
+namespace net {
+
+/**
+ * Memory for completion handlers of one chain of asynchronous operations
+ * (e.g. all reads of a session). A chain keeps only a few allocations alive at a time:
+ * the composed operation state plus the lower layer operation it is waiting on.
+ * Requests that do not fit or find every slot busy fall back to the heap.
+ * @note not thread-safe, one chain of operations runs at a time (within a strand).
+ * @see https://www.boost.org/doc/libs/1_69_0/doc/html/boost_asio/example/cpp11/allocation/server.cpp
+ **/
+template <std::size_t SlotSize, std::size_t SlotsCount> class HandlerMemory {
+public:
+  HandlerMemory() {}
+
+  HandlerMemory(const HandlerMemory&) = delete;
+  HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+  // alignment above the one of slots (e.g. alignas(64) handlers) goes to the heap too
+  void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) {
+    if (size <= SlotSize && alignment <= alignof(Slot)) {
+      for (std::size_t i = 0; i < SlotsCount; i++) {
+        if (!inUse_[i]) {
+          inUse_[i] = true;
+          return &storage_[i];
+        }
+      }
+    }
+    heapFallbacks_++;
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+      return ::operator new(size, std::align_val_t(alignment));
+    }
+    return ::operator new(size);
+  }
+
+  // alignment must be the one passed to allocate
+  void deallocate(void* pointer, std::size_t alignment = alignof(std::max_align_t)) {
+    for (std::size_t i = 0; i < SlotsCount; i++) {
+      if (pointer == &storage_[i]) {
+        inUse_[i] = false;
+        return;
+      }
+    }
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+      ::operator delete(pointer, std::align_val_t(alignment));
+      return;
+    }
+    ::operator delete(pointer);
+  }
+
+  // number of allocations served by the heap, useful to tune SlotSize and SlotsCount
+  std::size_t heapFallbacks() const { return heapFallbacks_; }
+
+private:
+  typedef typename std::aligned_storage<SlotSize>::type Slot;
+
+  std::array<Slot, SlotsCount> storage_;
+
+  std::array<bool, SlotsCount> inUse_{};
+
+  std::size_t heapFallbacks_ = 0;
+};
+
+/**
+ * Memory for each chain of operations of a WebSocket session.
+ * At most 2 allocations of a chain are alive at a time (websocket operation and
+ * its socket operation), the biggest one is websocket write (~700 bytes).
+ * Only the accept handshake briefly needs more and goes to the heap.
+ **/
+typedef HandlerMemory<1024, 2> SessionHandlerMemory;
+
+// Ping chain: websocket ping and its write (~500 bytes over TLS)
+typedef HandlerMemory<512, 2> SessionPingMemory;
+
+// Deadline posted by the timer wheel, a bound shared_ptr (~80 bytes)
+typedef HandlerMemory<128, 1> SessionTimerMemory;
+
+/**
+ * Allocator that satisfies the C++11 minimal allocator requirements,
+ * returned as associated allocator of CustomAllocHandler
+ **/
+template <typename T, typename Memory> class HandlerAllocator {
+public:
+  using value_type = T;
+
+  explicit HandlerAllocator(Memory& memory) : memory_(memory) {}
+
+  template <typename U>
+  HandlerAllocator(const HandlerAllocator<U, Memory>& other) noexcept : memory_(other.memory_) {}
+
+  bool operator==(const HandlerAllocator& other) const noexcept {
+    return &memory_ == &other.memory_;
+  }
+
+  bool operator!=(const HandlerAllocator& other) const noexcept {
+    return &memory_ != &other.memory_;
+  }
+
+  T* allocate(std::size_t n) const {
+    return static_cast<T*>(memory_.allocate(sizeof(T) * n, alignof(T)));
+  }
+
+  void deallocate(T* pointer, std::size_t /*n*/) const {
+    return memory_.deallocate(pointer, alignof(T));
+  }
+
+private:
+  template <typename, typename> friend class HandlerAllocator;
+
+  Memory& memory_;
+};
+
+/**
+ * Wraps a completion handler so that memory for the operation is taken from Memory.
+ * Provides both the associated allocator (used by asio and beast since Boost 1.66)
+ * and the asio_handler_allocate hooks, the associated executor of the wrapped
+ * handler (e.g. strand from bind_executor) is kept.
+ **/
+template <typename Handler, typename Memory> class CustomAllocHandler {
+public:
+  using allocator_type = HandlerAllocator<Handler, Memory>;
+
+  using executor_type = typename boost::asio::associated_executor<Handler>::type;
+
+  CustomAllocHandler(Memory& memory, Handler handler)
+      : memory_(memory), handler_(std::move(handler)) {}
+
+  allocator_type get_allocator() const noexcept { return allocator_type(memory_); }
+
+  executor_type get_executor() const noexcept {
+    return boost::asio::get_associated_executor(handler_);
+  }
+
+  template <typename... Args> void operator()(Args&&... args) {
+    handler_(std::forward<Args>(args)...);
+  }
+
+  friend void* asio_handler_allocate(std::size_t size, CustomAllocHandler* thisHandler) {
+    return thisHandler->memory_.allocate(size);
+  }
+
+  friend void asio_handler_deallocate(void* pointer, std::size_t /*size*/,
+                                      CustomAllocHandler* thisHandler) {
+    thisHandler->memory_.deallocate(pointer);
+  }
+
+  friend bool asio_handler_is_continuation(CustomAllocHandler* thisHandler) {
+    using boost::asio::asio_handler_is_continuation;
+    return asio_handler_is_continuation(&thisHandler->handler_);
+  }
+
+private:
+  Memory& memory_;
+
+  Handler handler_;
+};
+
+// Helper function to wrap a handler object to add custom allocation.
+template <typename Handler, typename Memory>
+inline CustomAllocHandler<typename std::decay<Handler>::type, Memory>
+makeCustomAllocHandler(Memory& memory, Handler&& handler) {
+  return CustomAllocHandler<typename std::decay<Handler>::type, Memory>(
+      memory, std::forward<Handler>(handler));
+}
+
+} // namespace net
+} // namespace boostander
@@ -0,0 +1,213 @@
+#include "net/ListenerHandoff.hpp" // IWYU pragma: associated
+#include "log/Logger.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <utility>
+
+namespace boostander {
+namespace net {
+
+namespace beast = boost::beast;                    // from <boost/beast.hpp>
+namespace net = boost::asio;                       // from <boost/asio.hpp>
+using local = boost::asio::local::stream_protocol; // from <boost/asio/local/stream_protocol.hpp>
+
+namespace {
+
+constexpr std::size_t MAX_HANDLES = 3;
+
+// Kinds of passed handles, one byte of the payload per descriptor in the same order
+constexpr char WS_KIND = 'w';
+
+constexpr char WSS_KIND = 's';
+
+constexpr char METRICS_KIND = 'm';
+
+} // namespace
+
+bool sendListenerHandles(int unixFd, const ListenerHandles& handles) {
+  std::array<char, MAX_HANDLES> kinds{};
+  std::array<int, MAX_HANDLES> fds{};
+  std::size_t count = 0;
+  for (const auto& handle : {std::make_pair(WS_KIND, handles.ws),
+                             std::make_pair(WSS_KIND, handles.wss),
+                             std::make_pair(METRICS_KIND, handles.metrics)}) {
+    if (handle.second >= 0) {
+      kinds[count] = handle.first;
+      fds[count] = handle.second;
+      count++;
+    }
+  }
+  if (!count) {
+    LOG(WARNING) << "sendListenerHandles: no listening sockets";
+    return false;
+  }
+
+  iovec payload{kinds.data(), count};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_HANDLES)] = {};
+  msghdr message{};
+  message.msg_iov = &payload;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+  cmsghdr* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+  std::memcpy(CMSG_DATA(header), fds.data(), sizeof(int) * count);
+
+  if (::sendmsg(unixFd, &message, MSG_NOSIGNAL) != static_cast<ssize_t>(count)) {
+    LOG(WARNING) << "sendListenerHandles: sendmsg: " << std::strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+ListenerHandles receiveListenerHandles(int unixFd) {
+  std::array<char, MAX_HANDLES> kinds{};
+  iovec payload{kinds.data(), kinds.size()};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_HANDLES)] = {};
+  msghdr message{};
+  message.msg_iov = &payload;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  const ssize_t received = ::recvmsg(unixFd, &message, MSG_CMSG_CLOEXEC);
+  if (received <= 0) {
+    LOG(WARNING) << "receiveListenerHandles: recvmsg: "
+                 << (received < 0 ? std::strerror(errno) : "connection closed");
+    return {};
+  }
+
+  ListenerHandles handles;
+  for (cmsghdr* header = CMSG_FIRSTHDR(&message); header;
+       header = CMSG_NXTHDR(&message, header)) {
+    if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+      continue;
+    }
+    const std::size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    std::array<int, MAX_HANDLES> fds{};
+    std::memcpy(fds.data(), CMSG_DATA(header), sizeof(int) * std::min(count, MAX_HANDLES));
+    for (std::size_t i = 0; i < std::min(count, MAX_HANDLES); i++) {
+      const char kind = i < static_cast<std::size_t>(received) ? kinds[i] : '\0';
+      int* target = kind == WS_KIND        ? &handles.ws
+                    : kind == WSS_KIND     ? &handles.wss
+                    : kind == METRICS_KIND ? &handles.metrics
+                                           : nullptr;
+      if (target && *target < 0) {
+        *target = fds[i];
+      } else {
+        ::close(fds[i]);
+      }
+    }
+  }
+  if (message.msg_flags & MSG_CTRUNC) {
+    LOG(WARNING) << "receiveListenerHandles: some descriptors are truncated";
+  }
+  return handles;
+}
+
+ListenerHandoff::ListenerHandoff(net::io_context& ioc, const std::string& path)
+    : path_(path), acceptor_(ioc), socket_(ioc), strand_(ioc.get_executor()) {}
+
+ListenerHandles ListenerHandoff::takeOver(const std::string& path) {
+  sockaddr_un address{};
+  if (path.size() >= sizeof(address.sun_path)) {
+    LOG(WARNING) << "ListenerHandoff: too long path " << path;
+    return {};
+  }
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    LOG(WARNING) << "ListenerHandoff: socket: " << std::strerror(errno);
+    return {};
+  }
+  if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+    // no server or a socket file of a stopped one
+    LOG(INFO) << "ListenerHandoff: no running server at " << path << ", listening sockets are "
+              << "created";
+    ::close(fd);
+    return {};
+  }
+
+  ListenerHandles handles = receiveListenerHandles(fd);
+  ::close(fd);
+  if (!handles.empty()) {
+    LOG(INFO) << "ListenerHandoff: listening sockets are taken over from the server at " << path;
+  }
+  return handles;
+}
+
+bool ListenerHandoff::listen(HandlesProvider provider, HandedOffHandler onHandedOff) {
+  provider_ = std::move(provider);
+  onHandedOff_ = std::move(onHandedOff);
+
+  // the previous process is done with the path: handed off or stopped
+  ::unlink(path_.c_str());
+
+  beast::error_code ec;
+  const local::endpoint endpoint(path_);
+  acceptor_.open(endpoint.protocol(), ec);
+  if (!ec) {
+    acceptor_.bind(endpoint, ec);
+  }
+  if (!ec) {
+    acceptor_.listen(net::socket_base::max_listen_connections, ec);
+  }
+  if (ec) {
+    LOG(WARNING) << "ListenerHandoff: can not listen on " << path_ << ": " << ec.message();
+    acceptor_.close(ec);
+    return false;
+  }
+
+  net::post(strand_, std::bind(&ListenerHandoff::doAccept, shared_from_this()));
+  return true;
+}
+
+void ListenerHandoff::stop() {
+  net::post(strand_, [self = shared_from_this()]() {
+    beast::error_code ec;
+    self->acceptor_.close(ec);
+  });
+}
+
+void ListenerHandoff::doAccept() {
+  acceptor_.async_accept(socket_, net::bind_executor(strand_, std::bind(&ListenerHandoff::onAccept,
+                                                                        shared_from_this(),
+                                                                        std::placeholders::_1)));
+}
+
+void ListenerHandoff::onAccept(beast::error_code ec) {
+  if (ec == net::error::operation_aborted || !acceptor_.is_open()) {
+    return;
+  }
+  if (ec) {
+    LOG(WARNING) << "ListenerHandoff: accept: " << ec.message();
+    return doAccept();
+  }
+
+  const bool isHandedOff = sendListenerHandles(socket_.native_handle(), provider_());
+  socket_.close(ec);
+  if (!isHandedOff) {
+    return doAccept();
+  }
+
+  LOG(WARNING) << "ListenerHandoff: listening sockets are handed off to a new process";
+  acceptor_.close(ec);
+  if (onHandedOff_) {
+    onHandedOff_();
+  }
+}
+
+} // namespace net
+} // namespace boostander
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace boostander {
+namespace net {
+
+// Native handles of listening sockets of a server, -1 if the listener is not running
+struct ListenerHandles {
+  int ws = -1;
+
+  int wss = -1;
+
+  int metrics = -1;
+
+  bool empty() const { return ws < 0 && wss < 0 && metrics < 0; }
+};
+
+/**
+ * Passes listening sockets over the Unix socket unixFd (SCM_RIGHTS), the receiving process gets
+ * its own descriptors of the same sockets. Returns false on errors. Blocking.
+ **/
+bool sendListenerHandles(int unixFd, const ListenerHandles& handles);
+
+// Receives handles of sendListenerHandles, empty on errors. Blocking.
+ListenerHandles receiveListenerHandles(int unixFd);
+
+/**
+ * Zero-downtime restart: the running server listens on a Unix socket at path,
+ * a new process started with the same path connects to it at startup (takeOver) and gets the
+ * listening sockets instead of binding its ports. Connections in the listen backlog are accepted
+ * by the new process, no client sees a refused connection.
+ * After the handoff the old process drains its sessions (see NetworkManager::drain)
+ * and the new process takes the path for the next restart.
+ * @note anyone allowed to connect to path may take the sockets over, keep it in a private
+ * directory.
+ **/
+class ListenerHandoff : public std::enable_shared_from_this<ListenerHandoff> {
+public:
+  // Handles of listening sockets of this process, called on an I/O thread
+  typedef std::function<ListenerHandles()> HandlesProvider;
+
+  // Called on an I/O thread after the sockets are handed off
+  typedef std::function<void()> HandedOffHandler;
+
+  ListenerHandoff(boost::asio::io_context& ioc, const std::string& path);
+
+  /**
+   * Connects to a running server at path and takes its listening sockets.
+   * Empty if no server listens at path (the first start).
+   **/
+  static ListenerHandles takeOver(const std::string& path);
+
+  /**
+   * Starts serving handoff requests at path, replaces a socket file left by the previous
+   * process. Serves one request, then stops. Returns false if path can not be bound.
+   **/
+  bool listen(HandlesProvider provider, HandedOffHandler onHandedOff);
+
+  // Stops serving handoff requests, the socket file is left for the next start
+  void stop();
+
+private:
+  void doAccept();
+
+  void onAccept(boost::beast::error_code ec);
+
+  const std::string path_;
+
+  boost::asio::local::stream_protocol::acceptor acceptor_;
+
+  boost::asio::local::stream_protocol::socket socket_;
+
+  // acceptor_ and socket_ are accessed within strand_
+  boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+
+  HandlesProvider provider_;
+
+  HandedOffHandler onHandedOff_;
+};
+
+} // namespace net
+} // namespace boostander
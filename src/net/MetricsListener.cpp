@@ -0,0 +1,226 @@
+#include "net/MetricsListener.hpp" // IWYU pragma: associated
+#include "log/Logger.hpp"
+#include "metrics/MemoryAccounting.hpp"
+#include "metrics/Metrics.hpp"
+#include "metrics/Tracing.hpp"
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/version.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+
+namespace boostander {
+namespace net {
+
+namespace beast = boost::beast;   // from <boost/beast.hpp>
+namespace http = beast::http;     // from <boost/beast/http.hpp>
+namespace net = boost::asio;      // from <boost/asio.hpp>
+using tcp = boost::asio::ip::tcp; // from <boost/asio/ip/tcp.hpp>
+
+namespace {
+
+// Connections without a complete request for this time are closed, scrapers reconnect
+constexpr std::chrono::seconds METRICS_READ_TIMEOUT{10};
+
+constexpr char METRICS_PATH[] = "/metrics";
+
+// Chrome trace JSON of the last traced messages, see metrics::Tracer
+constexpr char TRACE_PATH[] = "/trace";
+
+/**
+ * Reads HTTP requests and answers them until the peer closes the connection.
+ * Keep-alive is supported, Prometheus reuses connections between scrapes.
+ **/
+class MetricsHttpSession : public std::enable_shared_from_this<MetricsHttpSession> {
+public:
+  MetricsHttpSession(net::io_context& ioc, tcp::socket socket)
+      : socket_(std::move(socket)), strand_(ioc.get_executor()), timer_(ioc) {}
+
+  void run() {
+    net::dispatch(strand_, std::bind(&MetricsHttpSession::doRead, shared_from_this()));
+  }
+
+private:
+  void doRead() {
+    request_ = {};
+
+    timer_.expires_after(METRICS_READ_TIMEOUT);
+    timer_.async_wait(net::bind_executor(
+        strand_, [self = shared_from_this()](beast::error_code ec) {
+          // NOTE: the deadline may have moved while the handler was queued
+          if (ec != net::error::operation_aborted &&
+              self->timer_.expiry() <= std::chrono::steady_clock::now()) {
+            self->close();
+          }
+        }));
+
+    http::async_read(socket_, buffer_, request_,
+                     net::bind_executor(strand_, std::bind(&MetricsHttpSession::onRead,
+                                                           shared_from_this(),
+                                                           std::placeholders::_1)));
+  }
+
+  void onRead(beast::error_code ec) {
+    timer_.cancel();
+
+    if (ec) {
+      // end_of_stream: the peer closed the connection, operation_aborted: read timeout
+      if (ec != http::error::end_of_stream && ec != net::error::operation_aborted) {
+        LOG(debug) << "MetricsHttpSession read: " << ec.message();
+      }
+      return close();
+    }
+
+    makeResponse();
+
+    http::async_write(socket_, response_,
+                      net::bind_executor(strand_, std::bind(&MetricsHttpSession::onWrite,
+                                                            shared_from_this(),
+                                                            std::placeholders::_1)));
+  }
+
+  void onWrite(beast::error_code ec) {
+    if (ec || !response_.keep_alive()) {
+      return close();
+    }
+    doRead();
+  }
+
+  void makeResponse() {
+    response_ = {};
+    response_.version(request_.version());
+    response_.keep_alive(request_.keep_alive());
+    response_.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    response_.set(http::field::content_type, "text/plain; version=0.0.4; charset=utf-8");
+
+    // query string is ignored
+    const beast::string_view target = request_.target();
+    const beast::string_view path = target.substr(0, target.find('?'));
+
+    if (path != METRICS_PATH && path != TRACE_PATH) {
+      response_.result(http::status::not_found);
+      response_.body() = "Not found, metrics are served at " + std::string(METRICS_PATH) + "\n";
+    } else if (request_.method() != http::verb::get) {
+      response_.result(http::status::method_not_allowed);
+      response_.set(http::field::allow, "GET");
+    } else if (path == TRACE_PATH) {
+      std::ostringstream trace;
+      metrics::Tracer::instance().writeChromeTrace(trace);
+      response_.result(http::status::ok);
+      response_.set(http::field::content_type, "application/json");
+      response_.body() = trace.str();
+    } else {
+      response_.result(http::status::ok);
+      std::ostringstream body;
+      metrics::MetricsRegistry::instance().renderPrometheus(body);
+      metrics::renderMemoryMetrics(body);
+      response_.body() = body.str();
+    }
+    response_.prepare_payload();
+  }
+
+  void close() {
+    beast::error_code ec;
+    socket_.shutdown(tcp::socket::shutdown_both, ec);
+    socket_.close(ec);
+  }
+
+  tcp::socket socket_;
+
+  // socket_, timer_, request_ and response_ are accessed within strand_
+  net::strand<net::io_context::executor_type> strand_;
+
+  net::steady_timer timer_;
+
+  beast::flat_buffer buffer_;
+
+  http::request<http::string_body> request_;
+
+  http::response<http::string_body> response_;
+};
+
+} // namespace
+
+MetricsListener::MetricsListener(net::io_context& ioc, const tcp::endpoint& endpoint,
+                                 int listenHandle)
+    : ioc_(ioc), acceptor_(ioc), socket_(ioc), endpoint_(endpoint), strand_(ioc.get_executor()) {
+  beast::error_code ec;
+
+  if (listenHandle >= 0) {
+    // already listening in the process that handed it off
+    acceptor_.assign(endpoint_.protocol(), listenHandle, ec);
+  } else {
+    acceptor_.open(endpoint_.protocol(), ec);
+  }
+  if (!ec && listenHandle < 0) {
+    acceptor_.set_option(net::socket_base::reuse_address(true), ec);
+  }
+  if (!ec && listenHandle < 0) {
+    acceptor_.bind(endpoint_, ec);
+  }
+  if (!ec && listenHandle < 0) {
+    acceptor_.listen(net::socket_base::max_listen_connections, ec);
+  }
+  if (ec) {
+    LOG(WARNING) << "MetricsListener: can not listen on " << endpoint_ << ": " << ec.message();
+    acceptor_.close(ec);
+  }
+}
+
+void MetricsListener::run() {
+  if (!isAccepting()) {
+    LOG(INFO) << "MetricsListener::run: not accepting";
+    return;
+  }
+  LOG(INFO) << "Metrics are served at http://" << getLocalEndpoint() << METRICS_PATH;
+  net::dispatch(strand_, std::bind(&MetricsListener::doAccept, shared_from_this()));
+}
+
+void MetricsListener::stop() {
+  net::post(strand_, [self = shared_from_this()]() {
+    beast::error_code ec;
+    self->acceptor_.close(ec);
+  });
+}
+
+tcp::endpoint MetricsListener::getLocalEndpoint() const {
+  beast::error_code ec;
+  const tcp::endpoint localEndpoint = acceptor_.local_endpoint(ec);
+  if (ec) {
+    return endpoint_;
+  }
+  return localEndpoint;
+}
+
+int MetricsListener::getNativeHandle() {
+  return acceptor_.is_open() ? static_cast<int>(acceptor_.native_handle()) : -1;
+}
+
+void MetricsListener::doAccept() {
+  acceptor_.async_accept(socket_, net::bind_executor(strand_, std::bind(&MetricsListener::onAccept,
+                                                                        shared_from_this(),
+                                                                        std::placeholders::_1)));
+}
+
+void MetricsListener::onAccept(beast::error_code ec) {
+  if (ec == net::error::operation_aborted || !acceptor_.is_open()) {
+    return;
+  }
+
+  if (ec) {
+    LOG_RATE_LIMITED(WARNING, std::chrono::seconds(1))
+        << "MetricsListener accept: " << ec.message();
+  } else {
+    std::make_shared<MetricsHttpSession>(ioc_, std::move(socket_))->run();
+  }
+
+  doAccept();
+}
+
+} // namespace net
+} // namespace boostander
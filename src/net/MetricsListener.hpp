@@ -0,0 +1,58 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+#include <memory>
+
+namespace boostander {
+namespace net {
+
+/**
+ * Serves metrics::MetricsRegistry over HTTP in Prometheus text format (GET /metrics)
+ * and traces of metrics::Tracer in Chrome trace format (GET /trace).
+ * Runs on the io_context of the WebSocket server, a scrape renders all metrics
+ * on one I/O thread, so scrape intervals of seconds are expected.
+ **/
+class MetricsListener : public std::enable_shared_from_this<MetricsListener> {
+public:
+  // listenHandle: listening socket taken over from another process, -1 to bind endpoint
+  MetricsListener(boost::asio::io_context& ioc, const boost::asio::ip::tcp::endpoint& endpoint,
+                  int listenHandle = -1);
+
+  // Start accepting incoming connections
+  void run();
+
+  // Stop accepting incoming connections, open connections are served until closed
+  void stop();
+
+  bool isAccepting() const { return acceptor_.is_open(); }
+
+  /**
+   * @brief endpoint the acceptor is bound to (resolves port 0 to the actual port)
+   */
+  boost::asio::ip::tcp::endpoint getLocalEndpoint() const;
+
+  // Native handle of the listening socket to hand off, -1 if not accepting
+  int getNativeHandle();
+
+private:
+  void doAccept();
+
+  void onAccept(boost::beast::error_code ec);
+
+  boost::asio::io_context& ioc_;
+
+  boost::asio::ip::tcp::acceptor acceptor_;
+
+  boost::asio::ip::tcp::socket socket_;
+
+  boost::asio::ip::tcp::endpoint endpoint_;
+
+  // acceptor_ and socket_ are accessed within strand_
+  boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+};
+
+} // namespace net
+} // namespace boostander
@@ -1,6 +1,8 @@
 #include "net/NetworkManager.hpp" // IWYU pragma: associated
 #include "config/ServerConfig.hpp"
 #include "log/Logger.hpp"
+#include "net/ListenerHandoff.hpp"
+#include "net/MetricsListener.hpp"
 #include "net/websockets/WsListener.hpp"
 #include "net/websockets/WsServer.hpp"
 #include <boost/asio.hpp>
@@ -11,6 +13,8 @@
 #include <filesystem>
 #include <string>
 #include <thread>
+#include <unistd.h>
+#include <utility>
 
 namespace boostander {
 namespace net {
@@ -21,8 +25,23 @@ namespace websocket = beast::websocket; // from <boost/beast/websocket.hpp>
 namespace net = boost::asio;            // from <boost/asio.hpp>
 using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
 
+namespace {
+
+// Closes sockets taken over from the previous process that this configuration does not listen on
+void closeUnusedHandles(const ListenerHandles& takenOver, const ListenerHandles& used) {
+  for (const int handle : {takenOver.ws, takenOver.wss, takenOver.metrics}) {
+    if (handle >= 0 && handle != used.ws && handle != used.wss && handle != used.metrics) {
+      ::close(handle);
+    }
+  }
+}
+
+} // namespace
+
 NetworkManager::NetworkManager() {}
 
+NetworkManager::~NetworkManager() {}
+
 std::shared_ptr<WSServer> NetworkManager::getWS() const { return wsServer_; }
 
 void NetworkManager::handleIncomingMessages() {
@@ -32,17 +51,99 @@ void NetworkManager::handleIncomingMessages() {
   wsServer_->handleIncomingMessages();
 }
 
-void NetworkManager::run(const boostander::config::ServerConfig& serverConfig) {
+void NetworkManager::run(const boostander::config::ServerConfig& serverConfig,
+                         std::function<void()> onStopRequested) {
+  onStopRequested_ = std::move(onStopRequested);
+
+  // NOTE: before the listeners, ports are bound by the running server
+  ListenerHandles takenOver;
+  if (!serverConfig.handoffSocket_.empty()) {
+    takenOver = ListenerHandoff::takeOver(serverConfig.handoffSocket_);
+  }
+
   // NOTE: no 'this' in constructor
   wsServer_ = std::make_shared<WSServer>(this, serverConfig);
 
-  wsServer_->runIocWsListener(serverConfig);
+  wsServer_->runIocWsListener(serverConfig, takenOver);
+  closeUnusedHandles(takenOver, wsServer_->getListenerHandles());
+
+  if (!serverConfig.handoffSocket_.empty()) {
+    listenerHandoff_ =
+        std::make_shared<ListenerHandoff>(wsServer_->ioc_, serverConfig.handoffSocket_);
+    const std::weak_ptr<WSServer> weakServer = wsServer_;
+    listenerHandoff_->listen(
+        [weakServer]() {
+          const auto server = weakServer.lock();
+          return server ? server->getListenerHandles() : ListenerHandles{};
+        },
+        [this]() { requestStop(); });
+  }
+
+  if (onStopRequested_) {
+    wsServer_->handleSignals([this]() { requestStop(); });
+  }
 
   wsServer_->runThreads(serverConfig);
 }
 
+void NetworkManager::requestStop() {
+  if (isStopRequested_.exchange(true)) {
+    LOG(WARNING) << "NetworkManager: stop is requested again, draining is cancelled";
+    isDrainCancelled_ = true;
+    return;
+  }
+  if (onStopRequested_) {
+    onStopRequested_();
+  }
+}
+
+bool NetworkManager::drain(std::chrono::milliseconds timeout) {
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  const std::chrono::milliseconds tickPeriod = wsServer_->getConfig().tickPeriod_;
+
+  // New connections go to the backlog of the next process or are refused
+  wsServer_->stopListeners();
+  if (listenerHandoff_) {
+    listenerHandoff_->stop();
+  }
+
+  LOG(WARNING) << "NetworkManager: draining " << wsServer_->getSessionsCount() << " sessions";
+
+  // Replies to messages received so far are queued before the close frames,
+  // heavy messages are processed on their own threads
+  wsServer_->handleIncomingMessages();
+  while (wsServer_->getHeavyQueueSize() && std::chrono::steady_clock::now() < deadline &&
+         !isDrainCancelled_) {
+    std::this_thread::sleep_for(tickPeriod);
+    wsServer_->handleIncomingMessages();
+  }
+  wsServer_->closeSessionsGracefully();
+
+  while (wsServer_->getSessionsCount() && std::chrono::steady_clock::now() < deadline &&
+         !isDrainCancelled_) {
+    std::this_thread::sleep_for(tickPeriod);
+    // messages that arrived before the close frames, replies to them are dropped
+    wsServer_->handleIncomingMessages();
+  }
+
+  const std::size_t openSessions = wsServer_->getSessionsCount();
+  if (openSessions) {
+    LOG(WARNING) << "NetworkManager: " << openSessions << " sessions are not closed by the drain";
+  } else {
+    LOG(WARNING) << "NetworkManager: all sessions are drained";
+  }
+  return openSessions == 0;
+}
+
 void NetworkManager::finish() {
-  wsServer_->getWsListener()->stop();
+  wsServer_->stopListeners();
+  if (listenerHandoff_) {
+    listenerHandoff_->stop();
+  }
+
+  // Sessions keep reads pending, the I/O threads would never run out of work
+  wsServer_->closeSessions();
+
   wsServer_->finishThreads();
 }
 
@@ -1,5 +1,8 @@
 ﻿#pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
 
 namespace boostander {
@@ -17,21 +20,53 @@ namespace net {
 constexpr unsigned long UINT32_FIELD_MAX_LEN = 10;
 
 class WSServer;
+class ListenerHandoff;
 
 class NetworkManager {
 public:
   NetworkManager();
 
+  ~NetworkManager();
+
   void handleIncomingMessages();
 
-  void run(const boostander::config::ServerConfig& serverConfig);
+  /**
+   * Starts listeners and I/O threads. With a handoff socket in serverConfig the listening sockets
+   * are taken over from a running server, and are handed off to the next one later.
+   * @param onStopRequested called on an I/O thread on SIGINT or SIGTERM and after the handoff,
+   * the owner of the tick loop stops it and calls drain(). Signals are not handled if empty.
+   **/
+  void run(const boostander::config::ServerConfig& serverConfig,
+           std::function<void()> onStopRequested = nullptr);
+
+  /**
+   * Graceful shutdown, called on the tick thread instead of the tick loop:
+   * stops accepting, dispatches queued messages, closes sessions with close frames after their
+   * send queues are flushed and keeps dispatching until all sessions are closed.
+   * Returns false if some sessions are open after timeout (or a second signal), finish()
+   * closes them.
+   **/
+  bool drain(std::chrono::milliseconds timeout);
 
+  // Stops listeners, closes sessions and joins the I/O threads
   void finish();
 
   std::shared_ptr<WSServer> getWS() const;
 
 private:
+  // Called by signals and the handoff on an I/O thread
+  void requestStop();
+
   std::shared_ptr<WSServer> wsServer_;
+
+  std::shared_ptr<ListenerHandoff> listenerHandoff_;
+
+  std::function<void()> onStopRequested_;
+
+  std::atomic<bool> isStopRequested_{false};
+
+  // Stop is requested again while draining, drain() gives up
+  std::atomic<bool> isDrainCancelled_{false};
 };
 
 } // namespace net
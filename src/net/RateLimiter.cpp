@@ -0,0 +1,79 @@
+#include "net/RateLimiter.hpp" // IWYU pragma: associated
+#include <algorithm>
+
+namespace boostander {
+namespace net {
+
+TokenBucket::TokenBucket(double rate, double capacity, Clock::time_point now)
+    : rate_(rate), capacity_(capacity), tokens_(capacity), lastRefill_(now) {}
+
+bool TokenBucket::isAvailable(Clock::time_point now) {
+  if (rate_ <= 0.0) {
+    return true;
+  }
+  if (now > lastRefill_) {
+    const std::chrono::duration<double> elapsed = now - lastRefill_;
+    tokens_ = std::min(capacity_, tokens_ + elapsed.count() * rate_);
+    lastRefill_ = now;
+  }
+  return tokens_ > 0.0;
+}
+
+void TokenBucket::take(double tokens) {
+  if (rate_ > 0.0) {
+    tokens_ -= tokens;
+  }
+}
+
+SessionRateLimiter::SessionRateLimiter(const std::map<char, config::RateLimit>& limits,
+                                       std::chrono::milliseconds burst)
+    : limits_(limits), burstSec_(std::chrono::duration<double>(burst).count()) {}
+
+bool SessionRateLimiter::tryAcquire(char opcode, std::size_t bytes, Clock::time_point now) {
+  Buckets* buckets = findBuckets(opcode, now);
+  if (!buckets) {
+    return true;
+  }
+  // NOTE: both are refilled, so the time without messages counts for both
+  const bool isMessageAvailable = buckets->messages.isAvailable(now);
+  const bool isBytesAvailable = buckets->bytes.isAvailable(now);
+  if (!isMessageAvailable || !isBytesAvailable) {
+    return false;
+  }
+  buckets->messages.take(1.0);
+  buckets->bytes.take(static_cast<double>(bytes));
+  return true;
+}
+
+void SessionRateLimiter::charge(char opcode, std::size_t bytes, Clock::time_point now) {
+  if (Buckets* buckets = findBuckets(opcode, now)) {
+    buckets->bytes.isAvailable(now);
+    buckets->bytes.take(static_cast<double>(bytes));
+  }
+}
+
+SessionRateLimiter::Buckets* SessionRateLimiter::findBuckets(char opcode, Clock::time_point now) {
+  for (auto& buckets : buckets_) {
+    if (buckets.first == opcode) {
+      return &buckets.second;
+    }
+  }
+
+  auto found = limits_.find(opcode);
+  if (found == limits_.end()) {
+    found = limits_.find(config::ANY_OPCODE);
+    if (found == limits_.end()) {
+      return nullptr;
+    }
+  }
+  const config::RateLimit& limit = found->second;
+  // at least one message passes in a burst, whatever the rate
+  buckets_.emplace_back(
+      opcode, Buckets{TokenBucket(limit.messagesPerSec,
+                                  std::max(1.0, limit.messagesPerSec * burstSec_), now),
+                      TokenBucket(limit.bytesPerSec, limit.bytesPerSec * burstSec_, now)});
+  return &buckets_.back().second;
+}
+
+} // namespace net
+} // namespace boostander
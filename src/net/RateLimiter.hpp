@@ -0,0 +1,79 @@
+#pragma once
+
+#include "config/ServerConfig.hpp"
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace boostander {
+namespace net {
+
+/**
+ * Tokens are added at rate per second up to capacity. A message passes while the bucket is not
+ * empty and takes all its tokens, the bucket may go into debt: a message larger than the
+ * capacity passes, the next ones wait until the debt is repaid.
+ * Rate 0 is unlimited. Not thread-safe.
+ **/
+class TokenBucket {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  // Full bucket
+  TokenBucket(double rate, double capacity, Clock::time_point now);
+
+  // Refills the bucket by the time since the previous call
+  bool isAvailable(Clock::time_point now);
+
+  void take(double tokens);
+
+private:
+  const double rate_;
+
+  const double capacity_;
+
+  double tokens_;
+
+  Clock::time_point lastRefill_;
+};
+
+/**
+ * Rate limits of received messages of one session, see ServerConfig::rateLimits_.
+ * Every opcode has its own buckets of messages and bytes, created by its first message.
+ * Runs within the strand of the session.
+ **/
+class SessionRateLimiter {
+public:
+  typedef TokenBucket::Clock Clock;
+
+  // limits must outlive the limiter
+  SessionRateLimiter(const std::map<char, config::RateLimit>& limits,
+                     std::chrono::milliseconds burst);
+
+  // Takes a message of opcode with its size, false if the session exceeds the limits of opcode
+  bool tryAcquire(char opcode, std::size_t bytes, Clock::time_point now);
+
+  // Takes bytes of an acquired message that are read later (streamed fragments)
+  void charge(char opcode, std::size_t bytes, Clock::time_point now);
+
+private:
+  struct Buckets {
+    TokenBucket messages;
+
+    TokenBucket bytes;
+  };
+
+  // nullptr if opcode is not limited
+  Buckets* findBuckets(char opcode, Clock::time_point now);
+
+  const std::map<char, config::RateLimit>& limits_;
+
+  const double burstSec_;
+
+  // few opcodes per session, a vector is smaller and faster than a map
+  std::vector<std::pair<char, Buckets>> buckets_;
+};
+
+} // namespace net
+} // namespace boostander
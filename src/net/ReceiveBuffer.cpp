@@ -0,0 +1,41 @@
+#include "net/ReceiveBuffer.hpp" // IWYU pragma: associated
+#include <algorithm>
+
+namespace boostander {
+namespace net {
+
+ReceiveBuffer::ReceiveBuffer(std::size_t maxCapacity)
+    : maxCapacity_(std::max(maxCapacity, MIN_CAPACITY)) {}
+
+void ReceiveBuffer::consumeAll() {
+  peakSize_ = std::max(peakSize_, size());
+  consume(size());
+
+  if (capacity() > maxCapacity_) {
+    // a spike, the next big message grows the buffer again
+    reallocate(0);
+    return;
+  }
+
+  if (++messagesCount_ < SHRINK_PERIOD) {
+    return;
+  }
+  if (capacity() > MIN_CAPACITY && peakSize_ <= capacity() / 4) {
+    reallocate(std::max(peakSize_, MIN_CAPACITY));
+  }
+  peakSize_ = 0;
+  messagesCount_ = 0;
+}
+
+void ReceiveBuffer::reallocate(std::size_t newCapacity) {
+  // the buffer is empty, shrink_to_fit frees all of its memory
+  shrink_to_fit();
+  if (newCapacity) {
+    reserve(newCapacity);
+  }
+  peakSize_ = 0;
+  messagesCount_ = 0;
+}
+
+} // namespace net
+} // namespace boostander
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <boost/beast/core/flat_buffer.hpp>
+#include <cstddef>
+
+namespace boostander {
+namespace net {
+
+/**
+ * Contiguous receive buffer of a session that keeps its memory across messages:
+ * steady-state reads of similar messages do not allocate, unlike multi_buffer that allocates
+ * chunks for every message and frees them again.
+ * Capacity adapts to recent messages (see consumeAll), so a spike does not pin memory:
+ * - up to MIN_CAPACITY is always kept, it fits a TCP frame that websocket reads ask for;
+ * - over maxCapacity (e.g. a single huge upload) is released right after the message;
+ * - in between it is shrunk to the largest of the last SHRINK_PERIOD messages
+ *   if they used a quarter of it or less.
+ * Used as a beast DynamicBuffer by websocket reads. Not thread-safe, used within the strand.
+ **/
+class ReceiveBuffer : public boost::beast::flat_buffer {
+public:
+  static constexpr std::size_t MIN_CAPACITY = 4 * 1024;
+
+  static constexpr std::size_t SHRINK_PERIOD = 16;
+
+  explicit ReceiveBuffer(std::size_t maxCapacity);
+
+  /**
+   * Consumes all bytes of a handled message (or fragment of a streamed message) and adapts
+   * capacity. Must not be called while a read into the buffer is in progress.
+   **/
+  void consumeAll();
+
+  std::size_t getMaxCapacity() const { return maxCapacity_; }
+
+private:
+  // Frees the memory and reserves newCapacity (0 to keep none)
+  void reallocate(std::size_t newCapacity);
+
+  const std::size_t maxCapacity_;
+
+  // Largest message since the last shrink check
+  std::size_t peakSize_ = 0;
+
+  std::size_t messagesCount_ = 0;
+};
+
+} // namespace net
+} // namespace boostander
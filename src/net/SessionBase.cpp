@@ -30,20 +30,16 @@ std::shared_ptr<algo::DispatchQueue> SessionBase::getReceivedMessages() const {
   return receivedMessagesQueue_;
 }
 
+// NOTE: sessions may create the queue on the first received message
 bool SessionBase::hasReceivedMessages() const {
-  if (!receivedMessagesQueue_ && receivedMessagesQueue_.get()) {
-    LOG(WARNING) << "WsSession::hasReceivedMessages invalid receivedMessagesQueue_";
-    return true;
-  }
-  return receivedMessagesQueue_->isEmpty();
+  const auto queue = getReceivedMessages();
+  return queue && queue->size() != 0;
 }
 
 void SessionBase::clearReceivedMessages() const {
-  if (!receivedMessagesQueue_ && receivedMessagesQueue_.get()) {
-    LOG(WARNING) << "WsSession::hasReceivedMessages invalid receivedMessagesQueue_";
-    return;
+  if (const auto queue = getReceivedMessages()) {
+    queue->clear();
   }
-  receivedMessagesQueue_->clear();
 }
 
 } // namespace net
@@ -64,7 +64,10 @@ public:
 
   virtual void unregisterSession(const std::string& id) = 0;
 
-  virtual callbacksType getOperationCallbacks() const { return operationCallbacks_; }
+  virtual const callbacksType& getOperationCallbacks() const { return operationCallbacks_; }
+
+  // NOTE: callbacks are read without locks, add them before sessions receive messages
+  callbacksType& getOperationCallbacks() { return operationCallbacks_; }
 
   virtual void runThreads(const boostander::config::ServerConfig& serverConfig) = 0;
 
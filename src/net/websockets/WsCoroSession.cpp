@@ -0,0 +1,235 @@
+#include "net/websockets/WsCoroSession.hpp" // IWYU pragma: associated
+#include "algo/DispatchQueue.hpp"
+#include "log/Logger.hpp"
+#include "metrics/MemoryAccounting.hpp"
+#include "metrics/Tracing.hpp"
+#include "net/HandlerAllocator.hpp"
+#include "net/NetworkManager.hpp"
+#include "net/websockets/WsMetrics.hpp"
+#include "net/websockets/WsServer.hpp"
+#include <boost/asio.hpp>
+#include <boost/asio/coroutine.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace boostander {
+namespace net {
+
+namespace beast = boost::beast;         // from <boost/beast.hpp>
+namespace websocket = beast::websocket; // from <boost/beast/websocket.hpp>
+namespace net = boost::asio;            // from <boost/asio.hpp>
+using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
+namespace ssl = boost::asio::ssl;       // from <boost/asio/ssl.hpp>
+
+using namespace std::chrono_literals;
+
+/**
+ * Accepts the websocket handshake and then reads messages until the session is closed.
+ * Each asynchronous operation receives the moved coroutine as its completion handler.
+ **/
+class WsCoroSession::ReadLoop : public net::coroutine {
+public:
+  explicit ReadLoop(std::shared_ptr<WsCoroSession> self) : self_(std::move(self)) {}
+
+  void operator()(beast::error_code ec = {}, std::size_t bytes_transferred = 0);
+
+private:
+  std::shared_ptr<WsCoroSession> self_;
+};
+
+/**
+ * Writes queued messages one by one until the send queue is empty.
+ **/
+class WsCoroSession::WriteLoop : public net::coroutine {
+public:
+  explicit WriteLoop(std::shared_ptr<WsCoroSession> self) : self_(std::move(self)) {}
+
+  void operator()(beast::error_code ec = {}, std::size_t bytes_transferred = 0);
+
+private:
+  std::shared_ptr<WsCoroSession> self_;
+};
+
+#include <boost/asio/yield.hpp>
+
+void WsCoroSession::ReadLoop::operator()(beast::error_code ec, std::size_t bytes_transferred) {
+  // NOTE: the session outlives the handler that is moved into the next operation
+  WsCoroSession& sess = *self_;
+
+  reenter(*this) {
+    if (sess.isTls()) {
+      yield sess.asyncTlsHandshake(makeCustomAllocHandler(
+          sess.readMemory_, net::bind_executor(sess.strand_, std::move(*this))));
+
+      if (ec)
+        return sess.on_session_fail(ec, "tls handshake");
+    }
+
+    // Accept the websocket handshake
+    yield sess.visitStream([this, &sess](auto& ws) {
+      ws.async_accept(makeCustomAllocHandler(
+          sess.readMemory_, net::bind_executor(sess.strand_, std::move(*this))));
+    });
+
+    // Happens when the timer closes the socket
+    if (ec == net::error::operation_aborted) {
+      LOG_RATE_LIMITED(WARNING, 1s) << "WsCoroSession accept ec:" << ec.message();
+      return;
+    }
+
+    if (ec)
+      return sess.on_session_fail(ec, "accept");
+
+    sess.isFullyCreated_ = true;
+
+    for (;;) {
+      // Read a message into our buffer
+      yield sess.asyncReadMessage(makeCustomAllocHandler(
+          sess.readMemory_, net::bind_executor(sess.strand_, std::move(*this))));
+
+      // Happens when the timer closes the socket
+      if (ec == net::error::operation_aborted) {
+        LOG_RATE_LIMITED(WARNING, 1s) << "WsCoroSession read: net::error::operation_aborted";
+        return;
+      }
+
+      // This indicates that the session was closed
+      if (ec == websocket::error::closed) {
+        LOG_RATE_LIMITED(WARNING, 1s) << "WsCoroSession read ec:" << ec.message();
+        return;
+      }
+
+      if (ec)
+        return sess.on_session_fail(ec, "read");
+
+      // Note that there is activity
+      sess.onRemoteMessage();
+
+      if (sess.isStreamingReads_) {
+        // bytes are counted by fragments, a whole message may take several reads
+        WsMetrics::instance().receivedBytes.inc(bytes_transferred);
+        if (sess.consumeFragment()) {
+          // the fragment is consumed or the message is not complete yet
+          continue;
+        }
+      }
+
+      if (sess.recievedBuffer_.size() > sess.maxMessageSize_) {
+        LOG_RATE_LIMITED(WARNING, 1s) << "WsCoroSession read: Too big messageBuffer of size "
+                                      << sess.recievedBuffer_.size();
+      } else if (sess.recievedBuffer_.size()) {
+        WsMetrics::instance().messagesReceived.inc();
+        if (!sess.isStreamingReads_) {
+          WsMetrics::instance().receivedBytes.inc(bytes_transferred);
+        }
+        // the opcode is the first byte, a throttled message is never copied
+        const char opcode =
+            *static_cast<const char*>(beast::buffers_front(sess.recievedBuffer_.data()).data());
+        if (!sess.throttle(opcode, sess.recievedBuffer_.size(), std::chrono::steady_clock::now())) {
+          metrics::ScopedMemoryTag memoryTag(metrics::MemoryTag::RECEIVE_QUEUE);
+          sess.handleIncomingData(std::make_shared<std::string>(
+              beast::buffers_to_string(sess.recievedBuffer_.data())));
+        }
+      }
+
+      // Clear the buffer, its memory is kept for the next message
+      sess.recievedBuffer_.consumeAll();
+
+      if (!sess.isOpen()) {
+        LOG_RATE_LIMITED(WARNING, 1s) << "WsCoroSession read: !ws_.is_open()";
+        return;
+      }
+    }
+  }
+}
+
+void WsCoroSession::WriteLoop::operator()(beast::error_code ec, std::size_t bytes_transferred) {
+  // NOTE: the session outlives the handler that is moved into the next operation
+  WsCoroSession& sess = *self_;
+
+  reenter(*this) {
+    while (!sess.sendQueue_.empty()) {
+      if (sess.sendQueue_.front().trace) {
+        sess.sendQueue_.front().trace->stamp(metrics::TraceStage::WRITE_STARTED);
+      }
+
+      yield sess.visitStream([this, &sess](auto& ws) {
+        // This controls whether or not outgoing message opcodes are set to binary or text.
+        ws.text(true);
+        ws.async_write(net::buffer(*sess.sendQueue_.front().data),
+                       makeCustomAllocHandler(sess.writeMemory_,
+                                              net::bind_executor(sess.strand_, std::move(*this))));
+      });
+
+      // Happens when the timer closes the socket
+      if (ec == net::error::operation_aborted) {
+        LOG_RATE_LIMITED(WARNING, 1s)
+            << "WsCoroSession write: net::error::operation_aborted: " << ec.message();
+        return;
+      }
+
+      if (ec)
+        return sess.on_session_fail(ec, "write");
+
+      WsMetrics::instance().messagesSent.inc();
+      WsMetrics::instance().sentBytes.inc(bytes_transferred);
+
+      if (sess.sendQueue_.front().trace) {
+        sess.sendQueue_.front().trace->stamp(metrics::TraceStage::WRITTEN);
+      }
+
+      // Remove the already written string from the queue
+      sess.sendQueue_.erase(sess.sendQueue_.begin());
+      WsMetrics::instance().sendQueueMessages.sub();
+      sess.pendingSends_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    sess.isSendBusy_ = false;
+    sess.closeIfFlushed();
+  }
+}
+
+#include <boost/asio/unyield.hpp>
+
+WsCoroSession::WsCoroSession(tcp::socket socket, NetworkManager* nm, const std::string& id)
+    : WsSession(std::move(socket), nm, id) {}
+
+WsCoroSession::WsCoroSession(tcp::socket socket, ssl::context& sslContext, NetworkManager* nm,
+                             const std::string& id)
+    : WsSession(std::move(socket), sslContext, nm, id) {}
+
+WsCoroSession::~WsCoroSession() {}
+
+std::shared_ptr<WsCoroSession> WsCoroSession::sharedCoroFromThis() {
+  return std::static_pointer_cast<WsCoroSession>(shared_from_this());
+}
+
+// Start the asynchronous operation
+void WsCoroSession::runAsServer() {
+  LOG(debug) << "WS coroutine session run as server";
+
+  // Set the control callback. This will be called
+  // on every incoming ping, pong, and close frame.
+  visitStream([this](auto& ws) {
+    ws.control_callback(boost::asio::bind_executor(
+        strand_, std::bind(&WsSession::on_control_callback, this, std::placeholders::_1,
+                           std::placeholders::_2)));
+  });
+
+  // Set the deadlines and add the session to the timer wheel.
+  onRemoteMessage();
+  scheduleTimer();
+
+  ReadLoop{sharedCoroFromThis()}();
+}
+
+// Starts the write loop, it runs until sendQueue_ is empty
+void WsCoroSession::writeQueued() { WriteLoop{sharedCoroFromThis()}(); }
+
+} // namespace net
+} // namespace boostander
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "net/websockets/WsSession.hpp"
+#include <boost/asio.hpp>
+#include <boost/asio/coroutine.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace boostander {
+namespace net {
+
+class NetworkManager;
+
+/**
+ * Server-side WebSocket session driven by stackless coroutines instead of
+ * std::bind completion handlers.
+ * The accept -> read loop and the write loop are each a single small handler object
+ * that is moved from one asynchronous operation to the next, so no bound handler state
+ * is created per operation and the handler memory is recycled by asio.
+ * @note C++20 co_await needs a newer toolchain than this project targets (C++17, Boost 1.69),
+ * boost::asio::coroutine gives the same control flow without it.
+ * @see https://www.boost.org/doc/libs/1_69_0/doc/html/boost_asio/reference/coroutine.html
+ **/
+class WsCoroSession : public WsSession {
+public:
+  // Take ownership of the socket
+  explicit WsCoroSession(boost::asio::ip::tcp::socket socket, NetworkManager* nm,
+                         const std::string& id);
+
+  // Take ownership of the socket, the session runs over TLS (wss://)
+  explicit WsCoroSession(boost::asio::ip::tcp::socket socket,
+                         boost::asio::ssl::context& sslContext, NetworkManager* nm,
+                         const std::string& id);
+
+  ~WsCoroSession() override;
+
+  // Start the asynchronous operation
+  void runAsServer() override;
+
+protected:
+  void writeQueued() override;
+
+private:
+  class ReadLoop;
+
+  class WriteLoop;
+
+  std::shared_ptr<WsCoroSession> sharedCoroFromThis();
+};
+
+} // namespace net
+} // namespace boostander
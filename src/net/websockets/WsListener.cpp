@@ -1,7 +1,12 @@
 #include "net/websockets/WsListener.hpp" // IWYU pragma: associated
 #include "algo/StringUtils.hpp"
 #include "log/Logger.hpp"
+#include "metrics/MemoryAccounting.hpp"
+#include "net/AdmissionControl.hpp"
+#include "net/BlockPool.hpp"
 #include "net/NetworkManager.hpp"
+#include "net/websockets/WsCoroSession.hpp"
+#include "net/websockets/WsMetrics.hpp"
 #include "net/websockets/WsServer.hpp"
 #include "net/websockets/WsSession.hpp"
 #include <algorithm>
@@ -9,10 +14,13 @@
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/websocket.hpp>
+#include <chrono>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
+#include <utility>
 
 namespace boostander {
 namespace net {
@@ -22,18 +30,50 @@ namespace http = beast::http;           // from <boost/beast/http.hpp>
 namespace websocket = beast::websocket; // from <boost/beast/websocket.hpp>
 namespace net = boost::asio;            // from <boost/asio.hpp>
 using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
+namespace ssl = boost::asio::ssl;       // from <boost/asio/ssl.hpp>
+
+// NOTE: warnings of the accept path are rate limited, connection storms must not flood the logs
+using namespace std::chrono_literals;
 
 namespace {
 
 // TODO: prevent collision? respond ERROR to client if collided?
 static std::string nextWsSessionId() { return boostander::algo::genGuid(); }
 
+// shared_ptr control block stored in the same block as the session (refcounts, allocator)
+constexpr std::size_t SESSION_CONTROL_BLOCK_SIZE = 64;
+
+constexpr std::size_t SESSION_BLOCK_SIZE =
+    std::max(sizeof(WsSession), sizeof(WsCoroSession)) + SESSION_CONTROL_BLOCK_SIZE;
+
+constexpr std::size_t SESSIONS_PER_SLAB = 64;
+
+/**
+ * Session and its control block in one cache line aligned block of the session pool.
+ * NOTE: PoolAllocator fails to compile if the control block with the session does not fit.
+ **/
+template <typename Session, typename... Args>
+std::shared_ptr<Session> makeSession(Args&&... args) {
+  return std::allocate_shared<Session>(
+      PoolAllocator<Session, SESSION_BLOCK_SIZE>(WsListener::getSessionPool()),
+      std::forward<Args>(args)...);
+}
+
 } // namespace
 
+BlockPool& WsListener::getSessionPool() {
+  // NOTE: leaked, handlers holding sessions may run after static destructors
+  static BlockPool* const pool = new BlockPool(SESSION_BLOCK_SIZE, SESSIONS_PER_SLAB);
+  return *pool;
+}
+
 WsListener::WsListener(boost::asio::io_context& ioc, const boost::asio::ip::tcp::endpoint& endpoint,
-                       std::shared_ptr<std::string const> doc_root, NetworkManager* nm)
+                       std::shared_ptr<std::string const> doc_root, NetworkManager* nm,
+                       bool useCoroSessions, ssl::context* sslContext,
+                       std::size_t maxConcurrentHandshakes, int listenHandle)
     : socket_(ioc), acceptor_(ioc), doc_root_(doc_root), nm_(nm), endpoint_(endpoint),
-      strand_(ioc.get_executor()) {
+      listenHandle_(listenHandle), strand_(ioc.get_executor()), useCoroSessions_(useCoroSessions), sslContext_(sslContext),
+      maxConcurrentHandshakes_(maxConcurrentHandshakes) {
   configureAcceptor();
 }
 
@@ -45,6 +85,15 @@ void WsListener::on_WsListener_fail(beast::error_code ec, char const* what) {
 void WsListener::configureAcceptor() {
   beast::error_code ec;
 
+  if (listenHandle_ >= 0) {
+    // Already bound and listening in the process that handed it off
+    acceptor_.assign(endpoint_.protocol(), listenHandle_, ec);
+    if (ec) {
+      on_WsListener_fail(ec, "assign");
+    }
+    return;
+  }
+
   // Open the acceptor
   acceptor_.open(endpoint_.protocol(), ec);
   if (ec) {
@@ -123,6 +172,20 @@ void WsListener::stop() {
                     }));
 }
 
+tcp::endpoint WsListener::getLocalEndpoint() const {
+  beast::error_code ec;
+  const tcp::endpoint localEndpoint = acceptor_.local_endpoint(ec);
+  if (ec) {
+    LOG(WARNING) << "WsListener::getLocalEndpoint: " << ec.message();
+    return endpoint_;
+  }
+  return localEndpoint;
+}
+
+int WsListener::getNativeHandle() {
+  return acceptor_.is_open() ? static_cast<int>(acceptor_.native_handle()) : -1;
+}
+
 void WsListener::do_accept() {
   if (needClose_) {
     LOG(WARNING) << "WsListener::do_accept: need close";
@@ -138,7 +201,10 @@ std::shared_ptr<WsSession> WsListener::addClientSession(const std::string& newSe
     LOG(INFO) << "WsListener::addClientSession: need close";
     return nullptr;
   }
-  auto newWsSession = std::make_shared<WsSession>(std::move(socket_), nm_, newSessId);
+  metrics::ScopedMemoryTag memoryTag(metrics::MemoryTag::SESSION);
+  // NOTE: socket_ is used by the acceptor, client sessions get their own
+  auto newWsSession =
+      makeSession<WsSession>(tcp::socket(nm_->getWS()->ioc_), nm_, newSessId);
   nm_->getWS()->addSession(newSessId, newWsSession);
   return newWsSession;
 }
@@ -155,17 +221,98 @@ void WsListener::on_accept(beast::error_code ec) {
 
   if (ec) {
     on_WsListener_fail(ec, "accept");
-  } else {
+  } else if (const auto remoteAddress = admitConnection()) {
     // Create the session and run it
+    metrics::ScopedMemoryTag memoryTag(metrics::MemoryTag::SESSION);
     const auto newSessId = nextWsSessionId();
-    auto newWsSession = std::make_shared<WsSession>(std::move(socket_), nm_, newSessId);
+    std::shared_ptr<WsSession> newWsSession;
+    // Messages and TLS handshake flights are written as soon as they are ready,
+    // Nagle would hold a small write (or the tail of a large one) until the peer ACKs
+    beast::error_code optionEc;
+    socket_.set_option(tcp::no_delay(true), optionEc);
+    if (sslContext_) {
+      activeHandshakes_++;
+      newWsSession =
+          useCoroSessions_
+              ? makeSession<WsCoroSession>(std::move(socket_), *sslContext_, nm_, newSessId)
+              : makeSession<WsSession>(std::move(socket_), *sslContext_, nm_, newSessId);
+    } else {
+      newWsSession = useCoroSessions_
+                         ? makeSession<WsCoroSession>(std::move(socket_), nm_, newSessId)
+                         : makeSession<WsSession>(std::move(socket_), nm_, newSessId);
+    }
+    newWsSession->setAdmittedAddress(*remoteAddress);
     nm_->getWS()->addSession(newSessId, newWsSession);
     newWsSession->runAsServer();
   }
 
+  if (!canAcceptMore()) {
+    // Too many TLS handshakes or sessions, or the server is overloaded:
+    // new connections wait in the listen backlog
+    isAcceptPaused_ = true;
+    return;
+  }
+
   // Accept another connection
   do_accept();
 }
 
+std::optional<boost::asio::ip::address> WsListener::admitConnection() {
+  beast::error_code ec;
+  const tcp::endpoint remote = socket_.remote_endpoint(ec);
+  if (ec) {
+    // the peer is gone already
+    socket_.close(ec);
+    return std::nullopt;
+  }
+
+  const AdmissionControl::Verdict verdict =
+      nm_->getWS()->getAdmissionControl().admit(remote.address());
+  if (verdict == AdmissionControl::Verdict::ADMITTED) {
+    return remote.address();
+  }
+
+  if (verdict == AdmissionControl::Verdict::TOO_MANY_SESSIONS) {
+    WsMetrics::instance().rejectedMaxSessions.inc();
+  } else {
+    WsMetrics::instance().rejectedMaxSessionsPerAddress.inc();
+  }
+  LOG_RATE_LIMITED(WARNING, 1s) << "WsListener: connection from " << remote.address().to_string()
+                                << " is closed by "
+                                << (verdict == AdmissionControl::Verdict::TOO_MANY_SESSIONS
+                                        ? "max sessions"
+                                        : "max sessions per address");
+  socket_.shutdown(tcp::socket::shutdown_both, ec);
+  socket_.close(ec);
+  return std::nullopt;
+}
+
+bool WsListener::canAcceptMore() const {
+  if (maxConcurrentHandshakes_ && activeHandshakes_ >= maxConcurrentHandshakes_) {
+    return false;
+  }
+  return nm_->getWS()->getAdmissionControl().canAccept();
+}
+
+void WsListener::resumeIfPaused() {
+  if (isAcceptPaused_ && !needClose_ && canAcceptMore()) {
+    isAcceptPaused_ = false;
+    do_accept();
+  }
+}
+
+void WsListener::onTlsHandshakeDone() {
+  net::post(strand_, [self = shared_from_this()]() {
+    if (self->activeHandshakes_ > 0) {
+      self->activeHandshakes_--;
+    }
+    self->resumeIfPaused();
+  });
+}
+
+void WsListener::resumeAccept() {
+  net::post(strand_, [self = shared_from_this()]() { self->resumeIfPaused(); });
+}
+
 } // namespace net
 } // namespace boostander
@@ -5,6 +5,7 @@
 #include <boost/asio/bind_executor.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/signal_set.hpp>
+#include <boost/asio/ssl/context.hpp>
 #include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
@@ -17,6 +18,7 @@
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
 #include <thread>
 #include <vector>
@@ -24,6 +26,7 @@
 namespace boostander {
 namespace net {
 
+class BlockPool;
 class NetworkManager;
 class WsSession;
 
@@ -33,8 +36,18 @@ class WsSession;
 class WsListener : public std::enable_shared_from_this<WsListener> {
 
 public:
+  /**
+   * @param sslContext if set, accepted connections run over TLS (wss://)
+   * @param maxConcurrentHandshakes TLS handshakes in progress, after that the listener stops
+   * accepting until some handshake completes (connections wait in the listen backlog),
+   * 0 for unlimited
+   * @param listenHandle listening socket taken over from another process (see ListenerHandoff),
+   * -1 to bind endpoint
+   **/
   WsListener(boost::asio::io_context& ioc, const boost::asio::ip::tcp::endpoint& endpoint,
-             std::shared_ptr<std::string const> doc_root, NetworkManager* nm);
+             std::shared_ptr<std::string const> doc_root, NetworkManager* nm,
+             bool useCoroSessions = false, boost::asio::ssl::context* sslContext = nullptr,
+             std::size_t maxConcurrentHandshakes = 0, int listenHandle = -1);
 
   void configureAcceptor();
 
@@ -58,9 +71,45 @@ public:
 
   std::shared_ptr<WsSession> addClientSession(const std::string& newSessId);
 
+  /**
+   * @brief storage of all sessions (WsSession and WsCoroSession with their shared_ptr control
+   * blocks), recycled across connections. Never destroyed: sessions may outlive the listener.
+   */
+  static BlockPool& getSessionPool();
+
+  /**
+   * @brief called by TLS sessions when the handshake completes or fails, thread-safe
+   */
+  void onTlsHandshakeDone();
+
+  /**
+   * @brief accepts again if accepting is paused by session limits or overload and they allow it
+   * now, called periodically by the server, thread-safe
+   */
+  void resumeAccept();
+
   void stop();
 
+  /**
+   * @brief endpoint the acceptor is bound to (resolves port 0 to the actual port)
+   */
+  boost::asio::ip::tcp::endpoint getLocalEndpoint() const;
+
+  /**
+   * @brief native handle of the listening socket to hand off, -1 if not accepting
+   */
+  int getNativeHandle();
+
 private:
+  // Counts the accepted socket_ by session limits, closes it and returns nothing if they do not
+  // allow it
+  std::optional<boost::asio::ip::address> admitConnection();
+
+  // Handshake and session limits allow accepting, within strand_
+  bool canAcceptMore() const;
+
+  void resumeIfPaused();
+
   boost::asio::ip::tcp::socket socket_;
 
   boost::asio::ip::tcp::acceptor acceptor_;
@@ -71,6 +120,9 @@ private:
 
   boost::asio::ip::tcp::endpoint endpoint_;
 
+  // taken over by configureAcceptor instead of binding endpoint_, -1 if not set
+  const int listenHandle_;
+
   /**
    * I/O objects such as sockets and streams are not thread-safe. For efficiency, networking adopts
    * a model of using threads without explicit locking by requiring all access to I/O objects to be
@@ -79,6 +131,21 @@ private:
   boost::asio::strand<boost::asio::io_context::executor_type> strand_;
 
   bool needClose_ = false;
+
+  // create WsCoroSession instead of WsSession for accepted connections
+  const bool useCoroSessions_;
+
+  // TLS context of accepted sessions, nullptr for plain WebSockets
+  boost::asio::ssl::context* sslContext_;
+
+  const std::size_t maxConcurrentHandshakes_;
+
+  // TLS handshakes in progress, accessed within strand_
+  std::size_t activeHandshakes_ = 0;
+
+  // accepting is paused until a TLS handshake completes or the load allows it (see
+  // AdmissionControl), accessed within strand_
+  bool isAcceptPaused_ = false;
 };
 
 } // namespace net
@@ -0,0 +1,48 @@
+#include "net/websockets/WsMetrics.hpp" // IWYU pragma: associated
+#include "metrics/Metrics.hpp"
+#include <string>
+
+namespace boostander {
+namespace net {
+
+WsMetrics& WsMetrics::instance() {
+  metrics::MetricsRegistry& registry = metrics::MetricsRegistry::instance();
+  static WsMetrics wsMetrics{
+      registry.gauge("ws_sessions", "WebSocket sessions alive"),
+      registry.counter("ws_messages_received_total", "WebSocket messages received"),
+      registry.counter("ws_received_bytes_total", "Payload bytes of received WebSocket messages"),
+      registry.counter("ws_messages_sent_total", "WebSocket messages sent"),
+      registry.counter("ws_sent_bytes_total", "Payload bytes of sent WebSocket messages"),
+      registry.gauge("ws_send_queue_messages", "WebSocket messages waiting to be sent"),
+      registry.counter("ws_messages_dropped_total", "WebSocket messages dropped by queue limits",
+                       {{"reason", "send_queue_full"}}),
+      registry.counter("ws_messages_dropped_total", "WebSocket messages dropped by queue limits",
+                       {{"reason", "receive_queue_full"}}),
+      registry.counter("ws_messages_dropped_total", "WebSocket messages dropped by queue limits",
+                       {{"reason", "overloaded"}}),
+      registry.counter("ws_messages_dropped_total", "WebSocket messages dropped by queue limits",
+                       {{"reason", "throttled"}}),
+      registry.counter("ws_messages_dropped_total", "WebSocket messages dropped by queue limits",
+                       {{"reason", "heavy_queue_full"}}),
+      registry.counter("ws_messages_invalid_total",
+                       "Received WebSocket messages with unknown opcode"),
+      registry.counter("ws_connections_rejected_total",
+                       "Accepted connections closed by session limits",
+                       {{"reason", "max_sessions"}}),
+      registry.counter("ws_connections_rejected_total",
+                       "Accepted connections closed by session limits",
+                       {{"reason", "max_sessions_per_ip"}}),
+      registry.gauge("ws_overloaded", "1 while the server sheds load"),
+      registry.gauge("ws_heavy_queue_messages",
+                     "WebSocket messages queued or processed by the heavy threads")};
+  return wsMetrics;
+}
+
+metrics::Histogram& WsMetrics::callbackDuration(const std::string& opcode) {
+  return metrics::MetricsRegistry::instance().histogram(
+      "ws_callback_duration_seconds", "Time spent in callbacks of received messages",
+      {{"opcode", opcode}});
+}
+
+} // namespace net
+} // namespace boostander
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "metrics/Metrics.hpp"
+#include <string>
+
+namespace boostander {
+namespace net {
+
+/**
+ * Metrics of all WebSocket sessions, looked up in the registry once.
+ * @see metrics::MetricsRegistry
+ **/
+struct WsMetrics {
+  static WsMetrics& instance();
+
+  // Time spent in the callback of an opcode (on the tick thread)
+  static metrics::Histogram& callbackDuration(const std::string& opcode);
+
+  metrics::Gauge& sessions;
+
+  metrics::Counter& messagesReceived;
+
+  metrics::Counter& receivedBytes;
+
+  metrics::Counter& messagesSent;
+
+  metrics::Counter& sentBytes;
+
+  // messages waiting to be sent, summed over all sessions
+  metrics::Gauge& sendQueueMessages;
+
+  metrics::Counter& droppedSendQueueFull;
+
+  metrics::Counter& droppedReceiveQueueFull;
+
+  // received while the server is overloaded, answered with BUSY (as receive queue full)
+  metrics::Counter& droppedOverloaded;
+
+  // over the rate limits of the session, answered with THROTTLED
+  metrics::Counter& droppedThrottled;
+
+  // heavy messages over ServerConfig::maxHeavyQueueSize_, answered with BUSY
+  metrics::Counter& droppedHeavyQueueFull;
+
+  // received messages without a callback for their opcode
+  metrics::Counter& invalidMessages;
+
+  // accepted connections closed by session limits, see AdmissionControl
+  metrics::Counter& rejectedMaxSessions;
+
+  metrics::Counter& rejectedMaxSessionsPerAddress;
+
+  // 1 while new messages are answered with BUSY and listeners do not accept
+  metrics::Gauge& overloaded;
+
+  // heavy messages queued or processed by the heavy threads, see DispatchLane
+  metrics::Gauge& heavyQueueMessages;
+};
+
+} // namespace net
+} // namespace boostander
@@ -1,19 +1,27 @@
 #include "net/websockets/WsServer.hpp" // IWYU pragma: associated
-#include "algo/CSV.hpp"
+#include "algo/CsvAggregator.hpp"
 #include "algo/DispatchQueue.hpp"
 #include "algo/NetworkOperation.hpp"
 #include "algo/StringUtils.hpp"
 #include "config/ServerConfig.hpp"
 #include "log/Logger.hpp"
+#include "metrics/MemoryAccounting.hpp"
+#include "metrics/Metrics.hpp"
+#include "metrics/Tracing.hpp"
+#include "net/MetricsListener.hpp"
+#include "net/NetworkManager.hpp"
 #include "net/websockets/WsListener.hpp"
+#include "net/websockets/WsMetrics.hpp"
 #include "net/websockets/WsSession.hpp"
+#include <algorithm>
 #include <boost/asio.hpp>
 #include <boost/asio/buffer.hpp>
+#include <boost/asio/signal_set.hpp>
 #include <boost/asio/ssl/context.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/websocket.hpp>
 #include <boost/format.hpp>
-#include <boost/lexical_cast.hpp>
+#include <chrono>
 #include <cstddef>
 #include <filesystem>
 #include <fstream>
@@ -36,81 +44,216 @@ namespace websocket = beast::websocket; // from <boost/beast/websocket.hpp>
 namespace net = boost::asio;            // from <boost/asio.hpp>
 using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
 
+using namespace std::chrono_literals;
+
 namespace {
 
 using namespace ::boostander::net;
 
+/**
+ * Granularity of ping and idle-close deadlines.
+ * 64 slots of 500ms cover 32 seconds, ping deadlines fit into one revolution.
+ **/
+constexpr std::chrono::milliseconds WS_TIMER_WHEEL_TICK{500};
+
+constexpr std::size_t WS_TIMER_WHEEL_SLOTS = 64;
+
+// Period of load sampling of the admission control, shedding starts within this time
+constexpr std::chrono::milliseconds WS_LOAD_SAMPLE_PERIOD{100};
+
+// CSV_ANALIZE is parsed in slices, a cancel stops it within one slice
+constexpr std::size_t CSV_ANALIZE_SLICE = 64 * 1024;
+
 static void pingCallback(WsSession* clientSession, NetworkManager* nm,
                          std::shared_ptr<std::string> messageBuffer) {
   using boostander::algo::Opcodes;
   using boostander::algo::WS_OPCODE;
 
   if (!messageBuffer || !messageBuffer.get()) {
-    LOG(WARNING) << "WsServer: Invalid messageBuffer";
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsServer: Invalid messageBuffer";
     return;
   }
 
   if (!clientSession) {
-    LOG(WARNING) << "WSServer invalid clientSession!";
+    LOG_RATE_LIMITED(WARNING, 1s) << "WSServer invalid clientSession!";
     return;
   }
 
-  LOG(INFO) << std::this_thread::get_id() << ":"
-            << "pingCallback incomingMsg=" << messageBuffer->substr(0, 50).c_str();
+  LOG(debug) << std::this_thread::get_id() << ":"
+             << "pingCallback incomingMsg=" << messageBuffer->substr(0, 50).c_str();
 
   // send same message back (ping-pong)
   clientSession->send(messageBuffer);
 }
 
+// Logs results of CSV_ANALIZE and answers with the rows count
+static void sendCsvAnswer(WsSession* clientSession, const boostander::algo::CsvAggregator& csv) {
+  using namespace boostander::algo;
+
+  if (csv.getRowsCount() <= 0) {
+    LOG_RATE_LIMITED(WARNING, 1s) << "csvAnalizeCallback: Provided invalid csv file\n"
+                                  << "See example .csv files in assets folder\n";
+  }
+
+  LOG(debug) << "max. date = " << dateToStr(csv.getMaxDate()) << "; a/b = " << csv.getRatio();
+
+  // send analize result
+  const std::string CSVResponse =
+      Opcodes::opcodeToStr(WS_OPCODE::CSV_ANSWER) + std::to_string(csv.getRowsCount());
+  clientSession->send(CSVResponse);
+}
+
 static void csvAnalizeCallback(WsSession* clientSession, NetworkManager* nm,
                                std::shared_ptr<std::string> messageBuffer) {
-  using boostander::algo::Opcodes;
-  using boostander::algo::WS_OPCODE;
+  using namespace boostander::algo;
+
+  if (!messageBuffer || !messageBuffer.get()) {
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsServer: Invalid messageBuffer";
+    return;
+  }
+
+  if (!clientSession) {
+    LOG_RATE_LIMITED(WARNING, 1s) << "WSServer invalid clientSession!";
+    return;
+  }
+
+  // the payload is parsed in place, after the opcode
+  CsvAggregator csv;
+  CsvProgress progress(nm->getWS()->getConfig().csvProgressBytes_);
+  const char* data = messageBuffer->data() + 1;
+  const char* const end = messageBuffer->data() + messageBuffer->size();
+  while (data < end) {
+    if (clientSession->isCancelled()) {
+      LOG(debug) << "csv analysis is cancelled after " << csv.getBytesCount() << " bytes";
+      clientSession->send(csvPartialResults(WS_OPCODE::CSV_CANCEL, csv));
+      return;
+    }
+    const std::size_t slice = std::min<std::size_t>(end - data, CSV_ANALIZE_SLICE);
+    csv.feed(data, slice);
+    data += slice;
+    if (progress.update(csv)) {
+      clientSession->send(csvPartialResults(WS_OPCODE::CSV_PROGRESS, csv));
+    }
+  }
+  csv.finish();
+
+  sendCsvAnswer(clientSession, csv);
+}
+
+/**
+ * Just the opcode: the session cancelled its analyses received before it when it was received,
+ * see WsSession::cancelReceived. With partial results: the reply of a cancelled analysis.
+ **/
+static void csvCancelCallback(WsSession* clientSession, NetworkManager* nm,
+                              std::shared_ptr<std::string> messageBuffer) {
+  if (!messageBuffer || !messageBuffer.get()) {
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsServer: Invalid messageBuffer";
+    return;
+  }
+
+  if (!clientSession) {
+    LOG_RATE_LIMITED(WARNING, 1s) << "WSServer invalid clientSession!";
+    return;
+  }
+
+  if (messageBuffer->size() == 1) {
+    return;
+  }
+  LOG(WARNING) << "csv analysis is cancelled, partial results: " << messageBuffer->substr(1);
+}
+
+// Partial results of a CSV_ANALIZE in progress
+static void csvProgressCallback(WsSession* clientSession, NetworkManager* nm,
+                                std::shared_ptr<std::string> messageBuffer) {
+  if (!messageBuffer || !messageBuffer.get()) {
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsServer: Invalid messageBuffer";
+    return;
+  }
 
+  LOG(INFO) << "csv progress: " << messageBuffer->substr(1);
+}
+
+// Part of CSV_ANALIZE data, the session keeps only the aggregates and an unfinished row
+static void csvChunkCallback(WsSession* clientSession, NetworkManager* nm,
+                             std::shared_ptr<std::string> messageBuffer) {
   using namespace boostander::algo;
-  using namespace boostander::net;
 
   if (!messageBuffer || !messageBuffer.get()) {
-    LOG(WARNING) << "WsServer: Invalid messageBuffer";
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsServer: Invalid messageBuffer";
     return;
   }
 
   if (!clientSession) {
-    LOG(WARNING) << "WSServer invalid clientSession!";
+    LOG_RATE_LIMITED(WARNING, 1s) << "WSServer invalid clientSession!";
     return;
   }
 
-  const std::string payload = messageBuffer->substr(1, messageBuffer->size() - 1);
+  std::unique_ptr<CsvAggregator>& upload = clientSession->csvUpload();
+  if (!upload) {
+    upload = std::make_unique<CsvAggregator>();
+  }
+  upload->feed(messageBuffer->data() + 1, messageBuffer->size() - 1);
+}
 
-  CSV csv;
-  std::chrono::system_clock::time_point maxDate;
-  double delim = 0.0;
-  {
-    csv.loadFromMemory(payload);
-    if (csv.getRowsCount() <= 0 || csv.getColsCount() <= 0) {
-      LOG(WARNING) << "csvAnalizeCallback: Provided invalid csv file\n"
-                   << "See example .csv files in assets folder\n";
+static void csvChunkEndCallback(WsSession* clientSession, NetworkManager* nm,
+                                std::shared_ptr<std::string> messageBuffer) {
+  using namespace boostander::algo;
+
+  if (!clientSession) {
+    LOG_RATE_LIMITED(WARNING, 1s) << "WSServer invalid clientSession!";
+    return;
+  }
+
+  // an upload without chunks is an empty file
+  std::unique_ptr<CsvAggregator> upload = std::move(clientSession->csvUpload());
+  if (!upload) {
+    upload = std::make_unique<CsvAggregator>();
+  }
+  upload->finish();
+
+  LOG(debug) << "csv upload of " << upload->getBytesCount() << " bytes";
+  sendCsvAnswer(clientSession, *upload);
+}
+
+// CSV_ANALIZE analyzed during the upload, see ServerConfig::streamOpcodes_
+class CsvStreamConsumer : public WsStreamConsumer {
+public:
+  CsvStreamConsumer(WsSession* clientSession, std::size_t progressBytes)
+      : clientSession_(clientSession), progress_(progressBytes) {}
+
+  void feed(const char* data, std::size_t size) override {
+    using namespace boostander::algo;
+
+    // the rest of a cancelled message is skipped, the reply is sent by finish()
+    if (clientSession_->isCancelled()) {
+      return;
     }
-    for (unsigned int i = 0; i < csv.getRowsCount(); i++) {
-      auto dt = dateTimeFromStr(csv.getAt(i, 0));
-      if (dt > maxDate) {
-        maxDate = dt;
-        auto d1 = boost::lexical_cast<double>(csv.getAt(i, 1));
-        auto d2 = boost::lexical_cast<double>(csv.getAt(i, 2));
-        if (!std::isinf(d2) && d2 != 0) {
-          delim = d1 / d2;
-        }
-      }
+    csv_.feed(data, size);
+    if (progress_.update(csv_)) {
+      clientSession_->send(csvPartialResults(WS_OPCODE::CSV_PROGRESS, csv_));
     }
   }
 
-  LOG(WARNING) << "max. date = " << dateToStr(maxDate) << "; a/b = " << delim;
+  void finish(WsSession* clientSession, NetworkManager* nm) override {
+    using namespace boostander::algo;
 
-  // send analize result
-  const std::string CSVResponse =
-      Opcodes::opcodeToStr(WS_OPCODE::CSV_ANSWER) + std::to_string(csv.getRowsCount());
-  clientSession->send(CSVResponse);
-}
+    // partial results, as csvAnalizeCallback replies to a cancel
+    if (clientSession->isCancelled()) {
+      LOG(debug) << "csv analysis is cancelled after " << csv_.getBytesCount() << " bytes";
+      clientSession->send(csvPartialResults(WS_OPCODE::CSV_CANCEL, csv_));
+      return;
+    }
+    csv_.finish();
+    sendCsvAnswer(clientSession, csv_);
+  }
+
+private:
+  WsSession* clientSession_;
+
+  boostander::algo::CsvAggregator csv_;
+
+  boostander::algo::CsvProgress progress_;
+};
 
 static void csvAnswerCallback(WsSession* clientSession, NetworkManager* nm,
                               std::shared_ptr<std::string> messageBuffer) {
@@ -118,12 +261,12 @@ static void csvAnswerCallback(WsSession* clientSession, NetworkManager* nm,
   using boostander::algo::WS_OPCODE;
 
   if (!messageBuffer || !messageBuffer.get()) {
-    LOG(WARNING) << "WsServer: Invalid messageBuffer";
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsServer: Invalid messageBuffer";
     return;
   }
 
   if (!clientSession) {
-    LOG(WARNING) << "WSServer invalid clientSession!";
+    LOG_RATE_LIMITED(WARNING, 1s) << "WSServer invalid clientSession!";
     return;
   }
 
@@ -131,6 +274,22 @@ static void csvAnswerCallback(WsSession* clientSession, NetworkManager* nm,
   LOG(WARNING) << "result: rows in csv  = " << payload;
 }
 
+// The server dropped a message: BUSY (see AdmissionControl) or THROTTLED (see RateLimiter)
+static void droppedCallback(WsSession* clientSession, NetworkManager* nm,
+                            std::shared_ptr<std::string> messageBuffer) {
+  using boostander::algo::WS_OPCODE;
+
+  if (!messageBuffer || messageBuffer->size() < 2) {
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsServer: Invalid messageBuffer";
+    return;
+  }
+
+  const bool isBusy = messageBuffer->at(0) == static_cast<char>(WS_OPCODE::BUSY);
+  LOG_RATE_LIMITED(WARNING, 1s) << (isBusy ? "server is busy" : "rate limit is exceeded")
+                                << ", message of opcode " << messageBuffer->at(1)
+                                << " is dropped";
+}
+
 } // namespace
 
 namespace boostander {
@@ -140,17 +299,46 @@ WSInputCallbacks::WSInputCallbacks() {}
 
 WSInputCallbacks::~WSInputCallbacks() {}
 
-std::map<WsNetworkOperation, WsNetworkOperationCallback> WSInputCallbacks::getCallbacks() const {
+const std::map<WsNetworkOperation, WsNetworkOperationCallback>&
+WSInputCallbacks::getCallbacks() const {
   return operationCallbacks_;
 }
 
 void WSInputCallbacks::addCallback(const WsNetworkOperation& op,
                                    const WsNetworkOperationCallback& cb) {
-  operationCallbacks_[op] = cb;
+  // Every callback is timed, the histogram is looked up once per opcode
+  metrics::Histogram& duration = WsMetrics::callbackDuration(op.operationCodeStr_);
+  operationCallbacks_[op] = [cb, &duration](WsSession* clientSession, NetworkManager* nm,
+                                            std::shared_ptr<std::string> messageBuffer) {
+    const auto start = metrics::Histogram::Clock::now();
+    cb(clientSession, nm, std::move(messageBuffer));
+    duration.record(metrics::Histogram::Clock::now() - start);
+  };
+}
+
+void WSInputCallbacks::addStreamConsumer(const WsNetworkOperation& op,
+                                         const WsStreamConsumerFactory& factory) {
+  streamConsumers_[op] = factory;
+}
+
+const WsStreamConsumerFactory* WSInputCallbacks::findStreamConsumer(char opcode) const {
+  const auto found =
+      streamConsumers_.find(WsNetworkOperation(static_cast<algo::WS_OPCODE>(opcode)));
+  return found != streamConsumers_.end() ? &found->second : nullptr;
 }
 
 WSServer::WSServer(NetworkManager* nm, const boostander::config::ServerConfig& serverConfig)
-    : nm_(nm), ioc_(serverConfig.threads_) {
+    : nm_(nm), ioc_(serverConfig.threads_), serverConfig_(serverConfig),
+      timerWheel_(WS_TIMER_WHEEL_TICK, WS_TIMER_WHEEL_SLOTS),
+      timerWheelStrand_(ioc_.get_executor()), timerWheelTicker_(ioc_),
+      admissionControl_(serverConfig.maxSessions_, serverConfig.maxSessionsPerAddress_,
+                        serverConfig.busyQueuedMessages_, serverConfig.busyCpuPercent_),
+      loadTicker_(ioc_), sslContext_(net::ssl::context::tls_server) {
+
+  // Register metrics up front, so they are scraped as zeros before the first session
+  WsMetrics::instance();
+
+  metrics::Tracer::instance().configure(serverConfig.traceSampleEvery_);
 
   {
     const WsNetworkOperation op = WsNetworkOperation(
@@ -169,6 +357,68 @@ WSServer::WSServer(NetworkManager* nm, const boostander::config::ServerConfig& s
         algo::WS_OPCODE::CSV_ANSWER, algo::Opcodes::opcodeToStr(algo::WS_OPCODE::CSV_ANSWER));
     operationCallbacks_.addCallback(op, &csvAnswerCallback);
   }
+
+  {
+    const WsNetworkOperation op = WsNetworkOperation(
+        algo::WS_OPCODE::CSV_CHUNK, algo::Opcodes::opcodeToStr(algo::WS_OPCODE::CSV_CHUNK));
+    operationCallbacks_.addCallback(op, &csvChunkCallback);
+  }
+
+  {
+    const WsNetworkOperation op =
+        WsNetworkOperation(algo::WS_OPCODE::CSV_CHUNK_END,
+                           algo::Opcodes::opcodeToStr(algo::WS_OPCODE::CSV_CHUNK_END));
+    operationCallbacks_.addCallback(op, &csvChunkEndCallback);
+  }
+
+  {
+    const WsNetworkOperation op = WsNetworkOperation(
+        algo::WS_OPCODE::CSV_PROGRESS, algo::Opcodes::opcodeToStr(algo::WS_OPCODE::CSV_PROGRESS));
+    operationCallbacks_.addCallback(op, &csvProgressCallback);
+  }
+
+  {
+    const WsNetworkOperation op = WsNetworkOperation(
+        algo::WS_OPCODE::CSV_CANCEL, algo::Opcodes::opcodeToStr(algo::WS_OPCODE::CSV_CANCEL));
+    operationCallbacks_.addCallback(op, &csvCancelCallback);
+  }
+
+  for (const algo::WS_OPCODE opcode : {algo::WS_OPCODE::BUSY, algo::WS_OPCODE::THROTTLED}) {
+    const WsNetworkOperation op = WsNetworkOperation(opcode, algo::Opcodes::opcodeToStr(opcode));
+    operationCallbacks_.addCallback(op, &droppedCallback);
+  }
+
+  for (const char opcode : serverConfig.streamOpcodes_) {
+    const WsNetworkOperation op(static_cast<algo::WS_OPCODE>(opcode));
+    if (op.operationCode_ == algo::WS_OPCODE::CSV_ANALIZE) {
+      const std::size_t progressBytes = serverConfig.csvProgressBytes_;
+      operationCallbacks_.addStreamConsumer(op, [progressBytes](WsSession* clientSession) {
+        return std::make_shared<CsvStreamConsumer>(clientSession, progressBytes);
+      });
+    } else {
+      LOG(WARNING) << "WSServer: messages of opcode " << opcode << " can not be streamed";
+    }
+  }
+
+  dispatchLanes_.fill(DispatchLane::TICK);
+  for (const char opcode : serverConfig.inlineOpcodes_) {
+    dispatchLanes_[static_cast<unsigned char>(opcode)] = DispatchLane::INLINE;
+  }
+  if (serverConfig.heavyThreads_ > 0 && !serverConfig.heavyOpcodes_.empty()) {
+    heavyPool_ = std::make_unique<net::thread_pool>(
+        static_cast<std::size_t>(serverConfig.heavyThreads_));
+    for (const char opcode : serverConfig.heavyOpcodes_) {
+      dispatchLanes_[static_cast<unsigned char>(opcode)] = DispatchLane::HEAVY;
+    }
+  }
+}
+
+WSServer::~WSServer() {
+  // NOTE: sessions_ are destroyed after ioc_ (base class member),
+  // but sessions own sockets and timers of ioc_, so release them first.
+  // Sessions referenced by pending handlers are destroyed together with ioc_.
+  std::scoped_lock lock(sessionsMutex_);
+  sessions_.clear();
 }
 
 /**
@@ -183,6 +433,9 @@ void WSServer::unregisterSession(const std::string& id) {
     if (!removeSessById(idCopy)) {
       LOG(WARNING) << "WsServer::unregisterSession: trying to unregister non-existing session";
       // NOTE: continue cleanup with saved shared_ptr
+    } else if (sess && sess->getAdmittedAddress()) {
+      // once, the session is removed by this call
+      admissionControl_.release(*sess->getAdmittedAddress());
     }
     if (!sess) {
       // throw std::runtime_error(
@@ -203,7 +456,7 @@ void WSServer::sendToAll(const std::string& message) {
   {
     for (auto& sessionkv : getSessions()) {
       if (!sessionkv.second || !sessionkv.second.get()) {
-        LOG(WARNING) << "WSServer::sendToAll: Invalid session ";
+        LOG_RATE_LIMITED(WARNING, 1s) << "WSServer::sendToAll: Invalid session ";
         continue;
       }
       if (auto session = sessionkv.second.get()) {
@@ -219,7 +472,7 @@ void WSServer::sendTo(const std::string& sessionID, const std::string& message)
     auto it = sessionsCopy.find(sessionID);
     if (it != sessionsCopy.end()) {
       if (!it->second || !it->second.get()) {
-        LOG(WARNING) << "WSServer::sendTo: Invalid session ";
+        LOG_RATE_LIMITED(WARNING, 1s) << "WSServer::sendTo: Invalid session ";
         return;
       }
       it->second->send(message);
@@ -227,41 +480,148 @@ void WSServer::sendTo(const std::string& sessionID, const std::string& message)
   }
 }
 
+bool WSServer::tryAcquireHeavySlot() {
+  // NOTE: incremented first, concurrent sessions do not exceed the limit
+  const std::size_t queued = heavyQueueSize_.fetch_add(1, std::memory_order_relaxed);
+  if (serverConfig_.maxHeavyQueueSize_ && queued >= serverConfig_.maxHeavyQueueSize_) {
+    heavyQueueSize_.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+  WsMetrics::instance().heavyQueueMessages.add();
+  return true;
+}
+
+void WSServer::releaseHeavySlot() {
+  heavyQueueSize_.fetch_sub(1, std::memory_order_relaxed);
+  WsMetrics::instance().heavyQueueMessages.sub();
+}
+
 void WSServer::handleIncomingMessages() {
   doToAllSessions([&](const std::string& sessId, std::shared_ptr<WsSession> session) {
     if (!session || !session.get()) {
-      LOG(WARNING) << "WsServer::handleAllPlayerMessages: trying to "
-                      "use non-existing session";
+      LOG_RATE_LIMITED(WARNING, 1s) << "WsServer::handleAllPlayerMessages: trying to "
+                                       "use non-existing session";
       unregisterSession(sessId);
       return;
     }
 
+    // nullptr if the session has not received any message yet
     auto msgs = session->getReceivedMessages();
-    if (!msgs || !msgs.get()) {
-      LOG(WARNING) << "WsServer::handleAllPlayerMessages: invalid session->getReceivedMessages()";
-      return;
+    if (msgs && msgs->size()) {
+      tickQueues_.emplace_back(std::move(session), std::move(msgs));
     }
-    msgs->DispatchQueued();
   });
+
+  // NOTE: messages received meanwhile wait for the next tick, with sessions that had none
+  algo::DispatchQueue::dispatchFair(tickQueues_, serverConfig_.dispatchQuantum_,
+                                    serverConfig_.dispatchQuantumMessages_);
+}
+
+void WSServer::onTimerWheelTick(boost::system::error_code ec) {
+  if (ec == net::error::operation_aborted || isTimerWheelStopped_) {
+    return;
+  }
+
+  // Expired sessions post their deadline handlers to their own strands
+  timerWheel_.advance(std::chrono::steady_clock::now());
+
+  timerWheelTicker_.expires_at(timerWheelTicker_.expiry() + WS_TIMER_WHEEL_TICK);
+  timerWheelTicker_.async_wait(net::bind_executor(
+      timerWheelStrand_, std::bind(&WSServer::onTimerWheelTick, this, std::placeholders::_1)));
+}
+
+void WSServer::onLoadTick(boost::system::error_code ec) {
+  if (ec == net::error::operation_aborted || isTimerWheelStopped_) {
+    return;
+  }
+
+  if (admissionControl_.isLoadLimited()) {
+    const bool wasOverloaded = admissionControl_.isOverloaded();
+    admissionControl_.updateLoad(algo::DispatchQueue::totalSize(), cpuUsage_.sample());
+    if (admissionControl_.isOverloaded() != wasOverloaded) {
+      WsMetrics::instance().overloaded.add(wasOverloaded ? -1 : 1);
+    }
+  }
+
+  // Listeners paused by the load or by max sessions accept again
+  if (admissionControl_.canAccept()) {
+    for (const auto& listener : {iocWsListener_, iocWssListener_}) {
+      if (listener) {
+        listener->resumeAccept();
+      }
+    }
+  }
+
+  loadTicker_.expires_at(loadTicker_.expiry() + WS_LOAD_SAMPLE_PERIOD);
+  loadTicker_.async_wait(net::bind_executor(
+      timerWheelStrand_, std::bind(&WSServer::onLoadTick, this, std::placeholders::_1)));
 }
 
 void WSServer::runThreads(const config::ServerConfig& serverConfig) {
+  timerWheelTicker_.expires_after(WS_TIMER_WHEEL_TICK);
+  timerWheelTicker_.async_wait(net::bind_executor(
+      timerWheelStrand_, std::bind(&WSServer::onTimerWheelTick, this, std::placeholders::_1)));
+
+  if (admissionControl_.isEnabled()) {
+    loadTicker_.expires_after(WS_LOAD_SAMPLE_PERIOD);
+    loadTicker_.async_wait(net::bind_executor(
+        timerWheelStrand_, std::bind(&WSServer::onLoadTick, this, std::placeholders::_1)));
+  }
+
   wsThreads_.reserve(serverConfig.threads_);
   for (auto i = serverConfig.threads_; i > 0; --i) {
-    wsThreads_.emplace_back([this] { ioc_.run(); });
+    wsThreads_.emplace_back([this] {
+      metrics::setThreadMemoryTag(metrics::MemoryTag::NETWORK);
+      ioc_.run();
+    });
   }
 }
 
 void WSServer::finishThreads() {
+  // The tickers would keep ioc_ running forever
+  isTimerWheelStopped_ = true;
+  net::post(timerWheelStrand_, [this]() {
+    timerWheelTicker_.cancel();
+    loadTicker_.cancel();
+  });
+
+  // and so would a pending wait for signals
+  if (signals_) {
+    net::post(timerWheelStrand_, [this]() {
+      beast::error_code ec;
+      signals_->cancel(ec);
+    });
+  }
+
+  if (tlsHandshakePool_) {
+    tlsHandshakePool_->stop();
+    tlsHandshakePool_->join();
+  }
+
+  // Heavy messages not started yet are dropped, replies of running ones are still written
+  if (heavyPool_) {
+    heavyPool_->stop();
+    heavyPool_->join();
+  }
+
   // Block until all the threads exit
   for (auto& t : wsThreads_) {
     if (t.joinable()) {
       t.join();
     }
   }
+
+  if (!serverConfig_.traceFile_.empty()) {
+    if (metrics::Tracer::instance().writeChromeTrace(serverConfig_.traceFile_)) {
+      LOG(INFO) << "Chrome trace is written to " << serverConfig_.traceFile_;
+    } else {
+      LOG(WARNING) << "WSServer: can not write Chrome trace to " << serverConfig_.traceFile_;
+    }
+  }
 }
 
-void WSServer::runIocWsListener(const config::ServerConfig& serverConfig) {
+void WSServer::runIocWsListener(const config::ServerConfig& serverConfig,
+                                const ListenerHandles& handles) {
 
   tcp::endpoint tcpEndpoint = tcp::endpoint{serverConfig.address_, serverConfig.wsPort_};
 
@@ -274,13 +634,146 @@ void WSServer::runIocWsListener(const config::ServerConfig& serverConfig) {
   }
 
   // Create and launch a listening port
-  iocWsListener_ = std::make_shared<WsListener>(ioc_, tcpEndpoint, workdirPtr, nm_);
+  iocWsListener_ = std::make_shared<WsListener>(ioc_, tcpEndpoint, workdirPtr, nm_,
+                                                serverConfig.wsCoroSessions_, nullptr, 0,
+                                                handles.ws);
   if (!iocWsListener_ || !iocWsListener_.get()) {
     LOG(WARNING) << "WSServer::runIocWsListener: Invalid iocWsListener_";
     return;
   }
 
   iocWsListener_->run();
+
+  if (serverConfig.metricsEnabled_) {
+    const tcp::endpoint metricsEndpoint =
+        tcp::endpoint{serverConfig.address_, serverConfig.metricsPort_};
+    metricsListener_ = std::make_shared<MetricsListener>(ioc_, metricsEndpoint, handles.metrics);
+    metricsListener_->run();
+  }
+
+  if (serverConfig.tlsCertFile_.empty()) {
+    return;
+  }
+
+  if (!configureTls(serverConfig)) {
+    LOG(WARNING) << "WSServer::runIocWsListener: TLS disabled";
+    return;
+  }
+
+  if (serverConfig.tlsHandshakeThreads_ > 0) {
+    tlsHandshakePool_ = std::make_unique<net::thread_pool>(
+        static_cast<std::size_t>(serverConfig.tlsHandshakeThreads_));
+  }
+
+  const tcp::endpoint wssEndpoint = tcp::endpoint{serverConfig.address_, serverConfig.wssPort_};
+  iocWssListener_ = std::make_shared<WsListener>(ioc_, wssEndpoint, workdirPtr, nm_,
+                                                 serverConfig.wsCoroSessions_, &sslContext_,
+                                                 serverConfig.tlsMaxConcurrentHandshakes_,
+                                                 handles.wss);
+  iocWssListener_->run();
+}
+
+ListenerHandles WSServer::getListenerHandles() const {
+  ListenerHandles handles;
+  if (iocWsListener_) {
+    handles.ws = iocWsListener_->getNativeHandle();
+  }
+  if (iocWssListener_) {
+    handles.wss = iocWssListener_->getNativeHandle();
+  }
+  if (metricsListener_) {
+    handles.metrics = metricsListener_->getNativeHandle();
+  }
+  return handles;
+}
+
+void WSServer::stopListeners() {
+  for (const auto& listener : {iocWsListener_, iocWssListener_}) {
+    if (listener) {
+      listener->stop();
+    }
+  }
+  if (metricsListener_) {
+    metricsListener_->stop();
+  }
+}
+
+void WSServer::closeSessionsGracefully() {
+  doToAllSessions([](const std::string& sessId, std::shared_ptr<WsSession> session) {
+    session->closeGracefully();
+  });
+}
+
+void WSServer::handleSignals(std::function<void()> onSignal) {
+  onSignal_ = std::move(onSignal);
+  signals_ = std::make_unique<net::signal_set>(ioc_, SIGINT, SIGTERM);
+  waitForSignal();
+}
+
+void WSServer::waitForSignal() {
+  // NOTE: within timerWheelStrand_, finishThreads() cancels the wait there
+  signals_->async_wait(
+      net::bind_executor(timerWheelStrand_, [this](beast::error_code ec, int signal) {
+        if (ec == net::error::operation_aborted) {
+          return;
+        }
+        LOG(WARNING) << "WSServer: got signal " << signal;
+        onSignal_();
+        waitForSignal();
+      }));
+}
+
+void WSServer::closeSessions() {
+  doToAllSessions([](const std::string& sessId, std::shared_ptr<WsSession> session) {
+    session->close();
+  });
+}
+
+bool WSServer::configureTls(const config::ServerConfig& serverConfig) {
+  beast::error_code ec;
+
+  sslContext_.set_options(net::ssl::context::default_workarounds | net::ssl::context::no_sslv2 |
+                              net::ssl::context::no_sslv3 | net::ssl::context::no_tlsv1 |
+                              net::ssl::context::no_tlsv1_1 | net::ssl::context::single_dh_use,
+                          ec);
+  if (ec) {
+    LOG(WARNING) << "WSServer::configureTls: set_options: " << ec.message();
+    return false;
+  }
+
+  sslContext_.use_certificate_chain_file(serverConfig.tlsCertFile_, ec);
+  if (ec) {
+    LOG(WARNING) << "WSServer::configureTls: certificate " << serverConfig.tlsCertFile_ << ": "
+                 << ec.message();
+    return false;
+  }
+
+  sslContext_.use_private_key_file(serverConfig.tlsKeyFile_, net::ssl::context::pem, ec);
+  if (ec) {
+    LOG(WARNING) << "WSServer::configureTls: private key " << serverConfig.tlsKeyFile_ << ": "
+                 << ec.message();
+    return false;
+  }
+
+  /**
+   * Session resumption skips the key exchange of the full handshake.
+   * Server side cache for resumption by session id (TLS 1.2) and tickets, encrypted
+   * with a key of this process (TLS 1.2 tickets and TLS 1.3 PSK).
+   * @see https://www.openssl.org/docs/man1.1.1/man3/SSL_CTX_set_session_cache_mode.html
+   **/
+  SSL_CTX* ctx = sslContext_.native_handle();
+  static const unsigned char sessionIdContext[] = "boostander";
+  SSL_CTX_set_session_id_context(ctx, sessionIdContext, sizeof(sessionIdContext) - 1);
+  SSL_CTX_set_session_cache_mode(ctx, serverConfig.tlsSessionCacheSize_ ? SSL_SESS_CACHE_SERVER
+                                                                          : SSL_SESS_CACHE_OFF);
+  SSL_CTX_sess_set_cache_size(ctx, static_cast<long>(serverConfig.tlsSessionCacheSize_));
+  if (serverConfig.tlsSessionTickets_) {
+    SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+  } else {
+    SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+  }
+
+  return true;
 }
 
 } // namespace net
@@ -1,11 +1,23 @@
 #pragma once
 
 #include "algo/CallbackManager.hpp"
+#include "algo/DispatchQueue.hpp"
 #include "algo/NetworkOperation.hpp"
+#include "algo/TimerWheel.hpp"
+#include "config/ServerConfig.hpp"
+#include "net/AdmissionControl.hpp"
+#include "net/ListenerHandoff.hpp"
 #include "net/SessionManagerBase.hpp"
+#include <array>
+#include <atomic>
 #include <boost/asio.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <thread>
 #include <vector>
@@ -15,15 +27,10 @@ namespace net {
 class WsSession;
 class NetworkManager;
 class WsListener;
+class MetricsListener;
 } // namespace net
 } // namespace boostander
 
-namespace boostander {
-namespace config {
-class ServerConfig;
-} // namespace config
-} // namespace boostander
-
 namespace boostander {
 namespace net {
 
@@ -38,6 +45,40 @@ typedef std::function<void(WsSession* clientSession, NetworkManager* nm,
                            std::shared_ptr<std::string> messageBuffer)>
     WsNetworkOperationCallback;
 
+/**
+ * Consumes one message while it arrives, instead of a callback of the whole message.
+ * feed() gets fragments of the payload (without the opcode) in order, within the strand of
+ * the session, so processing overlaps with the transfer and the message is never buffered.
+ * Both feed() and finish() see the message as received at its first fragment by
+ * WsSession::isCancelled().
+ **/
+class WsStreamConsumer {
+public:
+  virtual ~WsStreamConsumer() {}
+
+  virtual void feed(const char* data, std::size_t size) = 0;
+
+  // The message is complete. Called on the tick thread, as callbacks.
+  virtual void finish(WsSession* clientSession, NetworkManager* nm) = 0;
+};
+
+/**
+ * Where callbacks of an opcode run, so cheap messages do not wait behind expensive ones.
+ * @see ServerConfig::inlineOpcodes_, ServerConfig::heavyOpcodes_
+ **/
+enum class DispatchLane : uint8_t {
+  // on the I/O thread right after the read, within the strand of the session
+  INLINE,
+  // receive queue of the session, dispatched by the tick thread
+  TICK,
+  // heavy threads, in order per session, bounded by ServerConfig::maxHeavyQueueSize_
+  HEAVY
+};
+
+// Creates a consumer for every message of an opcode received by clientSession
+typedef std::function<std::shared_ptr<WsStreamConsumer>(WsSession* clientSession)>
+    WsStreamConsumerFactory;
+
 class WSInputCallbacks
     : public algo::CallbackManager<WsNetworkOperation, WsNetworkOperationCallback> {
 public:
@@ -45,9 +86,21 @@ public:
 
   ~WSInputCallbacks() override;
 
-  std::map<WsNetworkOperation, WsNetworkOperationCallback> getCallbacks() const override;
+  const std::map<WsNetworkOperation, WsNetworkOperationCallback>& getCallbacks() const override;
 
   void addCallback(const WsNetworkOperation& op, const WsNetworkOperationCallback& cb) override;
+
+  // Messages of op are passed to consumers of factory, callbacks of op are not called for them
+  void addStreamConsumer(const WsNetworkOperation& op, const WsStreamConsumerFactory& factory);
+
+  // nullptr if messages of opcode are read as a whole
+  const WsStreamConsumerFactory* findStreamConsumer(char opcode) const;
+
+  // Sessions read fragments (read_some) only if some opcode is streamed
+  bool hasStreamConsumers() const { return !streamConsumers_.empty(); }
+
+private:
+  std::map<WsNetworkOperation, WsStreamConsumerFactory> streamConsumers_;
 };
 
 /**
@@ -57,10 +110,13 @@ class WSServer : public SessionManagerBase<WsSession, WSInputCallbacks> {
 public:
   WSServer(NetworkManager* nm, const boostander::config::ServerConfig& serverConfig);
 
+  ~WSServer() override;
+
   void sendToAll(const std::string& message) override;
 
   void sendTo(const std::string& sessionID, const std::string& message) override;
 
+  // Sessions take turns, see ServerConfig::dispatchQuantum_. Called by one thread at a time.
   void handleIncomingMessages() override;
 
   void unregisterSession(const std::string& id) override;
@@ -69,16 +125,127 @@ public:
 
   void finishThreads() override;
 
-  void runIocWsListener(const config::ServerConfig& serverConfig);
+  // handles: listening sockets taken over from another process, empty to bind the ports
+  void runIocWsListener(const config::ServerConfig& serverConfig,
+                        const ListenerHandles& handles = {});
+
+  // Listening sockets to hand off to a new process, see ListenerHandoff
+  ListenerHandles getListenerHandles() const;
+
+  // Stops accepting of WebSockets, secure WebSockets and metrics connections
+  void stopListeners();
+
+  /**
+   * Closes all sessions with a close frame after their queued messages are written,
+   * sessions are unregistered when the closing handshake completes. Thread-safe.
+   **/
+  void closeSessionsGracefully();
+
+  // Closes sockets of all sessions, so ioc_ runs out of work
+  void closeSessions();
+
+  // Calls onSignal on an I/O thread for every SIGINT and SIGTERM until finishThreads()
+  void handleSignals(std::function<void()> onSignal);
 
   std::shared_ptr<WsListener> getWsListener() const { return iocWsListener_; }
 
+  // Listener of secure WebSockets, nullptr if TLS is disabled
+  std::shared_ptr<WsListener> getWssListener() const { return iocWssListener_; }
+
+  // Prometheus metrics endpoint, nullptr if metrics are not served
+  std::shared_ptr<MetricsListener> getMetricsListener() const { return metricsListener_; }
+
+  // Threads for TLS handshakes, nullptr if handshakes run on the I/O threads
+  boost::asio::thread_pool* getTlsHandshakePool() const { return tlsHandshakePool_.get(); }
+
+  algo::TimerWheel<WsSession>& getTimerWheel() { return timerWheel_; }
+
+  DispatchLane getDispatchLane(char opcode) const {
+    return dispatchLanes_[static_cast<unsigned char>(opcode)];
+  }
+
+  // Threads of DispatchLane::HEAVY, nullptr if heavy opcodes run on the tick thread
+  boost::asio::thread_pool* getHeavyPool() const { return heavyPool_.get(); }
+
+  // Takes a place of a heavy message, false if ServerConfig::maxHeavyQueueSize_ are taken
+  bool tryAcquireHeavySlot();
+
+  // The heavy message is processed
+  void releaseHeavySlot();
+
+  // Heavy messages queued or processed. Thread-safe.
+  std::size_t getHeavyQueueSize() const { return heavyQueueSize_.load(std::memory_order_relaxed); }
+
+  // Session limits and overload state of the listeners and sessions of this server
+  AdmissionControl& getAdmissionControl() { return admissionControl_; }
+
+  const config::ServerConfig& getConfig() const { return serverConfig_; }
+
   // The io_context is required for all I/O
   boost::asio::io_context ioc_;
 
 private:
+  // Options of sessions are taken from here
+  const config::ServerConfig serverConfig_;
+
+  // Advances timerWheel_ periodically, runs within timerWheelStrand_
+  void onTimerWheelTick(boost::system::error_code ec);
+
+  /**
+   * Ping and idle-close deadlines of all sessions of ioc_.
+   * One asio timer per io_context instead of one per session.
+   **/
+  algo::TimerWheel<WsSession> timerWheel_;
+
+  boost::asio::strand<boost::asio::io_context::executor_type> timerWheelStrand_;
+
+  boost::asio::steady_timer timerWheelTicker_;
+
+  std::atomic<bool> isTimerWheelStopped_{false};
+
+  AdmissionControl admissionControl_;
+
+  ProcessCpuUsage cpuUsage_;
+
+  // Samples the load for admissionControl_ and resumes paused listeners, within timerWheelStrand_
+  boost::asio::steady_timer loadTicker_;
+
+  void onLoadTick(boost::system::error_code ec);
+
+  // Loads certificate and key, enables session resumption. Returns false if TLS can not be used.
+  bool configureTls(const config::ServerConfig& serverConfig);
+
   std::shared_ptr<WsListener> iocWsListener_;
 
+  boost::asio::ssl::context sslContext_;
+
+  std::unique_ptr<boost::asio::thread_pool> tlsHandshakePool_;
+
+  std::shared_ptr<WsListener> iocWssListener_;
+
+  std::shared_ptr<MetricsListener> metricsListener_;
+
+  // Lanes by opcode, looked up by every received message
+  std::array<DispatchLane, 256> dispatchLanes_;
+
+  std::unique_ptr<boost::asio::thread_pool> heavyPool_;
+
+  std::atomic<std::size_t> heavyQueueSize_{0};
+
+  /**
+   * Queues of sessions with received messages, its capacity is reused by every tick.
+   * Holds the sessions too, callbacks use their session after it is unregistered meanwhile.
+   **/
+  std::vector<algo::DispatchQueue::OwnedQueue> tickQueues_;
+
+  // SIGINT and SIGTERM, nullptr if signals are not handled
+  std::unique_ptr<boost::asio::signal_set> signals_;
+
+  std::function<void()> onSignal_;
+
+  // Waits for the next signal of signals_ within timerWheelStrand_
+  void waitForSignal();
+
   // Run the I/O service on the requested number of threads
   std::vector<std::thread> wsThreads_;
 
@@ -1,8 +1,15 @@
 #include "net/websockets/WsSession.hpp" // IWYU pragma: associated
+#include "algo/CsvAggregator.hpp"
 #include "algo/DispatchQueue.hpp"
 #include "algo/NetworkOperation.hpp"
+#include "config/ServerConfig.hpp"
 #include "log/Logger.hpp"
+#include "metrics/MemoryAccounting.hpp"
+#include "metrics/Tracing.hpp"
+#include "net/HandlerAllocator.hpp"
 #include "net/NetworkManager.hpp"
+#include "net/websockets/WsListener.hpp"
+#include "net/websockets/WsMetrics.hpp"
 #include "net/websockets/WsServer.hpp"
 #include <algorithm>
 #include <boost/asio.hpp>
@@ -24,12 +31,20 @@
 #include <type_traits>
 #include <utility>
 
-/**
- * The amount of time to wait in seconds, before sending a websocket 'ping'
- * message. Ping messages are used to determine if the remote end of the
- * connection is no longer available.
- **/
-constexpr unsigned long WS_PING_FREQUENCY_SEC = 15;
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Timestamps are stored as atomic ticks, so the timer wheel may read them from its own thread
+Clock::time_point loadTimePoint(const std::atomic<Clock::rep>& timestamp) {
+  return Clock::time_point(Clock::duration(timestamp.load(std::memory_order_relaxed)));
+}
+
+void storeTimePoint(std::atomic<Clock::rep>& timestamp, Clock::time_point timePoint) {
+  timestamp.store(timePoint.time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+} // namespace
 
 namespace boostander {
 namespace net {
@@ -39,67 +54,116 @@ namespace http = beast::http;           // from <boost/beast/http.hpp>
 namespace websocket = beast::websocket; // from <boost/beast/websocket.hpp>
 namespace net = boost::asio;            // from <boost/asio.hpp>
 using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
+namespace ssl = boost::asio::ssl;       // from <boost/asio/ssl.hpp>
+
+using namespace std::chrono_literals;
+
+template <typename Stream, typename... StreamArgs>
+WsSession::WsSession(std::in_place_type_t<Stream> streamType, NetworkManager* nm,
+                     const std::string& id, StreamArgs&&... streamArgs)
+    : SessionBase(id), pingInterval_(nm->getWS()->getConfig().pingInterval_),
+      pongTimeout_(nm->getWS()->getConfig().pongTimeout_),
+      idleTimeout_(nm->getWS()->getConfig().idleTimeout_),
+      maxMessageSize_(nm->getWS()->getConfig().maxMessageSize_),
+      maxSendQueueSize_(nm->getWS()->getConfig().maxSendQueueSize_),
+      maxReceiveQueueSize_(nm->getWS()->getConfig().maxReceiveQueueSize_),
+      isStreamingReads_(nm->getWS()->getOperationCallbacks().hasStreamConsumers()),
+      ws_(streamType, std::forward<StreamArgs>(streamArgs)...),
+      tlsHandshakePool_(nm->getWS()->getTlsHandshakePool()),
+      strand_(nm->getWS()->ioc_.get_executor()), nm_(nm), isSendBusy_(false) {
+
+  configureStream();
+
+  WsMetrics::instance().sessions.add();
+}
 
 // @note tcp::socket socket represents the local end of a connection between two peers
 WsSession::WsSession(tcp::socket socket, NetworkManager* nm, const std::string& id)
-    : SessionBase(id), ws_(std::move(socket)), strand_(ws_.get_executor()), nm_(nm),
-      timer_(ws_.get_executor().context(), (std::chrono::steady_clock::time_point::max)()),
-      isSendBusy_(false), resolver_(nm->getWS()->ioc_) {
-
-  receivedMessagesQueue_ =
-      std::make_shared<algo::DispatchQueue>(std::string{"WebSockets Server Dispatch Queue"}, 0);
-
-  // Set options before performing the handshake.
-  /**
-   * Determines if outgoing message payloads are broken up into
-   * multiple pieces.
-   **/
-  // ws_.auto_fragment(false);
-
-  /**
-   * Permessage-deflate allows messages to be compressed.
-   **/
-  beast::websocket::permessage_deflate pmd;
-  pmd.client_enable = true;
-  pmd.server_enable = true;
-  pmd.compLevel = 3; /// Deflate compression level 0..9
-  pmd.memLevel = 4;  // Deflate memory level, 1..9
-  ws_.set_option(pmd);
-  // ws.set_option(write_buffer_size{8192});
-
-  /**
-   * Set the maximum incoming message size option.
-   * Message frame fields indicating a size that would bring the total message
-   * size over this limit will cause a protocol failure.
-   **/
-  ws_.read_message_max(64 * 1024 * 1024);
+    : WsSession(std::in_place_type<PlainStream>, nm, id, std::move(socket)) {}
+
+WsSession::WsSession(tcp::socket socket, ssl::context& sslContext, NetworkManager* nm,
+                     const std::string& id)
+    : WsSession(std::in_place_type<TlsStream>, nm, id, std::move(socket), sslContext) {}
+
+void WsSession::configureStream() {
+  visitStream([this](auto& ws) {
+    // Set options before performing the handshake.
+    /**
+     * Determines if outgoing message payloads are broken up into
+     * multiple pieces.
+     **/
+    // ws.auto_fragment(false);
+
+    /**
+     * Permessage-deflate allows messages to be compressed.
+     **/
+    const config::ServerConfig& config = nm_->getWS()->getConfig();
+    beast::websocket::permessage_deflate pmd;
+    pmd.client_enable = config.deflateEnabled_;
+    pmd.server_enable = config.deflateEnabled_;
+    // windows of both directions live as long as the session, they dominate its memory
+    pmd.server_max_window_bits = config.deflateWindowBits_;
+    pmd.client_max_window_bits = config.deflateWindowBits_;
+    pmd.compLevel = config.deflateCompLevel_; /// Deflate compression level 0..9
+    pmd.memLevel = config.deflateMemLevel_;   // Deflate memory level, 1..9
+    ws.set_option(pmd);
+    // ws.set_option(write_buffer_size{8192});
+
+    /**
+     * Set the maximum incoming message size option.
+     * Message frame fields indicating a size that would bring the total message
+     * size over this limit will cause a protocol failure.
+     **/
+    ws.read_message_max(maxMessageSize_);
+  });
+}
+
+tcp::socket& WsSession::socket() {
+  return visitStream([](auto& ws) -> tcp::socket& {
+    if constexpr (std::is_same<std::decay_t<decltype(ws)>, PlainStream>::value) {
+      return ws.next_layer();
+    } else {
+      return ws.next_layer().next_layer();
+    }
+  });
 }
 
 WsSession::~WsSession() {
-  if (receivedMessagesQueue_ && receivedMessagesQueue_.get())
-    receivedMessagesQueue_.reset();
+  WsMetrics::instance().sessions.sub();
+  WsMetrics::instance().sendQueueMessages.sub(static_cast<std::int64_t>(sendQueue_.size()));
 }
 
 bool WsSession::waitForConnect(std::size_t maxWait_ms) const {
-  auto end_time = std::chrono::high_resolution_clock::now() + std::chrono::milliseconds(maxWait_ms);
-  auto current_time = std::chrono::high_resolution_clock::now();
-  while (!isOpen() && (current_time < end_time)) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    current_time = std::chrono::high_resolution_clock::now();
+  if (!clientConnect_) {
+    return isOpen();
   }
+  std::unique_lock<std::mutex> lock(clientConnect_->mutex);
+  clientConnect_->cv.wait_for(lock, std::chrono::milliseconds(maxWait_ms),
+                              [this]() { return clientConnect_->isFinished; });
   return isOpen();
 }
 
 void WsSession::on_session_fail(beast::error_code ec, char const* what) {
-  LOG(WARNING) << "WsSession failed: " << what << " : " << ec.message();
+  LOG_RATE_LIMITED(WARNING, 1s) << "WsSession failed: " << what << " : " << ec.message();
   std::string copyId = getId();
   nm_->getWS()->unregisterSession(copyId);
 }
 
-void WsSession::connectAsClient(const std::string& host, const std::string& port) {
+void WsSession::connectAsClient(const std::string& host, const std::string& port,
+                                ConnectHandler onConnected) {
+  clientConnect_ = std::make_unique<ClientConnect>(nm_->getWS()->ioc_);
+  clientConnect_->handler = std::move(onConnected);
+
+  if (isTls()) {
+    LOG(WARNING) << "WsSession::connectAsClient: client sessions over TLS are not supported";
+    net::post(strand_, std::bind(&WsSession::finishConnect, shared_from_this(),
+                                 beast::error_code(net::error::operation_not_supported),
+                                 "connect"));
+    return;
+  }
 
   // Look up the domain name
-  resolver_.async_resolve(
+  clientConnect_->resolver.async_resolve(
       host, port,
       boost::asio::bind_executor(strand_, std::bind(&WsSession::onResolve, shared_from_this(),
                                                     std::placeholders::_1, std::placeholders::_2)));
@@ -107,47 +171,85 @@ void WsSession::connectAsClient(const std::string& host, const std::string& port
 
 void WsSession::onResolve(beast::error_code ec, tcp::resolver::results_type results) {
   if (ec)
-    return on_session_fail(ec, "resolve");
+    return finishConnect(ec, "resolve");
 
   // Make the connection on the IP address we get from a lookup
   net::async_connect(
-      ws_.next_layer(), results.begin(), results.end(),
+      socket(), results.begin(), results.end(),
       boost::asio::bind_executor(
           strand_, std::bind(&WsSession::onConnect, shared_from_this(), std::placeholders::_1)));
 }
 
 void WsSession::onConnect(beast::error_code ec) {
   if (ec)
-    return on_session_fail(ec, "connect");
+    return finishConnect(ec, "connect");
+
+  // as accepted sockets, see WsListener::on_accept
+  beast::error_code optionEc;
+  socket().set_option(tcp::no_delay(true), optionEc);
 
   // Perform the websocket handshake
-  auto host = ws_.lowest_layer().local_endpoint().address().to_string();
-  ws_.async_handshake(
+  auto host = socket().local_endpoint().address().to_string();
+  std::get<PlainStream>(ws_).async_handshake(
       host, host,
       boost::asio::bind_executor(
           strand_, std::bind(&WsSession::onHandshake, shared_from_this(), std::placeholders::_1)));
 }
 
-void WsSession::onHandshake(beast::error_code ec) {
-  if (ec)
-    return on_session_fail(ec, "handshake");
+void WsSession::onHandshake(beast::error_code ec) { finishConnect(ec, "handshake"); }
+
+void WsSession::finishConnect(beast::error_code ec, char const* what) {
+  // NOTE: reading starts before the handler, so it may send right away
+  if (!ec) {
+    runAsClient();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(clientConnect_->mutex);
+    clientConnect_->isFinished = true;
+  }
+  clientConnect_->cv.notify_all();
+
+  if (const ConnectHandler handler = std::exchange(clientConnect_->handler, nullptr)) {
+    handler(ec);
+  }
+
+  if (ec) {
+    on_session_fail(ec, what);
+  }
+}
+
+algo::DispatchQueue& WsSession::receivedMessages() {
+  if (!hasReceivedMessagesQueue_.load(std::memory_order_relaxed)) {
+    receivedMessagesQueue_ = std::make_shared<algo::DispatchQueue>(std::string{"ws_session"}, 0);
+    // NOTE: the tick thread reads receivedMessagesQueue_ only after the flag, see below
+    hasReceivedMessagesQueue_.store(true, std::memory_order_release);
+  }
+  return *receivedMessagesQueue_;
+}
+
+std::shared_ptr<algo::DispatchQueue> WsSession::getReceivedMessages() const {
+  // the queue is never replaced once created, so it may be copied without a lock
+  if (!hasReceivedMessagesQueue_.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return receivedMessagesQueue_;
 }
 
 void WsSession::runAsClient() {
-  LOG(INFO) << "WS session run as client";
+  LOG(debug) << "WS session run as client";
 
   // Set the control callback. This will be called
   // on every incoming ping, pong, and close frame.
-  ws_.control_callback(
-      boost::asio::bind_executor(strand_, std::bind(&WsSession::on_control_callback, this,
-                                                    std::placeholders::_1, std::placeholders::_2)));
-
-  // Run the timer. The timer is operated
-  // continuously, this simplifies the code.
-  on_timer({});
+  visitStream([this](auto& ws) {
+    ws.control_callback(boost::asio::bind_executor(
+        strand_, std::bind(&WsSession::on_control_callback, this, std::placeholders::_1,
+                           std::placeholders::_2)));
+  });
 
-  // Set the timer
-  timer_.expires_after(std::chrono::seconds(WS_PING_FREQUENCY_SEC));
+  // Set the deadlines and add the session to the timer wheel.
+  onRemoteMessage();
+  scheduleTimer();
 
   isFullyCreated_ = true; // TODO
 
@@ -157,25 +259,78 @@ void WsSession::runAsClient() {
 
 // Start the asynchronous operation
 void WsSession::runAsServer() {
-  LOG(INFO) << "WS session run as server";
+  LOG(debug) << "WS session run as server";
 
   // Set the control callback. This will be called
   // on every incoming ping, pong, and close frame.
-  ws_.control_callback(
-      boost::asio::bind_executor(strand_, std::bind(&WsSession::on_control_callback, this,
-                                                    std::placeholders::_1, std::placeholders::_2)));
-
-  // Run the timer. The timer is operated
-  // continuously, this simplifies the code.
-  on_timer({});
+  visitStream([this](auto& ws) {
+    ws.control_callback(boost::asio::bind_executor(
+        strand_, std::bind(&WsSession::on_control_callback, this, std::placeholders::_1,
+                           std::placeholders::_2)));
+  });
+
+  // Set the deadlines and add the session to the timer wheel.
+  onRemoteMessage();
+  scheduleTimer();
+
+  if (isTls()) {
+    asyncTlsHandshake(
+        std::bind(&WsSession::onTlsHandshake, shared_from_this(), std::placeholders::_1));
+    return;
+  }
 
-  // Set the timer
-  timer_.expires_after(std::chrono::seconds(WS_PING_FREQUENCY_SEC));
+  doAccept();
+}
 
+void WsSession::doAccept() {
   // Accept the websocket handshake
   // Start reading and responding to a WebSocket HTTP Upgrade request.
-  ws_.async_accept(net::bind_executor(
-      strand_, std::bind(&WsSession::on_accept, shared_from_this(), std::placeholders::_1)));
+  visitStream([this](auto& ws) {
+    ws.async_accept(makeCustomAllocHandler(
+        readMemory_, net::bind_executor(strand_, std::bind(&WsSession::on_accept,
+                                                           shared_from_this(),
+                                                           std::placeholders::_1))));
+  });
+}
+
+void WsSession::onTlsHandshake(beast::error_code ec) {
+  // Happens when the timer closes the socket
+  if (ec == net::error::operation_aborted) {
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession onTlsHandshake ec:" << ec.message();
+    return;
+  }
+
+  if (ec)
+    return on_session_fail(ec, "tls handshake");
+
+  doAccept();
+}
+
+void WsSession::releaseTlsHandshakeSlot() {
+  if (auto listener = nm_->getWS()->getWssListener()) {
+    listener->onTlsHandshakeDone();
+  }
+}
+
+void WsSession::closeSocket() {
+  if (!isTlsHandshakeOffloaded_) {
+    beast::error_code ec;
+    socket().shutdown(tcp::socket::shutdown_both, ec);
+    socket().close(ec);
+    return;
+  }
+
+  // NOTE: a slow TLS client must not make the strand and the handshake use the socket at once
+  net::post(*tlsHandshakeStrand_, [self = shared_from_this()]() {
+    if (!self->isTlsHandshakeOffloaded_) {
+      // the handshake completed meanwhile, the socket is back within the strand
+      net::post(self->strand_, [self]() { self->closeSocket(); });
+      return;
+    }
+    beast::error_code ec;
+    self->socket().shutdown(tcp::socket::shutdown_both, ec);
+    self->socket().close(ec);
+  });
 }
 
 void WsSession::on_control_callback(websocket::frame_type kind, beast::string_view payload) {
@@ -190,15 +345,41 @@ void WsSession::onRemoteActivity() {
   // Note that the connection is alive
   pingState_ = PING_STATE::ALIVE;
 
-  // Set the timer
-  timer_.expires_after(std::chrono::seconds(WS_PING_FREQUENCY_SEC));
+  // Move the deadline, the timer wheel checks it lazily
+  storeTimePoint(lastActivity_, Clock::now());
+}
+
+void WsSession::onRemoteMessage() {
+  storeTimePoint(lastMessage_, Clock::now());
+  onRemoteActivity();
+}
+
+std::chrono::steady_clock::time_point WsSession::deadline() const {
+  // Send a ping after pingInterval_ of silence, close if it is not answered within pongTimeout_
+  Clock::time_point result = pingState_ == PING_STATE::ALIVE
+                                 ? loadTimePoint(lastActivity_) + pingInterval_
+                                 : loadTimePoint(lastPing_) + pongTimeout_;
+  if (idleTimeout_.count() > 0) {
+    result = std::min(result, loadTimePoint(lastMessage_) + idleTimeout_);
+  }
+  return result;
+}
+
+void WsSession::scheduleTimer() {
+  nm_->getWS()->getTimerWheel().schedule(weak_from_this(), deadline());
+}
+
+void WsSession::onDeadline() {
+  // NOTE: called from the timer wheel thread, session state is accessed only within the strand
+  net::post(strand_, makeCustomAllocHandler(
+                         timerMemory_, std::bind(&WsSession::on_timer, shared_from_this())));
 }
 
 void WsSession::on_accept(beast::error_code ec) {
 
   // Happens when the timer closes the socket
   if (ec == net::error::operation_aborted) {
-    LOG(WARNING) << "WsSession on_accept ec:" << ec.message();
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession on_accept ec:" << ec.message();
     return;
   }
 
@@ -215,12 +396,12 @@ void WsSession::on_accept(beast::error_code ec) {
 void WsSession::on_ping(beast::error_code ec) {
   // Happens when the timer closes the socket
   if (ec == net::error::operation_aborted) {
-    LOG(WARNING) << "WsSession on_ping ec:" << ec.message();
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession on_ping ec:" << ec.message();
     return;
   }
 
   if (ec) {
-    LOG(WARNING) << "WsSession on_ping ec:" << ec.message();
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession on_ping ec:" << ec.message();
     return on_session_fail(ec, "ping");
   }
 
@@ -235,102 +416,219 @@ void WsSession::on_ping(beast::error_code ec) {
   }
 }
 
-// Called when the timer expires.
-void WsSession::on_timer(beast::error_code ec) {
+// Called when the deadline is reached.
+void WsSession::on_timer() {
+  const Clock::time_point now = Clock::now();
 
-  if (ec && ec != net::error::operation_aborted) {
-    LOG(WARNING) << "WsSession on_timer ec:" << ec.message();
-    return on_session_fail(ec, "timer");
-  }
+  // See if the deadline really passed since it may have moved.
+  if (deadline() <= now) {
+    const bool isIdle =
+        idleTimeout_.count() > 0 && loadTimePoint(lastMessage_) + idleTimeout_ <= now;
 
-  // See if the timer really expired since the deadline may have moved.
-  if (timer_.expiry() <= std::chrono::steady_clock::now()) {
-    // If this is the first time the timer expired,
+    // If this is the first time the deadline passed,
     // send a ping to see if the other end is there.
-    if (isOpen() && pingState_ == PING_STATE::ALIVE) {
+    // NOTE: no pings during the closing handshake, the close frame waits for an answer too
+    if (isOpen() && !isIdle && !isCloseSent_ && pingState_ == PING_STATE::ALIVE) {
+      // Wait for the answer until pongTimeout_
+      storeTimePoint(lastPing_, now);
+
       // Note that we are sending a ping
       pingState_ = PING_STATE::SENDING;
 
-      // Set the timer
-      timer_.expires_after(std::chrono::seconds(WS_PING_FREQUENCY_SEC));
-
       // Now send the ping
-      ws_.async_ping({},
-                     net::bind_executor(strand_, std::bind(&WsSession::on_ping, shared_from_this(),
-                                                           std::placeholders::_1)));
+      visitStream([this](auto& ws) {
+        ws.async_ping({}, makeCustomAllocHandler(
+                              pingMemory_, net::bind_executor(
+                                               strand_, std::bind(&WsSession::on_ping,
+                                                                  shared_from_this(),
+                                                                  std::placeholders::_1))));
+      });
     } else {
-      // The timer expired while trying to handshake,
+      // The deadline passed while trying to handshake,
       // or we sent a ping and it never completed or
-      // we never got back a control frame, so close.
+      // we never got back a control frame,
+      // or the session did not send messages for idleTimeout_, so close.
 
       // Closing the socket cancels all outstanding operations. They
       // will complete with net::error::operation_aborted
-      LOG(INFO) << "The timer expired while trying to handshake, or we sent a "
-                   "ping and it never completed or we never got back a control "
-                   "frame, so close.";
+      LOG(INFO) << (isIdle ? "Session is idle for too long, so close."
+                           : "The deadline passed while trying to handshake, or we sent a "
+                             "ping and it never completed or we never got back a control "
+                             "frame, so close.");
       LOG(INFO) << "on_timer: total ws sessions: " << nm_->getWS()->getSessionsCount();
-      ws_.next_layer().shutdown(tcp::socket::shutdown_both, ec);
-      ws_.next_layer().close(ec);
-      std::string copyId = getId();
-      nm_->getWS()->unregisterSession(copyId);
+      closeSocket();
+      if (!isClosed_.exchange(true)) {
+        std::string copyId = getId();
+        nm_->getWS()->unregisterSession(copyId);
+      }
       return;
     }
   }
 
-  // Wait on the timer
-  timer_.async_wait(net::bind_executor(
-      strand_, std::bind(&WsSession::on_timer, shared_from_this(), std::placeholders::_1)));
+  // Check the session again at the next deadline
+  scheduleTimer();
+}
+
+void WsSession::close() {
+  // e.g. closed by the owner of the session and then by NetworkManager::finish
+  if (isClosed_.exchange(true)) {
+    return;
+  }
+  net::post(strand_, [self = shared_from_this()]() {
+    // Closing the socket cancels all outstanding operations
+    self->closeSocket();
+    std::string copyId = self->getId();
+    self->nm_->getWS()->unregisterSession(copyId);
+  });
 }
 
 void WsSession::do_read() {
   // Read a message into our buffer
-  ws_.async_read(
-      recievedBuffer_,
+  asyncReadMessage(makeCustomAllocHandler(
+      readMemory_,
       net::bind_executor(strand_, std::bind(&WsSession::on_read, shared_from_this(),
-                                            std::placeholders::_1, std::placeholders::_2)));
+                                            std::placeholders::_1, std::placeholders::_2))));
+}
+
+bool WsSession::consumeFragment() {
+  const bool isMessageDone = visitStream([](auto& ws) { return ws.is_message_done(); });
+
+  if (isDroppingMessage_) {
+    recievedBuffer_.consumeAll();
+    isDroppingMessage_ = isReadingMessage_ = !isMessageDone;
+    return true;
+  }
+
+  if (!isReadingMessage_ && !streamConsumer_) {
+    // NOTE: a frame may be empty, the message is streamed or buffered by its opcode byte.
+    // An empty message is skipped, as it has no opcode.
+    if (!recievedBuffer_.size()) {
+      return true;
+    }
+    // the first fragment of a message starts with the opcode
+    const char opcode =
+        *static_cast<const char*>(beast::buffers_front(recievedBuffer_.data()).data());
+    if (const auto factory = nm_->getWS()->getOperationCallbacks().findStreamConsumer(opcode)) {
+      // bytes of fragments are charged as they are fed
+      if (throttle(opcode, 0, Clock::now())) {
+        recievedBuffer_.consumeAll();
+        isDroppingMessage_ = isReadingMessage_ = !isMessageDone;
+        return true;
+      }
+      streamConsumer_ = (*factory)(this);
+      streamOpcode_ = opcode;
+      streamCancelEpoch_ = cancelEpoch_.current();
+      recievedBuffer_.consume(1);
+    }
+  }
+  isReadingMessage_ = !isMessageDone;
+
+  if (!streamConsumer_) {
+    // other messages are collected in recievedBuffer_ as by async_read
+    return !isMessageDone;
+  }
+
+  if (rateLimiter_) {
+    rateLimiter_->charge(streamOpcode_, recievedBuffer_.size(), Clock::now());
+  }
+  {
+    // the consumer checks isCancelled() as callbacks do
+    CancelEpoch::RunningCallback runningCallback(cancelEpoch_, streamCancelEpoch_);
+    for (const auto buffer : beast::buffers_range_ref(recievedBuffer_.data())) {
+      streamConsumer_->feed(static_cast<const char*>(buffer.data()), buffer.size());
+    }
+  }
+  recievedBuffer_.consumeAll();
+
+  if (!isMessageDone) {
+    return true;
+  }
+
+  std::shared_ptr<WsStreamConsumer> consumer = std::move(streamConsumer_);
+  metrics::ScopedMemoryTag memoryTag(metrics::MemoryTag::RECEIVE_QUEUE);
+  if (nm_->getWS()->getAdmissionControl().isOverloaded()) {
+    WsMetrics::instance().droppedOverloaded.inc();
+    replyDropped(algo::WS_OPCODE::BUSY, streamOpcode_);
+    return true;
+  }
+  WsMetrics::instance().messagesReceived.inc();
+  // NOTE: an inline stream opcode is finished by the tick thread, finish() may be expensive
+  DispatchLane lane = nm_->getWS()->getDispatchLane(streamOpcode_);
+  if (lane == DispatchLane::INLINE) {
+    lane = DispatchLane::TICK;
+  }
+  dispatchCallback(lane, streamOpcode_,
+                   [consumer, this, nm = nm_, cancelEpoch = streamCancelEpoch_]() {
+                     CancelEpoch::RunningCallback runningCallback(cancelEpoch_, cancelEpoch);
+                     consumer->finish(this, nm);
+                   },
+                   nullptr);
+  return true;
 }
 
 void WsSession::on_read(beast::error_code ec, std::size_t bytes_transferred) {
-  boost::ignore_unused(bytes_transferred);
+  const Clock::time_point receivedAt = Clock::now();
 
   // Happens when the timer closes the socket
   if (ec == net::error::operation_aborted) {
-    LOG(WARNING) << "WsSession on_read: net::error::operation_aborted";
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession on_read: net::error::operation_aborted";
     return;
   }
 
   // This indicates that the session was closed
   if (ec == websocket::error::closed) {
-    LOG(WARNING) << "WsSession on_read ec:" << ec.message();
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession on_read ec:" << ec.message();
     return; // on_session_fail(ec, "write");
   }
 
   if (ec)
     on_session_fail(ec, "read");
 
-  if (!receivedMessagesQueue_ || !receivedMessagesQueue_.get()) {
-    LOG(WARNING) << "WsSession::on_read: invalid receivedMessagesQueue_ ";
-    return;
+  // Note that there is activity
+  onRemoteMessage();
+
+  if (isStreamingReads_) {
+    // bytes are counted by fragments, a whole message may take several reads
+    WsMetrics::instance().receivedBytes.inc(bytes_transferred);
+    if (consumeFragment()) {
+      if (isOpen()) {
+        do_read();
+      }
+      return;
+    }
   }
 
   if (!recievedBuffer_.size()) {
     return;
   }
 
-  if (recievedBuffer_.size() > maxReceiveMsgSizebyte) {
-    LOG(WARNING) << "WsSession::on_read: Too big messageBuffer of size " << recievedBuffer_.size();
+  if (recievedBuffer_.size() > maxMessageSize_) {
+    LOG_RATE_LIMITED(WARNING, 1s)
+        << "WsSession::on_read: Too big messageBuffer of size " << recievedBuffer_.size();
+    recievedBuffer_.consumeAll();
     return;
   }
 
-  auto sharedBuffer =
-      std::make_shared<std::string>(beast::buffers_to_string(recievedBuffer_.data()));
-  handleIncomingData(sharedBuffer);
+  WsMetrics::instance().messagesReceived.inc();
+  if (!isStreamingReads_) {
+    WsMetrics::instance().receivedBytes.inc(bytes_transferred);
+  }
+
+  // the opcode is the first byte, a throttled message is never copied
+  const char opcode =
+      *static_cast<const char*>(beast::buffers_front(recievedBuffer_.data()).data());
+  if (!throttle(opcode, recievedBuffer_.size(), receivedAt)) {
+    metrics::ScopedMemoryTag memoryTag(metrics::MemoryTag::RECEIVE_QUEUE);
+    auto sharedBuffer =
+        std::make_shared<std::string>(beast::buffers_to_string(recievedBuffer_.data()));
+    handleIncomingData(sharedBuffer, receivedAt);
+  }
 
-  // Clear the buffer
-  recievedBuffer_.consume(recievedBuffer_.size());
+  // Clear the buffer, its memory is kept for the next message
+  recievedBuffer_.consumeAll();
 
   if (!isOpen()) {
-    LOG(WARNING) << "WsSession::on_read: !ws_.is_open()";
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession::on_read: !ws_.is_open()";
     return;
   }
 
@@ -338,28 +636,38 @@ void WsSession::on_read(beast::error_code ec, std::size_t bytes_transferred) {
   do_read();
 }
 
-bool WsSession::isOpen() const { return ws_.is_open(); }
+bool WsSession::isOpen() const {
+  return std::visit([](const auto& ws) { return ws.is_open(); }, ws_);
+}
 
 /**
  * Add message to queue for further processing
  * Returs true if message can be processed
  **/
 bool WsSession::handleIncomingData(std::shared_ptr<std::string> message) {
+  return handleIncomingData(std::move(message), Clock::now());
+}
+
+bool WsSession::handleIncomingData(std::shared_ptr<std::string> message,
+                                   Clock::time_point receivedAt) {
   if (!message || !message.get()) {
-    LOG(WARNING) << "WsSession::handleIncomingData: invalid message";
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession::handleIncomingData: invalid message";
     return false;
   }
 
-  if (message->length() < 2) {
-    LOG(WARNING) << "WsSession::handleIncomingData: ignored invalid message without type";
+  // a message may be just an opcode, e.g. CSV_CHUNK_END
+  if (message->empty()) {
+    LOG_RATE_LIMITED(WARNING, 1s)
+        << "WsSession::handleIncomingData: ignored invalid message without type";
     return false;
   }
 
   // Probably should do some error checking on the JSON object.
   std::string typeStr = std::to_string(message->at(0));
   if (typeStr.empty() || typeStr.length() > UINT32_FIELD_MAX_LEN) {
-    LOG(WARNING) << "WsSession::handleIncomingData: ignored invalid message with invalid "
-                    "type field";
+    LOG_RATE_LIMITED(WARNING, 1s)
+        << "WsSession::handleIncomingData: ignored invalid message with invalid "
+           "type field";
   }
   const auto& callbacks = nm_->getWS()->getOperationCallbacks().getCallbacks();
 
@@ -368,70 +676,205 @@ bool WsSession::handleIncomingData(std::shared_ptr<std::string> message) {
   const auto itFound = callbacks.find(wsNetworkOperation);
   // if a callback is registered for event, add it to queue
   if (itFound != callbacks.end()) {
-    WsNetworkOperationCallback callback = itFound->second;
-    algo::DispatchQueue::dispatch_callback callbackBind = std::bind(callback, this, nm_, message);
-    if (!receivedMessagesQueue_ || !receivedMessagesQueue_.get()) {
-      LOG(WARNING) << "WsSession::handleIncomingData: invalid receivedMessagesQueue_ ";
+    const DispatchLane lane = nm_->getWS()->getDispatchLane(message->at(0));
+
+    // NOTE: at receive time, a cancel in a queue would also cancel messages received after it
+    if (message->size() == 1 && message->at(0) == static_cast<char>(algo::WS_OPCODE::CSV_CANCEL)) {
+      cancelReceived();
+    }
+
+    // cheap callbacks do not wait for the tick, nor for heavy messages of other sessions.
+    // NOTE: not shed by the overload, a BUSY reply costs as much as the callback
+    if (lane == DispatchLane::INLINE) {
+      std::shared_ptr<metrics::MessageTrace> trace =
+          metrics::Tracer::instance().startTrace(message->at(0), receivedAt);
+      if (trace) {
+        trace->stamp(metrics::TraceStage::DISPATCHED);
+        metrics::ScopedTrace scopedTrace(trace);
+        itFound->second(this, nm_, message);
+      } else {
+        itFound->second(this, nm_, message);
+      }
+      return true;
+    }
+
+    // shed load before the message takes memory and time of the tick thread
+    if (nm_->getWS()->getAdmissionControl().isOverloaded()) {
+      WsMetrics::instance().droppedOverloaded.inc();
+      replyDropped(algo::WS_OPCODE::BUSY, message->at(0));
       return false;
     }
-    receivedMessagesQueue_->dispatch(callbackBind);
+
+    algo::DispatchQueue::dispatch_callback callbackBind;
+    std::shared_ptr<metrics::MessageTrace> trace =
+        metrics::Tracer::instance().startTrace(message->at(0), receivedAt);
+    const std::uint64_t cancelEpoch = cancelEpoch_.current();
+    if (trace) {
+      // NOTE: the trace is current while the callback runs, so send() attaches it to the reply
+      callbackBind = [callback = itFound->second, this, message, trace, cancelEpoch]() {
+        metrics::ScopedTrace scopedTrace(trace);
+        runCallback(callback, message, cancelEpoch);
+      };
+    } else {
+      callbackBind = [callback = itFound->second, this, message, cancelEpoch]() {
+        runCallback(callback, message, cancelEpoch);
+      };
+    }
+    return dispatchCallback(lane, message->at(0), std::move(callbackBind), trace.get());
 
   } else {
-    LOG(WARNING) << "WsSession::handleIncomingData: ignored invalid message "
-                 << message->substr(0, 50).c_str() << "... with type " << typeStr;
+    WsMetrics::instance().invalidMessages.inc();
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession::handleIncomingData: ignored invalid message "
+                                  << message->substr(0, 50).c_str() << "... with type " << typeStr;
     return false;
   }
 
   return true;
 }
 
-void WsSession::on_write(beast::error_code ec, std::size_t bytes_transferred) {
-  boost::ignore_unused(bytes_transferred);
+void WsSession::runCallback(const Callback& callback, const std::shared_ptr<std::string>& message,
+                            std::uint64_t cancelEpoch) {
+  CancelEpoch::RunningCallback runningCallback(cancelEpoch_, cancelEpoch);
+  callback(this, nm_, message);
+}
+
+bool WsSession::dispatchCallback(DispatchLane lane, char opcode, std::function<void()> callback,
+                                 metrics::MessageTrace* trace) {
+  if (lane == DispatchLane::TICK) {
+    if (maxReceiveQueueSize_ && receivedMessages().size() >= maxReceiveQueueSize_) {
+      WsMetrics::instance().droppedReceiveQueueFull.inc();
+      LOG_RATE_LIMITED(WARNING, 1s) << "WsSession: receive queue is full, message dropped";
+      replyDropped(algo::WS_OPCODE::BUSY, opcode);
+      return false;
+    }
+    if (trace) {
+      trace->stamp(metrics::TraceStage::DISPATCHED);
+    }
+    receivedMessages().dispatch(std::move(callback));
+    return true;
+  }
+
+  const std::shared_ptr<WSServer> wsServer = nm_->getWS();
+  if (!wsServer->tryAcquireHeavySlot()) {
+    WsMetrics::instance().droppedHeavyQueueFull.inc();
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession: heavy queue is full, message dropped";
+    replyDropped(algo::WS_OPCODE::BUSY, opcode);
+    return false;
+  }
+  if (trace) {
+    trace->stamp(metrics::TraceStage::DISPATCHED);
+  }
+  if (!heavyMessages_) {
+    heavyMessages_ = std::make_unique<HeavyMessages>();
+  }
+  {
+    std::scoped_lock lock(heavyMessages_->mutex);
+    heavyMessages_->callbacks.push_back(std::move(callback));
+    // the running job of the session posts the next one
+    if (heavyMessages_->callbacks.size() > 1) {
+      return true;
+    }
+  }
+  net::post(*wsServer->getHeavyPool(),
+            [self = shared_from_this()]() { self->runHeavyCallback(); });
+  return true;
+}
+
+void WsSession::runHeavyCallback() {
+  std::function<void()> callback;
+  {
+    std::scoped_lock lock(heavyMessages_->mutex);
+    callback = std::move(heavyMessages_->callbacks.front());
+  }
+  callback();
+  nm_->getWS()->releaseHeavySlot();
+
+  bool hasNext = false;
+  {
+    std::scoped_lock lock(heavyMessages_->mutex);
+    heavyMessages_->callbacks.pop_front();
+    hasNext = !heavyMessages_->callbacks.empty();
+  }
+  // one callback per job, a burst of one session does not hold a heavy thread
+  if (hasNext) {
+    net::post(*nm_->getWS()->getHeavyPool(),
+              [self = shared_from_this()]() { self->runHeavyCallback(); });
+  }
+}
+
+void WsSession::replyDropped(algo::WS_OPCODE reply, char opcode) {
+  // Drop replies are not answered, two overloaded peers would bounce them forever
+  if (opcode == static_cast<char>(algo::WS_OPCODE::BUSY) ||
+      opcode == static_cast<char>(algo::WS_OPCODE::THROTTLED)) {
+    return;
+  }
+  send(algo::Opcodes::opcodeToStr(reply) + opcode);
+}
+
+bool WsSession::throttle(char opcode, std::size_t bytes, Clock::time_point now) {
+  const auto& rateLimits = nm_->getWS()->getConfig().rateLimits_;
+  if (rateLimits.empty()) {
+    return false;
+  }
+  if (!rateLimiter_) {
+    metrics::ScopedMemoryTag memoryTag(metrics::MemoryTag::SESSION);
+    rateLimiter_ = std::make_unique<SessionRateLimiter>(
+        rateLimits, nm_->getWS()->getConfig().rateLimitBurst_);
+  }
+  if (rateLimiter_->tryAcquire(opcode, bytes, now)) {
+    return false;
+  }
+
+  WsMetrics::instance().droppedThrottled.inc();
+  LOG_RATE_LIMITED(WARNING, 1s) << "WsSession: message of opcode " << opcode << " from session "
+                                << getId() << " is over the rate limit, dropped";
+  replyDropped(algo::WS_OPCODE::THROTTLED, opcode);
+  return true;
+}
 
+void WsSession::on_write(beast::error_code ec, std::size_t bytes_transferred) {
   // Happens when the timer closes the socket
   if (ec == net::error::operation_aborted) {
-    LOG(WARNING) << "WsSession on_write: net::error::operation_aborted: " << ec.message();
+    LOG_RATE_LIMITED(WARNING, 1s)
+        << "WsSession on_write: net::error::operation_aborted: " << ec.message();
     return;
   }
 
   if (ec) {
-    LOG(WARNING) << "WsSession on_write: ec";
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession on_write: ec";
     return on_session_fail(ec, "write");
   }
 
+  WsMetrics::instance().messagesSent.inc();
+  WsMetrics::instance().sentBytes.inc(bytes_transferred);
+
+  if (!sendQueue_.empty() && sendQueue_.front().trace) {
+    sendQueue_.front().trace->stamp(metrics::TraceStage::WRITTEN);
+  }
+
   if (!isOpen()) {
-    LOG(WARNING) << "WsSession::on_write: !ws_.is_open()";
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession::on_write: !ws_.is_open()";
     return;
   }
 
   if (!sendQueue_.empty()) {
     // Remove the already written string from the queue
     sendQueue_.erase(sendQueue_.begin());
+    WsMetrics::instance().sendQueueMessages.sub();
+    pendingSends_.fetch_sub(1, std::memory_order_relaxed);
   }
 
   if (!sendQueue_.empty()) {
-
-    std::shared_ptr<const std::string> dp = sendQueue_.front();
-
-    if (!dp || !dp.get()) {
-      LOG(WARNING) << "invalid sendQueue_.front()) ";
-      return;
-    }
-
-    // This controls whether or not outgoing message opcodes are set to binary or text.
-    ws_.text(true);
-    ws_.async_write(
-        net::buffer(*dp),
-        net::bind_executor(strand_, std::bind(&WsSession::on_write, shared_from_this(),
-                                              std::placeholders::_1, std::placeholders::_2)));
+    writeQueued();
   } else {
     isSendBusy_ = false;
+    closeIfFlushed();
   }
 }
 
 void WsSession::send(std::shared_ptr<std::string> ss) {
   if (!ss || !ss.get()) {
-    LOG(WARNING) << "WsSession::send: Invalid messageBuffer";
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession::send: Invalid messageBuffer";
     return;
   }
   send(ss.get()->c_str());
@@ -443,46 +886,128 @@ void WsSession::send(std::shared_ptr<std::string> ss) {
  * @param message message passed to client
  */
 void WsSession::send(const std::string& ss) {
+  metrics::ScopedMemoryTag memoryTag(metrics::MemoryTag::SEND_QUEUE);
   std::shared_ptr<const std::string> ssShared =
       std::make_shared<const std::string>(ss); // TODO: std::move
 
   if (!ssShared || !ssShared.get() || ssShared->empty()) {
-    LOG(WARNING) << "WsSession::send: empty messageBuffer";
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession::send: empty messageBuffer";
+    return;
+  }
+
+  if (ssShared->size() > maxMessageSize_) {
+    LOG_RATE_LIMITED(WARNING, 1s)
+        << "WsSession::send: Too big messageBuffer of size " << ssShared->size();
+    return;
+  }
+
+  // a reply to a sampled message, see handleIncomingData
+  std::shared_ptr<metrics::MessageTrace> trace = metrics::MessageTrace::current();
+  if (trace) {
+    trace->stamp(metrics::TraceStage::SEND_QUEUED);
+  }
+
+  pendingSends_.fetch_add(1, std::memory_order_relaxed);
+
+  // NOTE: send may be called from any thread (callbacks run on the tick thread),
+  // but sendQueue_ and isSendBusy_ must only be accessed within the strand
+  net::dispatch(strand_, std::bind(&WsSession::queueSend, shared_from_this(), ssShared,
+                                   std::move(trace)));
+}
+
+void WsSession::queueSend(std::shared_ptr<const std::string> ssShared,
+                          std::shared_ptr<metrics::MessageTrace> trace) {
+  metrics::ScopedMemoryTag memoryTag(metrics::MemoryTag::SEND_QUEUE);
+  if (isClosing_) {
+    pendingSends_.fetch_sub(1, std::memory_order_relaxed);
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession::send: session is closing, message dropped";
     return;
   }
 
-  if (ssShared->size() > maxSendMsgSizebyte) {
-    LOG(WARNING) << "WsSession::send: Too big messageBuffer of size " << ssShared->size();
+  if (maxSendQueueSize_ && sendQueue_.size() >= maxSendQueueSize_) {
+    WsMetrics::instance().droppedSendQueueFull.inc();
+    pendingSends_.fetch_sub(1, std::memory_order_relaxed);
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession::send: send queue is full, message dropped";
     return;
   }
 
-  sendQueue_.push_back(ssShared);
+  sendQueue_.push_back({std::move(ssShared), std::move(trace)});
+  WsMetrics::instance().sendQueueMessages.add();
 
   if (!isOpen()) {
-    LOG(WARNING) << "WsSession::send: !ws_.is_open()";
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession::send: !ws_.is_open()";
     return;
   }
 
   if (!isSendBusy_ && !sendQueue_.empty()) {
     isSendBusy_ = true;
 
-    std::shared_ptr<const std::string> dp = sendQueue_.front();
+    // We are not currently writing, so send this immediately
+    writeQueued();
+  }
+}
 
-    if (!dp || !dp.get()) {
-      LOG(WARNING) << "invalid sendQueue_.front()) ";
-      return;
-    }
+void WsSession::closeGracefully() {
+  net::post(strand_, [self = shared_from_this()]() {
+    self->isClosing_ = true;
+    self->closeIfFlushed();
+  });
+}
 
-    // We are not currently writing, so send this immediately
-    {
-      ws_.text(true); // This controls whether or not outgoing message opcodes are set to binary
-                      // or text.
-      ws_.async_write(
-          net::buffer(*dp),
-          net::bind_executor(strand_, std::bind(&WsSession::on_write, shared_from_this(),
-                                                std::placeholders::_1, std::placeholders::_2)));
-    }
+void WsSession::closeIfFlushed() {
+  if (!isClosing_ || isCloseSent_ || isSendBusy_ || !isOpen()) {
+    return;
+  }
+  isCloseSent_ = true;
+
+  // NOTE: the pending read completes with websocket::error::closed after the closing handshake
+  visitStream([this](auto& ws) {
+    ws.async_close(websocket::close_code::going_away,
+                   makeCustomAllocHandler(
+                       writeMemory_, net::bind_executor(strand_, std::bind(&WsSession::on_close,
+                                                                           shared_from_this(),
+                                                                           std::placeholders::_1))));
+  });
+}
+
+void WsSession::on_close(beast::error_code ec) {
+  if (ec && ec != net::error::operation_aborted) {
+    LOG_RATE_LIMITED(WARNING, 1s) << "WsSession on_close: " << ec.message();
+  }
+
+  // the peer answered or the session is closed by close() or the timer
+  beast::error_code ignored;
+  socket().shutdown(tcp::socket::shutdown_both, ignored);
+  socket().close(ignored);
+  if (!isClosed_.exchange(true)) {
+    std::string copyId = getId();
+    nm_->getWS()->unregisterSession(copyId);
+  }
+}
+
+void WsSession::writeQueued() {
+  std::shared_ptr<const std::string> dp = sendQueue_.front().data;
+
+  if (!dp || !dp.get()) {
+    LOG_RATE_LIMITED(WARNING, 1s) << "invalid sendQueue_.front()) ";
+    return;
   }
+
+  if (sendQueue_.front().trace) {
+    sendQueue_.front().trace->stamp(metrics::TraceStage::WRITE_STARTED);
+  }
+
+  // This controls whether or not outgoing message opcodes are set to binary or text.
+  visitStream([this, &dp](auto& ws) {
+    ws.text(true);
+    ws.async_write(net::buffer(*dp),
+                   makeCustomAllocHandler(
+                       writeMemory_,
+                       net::bind_executor(strand_, std::bind(&WsSession::on_write,
+                                                             shared_from_this(),
+                                                             std::placeholders::_1,
+                                                             std::placeholders::_2))));
+  });
 }
 
 } // namespace net
@@ -1,18 +1,41 @@
 #pragma once
 
+#include "net/CancelEpoch.hpp"
+#include "net/HandlerAllocator.hpp"
+#include "net/RateLimiter.hpp"
+#include "net/ReceiveBuffer.hpp"
 #include "net/SessionBase.hpp"
+#include <atomic>
 #include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/asio/thread_pool.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <utility>
+#include <variant>
 #include <vector>
 
 namespace boostander {
 namespace algo {
+class CsvAggregator;
 class DispatchQueue;
+enum class WS_OPCODE_ENUM : uint32_t;
 } // namespace algo
+namespace metrics {
+class MessageTrace;
+} // namespace metrics
 } // namespace boostander
 
 namespace boostander {
@@ -23,13 +46,12 @@ namespace http = beast::http;           // from <boost/beast/http.hpp>
 namespace websocket = beast::websocket; // from <boost/beast/websocket.hpp>
 namespace net = boost::asio;            // from <boost/asio.hpp>
 using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
-
-// NOTE: ProducerConsumerQueue must be created with a fixed maximum size
-// We use Queue per connection, so it is for 1 client
-constexpr size_t maxSendQueueElems = 16;
+namespace ssl = boost::asio::ssl;       // from <boost/asio/ssl.hpp>
 
 class NetworkManager;
 class PCO;
+class WsStreamConsumer;
+enum class DispatchLane : uint8_t;
 
 enum class PING_STATE : uint32_t { ALIVE, SENDING, SENT, TOTAL };
 
@@ -40,10 +62,14 @@ public:
   explicit WsSession(boost::asio::ip::tcp::socket socket, NetworkManager* nm,
                      const std::string& id);
 
-  ~WsSession();
+  // Take ownership of the socket, the session runs over TLS (wss://)
+  explicit WsSession(boost::asio::ip::tcp::socket socket, boost::asio::ssl::context& sslContext,
+                     NetworkManager* nm, const std::string& id);
+
+  virtual ~WsSession();
 
   // Start the asynchronous operation
-  void runAsServer();
+  virtual void runAsServer();
 
   void on_session_fail(boost::beast::error_code ec, char const* what);
 
@@ -54,15 +80,33 @@ public:
   // Called to indicate activity from the remote peer
   void onRemoteActivity();
 
+  // Called to indicate an incoming message, postpones idle timeout
+  void onRemoteMessage();
+
   void on_accept(boost::beast::error_code ec);
 
-  // Called when the timer expires.
-  void on_timer(boost::beast::error_code ec);
+  void onTlsHandshake(boost::beast::error_code ec);
+
+  // Ping, pong or idle deadline, moves with remote activity. Thread-safe, used by the timer wheel.
+  std::chrono::steady_clock::time_point deadline() const;
+
+  // Called by the timer wheel when deadline() is reached.
+  void onDeadline();
+
+  // Called within the strand when the deadline is reached.
+  void on_timer();
 
   void do_read();
 
   bool handleIncomingData(std::shared_ptr<std::string> message) override;
 
+  // nullptr until the first message is received. Thread-safe.
+  std::shared_ptr<algo::DispatchQueue> getReceivedMessages() const override;
+
+  // receivedAt: completion of the read, the start of a trace if the message is sampled
+  bool handleIncomingData(std::shared_ptr<std::string> message,
+                          std::chrono::steady_clock::time_point receivedAt);
+
   void send(std::shared_ptr<std::string> ss) override;
 
   void send(const std::string& ss) override;
@@ -75,9 +119,37 @@ public:
 
   bool isOpen() const;
 
+  bool isTls() const { return std::holds_alternative<TlsStream>(ws_); }
+
   bool fullyCreated() const { return isFullyCreated_; }
 
-  void connectAsClient(const std::string& host, const std::string& port);
+  // Messages passed to send() and not written or dropped yet, may be read from any thread
+  std::size_t getPendingSendCount() const { return pendingSends_.load(std::memory_order_relaxed); }
+
+  // CSV_CHUNK upload in progress or nullptr, accessed only by callbacks on the tick thread
+  std::unique_ptr<algo::CsvAggregator>& csvUpload() { return csvUpload_; }
+
+  /**
+   * Cancels callbacks of messages received so far, queued and running ones: isCancelled()
+   * is true in them, long callbacks check it and stop early. Called when a bare CSV_CANCEL
+   * is received, whatever its lane. Thread-safe.
+   **/
+  void cancelReceived() { cancelEpoch_.cancel(); }
+
+  // The callback running on this thread handles a message received before cancelReceived()
+  bool isCancelled() const { return cancelEpoch_.isCancelled(); }
+
+  // Called within the strand when connectAsClient finishes, ec is empty on success
+  typedef std::function<void(beast::error_code ec)> ConnectHandler;
+
+  /**
+   * Resolves host, connects and performs the websocket handshake asynchronously.
+   * On success the session starts reading within the strand, then onConnected is called.
+   * On failure onConnected is called with the error, then the session is unregistered.
+   * Does not block, so many sessions may connect concurrently.
+   **/
+  void connectAsClient(const std::string& host, const std::string& port,
+                       ConnectHandler onConnected = nullptr);
 
   void onResolve(beast::error_code ec, tcp::resolver::results_type results);
 
@@ -85,26 +157,175 @@ public:
 
   void onHandshake(beast::error_code ec);
 
+  // Blocks until connectAsClient finishes or max_wait_ms passes, returns isOpen()
   bool waitForConnect(std::size_t max_wait_ms) const;
 
+  // Closes the socket within the strand and unregisters the session, so ioc_ can stop
+  void close();
+
+  /**
+   * Closes the session with a close frame (going away) after the queued messages are written,
+   * later messages are dropped. The session is unregistered when the closing handshake
+   * completes. Used by the graceful drain of the server. Thread-safe.
+   **/
+  void closeGracefully();
+
+  /**
+   * Remote address counted by AdmissionControl::admit, released when the session is unregistered.
+   * Set by the listener before the session is registered, not set for client sessions.
+   **/
+  void setAdmittedAddress(const boost::asio::ip::address& address) { admittedAddress_ = address; }
+
+  const std::optional<boost::asio::ip::address>& getAdmittedAddress() const {
+    return admittedAddress_;
+  }
+
+protected:
+  typedef boost::beast::websocket::stream<boost::asio::ip::tcp::socket> PlainStream;
+
+  typedef boost::beast::websocket::stream<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>
+      TlsStream;
+
+  // Calls f with the websocket stream, plain or TLS
+  template <typename F> decltype(auto) visitStream(F&& f) {
+    return std::visit(std::forward<F>(f), ws_);
+  }
+
+  // Connected TCP socket under the websocket stream
+  boost::asio::ip::tcp::socket& socket();
+
+  // Applies options of the websocket stream, called by constructors
+  void configureStream();
+
+  // Accepts the websocket handshake (HTTP Upgrade request)
+  void doAccept();
+
+  /**
+   * Performs the server TLS handshake. Handler is called within the strand.
+   * With the handshake thread pool the handshake runs there (the handler executor decides
+   * where ssl::stream does its work), so reconnect storms do not starve the I/O threads.
+   **/
+  template <typename Handler> void asyncTlsHandshake(Handler&& handler);
+
+  // Lets the TLS listener accept the next connection
+  void releaseTlsHandshakeSlot();
+
+  /**
+   * Shuts down and closes the socket, called within the strand.
+   * While the handshake runs on tlsHandshakeStrand_ the socket is closed there.
+   **/
+  void closeSocket();
+
+  // Adds the session to the timer wheel of the server, it is checked again at deadline()
+  void scheduleTimer();
+
+  // Starts reading of a connected client session. Runs within the strand.
   void runAsClient();
 
-private:
-  bool isFullyCreated_{false};
+  // Reads the next message or fragment into recievedBuffer_
+  template <typename Handler> void asyncReadMessage(Handler&& handler);
+
+  /**
+   * Passes a fragment in recievedBuffer_ to the stream consumer of its message.
+   * Returns false if recievedBuffer_ holds a whole message for handleIncomingData.
+   * Runs within the strand.
+   **/
+  bool consumeFragment();
+
+  // Completes connectAsClient: starts the session or unregisters it. Runs within the strand.
+  void finishConnect(beast::error_code ec, char const* what);
 
   /**
-   * 16 Kbyte for the highest throughput, while also being the most portable one
-   * @see https://viblast.com/blog/2015/2/5/webrtc-data-channel-message-size/
+   * Queue of received messages, created by the first message: most connections of a gateway
+   * are idle and do not need one. Runs within the strand.
    **/
-  static constexpr size_t maxReceiveMsgSizebyte = 1024 * 1024 * 1024;
-  static constexpr size_t maxSendMsgSizebyte = 1024 * 1024 * 1024;
+  algo::DispatchQueue& receivedMessages();
+
+  // Outgoing message with the trace of the message it replies to (nullptr if not sampled)
+  struct OutgoingMessage {
+    std::shared_ptr<const std::string> data;
+
+    std::shared_ptr<metrics::MessageTrace> trace;
+  };
+
+  // Adds message to sendQueue_ and starts writing if idle. Runs within the strand.
+  void queueSend(std::shared_ptr<const std::string> ssShared,
+                 std::shared_ptr<metrics::MessageTrace> trace);
+
+  // Writes sendQueue_.front(). Runs within the strand.
+  virtual void writeQueued();
+
+  // Sends the close frame of closeGracefully() once nothing is written. Runs within the strand.
+  void closeIfFlushed();
+
+  typedef std::function<void(WsSession* clientSession, NetworkManager* nm,
+                             std::shared_ptr<std::string> messageBuffer)>
+      Callback;
+
+  // Runs callback of message received at cancelEpoch, see isCancelled()
+  void runCallback(const Callback& callback, const std::shared_ptr<std::string>& message,
+                   std::uint64_t cancelEpoch);
+
+  /**
+   * Passes callback of a message of opcode to its lane, TICK or HEAVY, see DispatchLane.
+   * Returns false if the message is dropped by the limit of the lane. Runs within the strand.
+   **/
+  bool dispatchCallback(DispatchLane lane, char opcode, std::function<void()> callback,
+                        metrics::MessageTrace* trace);
+
+  // Runs the first callback of heavyMessages_ and posts the next one. Runs on the heavy threads.
+  void runHeavyCallback();
+
+  // Answers a message of opcode dropped by a limit with reply (BUSY or THROTTLED)
+  void replyDropped(algo::WS_OPCODE_ENUM reply, char opcode);
+
+  /**
+   * Drops a message of opcode over the rate limits of the session before it is copied and
+   * answers THROTTLED. Returns true if the message is dropped. Runs within the strand.
+   **/
+  bool throttle(char opcode, std::size_t bytes, std::chrono::steady_clock::time_point now);
+
+  void on_close(beast::error_code ec);
+
+  bool isFullyCreated_{false};
+
+  // Ping and idle policies, see ServerConfig
+  const std::chrono::seconds pingInterval_;
+
+  const std::chrono::seconds pongTimeout_;
+
+  const std::chrono::seconds idleTimeout_;
+
+  // Max size of incoming and outgoing messages
+  const std::size_t maxMessageSize_;
+
+  // Max queued messages, 0 for unlimited
+  const std::size_t maxSendQueueSize_;
+
+  const std::size_t maxReceiveQueueSize_;
+
+  // Messages are read in fragments (read_some) if some opcode is streamed, see WsStreamConsumer
+  const bool isStreamingReads_;
+
+  // Max bytes of one fragment, memory of a streamed message does not grow over it
+  static constexpr std::size_t READ_FRAGMENT_SIZE = 64 * 1024;
 
   /**
    * The websocket::stream class template provides asynchronous and blocking message-oriented
    * functionality necessary for clients and servers to utilize the WebSocket protocol.
    * @note all asynchronous operations are performed within the same implicit or explicit strand.
    **/
-  boost::beast::websocket::stream<boost::asio::ip::tcp::socket> ws_;
+  std::variant<PlainStream, TlsStream> ws_;
+
+  // Threads for TLS handshakes, nullptr to run them within the strand
+  boost::asio::thread_pool* tlsHandshakePool_;
+
+  // Runs the handshake on tlsHandshakePool_, set by asyncTlsHandshake
+  std::optional<boost::asio::strand<boost::asio::thread_pool::executor_type>>
+      tlsHandshakeStrand_;
+
+  // The handshake on tlsHandshakeStrand_ uses the socket, the strand does not
+  std::atomic<bool> isTlsHandshakeOffloaded_{false};
 
   /**
    * I/O objects such as sockets and streams are not thread-safe. For efficiency, networking adopts
@@ -113,20 +334,168 @@ private:
    */
   boost::asio::strand<boost::asio::io_context::executor_type> strand_;
 
-  boost::asio::ip::tcp::resolver resolver_;
+  // Keeps capacity of up to READ_FRAGMENT_SIZE across messages, consumed by consumeAll()
+  ReceiveBuffer recievedBuffer_{READ_FRAGMENT_SIZE};
+
+  /**
+   * Time of the last remote activity (steady_clock ticks since epoch).
+   * @note no per-session asio timer: sessions are checked by the timer wheel of WSServer,
+   * so remote activity only stores a timestamp instead of re-arming a timer.
+   **/
+  std::atomic<std::chrono::steady_clock::rep> lastActivity_{0};
+
+  // Time of the last incoming message, used by idle timeout
+  std::atomic<std::chrono::steady_clock::rep> lastMessage_{0};
+
+  // Time of the last ping, used by pong timeout
+  std::atomic<std::chrono::steady_clock::rep> lastPing_{0};
 
-  boost::beast::multi_buffer recievedBuffer_;
+  /**
+   * Completion handler memory, one arena per chain of operations, so the steady-state
+   * read/write/ping/deadline cycle does not allocate handlers on the heap.
+   * Accept (handshake) uses readMemory_, it completes before the first read.
+   **/
+  SessionHandlerMemory readMemory_;
 
-  boost::asio::steady_timer timer_;
+  SessionHandlerMemory writeMemory_;
+
+  // NOTE: smaller than read and write memory, every session carries them
+  SessionPingMemory pingMemory_;
+
+  SessionTimerMemory timerMemory_;
 
   bool isSendBusy_;
 
-  std::vector<std::shared_ptr<const std::string>> sendQueue_;
+  std::vector<OutgoingMessage> sendQueue_;
+
+  // see getPendingSendCount()
+  std::atomic<std::size_t> pendingSends_{0};
+
+  std::unique_ptr<algo::CsvAggregator> csvUpload_;
+
+  // Consumer of the message being read, nullptr if it is read as a whole
+  std::shared_ptr<WsStreamConsumer> streamConsumer_;
+
+  // Opcode of the message of streamConsumer_
+  char streamOpcode_{0};
+
+  // Cancel epoch of the message of streamConsumer_, taken at its first fragment
+  std::uint64_t streamCancelEpoch_{0};
+
+  // The rest of a throttled streamed message is skipped, accessed within the strand
+  bool isDroppingMessage_{false};
+
+  // Created by the first message if rate limits are set, idle sessions do not carry it
+  std::unique_ptr<SessionRateLimiter> rateLimiter_;
+
+  /**
+   * Callbacks of DispatchLane::HEAVY, the first one is running. One job of the session is
+   * posted to the heavy threads at a time, so callbacks of a session run in order.
+   * NOTE: not an asio strand of the heavy threads, sessions may outlive them.
+   **/
+  struct HeavyMessages {
+    std::mutex mutex;
+
+    std::deque<std::function<void()>> callbacks;
+  };
+
+  // Created by the first heavy message within the strand, before any job is posted
+  std::unique_ptr<HeavyMessages> heavyMessages_;
+
+  // Advanced by cancelReceived(), every received message keeps the epoch it arrived at
+  CancelEpoch cancelEpoch_;
+
+  // Some fragments of a message are read, the next fragment does not start with an opcode
+  bool isReadingMessage_{false};
+
+  // closeGracefully() is called, accessed within the strand
+  bool isClosing_{false};
+
+  // The close frame is being sent, accessed within the strand
+  bool isCloseSent_{false};
+
+  // Unregistered by close() or by the closing handshake, the other one does nothing
+  std::atomic<bool> isClosed_{false};
 
   NetworkManager* nm_;
 
-  PING_STATE pingState_ = PING_STATE::ALIVE;
+  std::optional<boost::asio::ip::address> admittedAddress_;
+
+  // NOTE: atomic, deadline() reads it from the timer wheel thread
+  std::atomic<PING_STATE> pingState_{PING_STATE::ALIVE};
+
+  // State of connectAsClient, accepted sessions do not carry it
+  struct ClientConnect {
+    explicit ClientConnect(boost::asio::io_context& ioc) : resolver(ioc) {}
+
+    boost::asio::ip::tcp::resolver resolver;
+
+    // Called once by finishConnect
+    ConnectHandler handler;
+
+    // Signalled by finishConnect, waitForConnect waits for it
+    std::mutex mutex;
+
+    std::condition_variable cv;
+
+    bool isFinished{false};
+  };
+
+  // Created by connectAsClient before any asynchronous operation
+  std::unique_ptr<ClientConnect> clientConnect_;
+
+  // Set once by the strand when receivedMessagesQueue_ is created, see receivedMessages()
+  std::atomic<bool> hasReceivedMessagesQueue_{false};
+
+private:
+  // Common part of constructors, ws_ is created from streamArgs
+  template <typename Stream, typename... StreamArgs>
+  WsSession(std::in_place_type_t<Stream> streamType, NetworkManager* nm, const std::string& id,
+            StreamArgs&&... streamArgs);
 };
 
+template <typename Handler> void WsSession::asyncReadMessage(Handler&& handler) {
+  visitStream([this, &handler](auto& ws) {
+    if (isStreamingReads_) {
+      ws.async_read_some(recievedBuffer_, READ_FRAGMENT_SIZE, std::forward<Handler>(handler));
+    } else {
+      ws.async_read(recievedBuffer_, std::forward<Handler>(handler));
+    }
+  });
+}
+
+template <typename Handler> void WsSession::asyncTlsHandshake(Handler&& handler) {
+  auto& tlsStream = std::get<TlsStream>(ws_).next_layer();
+
+  if (!tlsHandshakePool_) {
+    tlsStream.async_handshake(
+        ssl::stream_base::server,
+        net::bind_executor(strand_, [self = shared_from_this(),
+                                     handler = std::forward<Handler>(handler)](
+                                        beast::error_code ec) mutable {
+          self->releaseTlsHandshakeSlot();
+          handler(ec);
+        }));
+    return;
+  }
+
+  // NOTE: intermediate handlers of ssl::stream run on the executor of the final handler,
+  // so the crypto of the handshake runs on tlsHandshakePool_
+  if (!tlsHandshakeStrand_) {
+    tlsHandshakeStrand_.emplace(tlsHandshakePool_->get_executor());
+  }
+  isTlsHandshakeOffloaded_ = true;
+  tlsStream.async_handshake(
+      ssl::stream_base::server,
+      net::bind_executor(*tlsHandshakeStrand_,
+                         [self = shared_from_this(), handler = std::forward<Handler>(handler)](
+                             beast::error_code ec) mutable {
+                           // the socket is back within the strand
+                           self->isTlsHandshakeOffloaded_ = false;
+                           self->releaseTlsHandshakeSlot();
+                           net::post(self->strand_, beast::bind_handler(std::move(handler), ec));
+                         }));
+}
+
 } // namespace net
 } // namespace boostander
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "net/AdmissionControl.hpp"
+#include <boost/asio/ip/address.hpp>
+
+#include "testsCommon.h"
+
+SCENARIO("admissionControl", "[AdmissionControl]") {
+  using namespace boostander::net;
+  using Verdict = AdmissionControl::Verdict;
+  const auto first = boost::asio::ip::make_address("10.0.0.1");
+  const auto second = boost::asio::ip::make_address("10.0.0.2");
+
+  GIVEN("no limits") {
+    AdmissionControl admission(0, 0, 0, 0);
+    CHECK_FALSE(admission.isEnabled());
+    for (int i = 0; i < 100; i++) {
+      REQUIRE(admission.admit(first) == Verdict::ADMITTED);
+    }
+    admission.updateLoad(1000000, 100.0);
+    CHECK_FALSE(admission.isOverloaded());
+    CHECK(admission.canAccept());
+  }
+
+  GIVEN("max sessions") {
+    AdmissionControl admission(2, 0, 0, 0);
+    REQUIRE(admission.admit(first) == Verdict::ADMITTED);
+    REQUIRE(admission.admit(second) == Verdict::ADMITTED);
+    CHECK_FALSE(admission.canAccept());
+    CHECK(admission.admit(first) == Verdict::TOO_MANY_SESSIONS);
+    CHECK(admission.getSessions() == 2);
+
+    admission.release(first);
+    CHECK(admission.canAccept());
+    CHECK(admission.admit(second) == Verdict::ADMITTED);
+  }
+
+  GIVEN("max sessions per address") {
+    AdmissionControl admission(0, 2, 0, 0);
+    REQUIRE(admission.admit(first) == Verdict::ADMITTED);
+    REQUIRE(admission.admit(first) == Verdict::ADMITTED);
+    CHECK(admission.admit(first) == Verdict::TOO_MANY_FROM_ADDRESS);
+    // other addresses are not limited by it
+    CHECK(admission.admit(second) == Verdict::ADMITTED);
+    CHECK(admission.getSessions() == 3);
+    CHECK(admission.canAccept());
+
+    admission.release(first);
+    CHECK(admission.admit(first) == Verdict::ADMITTED);
+  }
+
+  GIVEN("queued messages threshold") {
+    AdmissionControl admission(0, 0, 1000, 0);
+    REQUIRE(admission.isLoadLimited());
+    admission.updateLoad(999, 100.0);
+    CHECK_FALSE(admission.isOverloaded());
+    admission.updateLoad(1000, 0.0);
+    CHECK(admission.isOverloaded());
+    CHECK_FALSE(admission.canAccept());
+
+    // the overload lasts until the load is well below the threshold
+    admission.updateLoad(800, 0.0);
+    CHECK(admission.isOverloaded());
+    admission.updateLoad(700, 0.0);
+    CHECK_FALSE(admission.isOverloaded());
+    CHECK(admission.canAccept());
+  }
+
+  GIVEN("CPU threshold") {
+    AdmissionControl admission(0, 0, 0, 80);
+    admission.updateLoad(1000000, 79.0);
+    CHECK_FALSE(admission.isOverloaded());
+    admission.updateLoad(0, 95.0);
+    CHECK(admission.isOverloaded());
+    admission.updateLoad(0, 70.0);
+    CHECK(admission.isOverloaded());
+    admission.updateLoad(0, 50.0);
+    CHECK_FALSE(admission.isOverloaded());
+  }
+
+  GIVEN("CPU usage of the process") {
+    ProcessCpuUsage cpuUsage;
+    volatile double sum = 0.0;
+    for (int i = 0; i < 1000000; i++) {
+      sum = sum + i;
+    }
+    const double percent = cpuUsage.sample();
+    CHECK(percent >= 0.0);
+    CHECK(percent <= 100.0 + 1.0);
+  }
+}
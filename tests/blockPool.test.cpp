@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "net/BlockPool.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "testsCommon.h"
+
+SCENARIO("blockPool", "[BlockPool]") {
+  using namespace boostander::net;
+
+  GIVEN("blocks of a pool") {
+    BlockPool pool(100, 4);
+    REQUIRE(pool.getBlockSize() == 2 * CACHE_LINE_SIZE);
+
+    std::vector<void*> blocks;
+    for (int i = 0; i < 6; i++) {
+      blocks.push_back(pool.allocate(100));
+      // cache line aligned
+      CHECK(reinterpret_cast<std::uintptr_t>(blocks.back()) % CACHE_LINE_SIZE == 0);
+    }
+    CHECK(pool.getBlocksInUse() == 6);
+    CHECK(pool.getBlocksCount() == 8);
+
+    // the last freed block is reused first, no new slabs for churn
+    void* freed = blocks.back();
+    pool.deallocate(freed, 100);
+    CHECK(pool.getBlocksInUse() == 5);
+    CHECK(pool.allocate(100) == freed);
+    CHECK(pool.getBlocksCount() == 8);
+
+    for (void* block : blocks) {
+      pool.deallocate(block, 100);
+    }
+    CHECK(pool.getBlocksInUse() == 0);
+    CHECK(pool.getHeapAllocationsCount() == 0);
+  }
+
+  GIVEN("too big allocation") {
+    BlockPool pool(64, 4);
+    void* big = pool.allocate(1000);
+    CHECK(pool.getHeapAllocationsCount() == 1);
+    CHECK(pool.getBlocksInUse() == 0);
+    pool.deallocate(big, 1000);
+  }
+
+  GIVEN("allocate_shared") {
+    BlockPool pool(sizeof(std::string) + 64, 2);
+    {
+      auto first = std::allocate_shared<std::string>(PoolAllocator<std::string>(pool), "first");
+      auto second = std::allocate_shared<std::string>(PoolAllocator<std::string>(pool), "second");
+      CHECK(*first == "first");
+      CHECK(pool.getBlocksInUse() == 2);
+    }
+    CHECK(pool.getBlocksInUse() == 0);
+    CHECK(pool.getHeapAllocationsCount() == 0);
+  }
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "algo/DispatchQueue.hpp"
+#include "net/CancelEpoch.hpp"
+#include <cctype>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "testsCommon.h"
+
+SCENARIO("cancelEpoch", "[CancelEpoch]") {
+  using boostander::algo::DispatchQueue;
+  using boostander::net::CancelEpoch;
+
+  CancelEpoch session;
+  DispatchQueue queue("session", 0);
+
+  // callbacks in the order they ran, upper case if cancelled
+  std::string order;
+
+  // a message is received by the session: it keeps the epoch and waits for the tick
+  std::function<void(char, std::function<void()>)> receive =
+      [&](char name, std::function<void()> whileRunning) {
+        const std::uint64_t epoch = session.current();
+        queue.dispatch([&session, &order, name, epoch, whileRunning]() {
+          CancelEpoch::RunningCallback runningCallback(session, epoch);
+          if (whileRunning) {
+            whileRunning();
+          }
+          order += session.isCancelled() ? static_cast<char>(std::toupper(name)) : name;
+        });
+      };
+
+  GIVEN("cancel received while an analysis runs") {
+    receive('a', [&]() {
+      session.cancel();
+      receive('c', nullptr);
+    });
+    receive('b', nullptr);
+    queue.DispatchQueued();
+    // the running and the queued analyses are cancelled, the later one is not
+    CHECK(order == "ABc");
+  }
+
+  GIVEN("cancel received before the tick") {
+    receive('a', nullptr);
+    session.cancel();
+    receive('b', nullptr);
+    queue.DispatchQueued();
+    CHECK(order == "Ab");
+  }
+
+  GIVEN("callbacks of other sessions") {
+    CancelEpoch other;
+    receive('a', [&]() {
+      {
+        CancelEpoch::RunningCallback runningCallback(other, other.current());
+        session.cancel();
+        CHECK_FALSE(other.isCancelled());
+        CHECK_FALSE(session.isCancelled());
+      }
+      // restored after the nested callback
+      CHECK(session.isCancelled());
+    });
+    queue.DispatchQueued();
+    CHECK(order == "A");
+    // outside of callbacks
+    CHECK_FALSE(session.isCancelled());
+  }
+}
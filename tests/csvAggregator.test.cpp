@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "algo/CSV.hpp"
+#include "algo/CsvAggregator.hpp"
+#include "algo/StringUtils.hpp"
+#include <boost/format.hpp>
+#include <chrono>
+#include <cstddef>
+#include <locale>
+#include <random>
+#include <string>
+
+#include "testsCommon.h"
+
+namespace {
+
+// Rows as in the randomCSV test, in random order of dates
+std::string makeRandomCsv(std::size_t rows) {
+  std::mt19937 randomGenerator(7);
+  std::uniform_int_distribution<int> iRoll(1, 1000);
+  std::uniform_real_distribution<double> dRoll(1, 1000);
+
+  std::string csv;
+  const auto start = std::chrono::system_clock::time_point() + std::chrono::hours(24 * 365 * 49);
+  for (std::size_t i = 0; i < rows; i++) {
+    csv += boostander::algo::dateToStr(start + std::chrono::hours(iRoll(randomGenerator)));
+    csv += ',';
+    csv += boost::str(boost::format("%.9f") % dRoll(randomGenerator));
+    csv += ',';
+    csv += boost::str(boost::format("%.9f") % dRoll(randomGenerator));
+    csv += i % 2 ? "\r\n" : "\n";
+  }
+  return csv;
+}
+
+} // namespace
+
+SCENARIO("csvAggregator", "[CSV]") {
+  using namespace boostander::algo;
+
+  std::locale::global(std::locale::classic()); // https://stackoverflow.com/a/18981514/10904212
+
+  const std::string data = makeRandomCsv(200);
+
+  CsvAggregator whole;
+  whole.feed(data);
+  whole.finish();
+
+  GIVEN("the rows count of CSV") {
+    CSV csv;
+    csv.loadFromMemory(data);
+    CHECK(whole.getRowsCount() == csv.getRowsCount());
+    CHECK(whole.getRowsCount() == 200);
+    CHECK(whole.getBytesCount() == data.size());
+    CHECK(whole.getRatio() != 0.0);
+  }
+
+  GIVEN("any chunk sizes") {
+    for (const std::size_t chunkSize : {1u, 2u, 7u, 64u, 1000u}) {
+      CsvAggregator chunked;
+      for (std::size_t i = 0; i < data.size(); i += chunkSize) {
+        chunked.feed(data.substr(i, chunkSize));
+      }
+      chunked.finish();
+      CHECK(chunked.getRowsCount() == whole.getRowsCount());
+      CHECK(chunked.getMaxDate() == whole.getMaxDate());
+      CHECK(chunked.getRatio() == whole.getRatio());
+    }
+  }
+
+  GIVEN("last row without line break") {
+    CsvAggregator csv;
+    csv.feed("28.02.2019 10:18:05,1.5,3\n\n,,\n28.02.2019 11:18:05,");
+    CHECK(csv.getRowsCount() == 1);
+    csv.feed("2,8");
+    csv.finish();
+    CHECK(csv.getRowsCount() == 2);
+    CHECK(csv.getMaxDate() == dateTimeFromStr("28.02.2019 11:18:05"));
+    CHECK(csv.getRatio() == Approx(0.25));
+  }
+
+  GIVEN("too long row") {
+    CsvAggregator csv;
+    csv.feed(std::string(CsvAggregator::MAX_ROW_SIZE / 2, 'x'));
+    csv.feed(std::string(CsvAggregator::MAX_ROW_SIZE, 'x'));
+    csv.feed("x\n1,2,3\n");
+    csv.finish();
+    CHECK(csv.getSkippedRowsCount() == 1);
+    CHECK(csv.getRowsCount() == 1);
+  }
+
+  GIVEN("partial results") {
+    CsvAggregator csv;
+    csv.feed("28.02.2019 10:18:05,1.5,3\n28.02.2019 11:18");
+    CHECK(csvPartialResults(WS_OPCODE::CSV_PROGRESS, csv) ==
+          "71;42;" + dateToStr(dateTimeFromStr("28.02.2019 10:18:05")) + ";0.5");
+    CHECK(csvPartialResults(WS_OPCODE::CSV_CANCEL, csv).front() == '8');
+  }
+
+  GIVEN("progress after every 100 bytes") {
+    CsvProgress progress(100);
+    CsvAggregator csv;
+    std::string due;
+    for (int i = 0; i < 6; i++) {
+      csv.feed(std::string(39, 'x') + "\n");
+      due += progress.update(csv) ? '1' : '0';
+    }
+    // 120 bytes, then 240
+    CHECK(due == "001001");
+  }
+
+  GIVEN("no progress") {
+    CsvProgress progress(0);
+    CHECK_FALSE(progress.update(whole));
+  }
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "algo/DispatchQueue.hpp"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "testsCommon.h"
+
+SCENARIO("dispatchQueue", "[DispatchQueue]") {
+  using boostander::algo::DispatchQueue;
+  using namespace std::chrono_literals;
+
+  // order of callbacks over all queues, by the name of the queue
+  std::string order;
+  const auto fill = [&order](DispatchQueue& queue, char name, int callbacks) {
+    for (int i = 0; i < callbacks; i++) {
+      queue.dispatch([&order, name]() { order += name; });
+    }
+  };
+
+  GIVEN("no quantum") {
+    auto chatty = std::make_shared<DispatchQueue>("chatty", 0);
+    auto quiet = std::make_shared<DispatchQueue>("quiet", 0);
+    fill(*chatty, 'c', 5);
+    fill(*quiet, 'q', 1);
+    std::vector<DispatchQueue::OwnedQueue> queues{{nullptr, chatty}, {nullptr, quiet}};
+    DispatchQueue::dispatchFair(queues, 0ns, 0);
+    // a queue is drained in one turn
+    CHECK(order == "cccccq");
+    CHECK(queues.empty());
+  }
+
+  GIVEN("quantum of callbacks") {
+    auto chatty = std::make_shared<DispatchQueue>("chatty", 0);
+    auto quiet = std::make_shared<DispatchQueue>("quiet", 0);
+    auto other = std::make_shared<DispatchQueue>("other", 0);
+    fill(*chatty, 'c', 7);
+    fill(*quiet, 'q', 1);
+    fill(*other, 'o', 3);
+    std::vector<DispatchQueue::OwnedQueue> queues{
+        {nullptr, chatty}, {nullptr, quiet}, {nullptr, other}};
+    DispatchQueue::dispatchFair(queues, 0ns, 2);
+    // up to 2 callbacks per turn, emptied queues leave the rounds
+    CHECK(order == "ccqooccoccc");
+    CHECK(queues.empty());
+  }
+
+  GIVEN("quantum of callback time") {
+    auto slow = std::make_shared<DispatchQueue>("slow", 0);
+    auto fast = std::make_shared<DispatchQueue>("fast", 0);
+    for (int i = 0; i < 3; i++) {
+      slow->dispatch([&order]() {
+        order += 's';
+        std::this_thread::sleep_for(5ms);
+      });
+    }
+    fill(*fast, 'f', 3);
+    std::vector<DispatchQueue::OwnedQueue> queues{{nullptr, slow}, {nullptr, fast}};
+    DispatchQueue::dispatchFair(queues, 1ms, 0);
+    // the first slow callback takes the credit of a few turns, fast ones run meanwhile
+    CHECK(order == "sfffss");
+  }
+
+  GIVEN("callbacks dispatched during the tick") {
+    auto chatty = std::make_shared<DispatchQueue>("chatty", 0);
+    auto late = std::make_shared<DispatchQueue>("late", 0);
+    // an I/O thread keeps refilling the queue while it is dispatched
+    std::function<void()> refill = [&]() {
+      order += 'c';
+      chatty->dispatch(refill);
+      late->dispatch([&order]() { order += 'l'; });
+    };
+    chatty->dispatch(refill);
+    fill(*chatty, 'c', 1);
+    std::vector<DispatchQueue::OwnedQueue> queues{{nullptr, chatty}};
+    DispatchQueue::dispatchFair(queues, 0ns, 1);
+    // the tick ends after the callbacks it started with
+    CHECK(order == "cc");
+    CHECK(queues.empty());
+    CHECK(chatty->size() == 1);
+    // the next tick takes the session that had no messages before
+    queues = {{nullptr, chatty}, {nullptr, late}};
+    DispatchQueue::dispatchFair(queues, 0ns, 1);
+    CHECK(order == "cccl");
+    chatty->clear();
+    late->clear();
+  }
+
+  GIVEN("owner released by others during the tick") {
+    // stands for a session, its callbacks use it by a raw pointer
+    struct Owner {
+      explicit Owner(bool& destroyed) : destroyed_(destroyed) {}
+      ~Owner() { destroyed_ = true; }
+      bool& destroyed_;
+      int handled = 0;
+    };
+    bool destroyed = false;
+    auto owner = std::make_shared<Owner>(destroyed);
+    auto ownerQueue = std::make_shared<DispatchQueue>("owner", 0);
+    auto other = std::make_shared<DispatchQueue>("other", 0);
+    std::weak_ptr<Owner> weakOwner = owner;
+    // the session is unregistered by an I/O thread while its messages wait
+    other->dispatch([&owner]() { owner.reset(); });
+    for (int i = 0; i < 3; i++) {
+      ownerQueue->dispatch([ownerPtr = owner.get(), &destroyed]() {
+        CHECK_FALSE(destroyed);
+        ownerPtr->handled++;
+      });
+    }
+    std::vector<DispatchQueue::OwnedQueue> queues{{nullptr, other}, {owner, ownerQueue}};
+    DispatchQueue::dispatchFair(queues, 0ns, 1);
+    CHECK(owner == nullptr);
+    // released with the last callback of its queue
+    CHECK(destroyed);
+    CHECK(weakOwner.expired());
+    CHECK(queues.empty());
+  }
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "metrics/MemoryAccounting.hpp"
+#include "net/HandlerAllocator.hpp"
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "testsCommon.h"
+
+namespace {
+
+#ifdef BOOSTANDER_MEMORY_ACCOUNTING
+
+// operator new is replaced by memory accounting, it counts allocations too
+std::size_t allocationsCount() { return boostander::metrics::getTotalAllocationsCount(); }
+
+} // namespace
+
+#else
+
+std::atomic<std::size_t> gAllocationsCount{0};
+
+std::size_t allocationsCount() { return gAllocationsCount.load(); }
+
+} // namespace
+
+// Replaced global allocation functions, only count calls
+void* operator new(std::size_t size) {
+  gAllocationsCount.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+#endif // BOOSTANDER_MEMORY_ACCOUNTING
+
+namespace {
+
+namespace beast = boost::beast;         // from <boost/beast.hpp>
+namespace websocket = beast::websocket; // from <boost/beast/websocket.hpp>
+namespace net = boost::asio;            // from <boost/asio.hpp>
+using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
+
+using boostander::net::makeCustomAllocHandler;
+using boostander::net::SessionHandlerMemory;
+using boostander::net::SessionPingMemory;
+using boostander::net::SessionTimerMemory;
+
+/**
+ * Same chains of asio and beast operations as WsSession: server reads a message, writes
+ * the answer, sends a ping and waits on a timer. The client keeps a read pending (answers pongs).
+ * NOTE: covers only the handlers of the chains, not the per message work of WsSession
+ * (the received message, its dispatched callback, the send queue).
+ **/
+struct EchoCycle {
+  explicit EchoCycle(net::io_context& ioc)
+      : ioc_(ioc), server_(ioc), client_(ioc), timer_(ioc), message_(100, 'x') {}
+
+  void start() {
+    clientRead();
+    clientWrite();
+  }
+
+  void clientRead() {
+    client_.async_read(clientBuffer_, makeCustomAllocHandler(clientReadMemory_,
+                                                             [this](beast::error_code ec,
+                                                                    std::size_t) {
+                                                               if (ec) {
+                                                                 return;
+                                                               }
+                                                               clientBuffer_.consume(
+                                                                   clientBuffer_.size());
+                                                               clientRead();
+                                                             }));
+  }
+
+  void clientWrite() {
+    if (++iterations_ == warmupIterations) {
+      allocationsAfterWarmup_ = allocationsCount();
+    }
+    if (iterations_ > totalIterations) {
+      allocationsAtEnd_ = allocationsCount();
+      ioc_.stop();
+      return;
+    }
+    client_.async_write(net::buffer(message_),
+                        makeCustomAllocHandler(clientWriteMemory_,
+                                               [this](beast::error_code ec, std::size_t) {
+                                                 if (!ec) {
+                                                   serverRead();
+                                                 }
+                                               }));
+  }
+
+  void serverRead() {
+    server_.async_read(serverBuffer_, makeCustomAllocHandler(readMemory_, [this](
+                                                                              beast::error_code ec,
+                                                                              std::size_t) {
+                         if (!ec) {
+                           serverBuffer_.consume(serverBuffer_.size());
+                           serverWrite();
+                         }
+                       }));
+  }
+
+  void serverWrite() {
+    server_.async_write(net::buffer(message_),
+                        makeCustomAllocHandler(writeMemory_,
+                                               [this](beast::error_code ec, std::size_t) {
+                                                 if (!ec) {
+                                                   serverPing();
+                                                 }
+                                               }));
+  }
+
+  void serverPing() {
+    server_.async_ping({}, makeCustomAllocHandler(pingMemory_, [this](beast::error_code ec) {
+                         if (!ec) {
+                           serverTimer();
+                         }
+                       }));
+  }
+
+  void serverTimer() {
+    timer_.expires_after(std::chrono::microseconds(1));
+    timer_.async_wait(makeCustomAllocHandler(timerMemory_, [this](beast::error_code ec) {
+      if (!ec) {
+        clientWrite();
+      }
+    }));
+  }
+
+  static constexpr std::size_t warmupIterations = 16;
+
+  static constexpr std::size_t totalIterations = 256;
+
+  net::io_context& ioc_;
+
+  websocket::stream<tcp::socket> server_;
+
+  websocket::stream<tcp::socket> client_;
+
+  net::steady_timer timer_;
+
+  const std::string message_;
+
+  beast::flat_buffer serverBuffer_;
+
+  beast::flat_buffer clientBuffer_;
+
+  SessionHandlerMemory readMemory_;
+
+  SessionHandlerMemory writeMemory_;
+
+  SessionPingMemory pingMemory_;
+
+  SessionTimerMemory timerMemory_;
+
+  SessionHandlerMemory clientReadMemory_;
+
+  SessionHandlerMemory clientWriteMemory_;
+
+  std::size_t iterations_ = 0;
+
+  std::size_t allocationsAfterWarmup_ = 0;
+
+  std::size_t allocationsAtEnd_ = 0;
+};
+
+} // namespace
+
+SCENARIO("handlerMemory", "[net]") {
+  boostander::net::HandlerMemory<64, 2> memory;
+
+  void* first = memory.allocate(64);
+  void* second = memory.allocate(32);
+  CHECK(first != second);
+  CHECK(memory.heapFallbacks() == 0);
+
+  // all slots busy
+  void* third = memory.allocate(16);
+  CHECK(memory.heapFallbacks() == 1);
+
+  // too big for a slot
+  memory.deallocate(second);
+  void* big = memory.allocate(128);
+  CHECK(memory.heapFallbacks() == 2);
+
+  // freed slot is reused
+  CHECK(memory.allocate(8) == second);
+
+  // over-aligned handler state is not placed into a slot
+  struct alignas(128) OverAlignedState {
+    char state[8];
+  };
+  boostander::net::HandlerAllocator<OverAlignedState, decltype(memory)> allocator(memory);
+  memory.deallocate(first);
+  OverAlignedState* aligned = allocator.allocate(1);
+  CHECK(reinterpret_cast<std::uintptr_t>(aligned) % alignof(OverAlignedState) == 0);
+  CHECK(memory.heapFallbacks() == 3);
+  allocator.deallocate(aligned, 1);
+
+  memory.deallocate(second);
+  memory.deallocate(third);
+  memory.deallocate(big);
+}
+
+SCENARIO("handlerChainsWithoutAllocations", "[net]") {
+  net::io_context ioc;
+  EchoCycle cycle(ioc);
+
+  tcp::acceptor acceptor(ioc, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+  cycle.client_.next_layer().connect(acceptor.local_endpoint());
+  acceptor.accept(cycle.server_.next_layer());
+
+  cycle.server_.async_accept([](beast::error_code ec) { REQUIRE(!ec); });
+  cycle.client_.async_handshake("127.0.0.1", "/", [](beast::error_code ec) { REQUIRE(!ec); });
+  ioc.run();
+  ioc.restart();
+
+  cycle.start();
+  ioc.run();
+
+  REQUIRE(cycle.iterations_ > EchoCycle::totalIterations);
+  CHECK(cycle.allocationsAtEnd_ - cycle.allocationsAfterWarmup_ == 0);
+
+  // every handler fits into the session arenas
+  CHECK(cycle.readMemory_.heapFallbacks() == 0);
+  CHECK(cycle.writeMemory_.heapFallbacks() == 0);
+  CHECK(cycle.pingMemory_.heapFallbacks() == 0);
+  CHECK(cycle.timerMemory_.heapFallbacks() == 0);
+}
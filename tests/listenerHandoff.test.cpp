@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "net/ListenerHandoff.hpp"
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "testsCommon.h"
+
+namespace {
+
+// Port a listening socket is bound to
+unsigned short localPort(int fd) {
+  sockaddr_in address{};
+  socklen_t length = sizeof(address);
+  if (::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+    return 0;
+  }
+  return ntohs(address.sin_port);
+}
+
+} // namespace
+
+SCENARIO("listenerHandoff", "[ListenerHandoff]") {
+  using namespace boostander::net;
+  using tcp = boost::asio::ip::tcp;
+
+  boost::asio::io_context ioc;
+  tcp::acceptor ws(ioc, tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+  tcp::acceptor metrics(ioc, tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+  const unsigned short wsPort = ws.local_endpoint().port();
+  const unsigned short metricsPort = metrics.local_endpoint().port();
+
+  GIVEN("handles over a socket pair") {
+    int pair[2];
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+
+    ListenerHandles sent;
+    sent.ws = ws.native_handle();
+    sent.metrics = metrics.native_handle();
+    REQUIRE(sendListenerHandles(pair[0], sent));
+
+    const ListenerHandles received = receiveListenerHandles(pair[1]);
+    // own descriptors of the same sockets
+    REQUIRE(received.ws >= 0);
+    REQUIRE(received.metrics >= 0);
+    CHECK(received.wss < 0);
+    CHECK(received.ws != sent.ws);
+    CHECK(localPort(received.ws) == wsPort);
+    CHECK(localPort(received.metrics) == metricsPort);
+
+    ::close(received.ws);
+    ::close(received.metrics);
+    ::close(pair[0]);
+    ::close(pair[1]);
+  }
+
+  GIVEN("nothing to hand off") {
+    int pair[2];
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    CHECK_FALSE(sendListenerHandles(pair[0], ListenerHandles{}));
+    ::close(pair[0]);
+    ::close(pair[1]);
+  }
+
+  GIVEN("a running server at a path") {
+    const std::string path =
+        (std::filesystem::temp_directory_path() /
+         ("boostander_handoff_" + std::to_string(::getpid()) + ".sock"))
+            .string();
+
+    // no server yet, the first start binds its ports
+    CHECK(ListenerHandoff::takeOver(path).empty());
+
+    std::atomic<bool> isHandedOff{false};
+    auto handoff = std::make_shared<ListenerHandoff>(ioc, path);
+    REQUIRE(handoff->listen(
+        [&ws]() {
+          ListenerHandles handles;
+          handles.ws = ws.native_handle();
+          return handles;
+        },
+        [&isHandedOff]() { isHandedOff = true; }));
+    std::thread ioThread([&ioc]() { ioc.run(); });
+
+    const ListenerHandles takenOver = ListenerHandoff::takeOver(path);
+    ioThread.join();
+    CHECK(isHandedOff);
+    REQUIRE(takenOver.ws >= 0);
+    CHECK(localPort(takenOver.ws) == wsPort);
+    CHECK(takenOver.metrics < 0);
+    ::close(takenOver.ws);
+
+    // one handoff only, the new process serves the next one
+    CHECK(ListenerHandoff::takeOver(path).empty());
+    std::filesystem::remove(path);
+  }
+}
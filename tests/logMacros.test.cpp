@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "log/Logger.hpp"
+#include <boost/log/core.hpp>
+#include <boost/log/sinks/basic_sink_backend.hpp>
+#include <boost/log/sinks/sync_frontend.hpp>
+#include <boost/make_shared.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "testsCommon.h"
+
+namespace {
+
+namespace logging = boost::log;
+namespace sinks = boost::log::sinks;
+
+using namespace std::chrono_literals;
+
+// Counts records that reached the sink
+class CountingBackend : public sinks::basic_sink_backend<sinks::synchronized_feeding> {
+public:
+  void consume(const logging::record_view&) { count_++; }
+
+  std::size_t count_ = 0;
+};
+
+int evaluated(int& counter) { return ++counter; }
+
+} // namespace
+
+SCENARIO("logMacros", "[Logger]") {
+  auto backend = boost::make_shared<CountingBackend>();
+  auto sink = boost::make_shared<sinks::synchronous_sink<CountingBackend>>(backend);
+  logging::core::get()->add_sink(sink);
+
+  int evaluatedCount = 0;
+
+  GIVEN("severity below compile-time minimum") {
+    static_assert(!boostander::log::isCompiledIn(boost::log::trivial::debug),
+                  "tests are built with the default minimum severity");
+    LOG(debug) << evaluated(evaluatedCount);
+    CHECK(evaluatedCount == 0);
+    CHECK(backend->count_ == 0);
+
+    LOG(WARNING) << evaluated(evaluatedCount);
+    CHECK(evaluatedCount == 1);
+    CHECK(backend->count_ == 1);
+  }
+
+  GIVEN("single statement in if-else") {
+    const bool condition = false;
+    if (condition)
+      LOG(WARNING) << "not logged";
+    else
+      evaluated(evaluatedCount);
+    CHECK(evaluatedCount == 1);
+    CHECK(backend->count_ == 0);
+  }
+
+  GIVEN("every n-th statement") {
+    for (int i = 0; i < 10; i++) {
+      LOG_EVERY_N(WARNING, 3) << evaluated(evaluatedCount);
+    }
+    // 1st, 4th, 7th and 10th
+    CHECK(evaluatedCount == 4);
+    CHECK(backend->count_ == 4);
+  }
+
+  GIVEN("rate limited statement") {
+    for (int i = 0; i < 10; i++) {
+      LOG_RATE_LIMITED(WARNING, 1h) << evaluated(evaluatedCount);
+    }
+    CHECK(evaluatedCount == 1);
+    CHECK(backend->count_ == 1);
+  }
+
+  logging::core::get()->remove_sink(sink);
+}
+
+SCENARIO("logRateLimiter", "[Logger]") {
+  boostander::log::LogRateLimiter limiter;
+  std::uint64_t suppressed = 0;
+
+  CHECK(limiter.shouldLog(50ms, suppressed));
+  CHECK(suppressed == 0);
+  CHECK_FALSE(limiter.shouldLog(50ms, suppressed));
+  CHECK_FALSE(limiter.shouldLog(50ms, suppressed));
+
+  std::this_thread::sleep_for(60ms);
+  CHECK(limiter.shouldLog(50ms, suppressed));
+  // calls suppressed since the last logged one
+  CHECK(suppressed == 2);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "log/LogQueue.hpp"
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include "testsCommon.h"
+
+SCENARIO("spscRing", "[LogQueue]") {
+  using boostander::log::SpscRing;
+
+  // rounded up to a power of two
+  SpscRing<int> ring(3);
+  REQUIRE(ring.capacity() == 4);
+
+  int value = 0;
+  CHECK_FALSE(ring.tryPop(value));
+
+  for (int i = 0; i < 4; i++) {
+    CHECK(ring.tryPush(i));
+  }
+  // full
+  CHECK_FALSE(ring.tryPush(4));
+
+  // wraps around
+  for (int i = 0; i < 10; i++) {
+    REQUIRE(ring.tryPop(value));
+    CHECK(value == i);
+    CHECK(ring.tryPush(i + 4));
+  }
+}
+
+SCENARIO("perThreadRings", "[LogQueue]") {
+  using boostander::log::PerThreadRings;
+
+  GIVEN("ring is full") {
+    PerThreadRings<int> rings(2);
+    CHECK(rings.push(1));
+    CHECK(rings.push(2));
+    CHECK_FALSE(rings.push(3));
+    CHECK(rings.droppedCount() == 1);
+
+    int value = 0;
+    REQUIRE(rings.tryPop(value));
+    CHECK(value == 1);
+    CHECK(rings.push(3));
+    CHECK(rings.droppedCount() == 1);
+  }
+
+  GIVEN("queues recreated, as sinks by Logger::configure") {
+    for (int i = 0; i < 10; i++) {
+      PerThreadRings<int> rings(2);
+      CHECK(rings.push(i));
+    }
+    PerThreadRings<int> rings(2);
+    CHECK(rings.push(10));
+    // rings of destroyed queues are forgotten
+    CHECK(PerThreadRings<int>::threadRingsCount() == 1);
+  }
+
+  GIVEN("many producer threads") {
+    constexpr int producersCount = 4;
+    constexpr int valuesPerProducer = 10000;
+    PerThreadRings<int> rings(valuesPerProducer);
+
+    std::atomic<int> finishedProducers{0};
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < producersCount; producer++) {
+      producers.emplace_back([&rings, &finishedProducers, producer]() {
+        for (int i = 0; i < valuesPerProducer; i++) {
+          rings.push(producer * valuesPerProducer + i);
+        }
+        finishedProducers++;
+      });
+    }
+
+    // order is preserved per producer
+    std::vector<int> lastValues(producersCount, -1);
+    std::size_t popped = 0;
+    bool isOrdered = true;
+    int value = 0;
+    while (true) {
+      // NOTE: read before tryPop, all values of finished producers are visible then
+      const bool isFinished = finishedProducers == producersCount;
+      if (rings.tryPop(value)) {
+        const int producer = value / valuesPerProducer;
+        isOrdered = isOrdered && value > lastValues[producer];
+        lastValues[producer] = value;
+        popped++;
+        continue;
+      }
+      if (isFinished) {
+        break;
+      }
+      std::this_thread::yield();
+    }
+    for (std::thread& producer : producers) {
+      producer.join();
+    }
+
+    CHECK(isOrdered);
+    CHECK(rings.droppedCount() == 0);
+    CHECK(popped == producersCount * valuesPerProducer);
+  }
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "metrics/MemoryAccounting.hpp"
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "testsCommon.h"
+
+SCENARIO("memoryAccounting", "[metrics]") {
+  using namespace boostander::metrics;
+
+  GIVEN("scoped tags") {
+    REQUIRE(getThreadMemoryTag() == MemoryTag::OTHER);
+    {
+      ScopedMemoryTag sessionTag(MemoryTag::SESSION);
+      CHECK(getThreadMemoryTag() == MemoryTag::SESSION);
+      {
+        ScopedMemoryTag sendTag(MemoryTag::SEND_QUEUE);
+        CHECK(getThreadMemoryTag() == MemoryTag::SEND_QUEUE);
+      }
+      CHECK(getThreadMemoryTag() == MemoryTag::SESSION);
+    }
+    CHECK(getThreadMemoryTag() == MemoryTag::OTHER);
+    CHECK(std::string(memoryTagName(MemoryTag::RECEIVE_QUEUE)) == "receive_queue");
+  }
+
+  GIVEN("bytes of a tag") {
+    const MemoryUsage before = getMemoryUsage(MemoryTag::SEND_QUEUE);
+    std::unique_ptr<char[]> block;
+    {
+      ScopedMemoryTag tag(MemoryTag::SEND_QUEUE);
+      block.reset(new char[1000]);
+    }
+    const MemoryUsage allocated = getMemoryUsage(MemoryTag::SEND_QUEUE);
+
+    // freed by another thread, still returned to the tag
+    std::thread([&block]() { block.reset(); }).join();
+    const MemoryUsage after = getMemoryUsage(MemoryTag::SEND_QUEUE);
+
+    if (isMemoryAccountingEnabled()) {
+      CHECK(allocated.bytes - before.bytes == 1000);
+      CHECK(allocated.allocations - before.allocations == 1);
+      CHECK(after.bytes == before.bytes);
+    } else {
+      CHECK(allocated.bytes == 0);
+      CHECK(after.bytes == 0);
+    }
+  }
+
+  GIVEN("prometheus text") {
+    CHECK(getResidentMemoryBytes() > 0);
+    std::ostringstream out;
+    renderMemoryMetrics(out);
+    CHECK(out.str().find("process_resident_memory_bytes ") != std::string::npos);
+    CHECK((out.str().find("heap_bytes{subsystem=\"network\"}") != std::string::npos) ==
+          isMemoryAccountingEnabled());
+  }
+}
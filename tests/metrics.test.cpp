@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "metrics/Metrics.hpp"
+#include "metrics/Tracing.hpp"
+#include "net/MetricsListener.hpp"
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "testsCommon.h"
+
+namespace {
+
+namespace beast = boost::beast;   // from <boost/beast.hpp>
+namespace http = beast::http;     // from <boost/beast/http.hpp>
+namespace net = boost::asio;      // from <boost/asio.hpp>
+using tcp = boost::asio::ip::tcp; // from <boost/asio/ip/tcp.hpp>
+
+using namespace std::chrono_literals;
+
+// Stand-in for a Prometheus scraper: one blocking HTTP GET
+http::response<http::string_body> httpGet(unsigned short port, const std::string& target) {
+  net::io_context ioc;
+  tcp::socket socket(ioc);
+  socket.connect(tcp::endpoint(net::ip::make_address("127.0.0.1"), port));
+
+  http::request<http::string_body> request{http::verb::get, target, 11};
+  request.set(http::field::host, "127.0.0.1");
+  http::write(socket, request);
+
+  beast::flat_buffer buffer;
+  http::response<http::string_body> response;
+  http::read(socket, buffer, response);
+
+  beast::error_code ec;
+  socket.shutdown(tcp::socket::shutdown_both, ec);
+  return response;
+}
+
+} // namespace
+
+SCENARIO("metricsValues", "[Metrics]") {
+  using namespace boostander::metrics;
+
+  GIVEN("counter and gauge updated from several threads") {
+    Counter counter;
+    Gauge gauge;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+      threads.emplace_back([&counter, &gauge]() {
+        for (int j = 0; j < 1000; j++) {
+          counter.inc();
+          gauge.add(2);
+          gauge.sub();
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    CHECK(counter.value() == 4000);
+    CHECK(gauge.value() == 4000);
+  }
+
+  GIVEN("histogram buckets") {
+    // buckets are contiguous, every value is below the upper bound of its bucket
+    for (std::uint64_t ns = 0; ns < 100000; ns++) {
+      const std::size_t index = Histogram::bucketIndex(ns);
+      REQUIRE(ns < Histogram::bucketUpperBound(index));
+      REQUIRE((index == 0 || ns >= Histogram::bucketUpperBound(index - 1)));
+    }
+    CHECK(Histogram::bucketIndex(Histogram::HISTOGRAM_MAX_NS - 1) ==
+          Histogram::HISTOGRAM_BUCKETS - 1);
+    CHECK(Histogram::bucketIndex(std::uint64_t(1) << 50) == Histogram::HISTOGRAM_BUCKETS - 1);
+  }
+
+  GIVEN("histogram quantiles") {
+    Histogram histogram;
+    CHECK(histogram.quantileNs(0.5) == 0);
+
+    // 1us .. 1000us
+    for (std::uint64_t us = 1; us <= 1000; us++) {
+      histogram.record(std::chrono::microseconds(us));
+    }
+    CHECK(histogram.count() == 1000);
+    CHECK(histogram.sumNs() == 500500 * 1000);
+
+    // relative error is at most 1 / HISTOGRAM_SUB_BUCKETS
+    const double maxError = 1.0 / Histogram::HISTOGRAM_SUB_BUCKETS;
+    CHECK(histogram.quantileNs(0.5) >= 500000);
+    CHECK(histogram.quantileNs(0.5) <= 500000 * (1.0 + maxError));
+    CHECK(histogram.quantileNs(0.99) >= 990000);
+    CHECK(histogram.quantileNs(0.99) <= 990000 * (1.0 + maxError));
+    CHECK(histogram.quantileNs(1.0) >= 1000000);
+
+    CHECK(histogram.countBelow(std::uint64_t(1) << 9) == 0);
+    CHECK(histogram.countBelow(std::uint64_t(1) << 10) == 1);
+    // 1us .. 262us are below 2^18 ns
+    CHECK(histogram.countBelow(std::uint64_t(1) << 18) == 262);
+  }
+}
+
+SCENARIO("metricsPrometheusFormat", "[Metrics]") {
+  using namespace boostander::metrics;
+  MetricsRegistry& registry = MetricsRegistry::instance();
+
+  Counter& counter =
+      registry.counter("test_requests_total", "Requests", {{"path", "/a\"b"}, {"code", "200"}});
+  CHECK(&counter == &registry.counter("test_requests_total", "Requests",
+                                      {{"code", "200"}, {"path", "/a\"b"}}));
+  counter.inc(3);
+  registry.gauge("test_depth", "Depth").add(-2);
+  registry.histogram("test_latency_seconds", "Latency", {{"op", "x"}}).record(3us);
+
+  const std::string text = registry.renderPrometheus();
+  CHECK_THAT(text, Contains("# HELP test_requests_total Requests\n"
+                            "# TYPE test_requests_total counter\n"
+                            "test_requests_total{code=\"200\",path=\"/a\\\"b\"} 3\n"));
+  CHECK_THAT(text, Contains("# TYPE test_depth gauge\ntest_depth -2\n"));
+  CHECK_THAT(text, Contains("# TYPE test_latency_seconds histogram\n"));
+  CHECK_THAT(text, Contains("test_latency_seconds_bucket{op=\"x\",le=\"2.048e-06\"} 0\n"));
+  CHECK_THAT(text, Contains("test_latency_seconds_bucket{op=\"x\",le=\"4.096e-06\"} 1\n"));
+  CHECK_THAT(text, Contains("test_latency_seconds_bucket{op=\"x\",le=\"+Inf\"} 1\n"));
+  CHECK_THAT(text, Contains("test_latency_seconds_sum{op=\"x\"} 3e-06\n"));
+  CHECK_THAT(text, Contains("test_latency_seconds_count{op=\"x\"} 1\n"));
+}
+
+SCENARIO("metricsEndpoint", "[Metrics]") {
+  using boostander::metrics::MetricsRegistry;
+  using boostander::net::MetricsListener;
+
+  MetricsRegistry::instance().counter("test_scraped_total", "Scraped counter").inc(7);
+
+  net::io_context ioc;
+  auto listener = std::make_shared<MetricsListener>(
+      ioc, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+  REQUIRE(listener->isAccepting());
+  listener->run();
+  const unsigned short port = listener->getLocalEndpoint().port();
+  std::thread iocThread([&ioc]() { ioc.run(); });
+
+  GIVEN("GET /metrics") {
+    const auto response = httpGet(port, "/metrics");
+    CHECK(response.result() == http::status::ok);
+    CHECK(std::string(response[http::field::content_type]) ==
+          "text/plain; version=0.0.4; charset=utf-8");
+    CHECK_THAT(response.body(), Contains("test_scraped_total 7\n"));
+  }
+
+  GIVEN("GET /trace") {
+    const auto response = httpGet(port, "/trace");
+    CHECK(response.result() == http::status::ok);
+    CHECK(std::string(response[http::field::content_type]) == "application/json");
+    CHECK_THAT(response.body(), Contains("\"traceEvents\":["));
+  }
+
+  GIVEN("unknown path") {
+    const auto response = httpGet(port, "/nothing");
+    CHECK(response.result() == http::status::not_found);
+  }
+
+  listener->stop();
+  iocThread.join();
+}
+
+SCENARIO("metricsTracing", "[Metrics]") {
+  using namespace boostander::metrics;
+  Tracer& tracer = Tracer::instance();
+
+  GIVEN("sampling") {
+    tracer.configure(0);
+    CHECK(!tracer.startTrace('t', Tracer::Clock::now()));
+
+    tracer.configure(3);
+    int sampled = 0;
+    for (int i = 0; i < 30; i++) {
+      if (tracer.startTrace('t', Tracer::Clock::now())) {
+        sampled++;
+      }
+    }
+    CHECK(sampled == 10);
+  }
+
+  GIVEN("message traced from read to written reply") {
+    tracer.configure(1);
+    const std::uint64_t finishedBefore = tracer.finishedCount();
+
+    std::shared_ptr<MessageTrace> trace = tracer.startTrace('t', Tracer::Clock::now());
+    REQUIRE(trace);
+    trace->stamp(TraceStage::DISPATCHED);
+    CHECK(!MessageTrace::current());
+
+    std::shared_ptr<MessageTrace> reply;
+    {
+      ScopedTrace scopedTrace(trace);
+      std::this_thread::sleep_for(1ms);
+      // as send() of a callback
+      reply = MessageTrace::current();
+      REQUIRE(reply == trace);
+      reply->stamp(TraceStage::SEND_QUEUED);
+    }
+    CHECK(!MessageTrace::current());
+
+    // the dispatch queue releases the callback, the reply is still queued
+    trace.reset();
+    CHECK(tracer.finishedCount() == finishedBefore);
+
+    reply->stamp(TraceStage::WRITE_STARTED);
+    reply->stamp(TraceStage::WRITTEN);
+    reply.reset();
+    CHECK(tracer.finishedCount() == finishedBefore + 1);
+
+    const std::string text = MetricsRegistry::instance().renderPrometheus();
+    CHECK_THAT(text,
+               Contains("ws_stage_duration_seconds_count{opcode=\"t\",stage=\"callback\"} 1\n"));
+    CHECK_THAT(text, Contains("ws_stage_duration_seconds_count{opcode=\"t\",stage=\"write\"} 1\n"));
+    CHECK_THAT(text, Contains("ws_stage_duration_seconds_count{opcode=\"t\",stage=\"total\"} 1\n"));
+    // the callback slept for 1ms
+    CHECK_THAT(text, Contains("ws_stage_duration_seconds_bucket{opcode=\"t\",stage=\"callback\","
+                              "le=\"0.000524288\"} 0\n"));
+
+    std::ostringstream chromeTrace;
+    tracer.writeChromeTrace(chromeTrace);
+    CHECK_THAT(chromeTrace.str(),
+               Contains("{\"name\":\"dispatch_wait\",\"cat\":\"ws\",\"ph\":\"b\""));
+    CHECK_THAT(chromeTrace.str(), Contains("{\"name\":\"reply\",\"cat\":\"ws\",\"ph\":\"e\""));
+  }
+
+  tracer.configure(0);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "config/ServerConfig.hpp"
+#include "net/RateLimiter.hpp"
+#include <chrono>
+#include <map>
+
+#include "testsCommon.h"
+
+SCENARIO("rateLimiter", "[RateLimiter]") {
+  using namespace boostander::net;
+  using boostander::config::RateLimit;
+  using namespace std::chrono_literals;
+  const auto start = TokenBucket::Clock::now();
+
+  GIVEN("a token bucket") {
+    TokenBucket bucket(10.0, 2.0, start);
+    // a full bucket takes a burst
+    REQUIRE(bucket.isAvailable(start));
+    bucket.take(1.0);
+    REQUIRE(bucket.isAvailable(start));
+    bucket.take(1.0);
+    CHECK_FALSE(bucket.isAvailable(start));
+
+    // refilled at the rate, up to the capacity
+    CHECK(bucket.isAvailable(start + 50ms));
+    bucket.take(1.0);
+    CHECK_FALSE(bucket.isAvailable(start + 50ms));
+    CHECK(bucket.isAvailable(start + 10s));
+    bucket.take(2.0);
+    CHECK_FALSE(bucket.isAvailable(start + 10s));
+  }
+
+  GIVEN("a debt") {
+    TokenBucket bucket(100.0, 100.0, start);
+    // larger than the capacity, passes at once and is repaid later
+    REQUIRE(bucket.isAvailable(start));
+    bucket.take(1000.0);
+    CHECK_FALSE(bucket.isAvailable(start + 5s));
+    CHECK(bucket.isAvailable(start + 10s + 1ms));
+  }
+
+  GIVEN("unlimited rate") {
+    TokenBucket bucket(0.0, 0.0, start);
+    bucket.take(1e9);
+    CHECK(bucket.isAvailable(start));
+  }
+
+  GIVEN("limits per opcode") {
+    std::map<char, RateLimit> limits;
+    limits['1'] = RateLimit{2.0, 0.0};
+    limits['3'] = RateLimit{0.0, 1000.0};
+    SessionRateLimiter limiter(limits, 1000ms);
+
+    CHECK(limiter.tryAcquire('1', 10, start));
+    CHECK(limiter.tryAcquire('1', 10, start));
+    CHECK_FALSE(limiter.tryAcquire('1', 10, start));
+    CHECK(limiter.tryAcquire('1', 10, start + 500ms));
+
+    // opcodes without limits always pass
+    for (int i = 0; i < 100; i++) {
+      REQUIRE(limiter.tryAcquire('0', 10, start));
+    }
+
+    // bytes: streamed fragments are charged after the message is acquired
+    CHECK(limiter.tryAcquire('3', 0, start));
+    limiter.charge('3', 1500, start);
+    CHECK_FALSE(limiter.tryAcquire('3', 0, start));
+    CHECK(limiter.tryAcquire('3', 0, start + 600ms));
+  }
+
+  GIVEN("limits of other opcodes") {
+    std::map<char, RateLimit> limits;
+    limits[boostander::config::ANY_OPCODE] = RateLimit{1.0, 0.0};
+    SessionRateLimiter limiter(limits, 1000ms);
+    CHECK(limiter.tryAcquire('0', 1, start));
+    CHECK_FALSE(limiter.tryAcquire('0', 1, start));
+    // every opcode has its own buckets
+    CHECK(limiter.tryAcquire('1', 1, start));
+  }
+}
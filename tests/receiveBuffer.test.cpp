@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "net/ReceiveBuffer.hpp"
+#include <boost/asio/buffer.hpp>
+#include <cstddef>
+
+#include "testsCommon.h"
+
+namespace {
+
+// Receives a message of size bytes as a websocket read does and consumes it
+void receive(boostander::net::ReceiveBuffer& buffer, std::size_t size) {
+  buffer.commit(boost::asio::buffer_size(buffer.prepare(size)));
+  buffer.consumeAll();
+}
+
+} // namespace
+
+SCENARIO("receiveBuffer", "[ReceiveBuffer]") {
+  using namespace boostander::net;
+
+  GIVEN("small messages") {
+    ReceiveBuffer buffer(64 * 1024);
+    receive(buffer, 100);
+    const auto data = buffer.data().data();
+    const std::size_t capacity = buffer.capacity();
+    CHECK(capacity >= 100);
+
+    // memory is kept across messages, no reallocations
+    for (std::size_t i = 0; i < 10 * ReceiveBuffer::SHRINK_PERIOD; i++) {
+      receive(buffer, 100 - i % 10);
+      CHECK(buffer.size() == 0);
+    }
+    CHECK(buffer.capacity() == capacity);
+    CHECK(buffer.data().data() == data);
+  }
+
+  GIVEN("a spike over the max capacity") {
+    ReceiveBuffer buffer(64 * 1024);
+    receive(buffer, 1024 * 1024);
+    // released right after the message
+    CHECK(buffer.capacity() == 0);
+  }
+
+  GIVEN("capacity between the min and the max") {
+    ReceiveBuffer buffer(64 * 1024);
+    receive(buffer, 32 * 1024);
+    REQUIRE(buffer.capacity() >= 32 * 1024);
+
+    // kept while it is used
+    for (std::size_t i = 0; i < 2 * ReceiveBuffer::SHRINK_PERIOD; i++) {
+      receive(buffer, i % 2 ? 16 * 1024 : 100);
+    }
+    CHECK(buffer.capacity() >= 32 * 1024);
+
+    // shrunk after a period of small messages
+    for (std::size_t i = 0; i < 2 * ReceiveBuffer::SHRINK_PERIOD; i++) {
+      receive(buffer, 100);
+    }
+    CHECK(buffer.capacity() == ReceiveBuffer::MIN_CAPACITY);
+  }
+
+  GIVEN("too small max capacity") {
+    ReceiveBuffer buffer(10);
+    CHECK(buffer.getMaxCapacity() == ReceiveBuffer::MIN_CAPACITY);
+  }
+}
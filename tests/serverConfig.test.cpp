@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "config/ServerConfig.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "testsCommon.h"
+
+namespace fs = std::filesystem; // from <filesystem>
+
+SCENARIO("serverConfigFromArgs", "[ServerConfig]") {
+  using boostander::config::ServerConfig;
+
+  // NOTE: no assets/server.conf in temp directory, defaults are used
+  const fs::path workdir = fs::temp_directory_path();
+  const fs::path configPath = workdir / "boostander_server_config_test.conf";
+  {
+    std::ofstream configFile(configPath);
+    configFile << "port = 9000\n"
+               << "threads = 4\n"
+               << "ping-interval = 30\n"
+               << "max-message-size = 1024\n";
+  }
+  const std::string configArg = configPath.string();
+
+  GIVEN("no options") {
+    ServerConfig serverConfig(workdir);
+    const char* argv[] = {"server"};
+    REQUIRE(serverConfig.loadFromArgs(1, argv));
+    CHECK(serverConfig.wsPort_ == 8080);
+    CHECK(serverConfig.pingInterval_ == std::chrono::seconds(15));
+    CHECK(serverConfig.idleTimeout_ == std::chrono::seconds(0));
+    // TLS is disabled without certificate
+    CHECK(serverConfig.tlsCertFile_.empty());
+    CHECK_FALSE(serverConfig.metricsEnabled_);
+    // every message is read as a whole
+    CHECK(serverConfig.streamOpcodes_.empty());
+    CHECK(serverConfig.deflateEnabled_);
+    CHECK(serverConfig.deflateWindowBits_ == 15);
+    // listening sockets are bound, not taken over
+    CHECK(serverConfig.handoffSocket_.empty());
+    CHECK(serverConfig.drainTimeout_ == std::chrono::seconds(30));
+    // no overload protection
+    CHECK(serverConfig.maxSessions_ == 0);
+    CHECK(serverConfig.busyQueuedMessages_ == 0);
+    CHECK(serverConfig.inlineOpcodes_ == "08");
+    CHECK(serverConfig.heavyOpcodes_ == "1");
+    CHECK(serverConfig.heavyThreads_ == 1);
+    CHECK(serverConfig.maxHeavyQueueSize_ == 64);
+    CHECK(serverConfig.csvProgressBytes_ == 1024 * 1024);
+    CHECK(serverConfig.dispatchQuantum_ == std::chrono::microseconds(1000));
+    CHECK(serverConfig.dispatchQuantumMessages_ == 0);
+    CHECK(serverConfig.rateLimits_.empty());
+  }
+
+  GIVEN("drain options") {
+    ServerConfig serverConfig(workdir);
+    const char* argv[] = {"server", "--drain-timeout", "5", "--handoff-socket", "/tmp/h.sock"};
+    REQUIRE(serverConfig.loadFromArgs(5, argv));
+    CHECK(serverConfig.drainTimeout_ == std::chrono::seconds(5));
+    CHECK(serverConfig.handoffSocket_ == "/tmp/h.sock");
+    const char* negativeTimeout[] = {"server", "--drain-timeout", "-1"};
+    CHECK_FALSE(serverConfig.loadFromArgs(3, negativeTimeout));
+  }
+
+  GIVEN("overload options") {
+    ServerConfig serverConfig(workdir);
+    const char* argv[] = {"server", "--max-sessions", "1000", "--max-sessions-per-ip", "10",
+                          "--busy-queued-messages", "5000", "--busy-cpu-percent", "90"};
+    REQUIRE(serverConfig.loadFromArgs(9, argv));
+    CHECK(serverConfig.maxSessions_ == 1000);
+    CHECK(serverConfig.maxSessionsPerAddress_ == 10);
+    CHECK(serverConfig.busyQueuedMessages_ == 5000);
+    CHECK(serverConfig.busyCpuPercent_ == 90);
+    const char* overCpu[] = {"server", "--busy-cpu-percent", "101"};
+    CHECK_FALSE(serverConfig.loadFromArgs(3, overCpu));
+  }
+
+  GIVEN("rate limits") {
+    ServerConfig serverConfig(workdir);
+    const char* argv[] = {"server", "--rate-limit", "1:5:10485760", "--rate-limit", "*:100:0",
+                          "--rate-limit-burst", "500"};
+    REQUIRE(serverConfig.loadFromArgs(7, argv));
+    REQUIRE(serverConfig.rateLimits_.size() == 2);
+    CHECK(serverConfig.rateLimits_.at('1').messagesPerSec == 5.0);
+    CHECK(serverConfig.rateLimits_.at('1').bytesPerSec == 10485760.0);
+    CHECK(serverConfig.rateLimits_.at(boostander::config::ANY_OPCODE).messagesPerSec == 100.0);
+    CHECK(serverConfig.rateLimits_.at(boostander::config::ANY_OPCODE).bytesPerSec == 0.0);
+    CHECK(serverConfig.rateLimitBurst_ == std::chrono::milliseconds(500));
+    const char* invalid[] = {"server", "--rate-limit", "1:5"};
+    CHECK_FALSE(serverConfig.loadFromArgs(3, invalid));
+    const char* negative[] = {"server", "--rate-limit", "1:-5:0"};
+    CHECK_FALSE(serverConfig.loadFromArgs(3, negative));
+  }
+
+  GIVEN("dispatch lanes and turns") {
+    ServerConfig serverConfig(workdir);
+    const char* argv[] = {"server", "--inline-opcodes", "02", "--heavy-opcodes", "",
+                          "--heavy-threads", "0", "--max-heavy-queue", "0",
+                          "--csv-progress-kb", "0"};
+    REQUIRE(serverConfig.loadFromArgs(11, argv));
+    CHECK(serverConfig.inlineOpcodes_ == "02");
+    CHECK(serverConfig.heavyOpcodes_.empty());
+    CHECK(serverConfig.heavyThreads_ == 0);
+    CHECK(serverConfig.maxHeavyQueueSize_ == 0);
+    CHECK(serverConfig.csvProgressBytes_ == 0);
+    const char* quantum[] = {"server", "--dispatch-quantum-us", "0",
+                             "--dispatch-quantum-messages", "16"};
+    REQUIRE(serverConfig.loadFromArgs(5, quantum));
+    CHECK(serverConfig.dispatchQuantum_.count() == 0);
+    CHECK(serverConfig.dispatchQuantumMessages_ == 16);
+    const char* negativeQuantum[] = {"server", "--dispatch-quantum-us", "-1"};
+    CHECK_FALSE(serverConfig.loadFromArgs(3, negativeQuantum));
+    const char* bothLanes[] = {"server", "--inline-opcodes", "01", "--heavy-opcodes", "1"};
+    CHECK_FALSE(serverConfig.loadFromArgs(5, bothLanes));
+    const char* negative[] = {"server", "--heavy-threads", "-1"};
+    CHECK_FALSE(serverConfig.loadFromArgs(3, negative));
+  }
+
+  GIVEN("deflate options") {
+    ServerConfig serverConfig(workdir);
+    const char* argv[] = {"server", "--deflate-window-bits", "10", "--deflate-mem-level", "1"};
+    REQUIRE(serverConfig.loadFromArgs(5, argv));
+    CHECK(serverConfig.deflateWindowBits_ == 10);
+    CHECK(serverConfig.deflateMemLevel_ == 1);
+    const char* smallWindow[] = {"server", "--deflate-window-bits", "8"};
+    CHECK_FALSE(serverConfig.loadFromArgs(3, smallWindow));
+  }
+
+  GIVEN("config file and command line") {
+    ServerConfig serverConfig(workdir);
+    const char* argv[] = {"server", "--config", configArg.c_str(), "--threads", "2",
+                          "--idle-timeout", "60", "--stream-opcodes", "1"};
+    REQUIRE(serverConfig.loadFromArgs(9, argv));
+    CHECK(serverConfig.wsPort_ == 9000);
+    CHECK(serverConfig.pingInterval_ == std::chrono::seconds(30));
+    CHECK(serverConfig.maxMessageSize_ == 1024);
+    CHECK(serverConfig.idleTimeout_ == std::chrono::seconds(60));
+    CHECK(serverConfig.streamOpcodes_ == "1");
+    // command line takes precedence
+    CHECK(serverConfig.threads_ == 2);
+  }
+
+  GIVEN("invalid options") {
+    ServerConfig serverConfig(workdir);
+    const char* zeroThreads[] = {"server", "--threads", "0"};
+    CHECK_FALSE(serverConfig.loadFromArgs(3, zeroThreads));
+    const char* badAddress[] = {"server", "--address", "not an address"};
+    CHECK_FALSE(serverConfig.loadFromArgs(3, badAddress));
+    const char* unknownOption[] = {"server", "--no-such-option"};
+    CHECK_FALSE(serverConfig.loadFromArgs(2, unknownOption));
+    const char* missingConfig[] = {"server", "--config", "no_such_dir/server.conf"};
+    CHECK_FALSE(serverConfig.loadFromArgs(3, missingConfig));
+    const char* certWithoutKey[] = {"server", "--tls-cert", "server.crt"};
+    CHECK_FALSE(serverConfig.loadFromArgs(3, certWithoutKey));
+  }
+
+  fs::remove(configPath);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+
+#include "testsServer.h" // IWYU pragma: associated
+#include "net/NetworkManager.hpp"
+#include "net/websockets/WsListener.hpp"
+#include "net/websockets/WsServer.hpp"
+#include <filesystem>
+#include <stdexcept>
+
+namespace boostander {
+namespace tests {
+
+namespace beast = boost::beast;         // from <boost/beast.hpp>
+namespace websocket = beast::websocket; // from <boost/beast/websocket.hpp>
+namespace net = boost::asio;            // from <boost/asio.hpp>
+using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
+
+config::ServerConfig localServerConfig() {
+  config::ServerConfig serverConfig(std::filesystem::current_path());
+  serverConfig.address_ = net::ip::make_address("127.0.0.1");
+  // NOTE Tell the socket to bind to port 0 - random port
+  serverConfig.wsPort_ = static_cast<unsigned short>(0);
+  serverConfig.wssPort_ = static_cast<unsigned short>(0);
+  serverConfig.metricsPort_ = static_cast<unsigned short>(0);
+  serverConfig.threads_ = 1;
+  return serverConfig;
+}
+
+TestServer::TestServer(const config::ServerConfig& serverConfig)
+    : nm_(std::make_shared<::boostander::net::NetworkManager>()) {
+  nm_->run(serverConfig);
+  port_ = nm_->getWS()->getWsListener()->getLocalEndpoint().port();
+}
+
+TestServer::~TestServer() {
+  // sessions keep timers and reads pending, stop the io_context instead of waiting for them
+  nm_->getWS()->ioc_.stop();
+  nm_->finish();
+}
+
+void TestServer::tick() { nm_->handleIncomingMessages(); }
+
+TestWsClient::TestWsClient() : ws_(ioc_) {}
+
+void TestWsClient::connect(unsigned short port) {
+  ws_.next_layer().connect(tcp::endpoint(net::ip::make_address("127.0.0.1"), port));
+  ws_.next_layer().set_option(tcp::no_delay(true));
+  ws_.handshake("127.0.0.1", "/");
+  ws_.text(true);
+}
+
+void TestWsClient::write(const std::string& message) { ws_.write(net::buffer(message)); }
+
+void TestWsClient::writeFragments(const std::vector<std::string>& fragments) {
+  for (std::size_t i = 0; i < fragments.size(); i++) {
+    ws_.write_some(i + 1 == fragments.size(), net::buffer(fragments[i]));
+  }
+}
+
+std::string TestWsClient::read(std::chrono::milliseconds timeout) {
+  buffer_.consume(buffer_.size());
+  beast::error_code result = net::error::timed_out;
+  ws_.async_read(buffer_, [&result](beast::error_code ec, std::size_t) { result = ec; });
+  ioc_.restart();
+  ioc_.run_for(timeout);
+  if (!ioc_.stopped()) {
+    // the read is aborted with the socket, the stream can not be used anymore
+    ws_.next_layer().close();
+    ioc_.run();
+  }
+  if (result) {
+    throw beast::system_error(result);
+  }
+  return beast::buffers_to_string(buffer_.data());
+}
+
+void TestWsClient::close() {
+  beast::error_code ec;
+  ws_.close(websocket::close_code::normal, ec);
+}
+
+} // namespace tests
+} // namespace boostander
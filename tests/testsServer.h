@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include "config/ServerConfig.hpp"
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace boostander {
+namespace net {
+class NetworkManager;
+} // namespace net
+} // namespace boostander
+
+namespace boostander {
+namespace tests {
+
+/**
+ * Loopback config: random port, one I/O thread
+ **/
+config::ServerConfig localServerConfig();
+
+/**
+ * NetworkManager running in-process on a loopback port.
+ * NOTE: there is no tick thread, messages of the tick lane wait for tick(),
+ * so tests decide what is received before the tick.
+ **/
+class TestServer {
+public:
+  explicit TestServer(const config::ServerConfig& serverConfig);
+
+  ~TestServer();
+
+  unsigned short port() const { return port_; }
+
+  // Dispatches received messages of the tick lane, as the tick thread of the server
+  void tick();
+
+  std::shared_ptr<net::NetworkManager> getNM() const { return nm_; }
+
+private:
+  std::shared_ptr<net::NetworkManager> nm_;
+
+  unsigned short port_ = 0;
+};
+
+/**
+ * Blocking WebSocket client, a read without an answer fails instead of hanging the test
+ **/
+class TestWsClient {
+public:
+  TestWsClient();
+
+  void connect(unsigned short port);
+
+  void write(const std::string& message);
+
+  // One message of the given fragments, a fragment may be empty
+  void writeFragments(const std::vector<std::string>& fragments);
+
+  // Throws if no message arrives within timeout
+  std::string read(std::chrono::milliseconds timeout = std::chrono::seconds(5));
+
+  void close();
+
+private:
+  boost::asio::io_context ioc_;
+
+  boost::beast::websocket::stream<boost::asio::ip::tcp::socket> ws_;
+
+  boost::beast::flat_buffer buffer_;
+};
+
+} // namespace tests
+} // namespace boostander
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "algo/TimerWheel.hpp"
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "testsCommon.h"
+
+namespace {
+
+using namespace std::chrono_literals;
+
+struct WheelItem {
+  using Clock = std::chrono::steady_clock;
+
+  explicit WheelItem(Clock::time_point deadline) : deadline_(deadline) {}
+
+  Clock::time_point deadline() const { return deadline_; }
+
+  void onDeadline() { firedCount_++; }
+
+  Clock::time_point deadline_;
+
+  std::size_t firedCount_ = 0;
+};
+
+using TimerWheel = boostander::algo::TimerWheel<WheelItem>;
+
+} // namespace
+
+SCENARIO("timerWheelExpiry", "[TimerWheel]") {
+  const auto start = WheelItem::Clock::now();
+  TimerWheel wheel(100ms, 8, start);
+
+  GIVEN("deadline within one revolution") {
+    auto item = std::make_shared<WheelItem>(start + 250ms);
+    wheel.schedule(item, item->deadline());
+    CHECK(wheel.size() == 1);
+
+    // never earlier than deadline
+    CHECK(wheel.advance(start + 200ms) == 0);
+    CHECK(item->firedCount_ == 0);
+
+    CHECK(wheel.advance(start + 300ms) == 1);
+    CHECK(item->firedCount_ == 1);
+    CHECK(wheel.size() == 0);
+
+    // fired items are removed
+    CHECK(wheel.advance(start + 5s) == 0);
+    CHECK(item->firedCount_ == 1);
+  }
+
+  GIVEN("deadline after several revolutions") {
+    auto item = std::make_shared<WheelItem>(start + 2s);
+    wheel.schedule(item, item->deadline());
+
+    CHECK(wheel.advance(start + 1s) == 0);
+    CHECK(wheel.advance(start + 1900ms) == 0);
+    CHECK(wheel.advance(start + 2s) == 1);
+  }
+
+  GIVEN("deadline moved after schedule") {
+    auto item = std::make_shared<WheelItem>(start + 250ms);
+    wheel.schedule(item, item->deadline());
+    item->deadline_ = start + 1500ms;
+
+    CHECK(wheel.advance(start + 300ms) == 0);
+    CHECK(wheel.size() == 1);
+    CHECK(wheel.advance(start + 1400ms) == 0);
+    CHECK(wheel.advance(start + 1500ms) == 1);
+    CHECK(item->firedCount_ == 1);
+  }
+
+  GIVEN("destroyed item") {
+    auto item = std::make_shared<WheelItem>(start + 100ms);
+    wheel.schedule(item, item->deadline());
+    item.reset();
+
+    CHECK(wheel.advance(start + 1s) == 0);
+    CHECK(wheel.size() == 0);
+  }
+
+  GIVEN("many items") {
+    std::vector<std::shared_ptr<WheelItem>> items;
+    for (std::size_t i = 0; i < 1000; i++) {
+      items.push_back(std::make_shared<WheelItem>(start + std::chrono::milliseconds(i)));
+      wheel.schedule(items.back(), items.back()->deadline());
+    }
+
+    // deadlines are rounded up to the granularity
+    CHECK(wheel.advance(start + 499ms) == 401);
+    CHECK(wheel.advance(start + 1s) == 599);
+    for (const auto& item : items) {
+      CHECK(item->firedCount_ == 1);
+    }
+  }
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2019 Denis Trofimov (den.a.trofimov@yandex.ru)
+ * Distributed under the MIT License.
+ * See accompanying file LICENSE.md or copy at http://opensource.org/licenses/MIT
+ */
+#include "algo/NetworkOperation.hpp"
+#include "net/NetworkManager.hpp"
+#include "net/websockets/WsListener.hpp"
+#include "net/websockets/WsServer.hpp"
+#include "net/websockets/WsSession.hpp"
+#include <boost/asio.hpp>
+#include <chrono>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "testsCommon.h"
+#include "testsServer.h"
+
+namespace {
+
+using boostander::algo::Opcodes;
+using boostander::algo::WS_OPCODE;
+
+const std::string CSV_ROW = "20.10.1995 22:15:14,1.5,2.5\n";
+
+// CSV_ANALIZE of rows, answered with CSV_ANSWER and the rows count
+std::string csvAnalize(int rows) {
+  std::string message = Opcodes::opcodeToStr(WS_OPCODE::CSV_ANALIZE);
+  for (int i = 0; i < rows; i++) {
+    message += CSV_ROW;
+  }
+  return message;
+}
+
+// PING is answered by the I/O thread, in order with the messages received before it
+std::string ping(const std::string& payload) {
+  return Opcodes::opcodeToStr(WS_OPCODE::PING) + payload;
+}
+
+} // namespace
+
+SCENARIO("streamedCsvCancel", "[WsSession]") {
+  using namespace boostander::tests;
+
+  auto serverConfig = localServerConfig();
+  serverConfig.streamOpcodes_ = "1";
+  // CSV_ANALIZE waits for the tick
+  serverConfig.heavyOpcodes_.clear();
+  TestServer server(serverConfig);
+
+  TestWsClient client;
+  client.connect(server.port());
+
+  GIVEN("a cancel received before the tick") {
+    client.write(csvAnalize(3));
+    client.write(Opcodes::opcodeToStr(WS_OPCODE::CSV_CANCEL));
+    client.write(ping("cancelled"));
+    REQUIRE(client.read() == ping("cancelled"));
+    server.tick();
+    // partial results
+    CHECK(client.read().at(0) == static_cast<char>(WS_OPCODE::CSV_CANCEL));
+
+    // a message started after the cancel is not cancelled by it
+    client.write(csvAnalize(2));
+    client.write(ping("next"));
+    REQUIRE(client.read() == ping("next"));
+    server.tick();
+    CHECK(client.read() == Opcodes::opcodeToStr(WS_OPCODE::CSV_ANSWER) + "2");
+  }
+
+  client.close();
+}
+
+SCENARIO("streamedMessages", "[WsSession]") {
+  using namespace boostander::tests;
+
+  auto serverConfig = localServerConfig();
+  serverConfig.streamOpcodes_ = "1";
+  serverConfig.heavyOpcodes_.clear();
+  // every fed fragment is reported, buffered messages report only when the tick runs them
+  serverConfig.csvProgressBytes_ = 1;
+  TestServer server(serverConfig);
+
+  TestWsClient client;
+  client.connect(server.port());
+
+  GIVEN("a streamed message mixed with buffered ones") {
+    // the mode is taken from the opcode, not from the empty first frame
+    client.writeFragments({"", Opcodes::opcodeToStr(WS_OPCODE::CSV_ANALIZE), CSV_ROW, CSV_ROW});
+    client.writeFragments({Opcodes::opcodeToStr(WS_OPCODE::CSV_CHUNK), CSV_ROW, CSV_ROW, CSV_ROW});
+    client.write(Opcodes::opcodeToStr(WS_OPCODE::CSV_CHUNK_END));
+    client.writeFragments({ping(""), "frag", "mented"});
+
+    int progressReplies = 0;
+    std::string reply = client.read();
+    for (; reply.at(0) == static_cast<char>(WS_OPCODE::CSV_PROGRESS); reply = client.read()) {
+      progressReplies++;
+    }
+    // fed by the I/O thread before the tick
+    CHECK(progressReplies > 0);
+    CHECK(reply == ping("fragmented"));
+
+    server.tick();
+    CHECK(client.read() == Opcodes::opcodeToStr(WS_OPCODE::CSV_ANSWER) + "2");
+    CHECK(client.read() == Opcodes::opcodeToStr(WS_OPCODE::CSV_ANSWER) + "3");
+  }
+
+  client.close();
+}
+
+SCENARIO("dispatchLanes", "[WsSession]") {
+  using namespace boostander::tests;
+
+  auto serverConfig = localServerConfig();
+
+  GIVEN("an inline message behind a message of the tick lane") {
+    serverConfig.heavyOpcodes_.clear();
+    TestServer server(serverConfig);
+    TestWsClient client;
+    client.connect(server.port());
+
+    client.write(csvAnalize(1));
+    client.write(ping("inline"));
+    // answered without a tick
+    CHECK(client.read() == ping("inline"));
+    server.tick();
+    CHECK(client.read() == Opcodes::opcodeToStr(WS_OPCODE::CSV_ANSWER) + "1");
+    client.close();
+  }
+
+  GIVEN("heavy messages of a session on several heavy threads") {
+    serverConfig.heavyThreads_ = 4;
+    TestServer server(serverConfig);
+    TestWsClient client;
+    client.connect(server.port());
+
+    constexpr int MESSAGES = 16;
+    for (int rows = 1; rows <= MESSAGES; rows++) {
+      client.write(csvAnalize(rows));
+    }
+    // in order of the session, without a tick
+    for (int rows = 1; rows <= MESSAGES; rows++) {
+      CHECK(client.read() == Opcodes::opcodeToStr(WS_OPCODE::CSV_ANSWER) + std::to_string(rows));
+    }
+    client.close();
+  }
+
+  GIVEN("the heavy queue is full") {
+    serverConfig.heavyThreads_ = 1;
+    serverConfig.maxHeavyQueueSize_ = 1;
+    TestServer server(serverConfig);
+    TestWsClient client;
+    client.connect(server.port());
+
+    // the only heavy thread is busy, the first message takes the queue
+    std::promise<void> release;
+    boost::asio::post(*server.getNM()->getWS()->getHeavyPool(),
+                      [busy = release.get_future()]() { busy.wait(); });
+    client.write(csvAnalize(1));
+    client.write(csvAnalize(2));
+    CHECK(client.read() ==
+          Opcodes::opcodeToStr(WS_OPCODE::BUSY) + Opcodes::opcodeToStr(WS_OPCODE::CSV_ANALIZE));
+
+    release.set_value();
+    CHECK(client.read() == Opcodes::opcodeToStr(WS_OPCODE::CSV_ANSWER) + "1");
+    client.close();
+  }
+}
+
+SCENARIO("coroSessionEcho", "[WsCoroSession]") {
+  using namespace boostander::tests;
+
+  auto serverConfig = localServerConfig();
+  serverConfig.wsCoroSessions_ = true;
+  serverConfig.heavyOpcodes_.clear();
+  TestServer server(serverConfig);
+
+  TestWsClient client;
+  client.connect(server.port());
+
+  client.write(ping("coro"));
+  CHECK(client.read() == ping("coro"));
+
+  client.write(csvAnalize(3));
+  client.write(ping("sync"));
+  REQUIRE(client.read() == ping("sync"));
+  server.tick();
+  CHECK(client.read() == Opcodes::opcodeToStr(WS_OPCODE::CSV_ANSWER) + "3");
+
+  client.close();
+}
+
+SCENARIO("connectAsClient", "[WsSession]") {
+  using namespace boostander::tests;
+  using boostander::net::WsSession;
+
+  // sessions of the client side are created by its listener, as by the client program
+  TestServer clientSide(localServerConfig());
+  auto session = clientSide.getNM()->getWS()->getWsListener()->addClientSession("client");
+  REQUIRE(session);
+
+  std::promise<boost::beast::error_code> connected;
+  const WsSession::ConnectHandler onConnected = [&connected](boost::beast::error_code ec) {
+    connected.set_value(ec);
+  };
+  constexpr std::size_t MAX_WAIT_MS = 5000;
+
+  GIVEN("a server") {
+    TestServer server(localServerConfig());
+    session->connectAsClient("127.0.0.1", std::to_string(server.port()), onConnected);
+    CHECK(session->waitForConnect(MAX_WAIT_MS));
+    CHECK_FALSE(connected.get_future().get());
+    session->close();
+  }
+
+  GIVEN("a refused connection") {
+    unsigned short closedPort = 0;
+    {
+      boost::asio::io_context ioc;
+      boost::asio::ip::tcp::acceptor acceptor(
+          ioc, {boost::asio::ip::make_address("127.0.0.1"), static_cast<unsigned short>(0)});
+      closedPort = acceptor.local_endpoint().port();
+    }
+    const auto start = std::chrono::steady_clock::now();
+    session->connectAsClient("127.0.0.1", std::to_string(closedPort), onConnected);
+    CHECK_FALSE(session->waitForConnect(MAX_WAIT_MS));
+    // returned by the failure, not by the timeout
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(MAX_WAIT_MS));
+    CHECK(connected.get_future().get() == boost::asio::error::connection_refused);
+  }
+}